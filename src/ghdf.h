@@ -22,6 +22,7 @@ extern "C" {
 const char *hdf_data_type_name(int32);
 size_t hdf_data_type_size(int32);
 int hdf_scaler_to_string(int32, void *, int, char *, int);
+int hdf_scaler_to_double(int32, void *, int, double *);
 int hdf_array_to_string(int32, void *, int32, char *, int);
 
 
@@ -63,6 +63,10 @@ int hdf5_scaler_to_string(hid_t datatype_id, H5T_class_t data_class,
           case H5T_INTEGER:
           case H5T_FLOAT:
                native_type = H5Tget_native_type(datatype_id, H5T_DIR_ASCEND);
+               if (native_type < 0) {
+                    fprintf(stderr, "ERROR: H5Tget_native_type()\n");
+                    return -1;
+               }
                if (H5Tequal(native_type, H5T_NATIVE_CHAR))
                     n = snprintf(temp, length, "%d",   ((char *)       ptr)[i]);
                else if (H5Tequal(native_type, H5T_NATIVE_SHORT))
@@ -93,6 +97,11 @@ int hdf5_scaler_to_string(hid_t datatype_id, H5T_class_t data_class,
 */
                else {
                     fprintf(stderr, "ERROR: Invalid HDF5 native type.\n");
+                    H5Tclose(native_type);
+                    return -1;
+               }
+               if (H5Tclose(native_type) < 0) {
+                    fprintf(stderr, "ERROR: H5Tclose()\n");
                     return -1;
                }
                break;
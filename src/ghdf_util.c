@@ -141,6 +141,45 @@ int hdf_scaler_to_string(int32 data_type, void *ptr, int i, char *temp, int leng
 
 
 
+/*******************************************************************************
+ *
+ ******************************************************************************/
+int hdf_scaler_to_double(int32 data_type, void *ptr, int i, double *value) {
+
+     switch(data_type) {
+          case DFNT_INT8:
+               *value = ((int8 *) ptr)[i];
+               break;
+          case DFNT_UINT8:
+               *value = ((uint8 *) ptr)[i];
+               break;
+          case DFNT_INT16:
+               *value = ((int16 *) ptr)[i];
+               break;
+          case DFNT_UINT16:
+               *value = ((uint16 *) ptr)[i];
+               break;
+          case DFNT_INT32:
+               *value = ((int32 *) ptr)[i];
+               break;
+          case DFNT_UINT32:
+               *value = ((uint32 *) ptr)[i];
+               break;
+          case DFNT_FLOAT32:
+               *value = ((float32 *) ptr)[i];
+               break;
+          case DFNT_FLOAT64:
+               *value = ((float64 *) ptr)[i];
+               break;
+          default:
+               return -1;
+     }
+
+     return 0;
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
@@ -20,7 +20,9 @@ extern "C" {
 const char *netcdf_data_type_name(nc_type);
 size_t netcdf_data_type_size(nc_type);
 int netcdf_scaler_to_string(nc_type data_type, void *ptr, int i, char *temp, int length);
+int netcdf_scaler_to_double(nc_type data_type, void *ptr, int i, double *value);
 int netcdf_array_to_string(nc_type data_type, void *ptr, int count, char *string, int length);
+int netcdf_inq_varid_path(int nc_id, const char *var_name, int *grp_id, int *var_id);
 
 
 #ifdef __cplusplus
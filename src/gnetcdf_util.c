@@ -136,6 +136,51 @@ int netcdf_scaler_to_string(nc_type data_type, void *ptr, int i, char *temp, int
 
 
 
+/*******************************************************************************
+ *
+ ******************************************************************************/
+int netcdf_scaler_to_double(nc_type data_type, void *ptr, int i, double *value) {
+
+     switch(data_type) {
+          case NC_BYTE:
+               *value = ((int8_t *) ptr)[i];
+               break;
+          case NC_UBYTE:
+               *value = ((uint8_t *) ptr)[i];
+               break;
+          case NC_SHORT:
+               *value = ((int16_t *) ptr)[i];
+               break;
+          case NC_USHORT:
+               *value = ((uint16_t *) ptr)[i];
+               break;
+          case NC_INT:
+               *value = ((int32_t *) ptr)[i];
+               break;
+          case NC_UINT:
+               *value = ((uint32_t *) ptr)[i];
+               break;
+          case NC_INT64:
+               *value = ((int64_t *) ptr)[i];
+               break;
+          case NC_UINT64:
+               *value = ((uint64_t *) ptr)[i];
+               break;
+          case NC_FLOAT:
+               *value = ((float *) ptr)[i];
+               break;
+          case NC_DOUBLE:
+               *value = ((double *) ptr)[i];
+               break;
+          default:
+               return -1;
+     }
+
+     return 0;
+}
+
+
+
 /*******************************************************************************
  *
  ******************************************************************************/
@@ -188,3 +233,41 @@ int netcdf_array_to_string(nc_type data_type, void *ptr, int count, char *string
 
      return n_save;
 }
+
+
+
+/*******************************************************************************
+ * Like nc_inq_varid() but variables in subgroups may be named by their full
+ * path, e.g. /group/var, in which case grp_id is set to the id of the group.
+ ******************************************************************************/
+int netcdf_inq_varid_path(int nc_id, const char *var_name, int *grp_id, int *var_id) {
+
+     char *grp_name;
+
+     const char *base_name;
+
+     int status;
+
+     base_name = strrchr(var_name, '/');
+     if (base_name == NULL) {
+          *grp_id = nc_id;
+          return nc_inq_varid(nc_id, var_name, var_id);
+     }
+
+     if (base_name == var_name)
+          grp_name = strdup("/");
+     else {
+          grp_name = (char *) malloc(base_name - var_name + 1);
+          memcpy(grp_name, var_name, base_name - var_name);
+          grp_name[base_name - var_name] = '\0';
+     }
+
+     status = nc_inq_grp_full_ncid(nc_id, grp_name, grp_id);
+
+     free(grp_name);
+
+     if (status != NC_NOERR)
+          return status;
+
+     return nc_inq_varid(*grp_id, base_name + 1, var_id);
+}
@@ -9,33 +9,33 @@
 
 #include <ghdf5.h>
 
+#include <qlist.h>
+#include <qmutex.h>
+#include <qvector.h>
+
 #include "xdfv.h"
 #include "hdf5tableview.h"
+#include "xdfstatistics.h"
+#include "xdftilecache.h"
 
 
 HDF5TableView::HDF5TableView(const char *file_name, const char *dataset_name,
                              QWidget *parent)
-    : XDFTableView(parent), file_name(file_name), dataset_name(dataset_name)
+    : XDFTableView(XDFV::HDF5, parent), file_name(file_name), dataset_name(dataset_name),
+      handle(NULL), datatype_id(-1), cell_type(XDFKernel::Unknown), has_vlen(false),
+      use_members(false), first_member(0), member_step(1), n_dims(0), use_tiles(false)
 {
-    int n_dims;
-
-    hid_t file_id;
-    hid_t dataset_id;
+    hid_t type_id;
     hid_t dataspace_id;
 
-    file_id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0) {
-        fprintf(stderr, "ERROR: H5Fopen(), file_name = %s\n", file_name);
-        exit(1);
-    }
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF5));
 
-    dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
-    if (dataset_id < 0) {
-        fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", dataset_name);
+    handle = XDFHandlePool::instance()->acquire(XDFHandlePool::HDF5Dataset,
+                                                file_name, dataset_name);
+    if (handle == NULL)
         exit(1);
-    }
 
-    dataspace_id = H5Dget_space(dataset_id);
+    dataspace_id = H5Dget_space(handle->id);
     if (dataspace_id < 0) {
         fprintf(stderr, "ERROR: H5Dget_space(), dataset_name = %s\n", dataset_name);
         exit(1);
@@ -52,17 +52,27 @@ HDF5TableView::HDF5TableView(const char *file_name, const char *dataset_name,
         exit(1);
     }
 
-    if (H5Dclose(dataset_id) < 0) {
-        fprintf(stderr, "ERROR: H5Dclose(), dataset_name = %s\n", dataset_name);
+    type_id = H5Dget_type(handle->id);
+    if (type_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_type(), dataset_name = %s\n", dataset_name);
         exit(1);
     }
 
-    if (H5Fclose(file_id) < 0) {
-        fprintf(stderr, "ERROR: H5Fclose(), file_name = %s\n", file_name);
+    /*
+     * The members of a compound are an extra last dimension of the slice, as
+     * the fields of an HDF4 vdata are, so that each member is a column.
+     */
+    use_members = H5Tget_class(type_id) == H5T_COMPOUND && n_dims < 8;
+
+    if (H5Tclose(type_id) < 0) {
+        fprintf(stderr, "ERROR: H5Tclose(), dataset_name = %s\n", dataset_name);
         exit(1);
     }
 
-    buildWidget(dataset_name, n_dims);
+    QObject::connect(XDFHandlePool::instance(), SIGNAL(invalidated(const QByteArray &)),
+                     this, SLOT(releaseStaleHandle()));
+
+    buildWidget(dataset_name, use_members ? n_dims + 1 : n_dims);
 
     refreshTable();
 }
@@ -71,20 +81,64 @@ HDF5TableView::HDF5TableView(const char *file_name, const char *dataset_name,
 
 HDF5TableView::~HDF5TableView()
 {
+    stopPrefetch();
 
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF5));
+
+    if (datatype_id >= 0 && H5Tclose(datatype_id) < 0)
+        fprintf(stderr, "ERROR: H5Tclose(), dataset_name = %s\n", dataset_name);
+
+    XDFHandlePool::instance()->release(handle);
+}
+
+
+
+/*
+ * Gets the dataset from the XDFHandlePool, again if its file has been
+ * reloaded.
+ */
+int HDF5TableView::openDataset()
+{
+    if (handle != NULL && ! handle->is_stale)
+        return 0;
+
+    XDFHandlePool::instance()->release(handle);
+
+    handle = XDFHandlePool::instance()->acquire(XDFHandlePool::HDF5Dataset,
+                                                file_name, dataset_name);
+    if (handle == NULL)
+        return -1;
+
+    return 0;
+}
+
+
+
+/*
+ * Lets go of the dataset once its file has been reloaded so that the file is
+ * closed before it is scanned again.  It is opened again on the next read.
+ */
+void HDF5TableView::releaseStaleHandle()
+{
+    if (handle != NULL && handle->is_stale) {
+        XDFHandlePool::instance()->release(handle);
+        handle = NULL;
+    }
 }
 
 
 
 int HDF5TableView::parseSlice(int n_dims, const hsize_t *dims,
                               int *i_row, int *n_rows, int *i_col, int *n_cols,
-                              hsize_t *offset, hsize_t *count, hsize_t *length)
+                              hsize_t *offset, hsize_t *count, hsize_t *stride,
+                              hsize_t *length)
 {
     int r = 0;
 
     size_t *dims_   = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t *offset_ = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t *count_  = (size_t *) malloc(n_dims * sizeof(size_t));
+    size_t *stride_ = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t length_;
 
     dims_[0] = 0;
@@ -92,10 +146,11 @@ int HDF5TableView::parseSlice(int n_dims, const hsize_t *dims,
         dims_[i] = dims[i];
 
     if (! XDFTableView::parseSlice(n_dims, dims_, i_row, n_rows, i_col, n_cols,
-                                   offset_, count_, &length_)) {
+                                   offset_, count_, stride_, &length_)) {
         for (int i = 0; i < n_dims; ++i) {
             offset[i] = offset_[i];
             count [i] = count_ [i];
+            stride[i] = stride_[i];
         }
 
         *length = length_;
@@ -106,53 +161,116 @@ int HDF5TableView::parseSlice(int n_dims, const hsize_t *dims,
     free(dims_);
     free(offset_);
     free(count_);
+    free(stride_);
 
     return r;
 }
 
 
 
-void HDF5TableView::refreshTable()
+/*
+ * Tiles are the chunks of the dataset from its creation property list.  For
+ * datasets that are not chunked tiles are made up of up to max_tile_side rows
+ * and columns of the last two dimensions.  Tiles are not used for scalars, for
+ * variable length types, which point to memory owned by the reads, or if a
+ * tile would take more than a quarter of the cache.
+ */
+int HDF5TableView::tileShape(hid_t dataset_id)
 {
-    char *temp;
+    int i;
+
+    hid_t plist_id;
 
+    size_t size;
+
+    hsize_t chunk_dims[8];
+
+    use_tiles = false;
+
+    if (n_dims == 0)
+        return 0;
+
+    if (H5Tdetect_class(datatype_id, H5T_VLEN) > 0 || H5Tis_variable_str(datatype_id) > 0)
+        return 0;
+
+    plist_id = H5Dget_create_plist(dataset_id);
+    if (plist_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_create_plist(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if (H5Pget_layout(plist_id) == H5D_CHUNKED) {
+        if (H5Pget_chunk(plist_id, n_dims, chunk_dims) < 0) {
+            fprintf(stderr, "ERROR: H5Pget_chunk(), dataset_name = %s\n", dataset_name);
+            return -1;
+        }
+
+        for (i = 0; i < n_dims; ++i)
+            tile_dims[i] = chunk_dims[i];
+    }
+    else {
+        for (i = 0; i < n_dims; ++i) {
+            if (i < n_dims - 2)
+                tile_dims[i] = 1;
+            else
+                tile_dims[i] = dims[i] < max_tile_side ? dims[i] : max_tile_side;
+        }
+    }
+
+    if (H5Pclose(plist_id) < 0) {
+        fprintf(stderr, "ERROR: H5Pclose(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    size = data_size;
+    for (i = 0; i < n_dims; ++i) {
+        if (tile_dims[i] == 0)
+            return 0;
+        size *= tile_dims[i];
+    }
+
+    use_tiles = size <= XDFTileCache::maxSize() / 4;
+
+    dataset_key = XDFTileCache::datasetKey(file_name, dataset_name);
+
+    return 0;
+}
+
+
+
+/*
+ * Only the shape and type of the dataset are read here.  The cells are read
+ * as they are displayed by readBlock().  The datatype is kept for formatting.
+ */
+void HDF5TableView::refreshTable()
+{
     int i_row;
     int n_rows;
     int i_col;
     int n_cols;
 
-    int n_dims;
+    bool has_fill;
 
-    size_t data_size;
+    double fill_value = 0.;
 
-    void *data;
-    void *ptr;
-
-    hid_t file_id;
     hid_t dataset_id;
-    hid_t datatype_id;
     hid_t filespace_id;
-    hid_t memspace_id;
 
     hsize_t length;
 
-    hsize_t *dims;
     hsize_t offset[8];
     hsize_t count[8];
+    hsize_t stride[8];
 
-    H5T_class_t data_class;
-
-    temp = (char *) malloc(LN * sizeof(char));
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF5));
 
-    file_id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file_id < 0) {
-        fprintf(stderr, "ERROR: H5Fopen(), file_name = %s\n", file_name);
+    if (openDataset() < 0)
         exit(1);
-    }
 
-    dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
-    if (dataset_id < 0) {
-        fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", dataset_name);
+    dataset_id = handle->id;
+
+    if (datatype_id >= 0 && H5Tclose(datatype_id) < 0) {
+        fprintf(stderr, "ERROR: H5Tclose(), dataset_name = %s\n", dataset_name);
         exit(1);
     }
 
@@ -174,6 +292,21 @@ void HDF5TableView::refreshTable()
         exit(1);
     }
 
+    cell_type = XDFKernel::hdf5Type(datatype_id);
+
+    has_vlen = H5Tdetect_class(datatype_id, H5T_VLEN) > 0 ||
+               H5Tis_variable_str(datatype_id) > 0;
+
+    has_fill = (data_class == H5T_INTEGER || data_class == H5T_FLOAT) &&
+               XDFStatistics::hdf5FillValue(dataset_id, &fill_value);
+    setFillValue(has_fill, fill_value);
+
+    if (plan.init(datatype_id) < 0) {
+        fprintf(stderr, "ERROR: XDFMemberPlan::init(), dataset_name = %s\n", dataset_name);
+        if (use_members)
+            exit(1);
+    }
+
     filespace_id = H5Dget_space(dataset_id);
     if (filespace_id < 0) {
         fprintf(stderr, "ERROR: H5Dget_space(), dataset_name = %s\n", dataset_name);
@@ -185,78 +318,443 @@ void HDF5TableView::refreshTable()
         fprintf(stderr, "ERROR: H5Sget_simple_extent_ndims(), dataset_name = %s\n", dataset_name);
         exit(1);
     }
-    dims = (hsize_t *) malloc(n_dims * sizeof(hsize_t));
     n_dims = H5Sget_simple_extent_dims(filespace_id, dims, NULL);
     if (n_dims < 0) {
         fprintf(stderr, "ERROR: H5Sget_simple_extent_dims(), dataset_name = %s\n", dataset_name);
         exit(1);
     }
 
-    if (! parseSlice(n_dims, dims, &i_row, &n_rows, &i_col, &n_cols, offset, count, &length)) {
+    if (tileShape(dataset_id) < 0)
+        exit(1);
 
-        memspace_id = H5Screate_simple(n_dims, count, NULL);
-        if (memspace_id < 0) {
-            fprintf(stderr, "ERROR: H5Screate_simple(), dataset_name = %s\n", dataset_name);
-            exit(1);
-        }
+    if (chunk_reader.init(dataset_id) < 0)
+        exit(1);
 
-        data = malloc(length * data_size);
-        if (data == NULL) {
-            fprintf(stderr, "ERROR: Memory allocation failed, attr_name = %s\n", dataset_name);
-            exit(1);
+    if (! use_members) {
+        if (! parseSlice(n_dims, dims, &i_row, &n_rows, &i_col, &n_cols, offset, count,
+                         stride, &length))
+            configureTable(i_row, n_rows, i_col, n_cols,
+                           has_vlen ? max_text_size : data_size);
+    }
+    else {
+        dims[n_dims] = plan.count();
+
+        if (! parseSlice(n_dims + 1, dims, &i_row, &n_rows, &i_col, &n_cols, offset, count,
+                         stride, &length)) {
+            /*
+             * Each cell holds one member copied out of its element.  If the
+             * members are not the columns they are all the same member.
+             */
+            first_member = offset[n_dims];
+            member_step  = count[n_dims] > 1 ? stride[n_dims] : 0;
+
+            QStringList h_labels;
+            if (count[n_dims] == (hsize_t) n_cols) {
+                for (int i = 0; i < n_cols; ++i)
+                    h_labels << plan.member(first_member + i * member_step).name.constData();
+            }
+            configureTable(i_row, n_rows, i_col, n_cols,
+                           has_vlen ? max_text_size : plan.maxMemberSize(), NULL,
+                           h_labels.isEmpty() ? NULL : &h_labels);
         }
+    }
 
-        if (n_dims > 0) {
-            if (H5Sselect_hyperslab(filespace_id, H5S_SELECT_SET, offset, NULL, count, NULL) < 0) {
-                fprintf(stderr, "ERROR: H5Sselect_hyperslab(), dataset_name = %s\n", dataset_name);
-                exit(1);
-            }
+    if (H5Sclose(filespace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
+        exit(1);
+    }
+}
+
+
+
+/*
+ * Reads the hyperslab at offset of count elements every stride elements, or
+ * every element if stride is NULL, into data.
+ */
+int HDF5TableView::readSlab(hid_t dataset_id, const size_t *offset_,
+                            const size_t *count_, const size_t *stride_, void *data)
+{
+    int i;
+
+    hid_t filespace_id;
+    hid_t memspace_id;
+
+    hsize_t offset[8];
+    hsize_t count[8];
+    hsize_t stride[8];
+
+    for (i = 0; i < n_dims; ++i) {
+        offset[i] = offset_[i];
+        count [i] = count_ [i];
+        stride[i] = stride_ ? stride_[i] : 1;
+    }
+
+    filespace_id = H5Dget_space(dataset_id);
+    if (filespace_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_space(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    memspace_id = H5Screate_simple(n_dims, count, NULL);
+    if (memspace_id < 0) {
+        fprintf(stderr, "ERROR: H5Screate_simple(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if (n_dims > 0) {
+        if (H5Sselect_hyperslab(filespace_id, H5S_SELECT_SET, offset, stride, count, NULL) < 0) {
+            fprintf(stderr, "ERROR: H5Sselect_hyperslab(), dataset_name = %s\n", dataset_name);
+            return -1;
         }
+    }
 
-        if (H5Dread(dataset_id, datatype_id, memspace_id, filespace_id, H5P_DEFAULT, data) < 0) {
-            fprintf(stderr, "ERROR: H5Dread(), dataset_name = %s\n", dataset_name);
-            exit(1);
+    if (H5Dread(dataset_id, datatype_id, memspace_id, filespace_id, H5P_DEFAULT, data) < 0) {
+        fprintf(stderr, "ERROR: H5Dread(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if (H5Sclose(memspace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if (H5Sclose(filespace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * The elements of a block are put together from the tiles that overlap it.
+ * Tiles that are not in the XDFTileCache are read whole and added to it, so
+ * that the neighboring blocks, and other views of the dataset, find them
+ * there.  For compressed datasets the missing tiles, which are then the
+ * chunks, are read together with the XDFChunkReader so that they are
+ * decompressed in parallel.  Strided slices are read directly so that only
+ * the selected elements are read.
+ */
+int HDF5TableView::readElements(const size_t *offset, const size_t *count,
+                                const size_t *stride, void *data)
+{
+    int i;
+    int j;
+
+    hid_t dataset_id;
+
+    size_t first[8];
+    size_t last[8];
+    size_t coords[8];
+
+    size_t size;
+
+    bool strided;
+
+    QByteArray key;
+
+    QList<QByteArray> keys;
+    QList<QByteArray> tiles;
+    QVector<size_t> tile_offsets;
+    QVector<size_t> tile_counts;
+
+    QVector<int> missing;
+    QVector<size_t> missing_offsets;
+    QVector<size_t> missing_counts;
+    QVector<void *> missing_data;
+
+    strided = false;
+    for (i = 0; i < n_dims; ++i) {
+        if (stride[i] > 1)
+            strided = true;
+    }
+
+    if (openDataset() < 0)
+        return -1;
+
+    dataset_id = handle->id;
+
+    if (! use_tiles || strided) {
+        if (! strided && chunk_reader.isSupported())
+            return chunk_reader.read(dataset_id, offset, count, data);
+
+        if (readSlab(dataset_id, offset, count, stride, data) < 0)
+            return -1;
+
+        return 0;
+    }
+
+    for (i = 0; i < n_dims; ++i) {
+        first [i] = offset[i] / tile_dims[i];
+        last  [i] = (offset[i] + count[i] - 1) / tile_dims[i];
+        coords[i] = first[i];
+    }
+
+    while (1) {
+        size = data_size;
+        for (i = 0; i < n_dims; ++i) {
+            tile_offsets.append(coords[i] * tile_dims[i]);
+            tile_counts .append(tile_dims[i]);
+            if (tile_offsets.last() + tile_counts.last() > dims[i])
+                tile_counts.last() = dims[i] - tile_offsets.last();
+            size *= tile_counts.last();
         }
 
-        configureTable(i_row, n_rows, i_col, n_cols);
+        key = XDFTileCache::tileKey(dataset_key, n_dims, coords);
 
-        for (int i = 0; i < n_rows; ++i) {
-            for (int j = 0; j < n_cols; ++j) {
-                ptr = ((char *) data) + (i * n_cols + j) * data_size;
-                hdf5_scaler_to_string(datatype_id, data_class, data_size, ptr, 0, temp, LN);
-                tableWidget()->setItem(i, j, new QTableWidgetItem(temp));
-            }
+        keys.append(key);
+        tiles.append(QByteArray());
+
+        if (! XDFTileCache::find(key, &tiles.last())) {
+            tiles.last().resize(size);
+            missing.append(tiles.size() - 1);
         }
 
-        free(data);
+        for (i = n_dims - 1; i >= 0; --i) {
+            if (++coords[i] <= last[i])
+                break;
+            coords[i] = first[i];
+        }
+        if (i < 0)
+            break;
+    }
 
-        if (H5Sclose(memspace_id) < 0) {
-            fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
-            exit(1);
+    for (j = 0; j < missing.size(); ++j) {
+        for (i = 0; i < n_dims; ++i) {
+            missing_offsets.append(tile_offsets[missing[j] * n_dims + i]);
+            missing_counts .append(tile_counts [missing[j] * n_dims + i]);
         }
+        missing_data.append(tiles[missing[j]].data());
     }
 
-    free(dims);
+    if (chunk_reader.isSupported() && ! missing.isEmpty()) {
+        if (chunk_reader.read(dataset_id, missing.size(), missing_offsets.constData(),
+                              missing_counts.constData(), missing_data.data()) < 0)
+            return -1;
+    }
+    else {
+        for (j = 0; j < missing.size(); ++j) {
+            if (readSlab(dataset_id, missing_offsets.constData() + j * n_dims,
+                         missing_counts.constData() + j * n_dims, NULL, missing_data[j]) < 0)
+                return -1;
+        }
+    }
 
-    if (H5Sclose(filespace_id) < 0) {
+    for (j = 0; j < missing.size(); ++j)
+        XDFTileCache::insert(keys[missing[j]], tiles[missing[j]]);
+
+    for (j = 0; j < tiles.size(); ++j)
+        XDFTileCache::copyTile(n_dims, data_size, tiles[j].constData(),
+                               tile_offsets.constData() + j * n_dims,
+                               tile_counts.constData() + j * n_dims, data, offset, count);
+
+    return 0;
+}
+
+
+
+/*
+ * Frees the memory the library allocated for the variable length data in n
+ * elements read by readElements().
+ */
+int HDF5TableView::reclaimElements(void *elements, size_t n)
+{
+    hid_t space_id;
+
+    hsize_t dims[1];
+
+    dims[0] = n;
+
+    space_id = H5Screate_simple(1, dims, NULL);
+    if (space_id < 0) {
+        fprintf(stderr, "ERROR: H5Screate_simple(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if (H5Dvlen_reclaim(datatype_id, space_id, H5P_DEFAULT, elements) < 0) {
+        fprintf(stderr, "ERROR: H5Dvlen_reclaim(), dataset_name = %s\n", dataset_name);
+        H5Sclose(space_id);
+        return -1;
+    }
+
+    if (H5Sclose(space_id) < 0) {
         fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
-        exit(1);
+        return -1;
     }
 
-    if (H5Tclose(datatype_id) < 0) {
-        fprintf(stderr, "ERROR: H5Tclose(), dataset_name = %s\n", dataset_name);
-        exit(1);
+    return 0;
+}
+
+
+
+/*
+ * Formats a member of an element, or the whole element if member is -1, by
+ * the plan, or from the datatype by the library if the datatype could not be
+ * analyzed.
+ */
+int HDF5TableView::formatCell(int member, const void *element, char *text, size_t size)
+{
+    if (member >= 0)
+        return plan.formatMember(member, element, text, size, numberFormat());
+
+    if (plan.count() > 0)
+        return plan.formatElement(element, text, size, numberFormat());
+
+    return hdf5_scaler_to_string(datatype_id, data_class, data_size, (void *) element, 0,
+                                 text, size);
+}
+
+
+
+/*
+ * Without members the elements are the cells.  With members the elements
+ * are read into a buffer from which the member of each cell is copied out.
+ * Either way the values are then put into the native byte order by the plan.
+ *
+ * Variable length data is allocated by the library behind each element, which
+ * the blocks, freed with free(), cannot own.  Such elements are read into a
+ * buffer, formatted into cells of text of up to max_text_size bytes, and
+ * reclaimed before returning.
+ */
+int HDF5TableView::readBlock(int row, int n_rows, int col, int n_cols, void *data)
+{
+    int i;
+    int r = 0;
+
+    size_t j;
+    size_t k;
+
+    size_t n;
+
+    size_t offset[8];
+    size_t count[8];
+    size_t stride[8];
+
+    char *elements;
+    char *element;
+    char *ptr;
+
+    blockSlice(row, n_rows, col, n_cols, offset, count, stride);
+
+    if (! use_members && ! has_vlen) {
+        if (readElements(offset, count, stride, data) < 0)
+            return -1;
+
+        plan.toNativeOrder(data, (size_t) n_rows * n_cols);
+
+        return 0;
     }
 
-    if (H5Dclose(dataset_id) < 0) {
-        fprintf(stderr, "ERROR: H5Dclose(), dataset_name = %s\n", dataset_name);
-        exit(1);
+    n = 1;
+    for (i = 0; i < n_dims; ++i)
+        n *= count[i];
+
+    elements = (char *) malloc(n * data_size);
+    if (elements == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed, dataset_name = %s\n", dataset_name);
+        return -1;
     }
 
-    if (H5Fclose(file_id) < 0) {
-        fprintf(stderr, "ERROR: H5Fclose(), file_name = %s\n", file_name);
-        exit(1);
+    if (readElements(offset, count, stride, elements) < 0) {
+        free(elements);
+        return -1;
+    }
+
+    plan.toNativeOrder(elements, n);
+
+    ptr = (char *) data;
+    for (j = 0; j < n; ++j) {
+        element = elements + j * data_size;
+
+        if (! use_members) {
+            if (formatCell(-1, element, ptr, max_text_size) < 0)
+                ptr[0] = '\0';
+            ptr += cellSize();
+            continue;
+        }
+
+        for (k = 0; k < count[n_dims]; ++k) {
+            if (! has_vlen)
+                plan.copyMember(offset[n_dims] + k * stride[n_dims], element, ptr);
+            else if (formatCell(offset[n_dims] + k * stride[n_dims], element, ptr,
+                                max_text_size) < 0)
+                ptr[0] = '\0';
+            ptr += cellSize();
+        }
     }
 
-    free(temp);
+    if (has_vlen && reclaimElements(elements, n) < 0)
+        r = -1;
+
+    free(elements);
+
+    return r;
+}
+
+
+
+/*
+ * Cells of numbers are formatted by the XDFKernel, cells of other classes
+ * from the raw bytes by formatCell(), and cells of variable length data were
+ * formatted when they were read.
+ */
+QString HDF5TableView::cellText(int col, const void *ptr)
+{
+    char temp[LN];
+
+    if (has_vlen)
+        return (const char *) ptr;
+
+    if (cellType(col) != XDFKernel::Unknown)
+        return XDFTableView::cellText(col, ptr);
+
+    if (formatCell(use_members ? first_member + col * member_step : -1, ptr, temp, LN) < 0)
+        return QString();
+
+    return temp;
+}
+
+
+
+/*
+ * A member is a number in a column of its own if it is a single value.
+ */
+XDFKernel::Type HDF5TableView::cellType(int col)
+{
+    const XDFMemberPlan::Member *member;
+
+    if (has_vlen)
+        return XDFKernel::Unknown;
+
+    if (! use_members)
+        return cell_type;
+
+    member = &plan.member(first_member + col * member_step);
+    if (member->kind != XDFMemberPlan::Number || member->count != 1)
+        return XDFKernel::Unknown;
+
+    return member->type;
+}
+
+
+
+/*
+ * Only datasets of numbers get a pyramid.  The members of a compound are not
+ * a two dimensional field.
+ */
+QByteArray HDF5TableView::datasetKey()
+{
+    if (use_members || has_vlen)
+        return QByteArray();
+
+    return XDFTileCache::datasetKey(file_name, dataset_name);
+}
+
+
+
+bool HDF5TableView::cellsAreText()
+{
+    return has_vlen;
 }
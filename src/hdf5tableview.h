@@ -12,6 +12,11 @@
 
 #include <hdf5.h>
 
+#include <qbytearray.h>
+
+#include "xdfchunkreader.h"
+#include "xdfhandlepool.h"
+#include "xdfmemberplan.h"
 #include "xdftableview.h"
 
 
@@ -23,15 +28,60 @@ private:
     const char *file_name;
     const char *dataset_name;
 
+    XDFHandlePool::Handle *handle;
+
+    hid_t datatype_id;
+    H5T_class_t data_class;
+    size_t data_size;
+    XDFKernel::Type cell_type;
+    bool has_vlen;
+
+    XDFMemberPlan plan;
+    bool use_members;
+    int first_member;
+    int member_step;
+
+    int n_dims;
+    hsize_t dims[8];
+    size_t tile_dims[8];
+    bool use_tiles;
+    QByteArray dataset_key;
+
+    XDFChunkReader chunk_reader;
+
+    static const size_t max_tile_side = 256;
+    static const size_t max_text_size = 256;
+
     int parseSlice(int n_dims, const hsize_t *dims,
                    int *i_row, int *n_rows, int *i_col, int *n_cols,
-                   hsize_t *offset, hsize_t *count, hsize_t *length);
+                   hsize_t *offset, hsize_t *count, hsize_t *stride,
+                   hsize_t *length);
+
+    int tileShape(hid_t dataset_id);
+    int openDataset();
+
+    int readSlab(hid_t dataset_id, const size_t *offset, const size_t *count,
+                 const size_t *stride, void *data);
+    int readElements(const size_t *offset, const size_t *count, const size_t *stride,
+                     void *data);
+    int reclaimElements(void *elements, size_t n);
+    int formatCell(int member, const void *element, char *text, size_t size);
+
+    int readBlock(int row, int n_rows, int col, int n_cols, void *data);
+    QString cellText(int col, const void *ptr);
+    XDFKernel::Type cellType(int col);
+    QByteArray datasetKey();
+    bool cellsAreText();
+
 public:
     HDF5TableView(const char *file_name, const char *dataset_name, QWidget *parent = 0);
     ~HDF5TableView();
 
 public slots:
     void refreshTable();
+
+private slots:
+    void releaseStaleHandle();
 };
 
 #endif /* HDF5TABLEVIEW_H */
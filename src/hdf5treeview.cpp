@@ -14,6 +14,9 @@
 #include "xdfv.h"
 #include "hdf5tableview.h"
 #include "hdf5treeview.h"
+#include "xdfhandlepool.h"
+#include "xdfmemberplan.h"
+#include "xdfstatisticsview.h"
 
 
 enum tree_view_fields {
@@ -29,41 +32,11 @@ enum tree_view_fields {
 };
 
 
-HDF5TreeViewItem::HDF5TreeViewItem(HDF5TreeView *parent, ItemType type,
-                                   const char *name)
-    : XDFTreeViewItem(parent, name), type_(type)
-{
-
-}
-
-
-
-HDF5TreeViewItem::HDF5TreeViewItem(HDF5TreeViewItem *parent, HDF5TreeViewItem *after,
-                                   ItemType type, const char *name)
-    : XDFTreeViewItem(parent, after, name), type_(type)
-{
-
-}
-
-
-
-HDF5TreeViewItem::~HDF5TreeViewItem()
-{
-
-}
-
-
-
-HDF5TreeViewItem::ItemType HDF5TreeViewItem::type()
-{
-    return type_;
-}
-
-
-
-HDF5TreeView::HDF5TreeView(const char *file_name, QWidget *parent)
+HDF5TreeView::HDF5TreeView(const char *file_name, int lazy, QWidget *parent)
     : XDFTreeView(file_name, XDFV::HDF5, parent)
 {
+    load_flag = lazy;
+
     load();
 }
 
@@ -73,9 +46,7 @@ void HDF5TreeView::load()
 {
     char *temp;
 
-    int status;
-
-    HDF5TreeViewItem *item;
+    int id;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -103,22 +74,49 @@ void HDF5TreeView::load()
     dataset_color   = QColor(  0, 224, 0);
     attr_color      = QColor(  0, 0,   224);
     dataspace_color = QColor(244, 0,   224);
+    link_color      = QColor(  0, 160, 160);
 
     snprintf(temp, LN, "%s - %s", program_name, filename());
     setWindowTitle(temp);
 
-    item = new HDF5TreeViewItem(this, HDF5TreeViewItem::File, filename());
-    item->setText(0, filename());
+    id = treeModel()->newNode(File, filename(), filename());
+    addNode(-1, -1, id);
 
-    status = procHDF5File(filename(), item);
-    if (status != 0)
-        throw status;
+    startLoad(id);
 
     free(temp);
 }
 
 
 
+int HDF5TreeView::loadItems(int root)
+{
+    return procHDF5File(filename(), nodePointer(root), load_flag);
+}
+
+
+
+int HDF5TreeView::loadOptions()
+{
+    return load_flag;
+}
+
+
+
+int HDF5TreeView::functionCanceled()
+{
+    return isLoadCanceled();
+}
+
+
+
+void HDF5TreeView::functionProgress(long done, long total)
+{
+    reportProgress(done, total);
+}
+
+
+
 HDF5TreeView::~HDF5TreeView()
 {
 
@@ -134,7 +132,6 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
     const char *class_name;
 
     int i;
-    int n;
 
     int n_dims;
 
@@ -151,7 +148,9 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
     hsize_t count[8];
     hsize_t offset[8];
 
-    HDF5TreeViewItem *item;
+    int id;
+
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 /*
@@ -160,11 +159,8 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
         return NULL;
     }
 */
-    item = new HDF5TreeViewItem((HDF5TreeViewItem *) parent, (HDF5TreeViewItem *) after,
-                                HDF5TreeViewItem::Attribute, attr_name);
-    item->setText(FIELD_Name, attr_name);
-
-    item->setText(FIELD_Description, "Attribute");
+    id = treeModel()->newNode(Attribute, attr_name, attr_name);
+    node = &treeModel()->node(id);
 
     datatype_id = H5Aget_type(attr_id);
     if (datatype_id < 0) {
@@ -184,11 +180,9 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
         return NULL;
     }
 
-    snprintf(temp, LN, "%s", class_name);
-    item->setText(FIELD_Data_Class, temp);
+    node->data_type = H5Tget_class(datatype_id);
 
-    snprintf(temp, LN, "%ld", data_size);
-    item->setText(FIELD_Data_Size, temp);
+    node->size = data_size;
 
     dataspace_id = H5Aget_space(attr_id);
     if (dataspace_id < 0) {
@@ -208,17 +202,9 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
         return NULL;
     }
 
-    if (n_dims == 0)
-        item->setText(FIELD_Dimensions, "Scalar");
-    else {
-        n = 0;
-        for (int i = 0; i < n_dims; ++i) {
-            n += snprintf(temp+n, LN - n, "%ld", (long) dims[i]);
-            if (i < n_dims - 1)
-                n += snprintf(temp+n, LN - n, ", ");
-        }
-        item->setText(FIELD_Dimensions, temp);
-    }
+    node->n_dims = n_dims;
+    node->dims   = treeModel()->addDims(n_dims, (long long *) dims);
+
     if (n_dims == 0)
         length = 1;
     else
@@ -249,11 +235,11 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
         return NULL;
     }
 
-    if (hdf5_array_to_string(datatype_id, data, length, temp, LN) < 0) {
+    if (XDFMemberPlan::arrayToString(datatype_id, data, length, temp, LN) < 0) {
         fprintf(stderr, "ERROR: hdf5_data_to_string(), attr_name = %s\n", attr_name);
         return NULL;
     }
-    item->setText(FIELD_Value, temp);
+    node->value = treeModel()->addString(temp);
 
     free(data);
     free(dims);
@@ -268,9 +254,11 @@ void *HDF5TreeView::functionH5A(const void *parent, const void *after,
         return NULL;
     }
 
+    addNode(nodeId(parent), nodeId(after), id);
+
     free(temp);
 
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -282,9 +270,6 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
 
     const char *class_name;
 
-    int i;
-    int n;
-
     int flag;
 
     int n_attr;
@@ -292,18 +277,14 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
 
     size_t data_size;
 
-    void *data;
-
     hid_t datatype_id;
     hid_t dataspace_id;
 
-    hsize_t length;
-
     hsize_t *dims;
-    hsize_t count[8];
-    hsize_t offset[8];
 
-    HDF5TreeViewItem *item;
+    int id;
+
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -312,21 +293,17 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new HDF5TreeViewItem((HDF5TreeViewItem *) parent, (HDF5TreeViewItem *) after,
-                                HDF5TreeViewItem::Dataset, temp);
-    item->setHasDataTable(true);
+    id = treeModel()->newNode(Dataset, temp, dataset_name);
+    node = &treeModel()->node(id);
 
-    item->setText(FIELD_Name, dataset_name);
+    node->flags |= XDFTreeModel::HasDataTable;
 
-    item->setText(FIELD_Description, "Dataset");
-
-    n_attr = H5Aget_num_attrs(dataset_id);
+    n_attr = object_num_attrs(dataset_id);
     if (n_attr < 0) {
-        fprintf(stderr, "ERROR: H5Aget_num_attrs(), dataset_name = %s\n", dataset_name);
+        fprintf(stderr, "ERROR: object_num_attrs(), dataset_name = %s\n", dataset_name);
         return NULL;
     }
-    snprintf(temp, LN, "%ld", (long) n_attr);
-    item->setText(FIELD_N_Objects, temp);
+    node->count = n_attr;
 
     datatype_id = H5Dget_type(dataset_id);
     if (datatype_id < 0) {
@@ -346,11 +323,9 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
         return NULL;
     }
 
-    snprintf(temp, LN, "%s", class_name);
-    item->setText(FIELD_Data_Class, temp);
+    node->data_type = H5Tget_class(datatype_id);
 
-    snprintf(temp, LN, "%ld", data_size);
-    item->setText(FIELD_Data_Size, temp);
+    node->size = data_size;
 
     dataspace_id = H5Dget_space(dataset_id);
     if (dataspace_id < 0) {
@@ -370,17 +345,8 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
         return NULL;
     }
 
-    if (n_dims == 0)
-        item->setText(FIELD_Dimensions, "Scalar");
-    else {
-        n = 0;
-        for (int i = 0; i < n_dims; ++i) {
-            n += snprintf(temp+n, LN - n, "%ld", (long) dims[i]);
-            if (i < n_dims - 1)
-                n += snprintf(temp+n, LN - n, ", ");
-        }
-        item->setText(FIELD_Dimensions, temp);
-    }
+    node->n_dims = n_dims;
+    node->dims   = treeModel()->addDims(n_dims, (long long *) dims);
 
     flag = 0;
     for (int i = 0; i < n_dims; ++i) {
@@ -389,47 +355,8 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
             break;
         }
     }
-    if (! flag) {
-        if (n_dims == 0)
-            length = 1;
-        else
-            length = dims[n_dims - 1];
-/*
-            length = MIN(64, dims[n_dims - 1]);
-*/
-        data = malloc(length * data_size);
-        if (data == NULL) {
-            fprintf(stderr, "ERROR: Memory allocation failed, dataset_name = %s\n", dataset_name);
-            return NULL;
-        }
-
-        if (n_dims > 0) {
-            for (i = 0; i < n_dims; ++i) {
-                offset[i] = 0;
-                count [i] = 1;
-            }
-
-            count[i - 1] = length;
-
-            if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL) < 0) {
-                fprintf(stderr, "ERROR: H5Sselect_hyperslab(), dataset_name = %s\n", dataset_name);
-                return NULL;
-            }
-        }
-
-        if (H5Dread(dataset_id, datatype_id, H5S_ALL, dataspace_id, H5P_DEFAULT, data) < 0) {
-            fprintf(stderr, "ERROR: H5Dread(), dataset_name = %s\n", dataset_name);
-            return NULL;
-        }
-
-        if (hdf5_array_to_string(datatype_id, data, length, temp, LN) < 0) {
-            fprintf(stderr, "ERROR: hdf5_data_to_string(), dataset_name = %s\n", dataset_name);
-            return NULL;
-        }
-        item->setText(FIELD_Value, temp);
-
-        free(data);
-    }
+    if (! flag)
+        node->flags |= XDFTreeModel::PreviewPending;
 
     free(dims);
 
@@ -443,9 +370,11 @@ void *HDF5TreeView::functionH5D(const void *parent, const void *after,
         return NULL;
     }
 
+    addNode(nodeId(parent), nodeId(after), id);
+
     free(temp);
 
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -455,9 +384,11 @@ void *HDF5TreeView::functionH5G(const void *parent, const void *after,
 {
     char *temp;
 
-    hsize_t n_obj;
+    int id;
+
+    H5G_info_t group_info;
 
-    HDF5TreeViewItem *item;
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -466,71 +397,444 @@ void *HDF5TreeView::functionH5G(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new HDF5TreeViewItem((HDF5TreeViewItem *) parent, (HDF5TreeViewItem *) after,
-                                HDF5TreeViewItem::Group, temp);
-    item->setText(FIELD_Name, group_name);
+    id = treeModel()->newNode(Group, temp, group_name);
+    node = &treeModel()->node(id);
 
-    item->setText(FIELD_Description, "Group");
-
-    if (H5Gget_num_objs(group_id, &n_obj) < 0) {
-        fprintf(stderr, "ERROR: H5Gget_num_objs(), group_name = %s\n", group_name);
+    if (H5Gget_info(group_id, &group_info) < 0) {
+        fprintf(stderr, "ERROR: H5Gget_info(), group_name = %s\n", group_name);
         return NULL;
     }
-    snprintf(temp, LN, "%ld", (long) n_obj);
-    item->setText(FIELD_N_Objects, temp);
+    node->count = group_info.nlinks;
+
+    addNode(nodeId(parent), nodeId(after), id);
 
     free(temp);
 
-    return (void *) item;
+    return nodePointer(id);
+}
+
+
+
+int HDF5TreeView::functionH5GLazy(const void *item, hid_t group_id,
+                                  const char *group_name)
+{
+    int n_attr;
+
+    H5G_info_t group_info;
+
+    if (H5Gget_info(group_id, &group_info) < 0) {
+        fprintf(stderr, "ERROR: H5Gget_info(), group_name = %s\n", group_name);
+        return -1;
+    }
+
+    n_attr = object_num_attrs(group_id);
+    if (n_attr < 0) {
+        fprintf(stderr, "ERROR: object_num_attrs(), group_name = %s\n", group_name);
+        return -1;
+    }
+
+    if (group_info.nlinks + n_attr > 0)
+        treeModel()->node(nodeId(item)).flags |= XDFTreeModel::Unpopulated;
+
+    return 0;
 }
 
 
 
-void HDF5TreeView::colorize(QTreeWidgetItem *item_, bool color)
+/*
+ * A link that is not followed: a soft, external, or user-defined link, or a
+ * hard link to a group or dataset shown elsewhere in the tree, target_item.
+ */
+void *HDF5TreeView::functionH5L(const void *parent, const void *after,
+                                const char *link_name, H5L_type_t link_type,
+                                const char *target, const void *target_item)
+{
+    int id;
+
+    XDFTreeNode *node;
+
+    id = treeModel()->newNode(Link, link_name, link_name);
+    node = &treeModel()->node(id);
+
+    node->data_type = link_type;
+
+    if (target_item != NULL)
+        node->value = treeModel()->node(nodeId(target_item)).name;
+    else if (target[0] != '\0')
+        node->value = treeModel()->addString(target);
+
+    addNode(nodeId(parent), nodeId(after), id);
+
+    return nodePointer(id);
+}
+
+
+
+/*
+ * The key of a group or dataset is kept as its record so that it is cached
+ * with the tree, see restoreVisited().
+ */
+void HDF5TreeView::functionVisited(const void *item, const QString &key)
 {
-    HDF5TreeViewItem *item = (HDF5TreeViewItem *) item_;
-
-    if (! color)
-        item->setTextColor(FIELD_Name, QColor(0, 0, 0));
-    else {
-        switch(item->type()) {
-            case HDF5TreeViewItem::File:
-                item->setTextColor(FIELD_Name, file_color);
-                break;
-            case HDF5TreeViewItem::Group:
-                item->setTextColor(FIELD_Name, group_color);
-                break;
-            case HDF5TreeViewItem::Dataset:
-                item->setTextColor(FIELD_Name, dataset_color);
-                break;
-            case HDF5TreeViewItem::Attribute:
-                item->setTextColor(FIELD_Name, attr_color);
-                break;
-            default:
-                break;
+    QByteArray record;
+
+    record = key.toLatin1();
+
+    treeModel()->node(nodeId(item)).record =
+        treeModel()->addRecord(record.constData(), record.size() + 1);
+}
+
+
+
+/*
+ * A tree restored from its cache has not been processed so the groups and
+ * datasets that later expansions link to are recovered from their records.
+ */
+void HDF5TreeView::restoreVisited()
+{
+    int id;
+
+    const char *key;
+
+    for (id = treeModel()->child(-1, 0); id >= 0; id = treeModel()->nextNode(id)) {
+        const XDFTreeNode &node = treeModel()->node(id);
+
+        if ((node.type != Group && node.type != Dataset) || node.record < 0)
+            continue;
+
+        key = (const char *) treeModel()->record(node.record);
+
+        addVisited(QString::fromLatin1(key, strnlen(key, treeModel()->recordSize(node.record))),
+                   nodePointer(id));
+    }
+}
+
+
+
+int HDF5TreeView::populate(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Group)
+        return 0;
+
+    if (! hasVisited())
+        restoreVisited();
+
+    return procHDF5Group(filename(), treeModel()->string(node.name), nodePointer(id));
+}
+
+
+
+/*
+ * Reads the start of the last dimension of a dataset, at most
+ * max_preview_size bytes, and formats it into value.
+ */
+int HDF5TreeView::loadPreview(hid_t dataset_id, char *value, int size)
+{
+    int i;
+    int r;
+
+    int n_dims;
+
+    bool has_vlen;
+
+    size_t data_size;
+
+    void *data;
+
+    hid_t datatype_id;
+    hid_t dataspace_id;
+    hid_t memspace_id;
+
+    hsize_t length;
+
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+    hsize_t offset[H5S_MAX_RANK];
+
+    datatype_id = H5Dget_type(dataset_id);
+    if (datatype_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_type()\n");
+        return -1;
+    }
+
+    data_size = H5Tget_size(datatype_id);
+    if (data_size == 0) {
+        fprintf(stderr, "ERROR: H5Tget_size()\n");
+        H5Tclose(datatype_id);
+        return -1;
+    }
+
+    has_vlen = H5Tdetect_class(datatype_id, H5T_VLEN) > 0 ||
+               H5Tis_variable_str(datatype_id) > 0;
+
+    dataspace_id = H5Dget_space(dataset_id);
+    if (dataspace_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_space()\n");
+        H5Tclose(datatype_id);
+        return -1;
+    }
+
+    n_dims = H5Sget_simple_extent_dims(dataspace_id, dims, NULL);
+    if (n_dims < 0) {
+        fprintf(stderr, "ERROR: H5Sget_simple_extent_dims()\n");
+        H5Sclose(dataspace_id);
+        H5Tclose(datatype_id);
+        return -1;
+    }
+
+    if (n_dims == 0)
+        length = 1;
+    else
+        length = qMin(dims[n_dims - 1], (hsize_t) qMax(1, max_preview_size / (int) data_size));
+
+    data = malloc(length * data_size);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        H5Sclose(dataspace_id);
+        H5Tclose(datatype_id);
+        return -1;
+    }
+
+    if (n_dims > 0) {
+        for (i = 0; i < n_dims; ++i) {
+            offset[i] = 0;
+            count [i] = 1;
+        }
+
+        count[i - 1] = length;
+
+        if (H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL) < 0) {
+            fprintf(stderr, "ERROR: H5Sselect_hyperslab()\n");
+            free(data);
+            H5Sclose(dataspace_id);
+            H5Tclose(datatype_id);
+            return -1;
+        }
+    }
+
+    if (H5Dread(dataset_id, datatype_id, H5S_ALL, dataspace_id, H5P_DEFAULT, data) < 0) {
+        fprintf(stderr, "ERROR: H5Dread()\n");
+        free(data);
+        H5Sclose(dataspace_id);
+        H5Tclose(datatype_id);
+        return -1;
+    }
+
+    r = 0;
+
+    if (XDFMemberPlan::arrayToString(datatype_id, data, length, value, size) < 0) {
+        fprintf(stderr, "ERROR: XDFMemberPlan::arrayToString()\n");
+        r = -1;
+    }
+
+    /*
+     * Variable length data read into data is allocated by the library and
+     * reclaimed as in HDF5TableView::reclaimElements().
+     */
+    if (has_vlen) {
+        memspace_id = H5Screate_simple(1, &length, NULL);
+        if (memspace_id < 0) {
+            fprintf(stderr, "ERROR: H5Screate_simple()\n");
+            r = -1;
+        }
+        else {
+            if (H5Dvlen_reclaim(datatype_id, memspace_id, H5P_DEFAULT, data) < 0) {
+                fprintf(stderr, "ERROR: H5Dvlen_reclaim()\n");
+                r = -1;
+            }
+
+            if (H5Sclose(memspace_id) < 0) {
+                fprintf(stderr, "ERROR: H5Sclose()\n");
+                r = -1;
+            }
+        }
+    }
+
+    free(data);
+
+    if (H5Sclose(dataspace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose()\n");
+        r = -1;
+    }
+
+    if (H5Tclose(datatype_id) < 0) {
+        fprintf(stderr, "ERROR: H5Tclose()\n");
+        r = -1;
+    }
+
+    return r;
+}
+
+
+
+int HDF5TreeView::loadPreviews(const QVector<int> &ids, QList<QByteArray> &values)
+{
+    char *temp;
+
+    const char *dataset_name;
+
+    int i;
+
+    hid_t dataset_id;
+
+    XDFHandlePool::Handle *file;
+
+    file = XDFHandlePool::instance()->acquire(XDFHandlePool::HDF5File, filename());
+    if (file == NULL)
+        return -1;
+
+    temp = (char *) malloc(LN * sizeof(char));
+
+    for (i = 0; i < ids.size(); ++i) {
+        dataset_name = treeModel()->string(treeModel()->node(ids[i]).name);
+
+        temp[0] = '\0';
+
+        dataset_id = H5Dopen(file->id, dataset_name, H5P_DEFAULT);
+        if (dataset_id < 0)
+            fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", dataset_name);
+        else {
+            if (loadPreview(dataset_id, temp, LN) < 0) {
+                fprintf(stderr, "ERROR: loadPreview(), dataset_name = %s\n", dataset_name);
+                temp[0] = '\0';
+            }
+
+            if (H5Dclose(dataset_id) < 0)
+                fprintf(stderr, "ERROR: H5Dclose(), dataset_name = %s\n", dataset_name);
         }
+
+        values.append(QByteArray(temp));
     }
+
+    free(temp);
+
+    XDFHandlePool::instance()->release(file);
+
+    return 0;
 }
 
 
 
-void HDF5TreeView::showDataTable()
+QString HDF5TreeView::nodeText(int id, int column)
 {
-    showDataTable((HDF5TreeViewItem *) currentItem(), 0);
+    char *temp;
+
+    int i;
+    int n;
+
+    const long long *dims;
+
+    QString text;
+
+    XDFTreeNode &node = treeModel()->node(id);
+
+    switch (column) {
+        case FIELD_Description:
+            switch (node.type) {
+                case Group:
+                    return "Group";
+                case Dataset:
+                    return "Dataset";
+                case Attribute:
+                    return "Attribute";
+                case Link:
+                    switch (node.data_type) {
+                        case H5L_TYPE_HARD:
+                            return "Hard Link";
+                        case H5L_TYPE_SOFT:
+                            return "Soft Link";
+                        case H5L_TYPE_EXTERNAL:
+                            return "External Link";
+                        default:
+                            return "User-defined Link";
+                    }
+                default:
+                    return QString();
+            }
+        case FIELD_N_Objects:
+            if (node.type != Group && node.type != Dataset)
+                return QString();
+            return QString::number(node.count);
+        case FIELD_Data_Class:
+            if (node.type != Dataset && node.type != Attribute)
+                return QString();
+            return hdf5_data_class_name((H5T_class_t) node.data_type);
+        case FIELD_Data_Size:
+            if (node.type != Dataset && node.type != Attribute)
+                return QString();
+            return QString::number(node.size);
+        case FIELD_Dimensions:
+            if (node.type != Dataset && node.type != Attribute)
+                return QString();
+            if (node.n_dims == 0)
+                return "Scalar";
+            temp = (char *) malloc(LN * sizeof(char));
+            dims = treeModel()->dims(node.dims);
+            n = 0;
+            for (i = 0; i < node.n_dims; ++i) {
+                n += snprintf(temp+n, LN - n, "%lld", dims[i]);
+                if (i < node.n_dims - 1)
+                    n += snprintf(temp+n, LN - n, ", ");
+            }
+            text = temp;
+            free(temp);
+            return text;
+        case FIELD_Value:
+            return treeModel()->string(node.value);
+        default:
+            return XDFTreeView::nodeText(id, column);
+    }
 }
 
 
 
-void HDF5TreeView::showDataTable(HDF5TreeViewItem *item, int column)
+QColor HDF5TreeView::nodeColor(int id)
 {
-    if (item == NULL)
-        return;
+    switch(treeModel()->node(id).type) {
+        case File:
+            return file_color;
+        case Group:
+            return group_color;
+        case Dataset:
+            return dataset_color;
+        case Attribute:
+            return attr_color;
+        case Link:
+            return link_color;
+        default:
+            return QColor(0, 0, 0);
+    }
+}
+
+
+
+void HDF5TreeView::showDataTable(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
 
-    if (item->type() != HDF5TreeViewItem::Dataset)
+    if (node.type != Dataset)
         return;
 
-    HDF5TableView *t = new HDF5TableView(filename(), item->name, 0);
+    HDF5TableView *t = new HDF5TableView(filename(), treeModel()->string(node.name), 0);
     t->setAttribute(Qt::WA_QuitOnClose, false);
     t->setAttribute(Qt::WA_DeleteOnClose, true);
     t->show();
 }
+
+
+
+void HDF5TreeView::showStatistics(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Dataset)
+        return;
+
+    XDFStatisticsView *s = new XDFStatisticsView(XDFV::HDF5, filename(),
+                                                 treeModel()->string(node.name), 0);
+    s->setAttribute(Qt::WA_QuitOnClose, false);
+    s->setAttribute(Qt::WA_DeleteOnClose, true);
+    s->show();
+}
@@ -14,26 +14,31 @@
 
 #include <hdf5processor.h>
 
-#include <qstandarditemmodel.h>
-
 #include "xdftreeview.h"
 
 
-class HDF5TreeViewItem;
-
-
 class HDF5TreeView : public XDFTreeView, HDF5Processor
 {
     Q_OBJECT
 
+public:
+    enum ItemType {
+        File,
+        Group,
+        Dataset,
+        Attribute,
+        Link
+    };
+
 private:
+    int load_flag;
+
     QColor file_color;
     QColor group_color;
     QColor dataset_color;
     QColor attr_color;
     QColor dataspace_color;
-
-    QStandardItemModel *model;
+    QColor link_color;
 
     void *functionH5A(const void *parent, const void *after,
                       hid_t attr_id, const char *attr_name);
@@ -41,41 +46,38 @@ private:
                       hid_t dataset_id, const char *dataset_name);
     void *functionH5G(const void *parent, const void *after,
                       hid_t group_id, const char *group_name);
+    int functionH5GLazy(const void *item, hid_t group_id,
+                        const char *group_name);
+    void *functionH5L(const void *parent, const void *after,
+                      const char *link_name, H5L_type_t link_type,
+                      const char *target, const void *target_item);
+    void functionVisited(const void *item, const QString &key);
 
-    void colorize(QTreeWidgetItem *item, bool color);
+    int functionCanceled();
+    void functionProgress(long done, long total);
+
+    void restoreVisited();
+    int populate(int id);
+
+    int loadPreview(hid_t dataset_id, char *value, int size);
+    int loadPreviews(const QVector<int> &ids, QList<QByteArray> &values);
 
 public:
-    HDF5TreeView(const char *file_name_, QWidget *parent = 0);
+    HDF5TreeView(const char *file_name_, int lazy, QWidget *parent = 0);
     ~HDF5TreeView();
 
     void load();
 
-public slots:
-    void showDataTable();
-    void showDataTable(HDF5TreeViewItem *item, int column);
-};
-
-
-class HDF5TreeViewItem : public XDFTreeViewItem
-{
-public:
-    enum ItemType {
-        File,
-        Group,
-        Dataset,
-        Attribute
-    };
+protected:
+    QString nodeText(int id, int column);
+    QColor nodeColor(int id);
 
-private:
-    ItemType type_;
+    int loadItems(int root);
+    int loadOptions();
 
-public:
-    HDF5TreeViewItem(HDF5TreeView *parent, ItemType type_, const char *name_);
-    HDF5TreeViewItem(HDF5TreeViewItem *parent, HDF5TreeViewItem *after,
-                     ItemType type_, const char *name_);
-    ~HDF5TreeViewItem();
-
-    ItemType type();
+public slots:
+    void showDataTable(int id);
+    void showStatistics(int id);
 };
 
 #endif /* HDF5TREEVIEW_H */
@@ -9,147 +9,114 @@
 
 #include <ghdf.h>
 
+#include <qmutex.h>
+
 #include "xdfv.h"
 #include "hdftableview.h"
+#include "xdfstatistics.h"
+#include "xdftilecache.h"
 
 
 HDFTableView::HDFTableView(const char *file_name, const char *object_name,
-                           HDFTreeViewItem::ItemType type, QWidget *parent)
-    : XDFTableView(parent), file_name(file_name), object_name(object_name), type(type)
+                           HDFTreeView::ItemType type, QWidget *parent)
+    : XDFTableView(XDFV::HDF4, parent), file_name(file_name), object_name(object_name),
+      type(type), handle(NULL), cell_type(XDFKernel::Unknown), first_field(0),
+      field_step(1)
 {
-    char field_name_list[VSFIELDMAX * (FIELDNAMELENMAX + 1)];
-
-    int32 sd_id;
-    int32 sds_index;
-    int32 sds_id;
-
     int32 rank;
     int32 dim_sizes[MAX_VAR_DIMS];
     int32 data_type;
     int32 num_attrs;
 
-    int32 file_id;
-    int32 vdata_ref;
-    int32 vdata_id;
-
-    int32 n_records;
-    int32 n_fields;
-    int32 vdata_size;
-
-    if (type == HDFTreeViewItem::Dataset) {
-        sd_id = SDstart(file_name, DFACC_READ);
-        if (sd_id == FAIL) {
-            fprintf(stderr, "ERROR: SDstart(), file_name = %s\n", file_name);
-            exit(1);
-        }
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF4));
 
-        sds_index = SDnametoindex(sd_id, object_name);
-        if (sds_index == FAIL) {
-            fprintf(stderr, "ERROR: SDnametoindex(), sds_name = %s\n", object_name);
-            exit(1);
-        }
+    if (type != HDFTreeView::Dataset && type != HDFTreeView::VData) {
+        fprintf(stderr, "ERROR: Unsupported HDFTreeView::ItemType\n");
+        exit(1);
+    }
 
-        sds_id = SDselect(sd_id, sds_index);
-        if (sds_id == FAIL) {
-            fprintf(stderr, "ERROR: SDselect()\n");
-            exit(1);
-        }
+    if (openObject() < 0)
+        exit(1);
 
-        if (SDgetinfo(sds_id, NULL, &rank, dim_sizes, &data_type, &num_attrs) == FAIL) {
+    if (type == HDFTreeView::Dataset) {
+        if (SDgetinfo(handle->id, NULL, &rank, dim_sizes, &data_type, &num_attrs) == FAIL) {
             fprintf(stderr, "ERROR: SDgetinfo()\n");
             exit(1);
         }
+    }
+    else
+        rank = 2;
 
-        if (SDendaccess(sds_id) == FAIL) {
-            fprintf(stderr, "ERROR: SDgetinfo(), sds_name = %s\n", object_name);
-            exit(1);
-        }
+    QObject::connect(XDFHandlePool::instance(), SIGNAL(invalidated(const QByteArray &)),
+                     this, SLOT(releaseStaleHandle()));
 
-        if (SDend(sd_id) == FAIL) {
-            fprintf(stderr, "ERROR: SDend(), file_name = %s\n", file_name);
-            exit(1);
-        }
-    }
-    else if (type == HDFTreeViewItem::VData) {
-        file_id = Hopen(file_name, DFACC_READ, DEF_NDDS);
-        if (file_id == FAIL) {
-            fprintf(stderr, "ERROR: Hopen(), file_name = %s\n", file_name);
-            exit(1);
-        }
+    buildWidget(object_name, rank);
 
-        if (Vstart(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Vstart(), file_name = %s\n", file_name);
-            exit(1);
-        }
+    refreshTable();
+}
 
-        vdata_ref = VSfind(file_id, object_name);
-        if (vdata_ref == FAIL) {
-            fprintf(stderr, "ERROR: VSfind()\n");
-            exit(1);
-        }
 
-        vdata_id = VSattach(file_id, vdata_ref, "r");
-        if (vdata_id == FAIL) {
-            fprintf(stderr, "ERROR: VSattach()\n");
-            exit(1);
-        }
 
-        rank = 2;
+HDFTableView::~HDFTableView()
+{
+    stopPrefetch();
 
-        if (VSinquire(vdata_id, &n_records, NULL, NULL, &vdata_size, NULL) == FAIL) {
-            fprintf(stderr, "ERROR: VSinquire()\n");
-            exit(1);
-        }
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF4));
 
-        n_fields = VSgetfields(vdata_id, field_name_list);
-        if (n_fields == FAIL) {
-            fprintf(stderr, "ERROR: VSgetfields(), vdata_name = %s\n", object_name);
-            exit(1);
-        }
+    XDFHandlePool::instance()->release(handle);
+}
 
-        if (VSdetach(vdata_id) == FAIL) {
-            fprintf(stderr, "ERROR: VSdetach(), vdata_name = %s\n", object_name);
-            exit(1);
-        }
 
-        if (Vend(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Vend(), file_name = %s\n", file_name);
-            exit(1);
-        }
 
-        if (Hclose(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Hclose(), file_name = %s\n", file_name);
-            exit(1);
-        }
-    }
-    else {
-        fprintf(stderr, "ERROR: Unsupported HDFTreeViewItem::ItemType\n");
-        exit(1);
-    }
+/*
+ * Gets the SD or vdata from the XDFHandlePool, again if its file has been
+ * reloaded.
+ */
+int HDFTableView::openObject()
+{
+    if (handle != NULL && ! handle->is_stale)
+        return 0;
 
-    buildWidget(object_name, rank);
+    XDFHandlePool::instance()->release(handle);
 
-    refreshTable();
+    if (type == HDFTreeView::Dataset)
+        handle = XDFHandlePool::instance()->acquire(XDFHandlePool::SDDataset,
+                                                    file_name, object_name);
+    else
+        handle = XDFHandlePool::instance()->acquire(XDFHandlePool::VData,
+                                                    file_name, object_name);
+    if (handle == NULL)
+        return -1;
+
+    return 0;
 }
 
 
 
-HDFTableView::~HDFTableView()
+/*
+ * Lets go of the SD or vdata once its file has been reloaded, see
+ * XDFHandlePool::invalidate().  openObject() gets it again.
+ */
+void HDFTableView::releaseStaleHandle()
 {
-
+    if (handle != NULL && handle->is_stale) {
+        XDFHandlePool::instance()->release(handle);
+        handle = NULL;
+    }
 }
 
 
 
 int HDFTableView::parseSlice(int32 n_dims, const int32 *dims,
                              int *i_row, int *n_rows, int *i_col, int *n_cols,
-                             int32 *offset, int32 *count, int32 *length)
+                             int32 *offset, int32 *count, int32 *stride, int32 *length)
 {
     int r = 0;
 
     size_t *dims_   = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t *offset_ = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t *count_  = (size_t *) malloc(n_dims * sizeof(size_t));
+    size_t *stride_ = (size_t *) malloc(n_dims * sizeof(size_t));
     size_t length_;
 
     dims_[0] = 0;
@@ -157,10 +124,11 @@ int HDFTableView::parseSlice(int32 n_dims, const int32 *dims,
         dims_[i] = dims[i];
 
     if (! XDFTableView::parseSlice(n_dims, dims_, i_row, n_rows, i_col, n_cols,
-                                   offset_, count_, &length_)) {
+                                   offset_, count_, stride_, &length_)) {
         for (int i = 0; i < n_dims; ++i) {
             offset[i] = offset_[i];
             count [i] = count_ [i];
+            stride[i] = stride_[i];
         }
 
         *length = length_;
@@ -171,16 +139,19 @@ int HDFTableView::parseSlice(int32 n_dims, const int32 *dims,
     free(dims_);
     free(offset_);
     free(count_);
+    free(stride_);
 
     return r;
 }
 
 
 
+/*
+ * Only the shape and types of the SD or vdata are read here.  The cells are
+ * read as they are displayed by readBlock().
+ */
 void HDFTableView::refreshTable()
 {
-    char *temp;
-
     char field_name_list[VSFIELDMAX * (FIELDNAMELENMAX + 1)];
 
     int data_size;
@@ -190,123 +161,62 @@ void HDFTableView::refreshTable()
     int i_col;
     int n_cols;
 
-    void *data;
-    void *ptr;
-
-    int32 sd_id;
-    int32 sds_index;
     int32 sds_id;
 
     int32 rank;
     int32 dim_sizes[MAX_VAR_DIMS];
 
-    int32 data_type;
     int32 num_attrs;
 
-    int32 start[MAX_VAR_DIMS];
-    int32 edge [MAX_VAR_DIMS];
+    int32 start [MAX_VAR_DIMS];
+    int32 edge  [MAX_VAR_DIMS];
+    int32 stride[MAX_VAR_DIMS];
 
-    int32 file_id;
-    int32 vdata_ref;
     int32 vdata_id;
 
     int32 n_records;
-    int32 n_records2;
     int32 n_fields;
     int32 vdata_size;
 
+    int32 field_size;
+
     int32 length;
 
-    temp = (char *) malloc(LN * sizeof(char));
+    bool has_fill;
 
-    if (type == HDFTreeViewItem::Dataset) {
-        sd_id = SDstart(file_name, DFACC_READ);
-        if (sd_id == FAIL) {
-            fprintf(stderr, "ERROR: SDstart(), file_name = %s\n", file_name);
-            exit(1);
-        }
+    double fill_value = 0.;
 
-        sds_index = SDnametoindex(sd_id, object_name);
-        if (sds_index == FAIL) {
-            fprintf(stderr, "ERROR: SDnametoindex(), sds_name = %s\n", object_name);
-            exit(1);
-        }
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::HDF4));
 
-        sds_id = SDselect(sd_id, sds_index);
-        if (sds_id == FAIL) {
-            fprintf(stderr, "ERROR: SDselect()\n");
-            exit(1);
-        }
+    if (openObject() < 0)
+        exit(1);
+
+    if (type == HDFTreeView::Dataset) {
+        sds_id = handle->id;
 
         if (SDgetinfo(sds_id, NULL, &rank, dim_sizes, &data_type, &num_attrs) == FAIL) {
             fprintf(stderr, "ERROR: SDgetinfo()\n");
             exit(1);
         }
 
-        if (! parseSlice(rank, dim_sizes, &i_row, &n_rows, &i_col, &n_cols, start, edge, &length)) {
+        if (! parseSlice(rank, dim_sizes, &i_row, &n_rows, &i_col, &n_cols, start, edge, stride,
+                         &length)) {
             data_size = hdf_data_type_size(data_type);
             if (data_size == 0) {
                 fprintf(stderr, "ERROR: hdf_data_type_size(), sds_name = %s\n", object_name);
                 exit(1);
             }
 
-            data = malloc(length * data_size);
-            if (data == NULL) {
-                fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", object_name);
-                exit(1);
-            }
-
-            if (SDreaddata(sds_id, start, NULL, edge, data) == FAIL) {
-                fprintf(stderr, "ERROR: SDreaddata(), sds_name = %s\n", object_name);
-                exit(1);
-            }
-
-            configureTable(i_row, n_rows, i_col, n_cols);
-
-            for (int i = 0; i < n_rows; ++i) {
-                for (int j = 0; j < n_cols; ++j) {
-                    ptr = ((char *) data) + (i * n_cols + j) * data_size;
-                    hdf_scaler_to_string(data_type, ptr, 0, temp, LN);
-                    tableWidget()->setItem(i, j, new QTableWidgetItem(temp));
-                }
-            }
-
-            free(data);
-        }
+            cell_type = XDFKernel::hdfType(data_type);
 
-        if (SDendaccess(sds_id) == FAIL) {
-            fprintf(stderr, "ERROR: SDgetinfo(), sds_name = %s\n", object_name);
-            exit(1);
-        }
+            has_fill = XDFStatistics::hdfFillValue(sds_id, data_type, &fill_value);
+            setFillValue(has_fill, fill_value);
 
-        if (SDend(sd_id) == FAIL) {
-            fprintf(stderr, "ERROR: SDend(), file_name = %s\n", file_name);
-            exit(1);
+            configureTable(i_row, n_rows, i_col, n_cols, data_size);
         }
     }
-    else if (type == HDFTreeViewItem::VData) {
-        file_id = Hopen(file_name, DFACC_READ, DEF_NDDS);
-        if (file_id == FAIL) {
-            fprintf(stderr, "ERROR: Hopen(), file_name = %s\n", file_name);
-            exit(1);
-        }
-
-        if (Vstart(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Vstart(), file_name = %s\n", file_name);
-            exit(1);
-        }
-
-        vdata_ref = VSfind(file_id, object_name);
-        if (vdata_ref == FAIL) {
-            fprintf(stderr, "ERROR: VSfind()\n");
-            exit(1);
-        }
-
-        vdata_id = VSattach(file_id, vdata_ref, "r");
-        if (vdata_id == FAIL) {
-            fprintf(stderr, "ERROR: VSattach()\n");
-            exit(1);
-        }
+    else if (type == HDFTreeView::VData) {
+        vdata_id = handle->id;
 
         if (VSinquire(vdata_id, &n_records, NULL, NULL, &vdata_size, NULL) == FAIL) {
             fprintf(stderr, "ERROR: VSinquire()\n");
@@ -323,64 +233,202 @@ void HDFTableView::refreshTable()
         dim_sizes[0] = n_records;
         dim_sizes[1] = n_fields;
 
-        if (! parseSlice(rank, dim_sizes, &i_row, &n_rows, &i_col, &n_cols, start, edge, &length)) {
+        if (! parseSlice(rank, dim_sizes, &i_row, &n_rows, &i_col, &n_cols, start, edge, stride,
+                         &length)) {
+            /*
+             * Records are read whole with the fields packed in order.  Each
+             * cell holds the first value of its field.
+             */
+            field_types.clear();
+            field_cell_types.clear();
+            field_offsets.clear();
+            field_sizes.clear();
+
+            record_size = 0;
+            data_size   = 0;
+            for (int i = 0; i < n_fields; ++i) {
+                field_types.append(VFfieldtype(vdata_id, i));
+                if (field_types[i] == FAIL) {
+                    fprintf(stderr, "ERROR: VFfieldtype(), vdata_name = %s\n", object_name);
+                    exit(1);
+                }
+                field_cell_types.append(XDFKernel::hdfType(field_types[i]));
+
+                field_size = VFfieldisize(vdata_id, i);
+                if (field_size == FAIL) {
+                    fprintf(stderr, "ERROR: VFfieldisize(), vdata_name = %s\n", object_name);
+                    exit(1);
+                }
 
-            data_type = VFfieldtype(vdata_id, 0);
-            if (data_type == FAIL) {
-                fprintf(stderr, "ERROR: VFfieldtype(), vdata_name = %s\n", object_name);
-                exit(1);
+                field_offsets.append(record_size);
+                field_sizes.append(field_size);
+                record_size += field_size;
+                data_size = qMax(data_size, (int) field_size);
             }
 
-            length *= n_records * vdata_size;
+            field_names = field_name_list;
+            first_field = i_col;
+            field_step  = stride[1];
 
-            data = malloc(length);
-            if (data == NULL) {
-                fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", object_name);
-                exit(1);
-            }
+            QStringList h_labels;
+            for (int i = 0; i < n_cols; ++i)
+                h_labels << VFfieldname(vdata_id, i_col + i * field_step);
+            configureTable(i_row, n_rows, i_col, n_cols, data_size, NULL, &h_labels);
+        }
+    }
+}
 
-            if (VSseek(vdata_id, i_row) == FAIL) {
-                fprintf(stderr, "ERROR: VSseek(), vdata_name = %s\n", object_name);
-                exit(1);
-            }
 
-            n_records2 = VSread(vdata_id, (uint8 *) data, n_records - i_row, FULL_INTERLACE);
-            if (n_records2 < n_records - i_row) {
-                fprintf(stderr, "ERROR: VSread(), vdata_name = %s\n", object_name);
-                exit(1);
-            }
 
-            QStringList h_labels;
-            for (int i = i_col; i < n_cols - i_col; ++i)
-                h_labels << VFfieldname(vdata_id, i);
-            configureTable(i_row, n_rows, i_col, n_cols, NULL, &h_labels);
-
-            for (int i = 0; i < n_rows; ++i) {
-                for (int j = i_col; j < n_cols - i_col; ++j) {
-                    ptr = ((char *) data) + (i * n_cols + j) * vdata_size;
-                    hdf_scaler_to_string(data_type, ptr, 0, temp, LN);
-                    tableWidget()->setItem(i, j, new QTableWidgetItem(temp));
-                }
-            }
+int HDFTableView::readBlockSD(int row, int n_rows, int col, int n_cols, void *data)
+{
+    int i;
 
-            free(data);
-        }
+    int32 sds_id;
 
-        if (VSdetach(vdata_id) == FAIL) {
-            fprintf(stderr, "ERROR: VSdetach(), vdata_name = %s\n", object_name);
-            exit(1);
+    int32 rank;
+    int32 dim_sizes[MAX_VAR_DIMS];
+
+    int32 num_attrs;
+
+    int32 start [MAX_VAR_DIMS];
+    int32 edge  [MAX_VAR_DIMS];
+    int32 stride[MAX_VAR_DIMS];
+
+    size_t start_ [MAX_VAR_DIMS];
+    size_t edge_  [MAX_VAR_DIMS];
+    size_t stride_[MAX_VAR_DIMS];
+
+    bool strided;
+
+    sds_id = handle->id;
+
+    if (SDgetinfo(sds_id, NULL, &rank, dim_sizes, NULL, &num_attrs) == FAIL) {
+        fprintf(stderr, "ERROR: SDgetinfo()\n");
+        return -1;
+    }
+
+    blockSlice(row, n_rows, col, n_cols, start_, edge_, stride_);
+
+    strided = false;
+    for (i = 0; i < rank; ++i) {
+        start [i] = start_ [i];
+        edge  [i] = edge_  [i];
+        stride[i] = stride_[i];
+        if (stride[i] > 1)
+            strided = true;
+    }
+
+    if (SDreaddata(sds_id, start, strided ? stride : NULL, edge, data) == FAIL) {
+        fprintf(stderr, "ERROR: SDreaddata(), sds_name = %s\n", object_name);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+int HDFTableView::readBlockVS(int row, int n_rows, int col, int n_cols, void *data)
+{
+    int i;
+    int j;
+    int k;
+
+    int32 vdata_id;
+
+    int32 n;
+    int32 n_records;
+
+    size_t start [2];
+    size_t edge  [2];
+    size_t stride[2];
+
+    char *records;
+    char *ptr;
+
+    blockSlice(row, n_rows, col, n_cols, start, edge, stride);
+
+    vdata_id = handle->id;
+
+    if (VSsetfields(vdata_id, field_names.constData()) == FAIL) {
+        fprintf(stderr, "ERROR: VSsetfields(), vdata_name = %s\n", object_name);
+        return -1;
+    }
+
+    records = (char *) malloc(edge[0] * record_size);
+    if (records == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed, vdata_name = %s\n", object_name);
+        return -1;
+    }
+
+    /*
+     * With a record stride only the selected records are read, one at a time.
+     */
+    n = stride[0] == 1 ? edge[0] : 1;
+
+    for (i = 0; i < (int) edge[0]; i += n) {
+        if (VSseek(vdata_id, start[0] + i * stride[0]) == FAIL) {
+            fprintf(stderr, "ERROR: VSseek(), vdata_name = %s\n", object_name);
+            free(records);
+            return -1;
         }
 
-        if (Vend(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Vend(), file_name = %s\n", file_name);
-            exit(1);
+        n_records = VSread(vdata_id, (uint8 *) records + i * record_size, n, FULL_INTERLACE);
+        if (n_records < n) {
+            fprintf(stderr, "ERROR: VSread(), vdata_name = %s\n", object_name);
+            free(records);
+            return -1;
         }
+    }
 
-        if (Hclose(file_id) == FAIL) {
-            fprintf(stderr, "ERROR: Hclose(), file_name = %s\n", file_name);
-            exit(1);
+    ptr = (char *) data;
+    for (i = 0; i < n_rows; ++i) {
+        for (j = 0; j < n_cols; ++j) {
+            k = start[1] + j * stride[1];
+            memcpy(ptr, records + i * record_size + field_offsets[k], field_sizes[k]);
+            ptr += cellSize();
         }
     }
 
-    free(temp);
+    free(records);
+
+    return 0;
+}
+
+
+
+int HDFTableView::readBlock(int row, int n_rows, int col, int n_cols, void *data)
+{
+    if (openObject() < 0)
+        return -1;
+
+    if (type == HDFTreeView::Dataset)
+        return readBlockSD(row, n_rows, col, n_cols, data);
+    else
+        return readBlockVS(row, n_rows, col, n_cols, data);
+}
+
+
+
+XDFKernel::Type HDFTableView::cellType(int col)
+{
+    if (type == HDFTreeView::Dataset)
+        return cell_type;
+    else
+        return field_cell_types[first_field + col * field_step];
+}
+
+
+
+/*
+ * Only SDs get a pyramid.  The fields of a vdata are not a two dimensional
+ * field.
+ */
+QByteArray HDFTableView::datasetKey()
+{
+    if (type != HDFTreeView::Dataset)
+        return QByteArray();
+
+    return XDFTileCache::datasetKey(file_name, object_name);
 }
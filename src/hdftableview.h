@@ -14,7 +14,11 @@
 #include <hdf.h>
 #include <mfhdf.h>
 
+#include <qbytearray.h>
+#include <qvector.h>
+
 #include "hdftreeview.h"
+#include "xdfhandlepool.h"
 #include "xdftableview.h"
 
 
@@ -26,19 +30,48 @@ private:
     const char *file_name;
     const char *object_name;
 
-    HDFTreeViewItem::ItemType type;
+    HDFTreeView::ItemType type;
+
+    XDFHandlePool::Handle *handle;
+
+    int32 data_type;
+    XDFKernel::Type cell_type;
+
+    /*
+     * For a vdata, the type, type of its cells, offset in a record, and size
+     * of each field.
+     */
+    QVector<int32> field_types;
+    QVector<XDFKernel::Type> field_cell_types;
+    QVector<int32> field_offsets;
+    QVector<int32> field_sizes;
+    int32 record_size;
+    int first_field;
+    int field_step;
+    QByteArray field_names;
 
     int parseSlice(int32 n_dims, const int32 *dims,
                    int *i_row, int *n_rows, int *i_col, int *n_cols,
-                   int32 *offset, int32 *count, int32 *length);
+                   int32 *offset, int32 *count, int32 *stride, int32 *length);
+
+    int openObject();
+
+    int readBlockSD(int row, int n_rows, int col, int n_cols, void *data);
+    int readBlockVS(int row, int n_rows, int col, int n_cols, void *data);
+    int readBlock(int row, int n_rows, int col, int n_cols, void *data);
+    XDFKernel::Type cellType(int col);
+    QByteArray datasetKey();
 
 public:
     HDFTableView(const char *file_name, const char *sds_name,
-                 HDFTreeViewItem::ItemType type, QWidget *parent = 0);
+                 HDFTreeView::ItemType type, QWidget *parent = 0);
     ~HDFTableView();
 
 public slots:
     void refreshTable();
+
+private slots:
+    void releaseStaleHandle();
 };
 
 #endif /* HDFTABLEVIEW_H */
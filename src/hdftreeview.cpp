@@ -14,6 +14,9 @@
 #include "xdfv.h"
 #include "hdftableview.h"
 #include "hdftreeview.h"
+#include "xdfhandlepool.h"
+#include "xdfkernel.h"
+#include "xdfstatisticsview.h"
 
 
 enum tree_view_fields {
@@ -41,38 +44,6 @@ enum tree_view_fields {
 };
 
 
-HDFTreeViewItem::HDFTreeViewItem(HDFTreeView *parent, ItemType type,
-                                 const char *name)
-    : XDFTreeViewItem(parent, name), type_(type)
-{
-
-}
-
-
-
-HDFTreeViewItem::HDFTreeViewItem(HDFTreeViewItem *parent, HDFTreeViewItem *after,
-                                 ItemType type, const char *name)
-    : XDFTreeViewItem(parent, after, name), type_(type)
-{
-
-}
-
-
-
-HDFTreeViewItem::~HDFTreeViewItem()
-{
-
-}
-
-
-
-HDFTreeViewItem::ItemType HDFTreeViewItem::type()
-{
-    return type_;
-}
-
-
-
 HDFTreeView::HDFTreeView(const char *file_name, int sds, QWidget *parent)
     : XDFTreeView(file_name, XDFV::HDF4, parent)
 {
@@ -86,9 +57,7 @@ void HDFTreeView::load()
 {
     char *temp;
 
-    int status;
-
-    HDFTreeViewItem *item;
+    int id;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -142,12 +111,10 @@ void HDFTreeView::load()
     snprintf(temp, LN, "%s - %s", program_name, filename());
     setWindowTitle(temp);
 
-    item = new HDFTreeViewItem(this, HDFTreeViewItem::File, filename());
-    item->setText(0, filename());
+    id = treeModel()->newNode(File, filename(), filename());
+    addNode(-1, -1, id);
 
-    status = procHDFFile(filename(), NULL, item, load_flag);
-    if (status != 0)
-        throw status;
+    startLoad(id);
 
     header()->resizeSection(0, 350);
 
@@ -156,6 +123,34 @@ void HDFTreeView::load()
 
 
 
+int HDFTreeView::loadItems(int root)
+{
+    return procHDFFile(filename(), NULL, nodePointer(root), load_flag);
+}
+
+
+
+int HDFTreeView::loadOptions()
+{
+    return load_flag;
+}
+
+
+
+int HDFTreeView::functionCanceled()
+{
+    return isLoadCanceled();
+}
+
+
+
+void HDFTreeView::functionProgress(long done, long total)
+{
+    reportProgress(done, total);
+}
+
+
+
 HDFTreeView::~HDFTreeView()
 {
 
@@ -166,41 +161,31 @@ HDFTreeView::~HDFTreeView()
 void *HDFTreeView::functionSDDim(const void *parent, const void *after,
                                  int dim_index, int32 dim_id, const int32 *flags)
 {
-    char *temp;
-
     char dim_name[MAX_NC_NAME];
 
     int32 length;
     int32 data_type;
     int32 num_attrs;
 
-    HDFTreeViewItem *item;
+    int id;
 
-    temp = (char *) malloc(LN * sizeof(char));
+    XDFTreeNode *node;
 
     if (SDdiminfo(dim_id, dim_name, &length, &data_type, &num_attrs) == FAIL) {
         fprintf(stderr, "ERROR: SDdiminfo()\n");
         return NULL;
     }
 
-    item = new HDFTreeViewItem((HDFTreeViewItem *) parent, (HDFTreeViewItem *) after,
-                               HDFTreeViewItem::Dimension, dim_name);
-
-    item->setText(FIELD_Name, dim_name);
-    item->setText(FIELD_Description, "SD Dimension");
+    id = treeModel()->newNode(Dimension, dim_name, dim_name);
+    node = &treeModel()->node(id);
 
-    snprintf(temp, LN, "%ld", (long) dim_index);
-    item->setText(FIELD_Index, temp);
+    node->count = dim_index;
+    node->id    = dim_id;
+    node->size  = length;
 
-    snprintf(temp, LN, "%ld", (long) dim_id);
-    item->setText(FIELD_ID, temp);
+    addNode(nodeId(parent), nodeId(after), id);
 
-    snprintf(temp, LN, "%ld", (long) length);
-    item->setText(FIELD_Value, temp);
-
-    free(temp);
-
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -219,7 +204,9 @@ void *HDFTreeView::functionSDAttrs(const void *parent, const void *after,
 
     void *data;
 
-    HDFTreeViewItem *item;
+    int node_id;
+
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -239,23 +226,16 @@ void *HDFTreeView::functionSDAttrs(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new HDFTreeViewItem((HDFTreeViewItem *) parent, (HDFTreeViewItem *) after,
-                               HDFTreeViewItem::Attribute, attr_name);
+    node_id = treeModel()->newNode(Attribute, attr_name, attr_name);
+    node = &treeModel()->node(node_id);
 
-    item->setText(FIELD_Name, attr_name);
-    item->setText(FIELD_Description, "SD Attribute");
+    node->count     = attr_index;
+    node->data_type = data_type;
+    node->size      = count;
 
-    snprintf(temp, LN, "%ld", (long) attr_index);
-    item->setText(FIELD_Index, temp);
-
-    item->setText(FIELD_Data_Type, hdf_data_type_name(data_type));
-
-    snprintf(temp, LN, "%ld", (long) count);
-    item->setText(FIELD_Dimensions, temp);
-
-    n = hdf_array_to_string(data_type, data, count, temp, LN);
+    n = XDFKernel::formatArray(XDFKernel::hdfType(data_type), data, count, temp, LN);
     if (n < 0) {
-        fprintf(stderr, "ERROR: hdf_array_to_string(), attr_name = %s\n", attr_name);
+        fprintf(stderr, "ERROR: XDFKernel::formatArray(), attr_name = %s\n", attr_name);
         return NULL;
     }
     if (data_type == DFNT_CHAR8 || data_type == DFNT_UCHAR8) {
@@ -264,12 +244,32 @@ void *HDFTreeView::functionSDAttrs(const void *parent, const void *after,
                 temp[i] = '\\';
         }
     }
-    item->setText(FIELD_Value, temp);
+    node->value = treeModel()->addString(temp);
+
+    addNode(nodeId(parent), nodeId(after), node_id);
 
     free(data);
     free(temp);
 
-    return (void *) item;
+    return nodePointer(node_id);
+}
+
+
+
+static int add_record_string(char *record, int *record_size, const char *s)
+{
+    int offset;
+
+    if (s[0] == '\0')
+        return -1;
+
+    offset = *record_size;
+
+    strcpy(record + offset, s);
+
+    *record_size += strlen(s) + 1;
+
+    return offset;
 }
 
 
@@ -277,8 +277,6 @@ void *HDFTreeView::functionSDAttrs(const void *parent, const void *after,
 void *HDFTreeView::functionSDIndex(const void *parent, const void *after,
                                    int32 sds_index, int32 sds_id, const int32 *flags)
 {
-    char *temp;
-
     char sds_name[MAX_NC_NAME];
 
     char *label;
@@ -286,10 +284,7 @@ void *HDFTreeView::functionSDIndex(const void *parent, const void *after,
     char *format;
     char *coordsys;
 
-    int data_size;
-
     int32 i;
-    int32 n;
 
     int32 flag;
 
@@ -301,114 +296,77 @@ void *HDFTreeView::functionSDIndex(const void *parent, const void *after,
     int32 data_type;
     int32 num_attrs;
 
-    int32 start[MAX_VAR_DIMS];
-    int32 edge [MAX_VAR_DIMS];
-
     float64 factor;
     float64 error;
     float64 offset;
     float64 offset_error;
     int32 data_type_raw;
 
-    void *data;
+    HDF_CHUNK_DEF cdef;
 
-    size_t length;
+    long long dims[MAX_VAR_DIMS];
 
-    HDF_CHUNK_DEF cdef;
+    int id;
 
-    HDFTreeViewItem *item;
+    int record_size;
 
-    temp = (char *) malloc(LN * sizeof(char));
+    XDFTreeNode *node;
+
+    SDRecord record;
+
+    char *record_buf;
 
     if (SDgetinfo(sds_id, sds_name, &rank, dim_sizes, &data_type, &num_attrs) == FAIL) {
         fprintf(stderr, "ERROR: SDgetinfo()\n");
         return NULL;
     }
 
-    item = new HDFTreeViewItem((HDFTreeViewItem *) parent, (HDFTreeViewItem *) after,
-                               HDFTreeViewItem::Dataset, sds_name);
-    item->setHasDataTable(true);
-
-    item->setText(FIELD_Name, sds_name);
-    item->setText(FIELD_Description, "SD");
+    id = treeModel()->newNode(Dataset, sds_name, sds_name);
+    node = &treeModel()->node(id);
 
-    snprintf(temp, LN, "%ld", (long) sds_index);
-    item->setText(FIELD_Index, temp);
+    node->flags |= XDFTreeModel::HasDataTable;
 
-    snprintf(temp, LN, "%ld", (long) sds_id);
-    item->setText(FIELD_ID, temp);
+    node->count     = sds_index;
+    node->id        = sds_id;
+    node->data_type = data_type;
 
     ref = SDidtoref(sds_id);
     if (ref == FAIL) {
         fprintf(stderr, "ERROR: SDidtoref()\n");
         return NULL;
     }
-    snprintf(temp, LN, "%ld", (long) ref);
-    item->setText(FIELD_Reference_Number, temp);
+    record.ref = ref;
 
-    item->setText(FIELD_Data_Type, hdf_data_type_name(data_type));
+    for (i = 0; i < rank; ++i)
+        dims[i] = dim_sizes[i];
 
-    n = 0;
-    for (i = 0; i < rank-1; ++i)
-        n += snprintf(temp+n, LN-(n+1), "%ld, ", (long) dim_sizes[i]);
-    n += snprintf(temp+n, LN-(n+1), "%ld", (long) dim_sizes[i]);
-    item->setText(FIELD_Dimensions, temp);
+    node->n_dims = rank;
+    node->dims   = treeModel()->addDims(rank, dims);
 
     if (SDgetchunkinfo(sds_id, &cdef, &flag) == FAIL) {
         fprintf(stderr, "ERROR: SDgetchunkinfo()\n");
         return NULL;
     }
 
-    n = 0;
-    if (flag == HDF_NONE)
-        n += snprintf(temp+n, LN - n, "None");
-    else if (flag ==  HDF_CHUNK ||
-            flag == (HDF_CHUNK | HDF_COMP) ||
-            flag == (HDF_CHUNK | HDF_NBIT))
-        n += snprintf(temp+n, LN - n, "Chunked");
-    else {
-        fprintf(stderr, "ERROR: SDgetchunkinfo(), invalid flag: %d\n", flag);
-        return NULL;
-    }
-    item->setText(FIELD_Chunking, temp);
-
-    n = 0;
-    if (flag == HDF_NONE ||
-        flag == HDF_CHUNK)
-        n += snprintf(temp+n, LN - n, "None");
-    else if (flag == (HDF_CHUNK | HDF_COMP))
-        n += snprintf(temp+n, LN - n, "RLE/GZIP");
-    else if (flag == (HDF_CHUNK | HDF_NBIT))
-        n += snprintf(temp+n, LN - n, "NBIT");
-    else {
+    if (flag != HDF_NONE &&
+        flag != HDF_CHUNK &&
+        flag != (HDF_CHUNK | HDF_COMP) &&
+        flag != (HDF_CHUNK | HDF_NBIT)) {
         fprintf(stderr, "ERROR: SDgetchunkinfo(), invalid flag: %d\n", flag);
         return NULL;
     }
-    item->setText(FIELD_Compression, temp);
-
+    record.chunk_flag = flag;
 
     if (SDgetcal(sds_id, &factor, &error, &offset, &offset_error, &data_type_raw) != FAIL) {
-        snprintf(temp, LN, "%e", factor);
-        item->setText(FIELD_Factor, temp);
-
-        snprintf(temp, LN, "%e", error);
-        item->setText(FIELD_Error, temp);
-
-        snprintf(temp, LN, "%e", offset);
-        item->setText(FIELD_Offset, temp);
-
-        snprintf(temp, LN, "%e", offset_error);
-        item->setText(FIELD_Offset_Error, temp);
-
-        item->setText(FIELD_Raw_Data_Type, hdf_data_type_name(data_type_raw));
-    }
-    else {
-        item->setText(FIELD_Factor, "n/a");
-        item->setText(FIELD_Error, "n/a");
-        item->setText(FIELD_Offset, "n/a");
-        item->setText(FIELD_Offset_Error, "n/a");
-        item->setText(FIELD_Raw_Data_Type, "n/a");
+        record.has_cal       = 1;
+        record.factor        = factor;
+        record.error         = error;
+        record.offset        = offset;
+        record.offset_error  = offset_error;
+        record.data_type_raw = data_type_raw;
     }
+    else
+        record.has_cal = 0;
 
     label    = (char *) malloc(LN * sizeof(char));
     unit     = (char *) malloc(LN * sizeof(char));
@@ -420,62 +378,35 @@ void *HDFTreeView::functionSDIndex(const void *parent, const void *after,
         return NULL;
     }
 
-    item->setText(FIELD_Label,    label[0]    != '\0' ? label    : "n/a");
-    item->setText(FIELD_Unit,     unit[0]     != '\0' ? unit     : "n/a");
-    item->setText(FIELD_Format,   format[0]   != '\0' ? format   : "n/a");
-    item->setText(FIELD_Coordsys, coordsys[0] != '\0' ? coordsys : "n/a");
+    record_buf = (char *) malloc(sizeof(SDRecord) + 4 * LN * sizeof(char));
+
+    record_size = sizeof(SDRecord);
+    record.label    = add_record_string(record_buf, &record_size, label);
+    record.unit     = add_record_string(record_buf, &record_size, unit);
+    record.format   = add_record_string(record_buf, &record_size, format);
+    record.coordsys = add_record_string(record_buf, &record_size, coordsys);
+
+    memcpy(record_buf, &record, sizeof(SDRecord));
+
+    node->record = treeModel()->addRecord(record_buf, record_size);
+
+    free(record_buf);
 
     free(label);
     free(unit);
     free(format);
     free(coordsys);
 
-    length = dim_sizes[rank - 1];
-/*
-    length = MIN(64, dim_sizes[rank - 1]);
-*/
-    data_size = hdf_data_type_size(data_type);
-    if (data_size == 0) {
-        fprintf(stderr, "ERROR: hdf_data_type_size(), sds_name = %s\n", sds_name);
-        return NULL;
-    }
-
-    data = malloc(length * data_size);
-    if (data == NULL) {
-        fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", sds_name);
-        return NULL;
-    }
-
     for (i = 0; i < rank; ++i) {
-        start[i] = 0;
-        edge[i] = 1;
-    }
-
-    edge[i - 1] = length;
-
-    if (SDreaddata(sds_id, start, NULL, edge, data) == FAIL) {
-        fprintf(stderr, "ERROR: SDreaddata(), sds_name = %s\n", sds_name);
-        return NULL;
+        if (dim_sizes[i] == 0)
+            break;
     }
+    if (i == rank)
+        node->flags |= XDFTreeModel::PreviewPending;
 
-    n = hdf_array_to_string(data_type, data, length, temp, LN);
-    if (n < 0) {
-        fprintf(stderr, "ERROR: hdf_array_to_string(), sds_name = %s\n", sds_name);
-        return NULL;
-    }
-    if (data_type == DFNT_CHAR8 || data_type == DFNT_UCHAR8) {
-        for (int i = 0; i < n; ++i) {
-            if (temp[i] == '\n')
-                temp[i] = '\\';
-        }
-    }
+    addNode(nodeId(parent), nodeId(after), id);
 
-    item->setText(FIELD_Value, temp);
-
-    free(data);
-    free(temp);
-
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -493,19 +424,17 @@ void *HDFTreeView::functionVRef(const void *parent, const void *after, void **af
     int32 count;
     int32 length;
 
-    HDFTreeViewItem *item;
-    HDFTreeViewItem *item2;
+    int id;
+    int attr_id;
+    int prev_id;
 
     if (Vgetname(vgroup_id, vgroup_name) == FAIL) {
         fprintf(stderr, "ERROR: Vgetname()\n");
         return NULL;
     }
 
-    item = new HDFTreeViewItem((HDFTreeViewItem *) parent, (HDFTreeViewItem *) after,
-                               HDFTreeViewItem::VGroup, vgroup_name);
-
-    item->setText(FIELD_Name, vgroup_name);
-    item->setText(FIELD_Description, "V");
+    id = treeModel()->newNode(VGroup, vgroup_name, vgroup_name);
+    addNode(nodeId(parent), nodeId(after), id);
 
     num_attrs = Vnattrs(vgroup_id);
     if (num_attrs == FAIL) {
@@ -513,23 +442,25 @@ void *HDFTreeView::functionVRef(const void *parent, const void *after, void **af
         return NULL;
     }
 
-    item2 = NULL;
+    prev_id = -1;
     for (int i = 0; i < num_attrs; ++i) {
         if (Vattrinfo(vgroup_id, i, attr_name, &data_type, &count, &length) == FAIL) {
             fprintf(stderr, "ERROR: Vattrinfo(), vgroup_name = %s\n", vgroup_name);
             return NULL;
         }
 
-        item2 = new HDFTreeViewItem(item, item2, HDFTreeViewItem::Attribute, attr_name);
+        attr_id = treeModel()->newNode(Attribute, attr_name, attr_name);
+
+        treeModel()->node(attr_id).data_type = data_type;
 
-        item2->setText(FIELD_Name, attr_name);
-        item2->setText(FIELD_Description, "V Attribute");
-        item2->setText(FIELD_Data_Type, hdf_data_type_name(data_type));
+        addNode(id, prev_id, attr_id);
+
+        prev_id = attr_id;
     }
 
     *after2 = NULL;
 
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -559,8 +490,13 @@ void *HDFTreeView::functionVSRef(const void *parent, const void *after,
 
     void *data;
 
-    HDFTreeViewItem *item;
-    HDFTreeViewItem *item2;
+    long long dims[3];
+
+    int id;
+    int attr_id;
+    int prev_id;
+
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -576,58 +512,60 @@ void *HDFTreeView::functionVSRef(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new HDFTreeViewItem((HDFTreeViewItem *) parent, (HDFTreeViewItem *) after,
-                               HDFTreeViewItem::VData, vdata_name);
-    item->setHasDataTable(true);
+    id = treeModel()->newNode(VData, vdata_name, vdata_name);
+
+    node = &treeModel()->node(id);
 
-    item->setText(FIELD_Name, vdata_name);
-    item->setText(FIELD_Description, "VS");
+    node->flags |= XDFTreeModel::HasDataTable;
 
     data_type = VFfieldtype(vdata_id, 0);
     if (data_type == FAIL) {
         fprintf(stderr, "ERROR: VFfieldtype(), vdata_name = %s\n", vdata_name);
         return NULL;
     }
-    item->setText(FIELD_Data_Type, hdf_data_type_name(data_type));
+    node->data_type = data_type;
 
-    snprintf(temp, LN, "Nr: %ld, Nf: %ld, Size: %ld",
-             (long) n_records, (long) n_fields, (long) vdata_size);
-    item->setText(FIELD_Dimensions, temp);
+    dims[0] = n_records;
+    dims[1] = n_fields;
+    dims[2] = vdata_size;
 
-    length = n_records * n_fields * vdata_size;
+    node->n_dims = 3;
+    node->dims   = treeModel()->addDims(3, dims);
 
-    data = malloc(length);
-    if (data == NULL) {
-        fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", vdata_name);
-        return NULL;
-    }
+    /*
+     * Only the first record is shown so only it is read.
+     */
+    if (n_records > 0) {
+        data = malloc(qMax(vdata_size, n_fields * DFKNTsize(data_type)));
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", vdata_name);
+            return NULL;
+        }
 
-    n_records2 = VSread(vdata_id, (uint8 *) data, n_records, FULL_INTERLACE);
-    if (n_records2 < n_records) {
-        fprintf(stderr, "ERROR: VSread(), vdata_name = %s\n", vdata_name);
-        return NULL;
-    }
-/*
-    if (VSfpack(vdata_id, _HDF_VSUNPACK, NULL, data, length, n_records, NULL, bufptrs) == FAIL) {
-        fprintf(stderr, "ERROR: VSread(), vdata_name = %s\n", vdata_name);
-        return NULL;
-    }
-*/
-    n = hdf_array_to_string(data_type, data, n_fields, temp, LN);
-    if (n < 0) {
-        fprintf(stderr, "ERROR: hdf_array_to_string(), sds_name = %s\n", vdata_name);
-        return NULL;
-    }
-    if (data_type == DFNT_CHAR8 || data_type == DFNT_UCHAR8) {
-        for (int i = 0; i < n; ++i) {
-            if (temp[i] == '\n')
-                temp[i] = '\\';
+        n_records2 = VSread(vdata_id, (uint8 *) data, 1, FULL_INTERLACE);
+        if (n_records2 < 1) {
+            fprintf(stderr, "ERROR: VSread(), vdata_name = %s\n", vdata_name);
+            return NULL;
         }
-    }
 
-    item->setText(FIELD_Value, temp);
+        n = XDFKernel::formatArray(XDFKernel::hdfType(data_type), data, n_fields, temp, LN);
+        if (n < 0) {
+            fprintf(stderr, "ERROR: XDFKernel::formatArray(), sds_name = %s\n", vdata_name);
+            return NULL;
+        }
+        if (data_type == DFNT_CHAR8 || data_type == DFNT_UCHAR8) {
+            for (int i = 0; i < n; ++i) {
+                if (temp[i] == '\n')
+                    temp[i] = '\\';
+            }
+        }
 
-    free(data);
+        node->value = treeModel()->addString(temp);
+
+        free(data);
+    }
+
+    addNode(nodeId(parent), nodeId(after), id);
 
     num_attrs = VSnattrs(vdata_id);
     if (num_attrs == FAIL) {
@@ -635,7 +573,7 @@ void *HDFTreeView::functionVSRef(const void *parent, const void *after,
         return NULL;
     }
 
-    item2 = NULL;
+    prev_id = -1;
     for (int i = 0; i < num_attrs; ++i) {
         if (VSattrinfo(vdata_id, -1, i, attr_name, &data_type, &count, &length) == FAIL) {
             fprintf(stderr, "ERROR: VSattrinfo(), vdata_name = %s\n", vdata_name);
@@ -655,18 +593,16 @@ void *HDFTreeView::functionVSRef(const void *parent, const void *after,
             return NULL;
         }
 
-        item2 = new HDFTreeViewItem(item, item2, HDFTreeViewItem::Attribute, attr_name);
+        attr_id = treeModel()->newNode(Attribute, attr_name, attr_name);
 
-        item2->setText(FIELD_Name, attr_name);
-        item2->setText(FIELD_Description, "VS Attribute");
-        item2->setText(FIELD_Data_Type, hdf_data_type_name(data_type));
+        node = &treeModel()->node(attr_id);
 
-        snprintf(temp, LN, "%ld", (long) count);
-        item2->setText(FIELD_Dimensions, temp);
+        node->data_type = data_type;
+        node->size      = count;
 
-        n = hdf_array_to_string(data_type, data, length, temp, LN);
+        n = XDFKernel::formatArray(XDFKernel::hdfType(data_type), data, length, temp, LN);
         if (n < 0) {
-            fprintf(stderr, "ERROR: hdf_array_to_string(), vdata_name = %s, attr_name = %s\n",
+            fprintf(stderr, "ERROR: XDFKernel::formatArray(), vdata_name = %s, attr_name = %s\n",
                     vdata_name, attr_name);
             return NULL;
         }
@@ -678,71 +614,344 @@ void *HDFTreeView::functionVSRef(const void *parent, const void *after,
             }
         }
 
-        item2->setText(FIELD_Value, temp);
+        node->value = treeModel()->addString(temp);
+
+        addNode(id, prev_id, attr_id);
 
         free(data);
+
+        prev_id = attr_id;
     }
 
     free(temp);
 
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
 
-void HDFTreeView::colorize(QTreeWidgetItem *item_, bool color)
+/*
+ * Reads the start of the last dimension of an SD, at most max_preview_size
+ * bytes, and formats it into value.
+ */
+int HDFTreeView::loadPreview(int32 sd_id, int id, char *value, int size)
 {
-    HDFTreeViewItem *item = (HDFTreeViewItem *) item_;
-
-    if (! color)
-        item->setTextColor(FIELD_Name, QColor(0, 0, 0));
-    else {
-        switch(item->type()) {
-            case HDFTreeViewItem::File:
-                item->setTextColor(FIELD_Name, file_color);
-                break;
-            case HDFTreeViewItem::VGroup:
-                item->setTextColor(FIELD_Name, v_color);
-                break;
-            case HDFTreeViewItem::Dataset:
-                item->setTextColor(FIELD_Name, sd_color);
-                break;
-            case HDFTreeViewItem::VData:
-                item->setTextColor(FIELD_Name, vs_color);
-                break;
-            case HDFTreeViewItem::Dimension:
-                item->setTextColor(FIELD_Name, dim_color);
-                break;
-            case HDFTreeViewItem::Attribute:
-                item->setTextColor(FIELD_Name, attr_color);
-                break;
-            default:
-                break;
+    const char *sds_name;
+
+    int data_size;
+
+    int32 i;
+    int32 n;
+
+    int32 sds_id;
+
+    int32 start[MAX_VAR_DIMS];
+    int32 edge [MAX_VAR_DIMS];
+
+    void *data;
+
+    size_t length;
+
+    const long long *dims;
+
+    XDFTreeNode &node = treeModel()->node(id);
+
+    sds_name = treeModel()->string(node.name);
+
+    data_size = hdf_data_type_size(node.data_type);
+    if (data_size == 0) {
+        fprintf(stderr, "ERROR: hdf_data_type_size(), sds_name = %s\n", sds_name);
+        return -1;
+    }
+
+    dims = treeModel()->dims(node.dims);
+
+    length = qMin(dims[node.n_dims - 1], (long long) qMax(1, max_preview_size / data_size));
+
+    sds_id = SDselect(sd_id, node.count);
+    if (sds_id == FAIL) {
+        fprintf(stderr, "ERROR: SDselect(), sds_name = %s\n", sds_name);
+        return -1;
+    }
+
+    data = malloc(length * data_size);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed, sds_name = %s\n", sds_name);
+        return -1;
+    }
+
+    for (i = 0; i < node.n_dims; ++i) {
+        start[i] = 0;
+        edge[i] = 1;
+    }
+
+    edge[i - 1] = length;
+
+    if (SDreaddata(sds_id, start, NULL, edge, data) == FAIL) {
+        fprintf(stderr, "ERROR: SDreaddata(), sds_name = %s\n", sds_name);
+        return -1;
+    }
+
+    n = XDFKernel::formatArray(XDFKernel::hdfType(node.data_type), data, length, value, size);
+    if (n < 0) {
+        fprintf(stderr, "ERROR: XDFKernel::formatArray(), sds_name = %s\n", sds_name);
+        return -1;
+    }
+    if (node.data_type == DFNT_CHAR8 || node.data_type == DFNT_UCHAR8) {
+        for (i = 0; i < n; ++i) {
+            if (value[i] == '\n')
+                value[i] = '\\';
         }
     }
+
+    free(data);
+
+    if (SDendaccess(sds_id) == FAIL) {
+        fprintf(stderr, "ERROR: SDendaccess(), sds_name = %s\n", sds_name);
+        return -1;
+    }
+
+    return 0;
 }
 
 
 
-void HDFTreeView::showDataTable()
+int HDFTreeView::loadPreviews(const QVector<int> &ids, QList<QByteArray> &values)
 {
-    showDataTable((HDFTreeViewItem *) currentItem(), 0);
+    char *temp;
+
+    int i;
+
+    XDFHandlePool::Handle *file;
+
+    file = XDFHandlePool::instance()->acquire(XDFHandlePool::SDFile, filename());
+    if (file == NULL)
+        return -1;
+
+    temp = (char *) malloc(LN * sizeof(char));
+
+    for (i = 0; i < ids.size(); ++i) {
+        if (loadPreview(file->id, ids[i], temp, LN) < 0)
+            temp[0] = '\0';
+
+        values.append(QByteArray(temp));
+    }
+
+    free(temp);
+
+    XDFHandlePool::instance()->release(file);
+
+    return 0;
 }
 
 
 
-void HDFTreeView::showDataTable(HDFTreeViewItem *item, int column)
+QString HDFTreeView::nodeText(int id, int column)
 {
-    if (item == NULL)
-        return;
+    char *temp;
+
+    int i;
+    int n;
+
+    int parent_type;
+
+    const long long *dims;
+
+    QString text;
+
+    XDFTreeNode &node = treeModel()->node(id);
 
-    if (item->type() != HDFTreeViewItem::Dataset &&
-        item->type() != HDFTreeViewItem::VData)
+    const SDRecord *record;
+
+    parent_type = node.parent < 0 ? File : treeModel()->node(node.parent).type;
+
+    record = node.type == Dataset ?
+             (const SDRecord *) treeModel()->record(node.record) : NULL;
+
+    switch (column) {
+        case FIELD_Description:
+            switch (node.type) {
+                case VGroup:
+                    return "V";
+                case Dataset:
+                    return "SD";
+                case VData:
+                    return "VS";
+                case Dimension:
+                    return "SD Dimension";
+                case Attribute:
+                    if (parent_type == VGroup)
+                        return "V Attribute";
+                    if (parent_type == VData)
+                        return "VS Attribute";
+                    return "SD Attribute";
+                default:
+                    return QString();
+            }
+        case FIELD_Index:
+            if (node.type != Dataset && node.type != Dimension &&
+                (node.type != Attribute || parent_type == VGroup || parent_type == VData))
+                return QString();
+            return QString::number(node.count);
+        case FIELD_ID:
+            if (node.type != Dataset && node.type != Dimension)
+                return QString();
+            return QString::number(node.id);
+        case FIELD_Reference_Number:
+            if (record == NULL)
+                return QString();
+            return QString::number(record->ref);
+        case FIELD_Data_Type:
+            if (node.type != Dataset && node.type != VData && node.type != Attribute)
+                return QString();
+            return hdf_data_type_name(node.data_type);
+        case FIELD_Dimensions:
+            if (node.type == Attribute && parent_type != VGroup)
+                return QString::number(node.size);
+            if (node.type != Dataset && node.type != VData)
+                return QString();
+            break;
+        case FIELD_Chunking:
+            if (record == NULL)
+                return QString();
+            if (record->chunk_flag == HDF_NONE)
+                return "None";
+            return "Chunked";
+        case FIELD_Compression:
+            if (record == NULL)
+                return QString();
+            if (record->chunk_flag == (HDF_CHUNK | HDF_COMP))
+                return "RLE/GZIP";
+            if (record->chunk_flag == (HDF_CHUNK | HDF_NBIT))
+                return "NBIT";
+            return "None";
+        case FIELD_Factor:
+        case FIELD_Error:
+        case FIELD_Offset:
+        case FIELD_Offset_Error:
+        case FIELD_Raw_Data_Type:
+            if (record == NULL)
+                return QString();
+            if (! record->has_cal)
+                return "n/a";
+            if (column == FIELD_Raw_Data_Type)
+                return hdf_data_type_name(record->data_type_raw);
+            break;
+        case FIELD_Label:
+            if (record == NULL)
+                return QString();
+            return record->label >= 0 ? (const char *) record + record->label : "n/a";
+        case FIELD_Unit:
+            if (record == NULL)
+                return QString();
+            return record->unit >= 0 ? (const char *) record + record->unit : "n/a";
+        case FIELD_Format:
+            if (record == NULL)
+                return QString();
+            return record->format >= 0 ? (const char *) record + record->format : "n/a";
+        case FIELD_Coordsys:
+            if (record == NULL)
+                return QString();
+            return record->coordsys >= 0 ? (const char *) record + record->coordsys : "n/a";
+        case FIELD_Value:
+            if (node.type == Dimension)
+                return QString::number(node.size);
+            return treeModel()->string(node.value);
+        default:
+            return XDFTreeView::nodeText(id, column);
+    }
+
+    temp = (char *) malloc(LN * sizeof(char));
+
+    n = 0;
+    switch (column) {
+        case FIELD_Dimensions:
+            dims = treeModel()->dims(node.dims);
+            if (node.type == VData)
+                n += snprintf(temp+n, LN - n, "Nr: %lld, Nf: %lld, Size: %lld",
+                              dims[0], dims[1], dims[2]);
+            else {
+                for (i = 0; i < node.n_dims; ++i) {
+                    n += snprintf(temp+n, LN - n, "%lld", dims[i]);
+                    if (i < node.n_dims - 1)
+                        n += snprintf(temp+n, LN - n, ", ");
+                }
+            }
+            break;
+        case FIELD_Factor:
+            n += snprintf(temp+n, LN - n, "%e", record->factor);
+            break;
+        case FIELD_Error:
+            n += snprintf(temp+n, LN - n, "%e", record->error);
+            break;
+        case FIELD_Offset:
+            n += snprintf(temp+n, LN - n, "%e", record->offset);
+            break;
+        case FIELD_Offset_Error:
+            n += snprintf(temp+n, LN - n, "%e", record->offset_error);
+            break;
+    }
+    temp[n] = '\0';
+
+    text = temp;
+
+    free(temp);
+
+    return text;
+}
+
+
+
+QColor HDFTreeView::nodeColor(int id)
+{
+    switch(treeModel()->node(id).type) {
+        case File:
+            return file_color;
+        case VGroup:
+            return v_color;
+        case Dataset:
+            return sd_color;
+        case VData:
+            return vs_color;
+        case Dimension:
+            return dim_color;
+        case Attribute:
+            return attr_color;
+        default:
+            return QColor(0, 0, 0);
+    }
+}
+
+
+
+void HDFTreeView::showDataTable(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Dataset &&
+        node.type != VData)
         return;
 
-    HDFTableView *t = new HDFTableView(filename(), item->name, item->type(), 0);
+    HDFTableView *t = new HDFTableView(filename(), treeModel()->string(node.name),
+                                       (ItemType) node.type, 0);
 
     t->setAttribute(Qt::WA_QuitOnClose, false);
     t->setAttribute(Qt::WA_DeleteOnClose, true);
     t->show();
 }
+
+
+
+void HDFTreeView::showStatistics(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Dataset)
+        return;
+
+    XDFStatisticsView *s = new XDFStatisticsView(XDFV::HDF4, filename(),
+                                                 treeModel()->string(node.name), 0);
+    s->setAttribute(Qt::WA_QuitOnClose, false);
+    s->setAttribute(Qt::WA_DeleteOnClose, true);
+    s->show();
+}
@@ -16,19 +16,44 @@
 
 #include <hdfprocessor.h>
 
-#include <qstandarditemmodel.h>
-
 #include "xdftreeview.h"
 
 
-class HDFTreeViewItem;
-
-
 class HDFTreeView : public XDFTreeView, HDFProcessor
 {
     Q_OBJECT
 
+public:
+    enum ItemType {
+        File,
+        VGroup,
+        Dataset,
+        VData,
+        Dimension,
+        Attribute
+    };
+
 private:
+    /*
+     * Details of an SD that only SDs have, kept in the node's record.  label,
+     * unit, format, and coordsys are byte offsets from the start of the record
+     * to strings that follow it or are -1 if empty.
+     */
+    struct SDRecord {
+        int ref;
+        int chunk_flag;
+        int has_cal;
+        int data_type_raw;
+        float64 factor;
+        float64 error;
+        float64 offset;
+        float64 offset_error;
+        int label;
+        int unit;
+        int format;
+        int coordsys;
+    };
+
     int load_flag;
 
     QColor file_color;
@@ -38,8 +63,6 @@ private:
     QColor dim_color;
     QColor attr_color;
 
-    QStandardItemModel *model;
-
     void *functionSDDim(const void *parent, const void *after,
                         int dim_index, int32 dim_id, const int32 *flags);
     void *functionSDAttrs(const void *parent, const void *after,
@@ -51,7 +74,11 @@ private:
     void *functionVSRef(const void *parent, const void *after,
                         int32 vdata_id, const int32 *flags);
 
-    void colorize(QTreeWidgetItem *item, bool color);
+    int functionCanceled();
+    void functionProgress(long done, long total);
+
+    int loadPreview(int32 sd_id, int id, char *value, int size);
+    int loadPreviews(const QVector<int> &ids, QList<QByteArray> &values);
 
 public:
     HDFTreeView(const char *file_name, int sds, QWidget *parent = 0);
@@ -59,35 +86,16 @@ public:
 
     void load();
 
-public slots:
-    void showDataTable();
-    void showDataTable(HDFTreeViewItem *item, int column);
-};
+protected:
+    QString nodeText(int id, int column);
+    QColor nodeColor(int id);
 
+    int loadItems(int root);
+    int loadOptions();
 
-class HDFTreeViewItem : public XDFTreeViewItem
-{
-public:
-    enum ItemType {
-        File,
-        VGroup,
-        Dataset,
-        VData,
-        Dimension,
-        Attribute
-    };
-
-private:
-    ItemType type_;
-
-public:
-    HDFTreeViewItem(HDFTreeView *parent, ItemType type_,
-                    const char *name_);
-    HDFTreeViewItem(HDFTreeViewItem *parent, HDFTreeViewItem *after,
-                    ItemType type_, const char *name_);
-    ~HDFTreeViewItem();
-
-    ItemType type();
+public slots:
+    void showDataTable(int id);
+    void showStatistics(int id);
 };
 
 #endif /* HDFTREEVIEW_H */
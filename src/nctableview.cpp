@@ -11,54 +11,40 @@
 
 #include <netcdf.h>
 
+#include <qmutex.h>
+
 #include "xdfv.h"
 #include "nctableview.h"
+#include "xdfstatistics.h"
+#include "xdftilecache.h"
 
 
 NCTableView::NCTableView(const char *file_name, const char *var_name, QWidget *parent)
-     : XDFTableView(parent), file_name(file_name), var_name(var_name)
+     : XDFTableView(XDFV::NetCDF, parent), file_name(file_name), var_name(var_name),
+       handle(NULL), n_dims(0), cell_type(XDFKernel::Unknown)
 {
     char temp[NC_MAX_NAME];
 
     int status;
 
-    int nc_id;
-    int var_id;
-
-    int n_dims;
     int dim_ids[NC_MAX_VAR_DIMS];
 
     int n_atts;
 
-    nc_type xtype;
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::NetCDF));
 
-    status = nc_open(file_name, NC_NOWRITE, &nc_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_open(), file_name = %s, %s\n",
-                file_name, nc_strerror(status));
+    if (openVar() < 0)
         exit(1);
-    }
 
-    status = nc_inq_varid(nc_id, var_name, &var_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_inq_varid(), varname = %s, %s\n",
-                var_name, nc_strerror(status));
-        exit(1);
-    }
-
-    status = nc_inq_var(nc_id, var_id, temp, &xtype, &n_dims, dim_ids, &n_atts);
+    status = nc_inq_var(grp_id, var_id, temp, &xtype, &n_dims, dim_ids, &n_atts);
     if (status != NC_NOERR) {
         fprintf(stderr, "ERROR: nc_inq_var(), varname = %s, %s\n",
                 var_name, nc_strerror(status));
         exit(1);
     }
 
-    status = nc_close(nc_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_close(), file_name = %s, %s\n",
-                file_name, nc_strerror(status));
-        exit(1);
-    }
+    QObject::connect(XDFHandlePool::instance(), SIGNAL(invalidated(const QByteArray &)),
+                     this, SLOT(releaseStaleHandle()));
 
     buildWidget(var_name, n_dims);
 
@@ -69,11 +55,62 @@ NCTableView::NCTableView(const char *file_name, const char *var_name, QWidget *p
 
 NCTableView::~NCTableView()
 {
+    stopPrefetch();
+
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::NetCDF));
 
+    XDFHandlePool::instance()->release(handle);
 }
 
 
 
+/*
+ * Gets the file from the XDFHandlePool, again if it has been reloaded, and
+ * looks up the variable in it.
+ */
+int NCTableView::openVar()
+{
+    int status;
+
+    if (handle != NULL && ! handle->is_stale)
+        return 0;
+
+    XDFHandlePool::instance()->release(handle);
+
+    handle = XDFHandlePool::instance()->acquire(XDFHandlePool::NCFile, file_name);
+    if (handle == NULL)
+        return -1;
+
+    status = netcdf_inq_varid_path(handle->id, var_name, &grp_id, &var_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_varid(), varname = %s, %s\n",
+                var_name, nc_strerror(status));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Lets go of the file once it has been reloaded, see
+ * XDFHandlePool::invalidate().  openVar() gets it again.
+ */
+void NCTableView::releaseStaleHandle()
+{
+    if (handle != NULL && handle->is_stale) {
+        XDFHandlePool::instance()->release(handle);
+        handle = NULL;
+    }
+}
+
+
+
+/*
+ * Only the shape and type of the variable are read here.  The cells are read
+ * as they are displayed by readBlock().
+ */
 void NCTableView::refreshTable()
 {
     int i_row;
@@ -85,97 +122,124 @@ void NCTableView::refreshTable()
 
     int status;
 
-    int nc_id;
-    int var_id;
-
-    int n_dims;
     int dim_ids[NC_MAX_VAR_DIMS];
 
     int n_atts;
 
     int data_size;
 
-    void *data;
+    bool has_fill;
 
-    void *ptr;
+    double fill_value = 0.;
 
     size_t length;
 
     size_t dimlen[MAX_VAR_DIMS];
 
-    size_t start[MAX_VAR_DIMS];
-    size_t count[MAX_VAR_DIMS];
+    size_t start [MAX_VAR_DIMS];
+    size_t count [MAX_VAR_DIMS];
+    size_t stride[MAX_VAR_DIMS];
 
-    nc_type xtype;
+    QMutexLocker locker(XDFV::libraryMutex(XDFV::NetCDF));
 
     temp = (char *) malloc(LN * sizeof(char));
 
-    status = nc_open(file_name, NC_NOWRITE, &nc_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_open(), file_name = %s, %s\n",
-                file_name, nc_strerror(status));
+    if (openVar() < 0)
         exit(1);
-    }
 
-    status = nc_inq_varid(nc_id, var_name, &var_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_inq_varid(), varname = %s, %s\n",
-                var_name, nc_strerror(status));
-        exit(1);
-    }
-
-    status = nc_inq_var(nc_id, var_id, temp, &xtype, &n_dims, dim_ids, &n_atts);
+    status = nc_inq_var(grp_id, var_id, temp, &xtype, &n_dims, dim_ids, &n_atts);
     if (status != NC_NOERR) {
         fprintf(stderr, "ERROR: nc_inq_var(), %s, %s\n", var_name, nc_strerror(status));
         exit(1);
     }
 
+    cell_type = XDFKernel::netcdfType(xtype);
+
+    has_fill = XDFStatistics::ncFillValue(grp_id, var_id, xtype, &fill_value);
+    setFillValue(has_fill, fill_value);
+
     for (int i = 0; i < n_dims; ++i) {
-        status = nc_inq_dimlen(nc_id, dim_ids[i], &dimlen[i]);
+        status = nc_inq_dimlen(grp_id, dim_ids[i], &dimlen[i]);
         if (status != NC_NOERR) {
             fprintf(stderr, "ERROR: nc_inq_dimlen(), %s\n", nc_strerror(status));
             exit(1);
         }
     }
 
-    if (! parseSlice(n_dims, dimlen, &i_row, &n_rows, &i_col, &n_cols, start, count, &length)) {
+    if (! parseSlice(n_dims, dimlen, &i_row, &n_rows, &i_col, &n_cols, start, count, stride,
+                     &length)) {
         data_size = netcdf_data_type_size(xtype);
         if (data_size == 0) {
             fprintf(stderr, "ERROR: netcdf_data_type_size(), var_name = %s\n", var_name);
             exit(1);
         }
 
-        data = malloc(length * data_size);
-        if (data == NULL) {
-            fprintf(stderr, "ERROR: Memory allocation failed, var_name = %s\n", var_name);
-            exit(1);
-        }
+        configureTable(i_row, n_rows, i_col, n_cols, data_size);
+    }
+
+    free(temp);
+}
+
+
+
+/*
+ * Strided slices are read with nc_get_vars() so that only the selected
+ * elements are read.
+ */
+int NCTableView::readBlock(int row, int n_rows, int col, int n_cols, void *data)
+{
+    int i;
+
+    int status;
+
+    bool strided;
+
+    size_t start [MAX_VAR_DIMS];
+    size_t count [MAX_VAR_DIMS];
+    size_t stride[MAX_VAR_DIMS];
+
+    ptrdiff_t stride_[MAX_VAR_DIMS];
 
-        status = nc_get_vara(nc_id, var_id, start, count, data);
+    if (openVar() < 0)
+        return -1;
+
+    blockSlice(row, n_rows, col, n_cols, start, count, stride);
+
+    strided = false;
+    for (i = 0; i < n_dims; ++i) {
+        stride_[i] = stride[i];
+        if (stride[i] > 1)
+            strided = true;
+    }
+
+    if (! strided) {
+        status = nc_get_vara(grp_id, var_id, start, count, data);
         if (status != NC_NOERR) {
             fprintf(stderr, "ERROR: nc_get_vara(), %s\n", nc_strerror(status));
-            return exit(1);
+            return -1;
+        }
+    }
+    else {
+        status = nc_get_vars(grp_id, var_id, start, count, stride_, data);
+        if (status != NC_NOERR) {
+            fprintf(stderr, "ERROR: nc_get_vars(), %s\n", nc_strerror(status));
+            return -1;
         }
+    }
 
-        configureTable(i_row, n_rows, i_col, n_cols);
+    return 0;
+}
 
-        for (int i = 0; i < n_rows; ++i) {
-            for (int j = 0; j < n_cols; ++j) {
-                ptr = ((char *) data) + (i * n_cols + j) * data_size;
-                netcdf_scaler_to_string(xtype, ptr, 0, temp, LN);
-                tableWidget()->setItem(i, j, new QTableWidgetItem(temp));
-            }
-        }
 
-        free(data);
-    }
 
-    status = nc_close(nc_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_close(), file_name = %s, %s\n",
-                file_name, nc_strerror(status));
-        exit(1);
-    }
+XDFKernel::Type NCTableView::cellType(int col)
+{
+    return cell_type;
+}
 
-    free(temp);
+
+
+QByteArray NCTableView::datasetKey()
+{
+    return XDFTileCache::datasetKey(file_name, var_name);
 }
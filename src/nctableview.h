@@ -12,6 +12,7 @@
 
 #include <netcdf.h>
 
+#include "xdfhandlepool.h"
 #include "xdftableview.h"
 
 
@@ -23,12 +24,29 @@ private:
     const char *file_name;
     const char *var_name;
 
+    XDFHandlePool::Handle *handle;
+    int grp_id;
+    int var_id;
+
+    int n_dims;
+    nc_type xtype;
+    XDFKernel::Type cell_type;
+
+    int openVar();
+
+    int readBlock(int row, int n_rows, int col, int n_cols, void *data);
+    XDFKernel::Type cellType(int col);
+    QByteArray datasetKey();
+
 public:
     NCTableView(const char *file_name, const char *var_name, QWidget *parent = 0);
     ~NCTableView();
 
 public slots:
     void refreshTable();
+
+private slots:
+    void releaseStaleHandle();
 };
 
 #endif /* NCTABLEVIEW_H */
@@ -14,6 +14,9 @@
 #include "xdfv.h"
 #include "nctableview.h"
 #include "nctreeview.h"
+#include "xdfhandlepool.h"
+#include "xdfkernel.h"
+#include "xdfstatisticsview.h"
 
 
 enum tree_view_fields {
@@ -30,38 +33,6 @@ enum tree_view_fields {
 };
 
 
-NCTreeViewItem::NCTreeViewItem(NCTreeView *parent, ItemType type,
-                               const char *name)
-    : XDFTreeViewItem(parent, name), type_(type)
-{
-
-}
-
-
-
-NCTreeViewItem::NCTreeViewItem(NCTreeViewItem *parent, NCTreeViewItem *after,
-                               ItemType type, const char *name)
-    : XDFTreeViewItem(parent, after, name), type_(type)
-{
-
-}
-
-
-
-NCTreeViewItem::~NCTreeViewItem()
-{
-
-}
-
-
-
-NCTreeViewItem::ItemType NCTreeViewItem::type()
-{
-    return type_;
-}
-
-
-
 NCTreeView::NCTreeView(const char *file_name, QWidget *parent)
     : XDFTreeView(file_name, XDFV::NetCDF, parent)
 {
@@ -77,9 +48,7 @@ void NCTreeView::load()
 {
     char *temp;
 
-    int status;
-
-    NCTreeViewItem *item;
+    int id;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -105,20 +74,19 @@ void NCTreeView::load()
     setColumnHidden(FIELD_Deflate,     false);
     setColumnHidden(FIELD_Value,       false);
 
-    file_color = QColor(  0,   0,   0);
-    var_color  = QColor(  0, 224,   0);
-    dim_color  = QColor(224,   0, 224);
-    attr_color = QColor(  0,   0, 224);
+    file_color  = QColor(  0,   0,   0);
+    var_color   = QColor(  0, 224,   0);
+    dim_color   = QColor(224,   0, 224);
+    attr_color  = QColor(  0,   0, 224);
+    group_color = QColor(224,   0,   0);
 
     snprintf(temp, LN, "%s - %s", program_name, filename());
     setWindowTitle(temp);
 
-    item = new NCTreeViewItem(this, NCTreeViewItem::File, filename());
-    item->setText(0, filename());
+    id = treeModel()->newNode(File, filename(), filename());
+    addNode(-1, -1, id);
 
-    status = procNCFile(filename(), NULL, item);
-    if (status != 0)
-        throw status;
+    startLoad(id);
 
     header()->resizeSection(0, 350);
 
@@ -127,6 +95,27 @@ void NCTreeView::load()
 
 
 
+int NCTreeView::loadItems(int root)
+{
+    return procNCFile(filename(), NULL, nodePointer(root));
+}
+
+
+
+int NCTreeView::functionCanceled()
+{
+    return isLoadCanceled();
+}
+
+
+
+void NCTreeView::functionProgress(long done, long total)
+{
+    reportProgress(done, total);
+}
+
+
+
 NCTreeView::~NCTreeView()
 {
 
@@ -137,17 +126,15 @@ NCTreeView::~NCTreeView()
 void *NCTreeView::functionDim(const void *parent, const void *after,
                               int dim_id, const int *flags)
 {
-    char *temp;
-
     char dim_name[MAX_NC_NAME];
 
     int status;
 
     size_t length;
 
-    NCTreeViewItem *item;
+    int id;
 
-    temp = (char *) malloc(LN * sizeof(char));
+    XDFTreeNode *node;
 
     status = nc_inq_dim(nc_id, dim_id, dim_name, &length);
     if (status != NC_NOERR) {
@@ -155,21 +142,15 @@ void *NCTreeView::functionDim(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new NCTreeViewItem((NCTreeViewItem *) parent, (NCTreeViewItem *) after,
-                              NCTreeViewItem::Dimension, dim_name);
-
-    item->setText(FIELD_Name, dim_name);
-    item->setText(FIELD_Description, "Dimension");
+    id = treeModel()->newNode(Dimension, dim_name, dim_name);
+    node = &treeModel()->node(id);
 
-    snprintf(temp, LN, "%d", dim_id);
-    item->setText(FIELD_Var_ID, temp);
+    node->id   = dim_id;
+    node->size = length;
 
-    snprintf(temp, LN, "%ld", (long) length);
-    item->setText(FIELD_Value, temp);
-
-    free(temp);
+    addNode(nodeId(parent), nodeId(after), id);
 
-    return (void *) item;
+    return nodePointer(id);
 }
 
 
@@ -191,7 +172,9 @@ void *NCTreeView::functionAttrs(const void *parent, const void *after,
 
     nc_type xtype;
 
-    NCTreeViewItem *item;
+    int node_id;
+
+    XDFTreeNode *node;
 
     temp = (char *) malloc(LN * sizeof(char));
 
@@ -219,21 +202,14 @@ void *NCTreeView::functionAttrs(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new NCTreeViewItem((NCTreeViewItem *) parent, (NCTreeViewItem *) after,
-                              NCTreeViewItem::Attribute, att_name);
-
-    item->setText(FIELD_Name, att_name);
-    item->setText(FIELD_Description, "Attribute");
-
-    snprintf(temp, LN, "%d", att_num);
-    item->setText(FIELD_Var_ID, temp);
+    node_id = treeModel()->newNode(Attribute, att_name, att_name);
+    node = &treeModel()->node(node_id);
 
-    item->setText(FIELD_Data_Type, netcdf_data_type_name(xtype));
+    node->id        = att_num;
+    node->data_type = xtype;
+    node->size      = length;
 
-    snprintf(temp, LN, "%ld", (long) length);
-    item->setText(FIELD_Dimensions, temp);
-
-    n = netcdf_array_to_string(xtype, data, length, temp, LN);
+    n = XDFKernel::formatArray(XDFKernel::netcdfType(xtype), data, length, temp, LN);
     if (n < 0) {
         fprintf(stderr, "ERROR: netcdf_data_to_string(), att_name = %s\n", att_name);
         return NULL;
@@ -245,12 +221,14 @@ void *NCTreeView::functionAttrs(const void *parent, const void *after,
         }
     }
 
-    item->setText(FIELD_Value, temp);
+    node->value = treeModel()->addString(temp);
+
+    addNode(nodeId(parent), nodeId(after), node_id);
 
     free(data);
     free(temp);
 
-    return (void *) item;
+    return nodePointer(node_id);
 }
 
 
@@ -258,12 +236,9 @@ void *NCTreeView::functionAttrs(const void *parent, const void *after,
 void *NCTreeView::functionVarID(const void *parent, const void *after,
                                 int var_id, const int *flags)
 {
-    char *temp;
-
     char var_name[MAX_NC_NAME];
 
     int i;
-    int n;
 
     int status;
 
@@ -272,30 +247,31 @@ void *NCTreeView::functionVarID(const void *parent, const void *after,
 
     int n_atts;
 
-    int data_size;
-
     int shuffle;
     int deflate;
     int deflate_level;
 
     int storage;
 
-    void *data;
-
-    size_t length;
-
     size_t dimlen[MAX_VAR_DIMS];
 
     size_t chunksizesp[MAX_VAR_DIMS];
 
-    size_t start[MAX_VAR_DIMS];
-    size_t count[MAX_VAR_DIMS];
-
     nc_type xtype;
 
-    NCTreeViewItem *item;
+    long long dims[MAX_VAR_DIMS];
 
-    temp = (char *) malloc(LN * sizeof(char));
+    int id;
+
+    int record_size;
+
+    char *full_name;
+
+    size_t full_length;
+
+    XDFTreeNode *node;
+
+    VariableRecord *record;
 
     status = nc_inq_var(nc_id, var_id, var_name, &xtype, &n_dims, dim_ids, &n_atts);
     if (status != NC_NOERR) {
@@ -303,34 +279,53 @@ void *NCTreeView::functionVarID(const void *parent, const void *after,
         return NULL;
     }
 
-    item = new NCTreeViewItem((NCTreeViewItem *) parent, (NCTreeViewItem *) after,
-                              NCTreeViewItem::Variable, var_name);
-    item->setHasDataTable(true);
+    /*
+     * Variables in a subgroup are named by their full path so that they can
+     * be found again from the file.
+     */
+    status = nc_inq_grpname_full(nc_id, &full_length, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    full_name = (char *) malloc(full_length + strlen(var_name) + 2);
 
-    item->setText(FIELD_Name, var_name);
+    if (full_length <= 1)
+        strcpy(full_name, var_name);
+    else {
+        status = nc_inq_grpname_full(nc_id, NULL, full_name);
+        if (status != NC_NOERR) {
+            fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+            return NULL;
+        }
+        strcat(full_name, "/");
+        strcat(full_name, var_name);
+    }
 
-    item->setText(FIELD_Description, "Variable");
+    id = treeModel()->newNode(Variable, full_name, var_name);
 
-    snprintf(temp, LN, "%d", var_id);
-    item->setText(FIELD_Var_ID, temp);
+    free(full_name);
 
-    item->setText(FIELD_Data_Type, netcdf_data_type_name(xtype));
+    node = &treeModel()->node(id);
 
-    n = 0;
-    for (int i = 0; i < n_dims; ++i) {
+    node->flags |= XDFTreeModel::HasDataTable;
+
+    node->id        = var_id;
+    node->data_type = xtype;
+
+    for (i = 0; i < n_dims; ++i) {
         status = nc_inq_dimlen(nc_id, dim_ids[i], &dimlen[i]);
         if (status != NC_NOERR) {
             fprintf(stderr, "ERROR: nc_inq_dimlen(), %s\n", nc_strerror(status));
             return NULL;
         }
 
-        n += snprintf(temp+n, LN - n, "%ld", (long) dimlen[i]);
-
-        if (i < n_dims-1)
-            n += snprintf(temp+n, LN - n, ", ");
+        dims[i] = dimlen[i];
     }
 
-    item->setText(FIELD_Dimensions, temp);
+    node->n_dims = n_dims;
+    node->dims   = treeModel()->addDims(n_dims, dims);
 
     status = nc_inq_var_chunking(nc_id, var_id, &storage, chunksizesp);
     if (status != NC_NOERR) {
@@ -338,20 +333,23 @@ void *NCTreeView::functionVarID(const void *parent, const void *after,
         return NULL;
     }
 
-    n = 0;
     if (storage == NC_CONTIGUOUS)
-        n += snprintf(temp+n, LN - n, "Contiguous");
-    else if (storage == NC_CHUNKED) {
-        n += snprintf(temp+n, LN - n, "Chunked");
-        for (int i = 0; i < n_dims; ++i)
-            n += snprintf(temp+n, LN - n, ", %ld", chunksizesp[i]);
-    }
+        record_size = sizeof(VariableRecord);
+    else if (storage == NC_CHUNKED)
+        record_size = sizeof(VariableRecord) + n_dims * sizeof(long long);
     else {
         fprintf(stderr, "ERROR: nc_inq_var_chunking(), invalid chunking value: %d\n", storage);
         return NULL;
     }
 
-    item->setText(FIELD_Chunking, temp);
+    record = (VariableRecord *) malloc(record_size);
+
+    record->storage = storage;
+
+    if (storage == NC_CHUNKED) {
+        for (i = 0; i < n_dims; ++i)
+            ((long long *) (record + 1))[i] = chunksizesp[i];
+    }
 
     status = nc_inq_var_deflate(nc_id, var_id, &shuffle, &deflate, &deflate_level);
     if (status != NC_NOERR) {
@@ -359,109 +357,382 @@ void *NCTreeView::functionVarID(const void *parent, const void *after,
         return NULL;
     }
 
-    n = 0;
-    n += snprintf(temp+n, LN - n, "%d,", shuffle);
-    n += snprintf(temp+n, LN - n, "%d,", deflate);
-    n += snprintf(temp+n, LN - n, "%d", deflate_level);
+    record->shuffle       = shuffle;
+    record->deflate       = deflate;
+    record->deflate_level = deflate_level;
+
+    node->record = treeModel()->addRecord(record, record_size);
+
+    free(record);
+
+    for (i = 0; i < n_dims; ++i) {
+        if (dimlen[i] == 0)
+            break;
+    }
+    if (i == n_dims)
+        node->flags |= XDFTreeModel::PreviewPending;
+
+    addNode(nodeId(parent), nodeId(after), id);
+
+    return nodePointer(id);
+}
+
 
-    item->setText(FIELD_Deflate, temp);
 
-    length = dimlen[n_dims - 1];
 /*
-    length = MIN(64, dimlen[n_dims - 1]);
-*/
-    data_size = netcdf_data_type_size(xtype);
+ * Groups are added unpopulated and enumerated by populate() when expanded so
+ * that files with many groups open quickly.
+ */
+void *NCTreeView::functionGroup(const void *parent, const void *after,
+                                int grp_id, const int *flags)
+{
+    char grp_name[NC_MAX_NAME + 1];
+
+    char *full_name;
+
+    int status;
+
+    int n_dims;
+    int n_vars;
+    int n_gatts;
+    int unlimdim_id;
+
+    int n_grps;
+
+    size_t full_length;
+
+    int id;
+
+    XDFTreeNode *node;
+
+    status = nc_inq_grpname(grp_id, grp_name);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    status = nc_inq_grpname_full(grp_id, &full_length, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    full_name = (char *) malloc(full_length + 1);
+
+    status = nc_inq_grpname_full(grp_id, NULL, full_name);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    id = treeModel()->newNode(Group, full_name, grp_name);
+    free(full_name);
+
+    node = &treeModel()->node(id);
+
+    status = nc_inq(grp_id, &n_dims, &n_vars, &n_gatts, &unlimdim_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    status = nc_inq_grps(grp_id, &n_grps, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grps(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    node->count = n_vars + n_grps;
+
+    if (n_vars + n_gatts + n_grps > 0)
+        node->flags |= XDFTreeModel::Unpopulated;
+
+    addNode(nodeId(parent), nodeId(after), id);
+
+    return nodePointer(id);
+}
+
+
+
+int NCTreeView::populate(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Group)
+        return 0;
+
+    return procNCGroup(filename(), treeModel()->string(node.name), nodePointer(id));
+}
+
+
+
+/*
+ * Reads the start of the last dimension of a variable, at most
+ * max_preview_size bytes, and formats it into value.
+ */
+int NCTreeView::loadPreview(int nc_id, int id, char *value, int size)
+{
+    const char *var_name;
+
+    int i;
+    int n;
+
+    int status;
+
+    int grp_id;
+    int var_id;
+
+    size_t data_size;
+
+    void *data;
+
+    size_t length;
+
+    size_t start[NC_MAX_VAR_DIMS];
+    size_t count[NC_MAX_VAR_DIMS];
+
+    const long long *dims;
+
+    XDFTreeNode &node = treeModel()->node(id);
+
+    var_name = treeModel()->string(node.name);
+
+    status = netcdf_inq_varid_path(nc_id, var_name, &grp_id, &var_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_varid(), var_name = %s, %s\n",
+                var_name, nc_strerror(status));
+        return -1;
+    }
+
+    data_size = netcdf_data_type_size(node.data_type);
     if (data_size == 0) {
         fprintf(stderr, "ERROR: netcdf_data_type_size(), var_name = %s\n", var_name);
-        exit(1);
+        return -1;
+    }
+
+    if (node.n_dims == 0)
+        length = 1;
+    else {
+        dims = treeModel()->dims(node.dims);
+        length = qMin((size_t) dims[node.n_dims - 1],
+                      (size_t) qMax(1, max_preview_size / (int) data_size));
     }
 
     data = malloc(length * data_size);
     if (data == NULL) {
         fprintf(stderr, "ERROR: Memory allocation failed, var_name = %s\n", var_name);
-        return NULL;
+        return -1;
     }
 
-    for (i = 0; i < n_dims; ++i) {
+    for (i = 0; i < node.n_dims; ++i) {
         start[i] = 0;
         count[i] = 1;
     }
 
-    count[i - 1] = length;
+    if (node.n_dims > 0)
+        count[node.n_dims - 1] = length;
 
-    status = nc_get_vara(nc_id, var_id, start, count, data);
+    status = nc_get_vara(grp_id, var_id, start, count, data);
     if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_get_vara(), %s\n", nc_strerror(status));
-        return NULL;
+        fprintf(stderr, "ERROR: nc_get_vara(), var_name = %s, %s\n",
+                var_name, nc_strerror(status));
+        free(data);
+        return -1;
     }
 
-    n = netcdf_array_to_string(xtype, data, length, temp, LN);
+    n = XDFKernel::formatArray(XDFKernel::netcdfType(node.data_type), data, length, value, size);
     if (n < 0) {
-        fprintf(stderr, "ERROR: netcdf_data_to_string(), var_name = %s\n", var_name);
-        return NULL;
+        fprintf(stderr, "ERROR: XDFKernel::formatArray(), var_name = %s\n", var_name);
+        free(data);
+        return -1;
     }
-    if (xtype == NC_CHAR) {
-        for (int i = 0; i < n; ++i) {
-            if (temp[i] == '\n')
-                temp[i] = '\\';
+    if (node.data_type == NC_CHAR) {
+        for (i = 0; i < n; ++i) {
+            if (value[i] == '\n')
+                value[i] = '\\';
         }
     }
 
-    item->setText(FIELD_Value, temp);
+    if (node.data_type == NC_STRING)
+        nc_free_string(length, (char **) data);
 
     free(data);
+
+    return 0;
+}
+
+
+
+int NCTreeView::loadPreviews(const QVector<int> &ids, QList<QByteArray> &values)
+{
+    char *temp;
+
+    int i;
+
+    XDFHandlePool::Handle *file;
+
+    file = XDFHandlePool::instance()->acquire(XDFHandlePool::NCFile, filename());
+    if (file == NULL)
+        return -1;
+
+    temp = (char *) malloc(LN * sizeof(char));
+
+    for (i = 0; i < ids.size(); ++i) {
+        if (loadPreview(file->id, ids[i], temp, LN) < 0)
+            temp[0] = '\0';
+
+        values.append(QByteArray(temp));
+    }
+
     free(temp);
 
-    return (void *) item;
+    XDFHandlePool::instance()->release(file);
+
+    return 0;
 }
 
 
 
-void NCTreeView::colorize(QTreeWidgetItem *item_, bool color)
+QString NCTreeView::nodeText(int id, int column)
 {
-    NCTreeViewItem *item = (NCTreeViewItem *) item_;
+    char *temp;
+
+    int i;
+    int n;
+
+    const long long *dims;
+
+    QString text;
+
+    XDFTreeNode &node = treeModel()->node(id);
+
+    const VariableRecord *record;
+
+    switch (column) {
+        case FIELD_Description:
+            switch (node.type) {
+                case Variable:
+                    return "Variable";
+                case Dimension:
+                    return "Dimension";
+                case Attribute:
+                    return "Attribute";
+                case Group:
+                    return "Group";
+                default:
+                    return QString();
+            }
+        case FIELD_Var_ID:
+            if (node.type == File || node.type == Group)
+                return QString();
+            return QString::number(node.id);
+        case FIELD_Data_Type:
+            if (node.type != Variable && node.type != Attribute)
+                return QString();
+            return netcdf_data_type_name((nc_type) node.data_type);
+        case FIELD_Dimensions:
+            if (node.type == Attribute)
+                return QString::number(node.size);
+            if (node.type != Variable)
+                return QString();
+            break;
+        case FIELD_Chunking:
+            if (node.type != Variable)
+                return QString();
+            break;
+        case FIELD_Deflate:
+            if (node.type != Variable)
+                return QString();
+            record = (const VariableRecord *) treeModel()->record(node.record);
+            return QString("%1,%2,%3").arg(record->shuffle)
+                                      .arg(record->deflate)
+                                      .arg(record->deflate_level);
+        case FIELD_Value:
+            if (node.type == Dimension)
+                return QString::number(node.size);
+            return treeModel()->string(node.value);
+        default:
+            return XDFTreeView::nodeText(id, column);
+    }
+
+    temp = (char *) malloc(LN * sizeof(char));
 
-    if (! color)
-        item->setTextColor(FIELD_Name, QColor(0, 0, 0));
+    n = 0;
+    if (column == FIELD_Dimensions) {
+        dims = treeModel()->dims(node.dims);
+        for (i = 0; i < node.n_dims; ++i) {
+            n += snprintf(temp+n, LN - n, "%lld", dims[i]);
+            if (i < node.n_dims - 1)
+                n += snprintf(temp+n, LN - n, ", ");
+        }
+    }
     else {
-        switch(item->type()) {
-            case NCTreeViewItem::File:
-                item->setTextColor(FIELD_Name, file_color);
-                break;
-            case NCTreeViewItem::Variable:
-                item->setTextColor(FIELD_Name, var_color);
-                break;
-            case NCTreeViewItem::Attribute:
-                item->setTextColor(FIELD_Name, attr_color);
-                break;
-            case NCTreeViewItem::Dimension:
-                item->setTextColor(FIELD_Name, dim_color);
-                break;
-            default:
-                break;
+        record = (const VariableRecord *) treeModel()->record(node.record);
+        if (record->storage == NC_CONTIGUOUS)
+            n += snprintf(temp+n, LN - n, "Contiguous");
+        else {
+            n += snprintf(temp+n, LN - n, "Chunked");
+            dims = (const long long *) (record + 1);
+            for (i = 0; i < node.n_dims; ++i)
+                n += snprintf(temp+n, LN - n, ", %lld", dims[i]);
         }
     }
+    temp[n] = '\0';
+
+    text = temp;
+
+    free(temp);
+
+    return text;
 }
 
 
 
-void NCTreeView::showDataTable()
+QColor NCTreeView::nodeColor(int id)
 {
-    showDataTable((NCTreeViewItem *) currentItem(), 0);
+    switch(treeModel()->node(id).type) {
+        case File:
+            return file_color;
+        case Variable:
+            return var_color;
+        case Attribute:
+            return attr_color;
+        case Dimension:
+            return dim_color;
+        case Group:
+            return group_color;
+        default:
+            return QColor(0, 0, 0);
+    }
 }
 
 
 
-void NCTreeView::showDataTable(NCTreeViewItem *item, int column)
+void NCTreeView::showDataTable(int id)
 {
-    if (item == NULL)
-        return;
+    XDFTreeNode &node = treeModel()->node(id);
 
-    if (item->type() != NCTreeViewItem::Variable)
+    if (node.type != Variable)
         return;
 
-    NCTableView *t = new NCTableView(filename(), item->name, 0);
+    NCTableView *t = new NCTableView(filename(), treeModel()->string(node.name), 0);
     t->setAttribute(Qt::WA_QuitOnClose, false);
     t->setAttribute(Qt::WA_DeleteOnClose, true);
     t->show();
 }
+
+
+
+void NCTreeView::showStatistics(int id)
+{
+    XDFTreeNode &node = treeModel()->node(id);
+
+    if (node.type != Variable)
+        return;
+
+    XDFStatisticsView *s = new XDFStatisticsView(XDFV::NetCDF, filename(),
+                                                 treeModel()->string(node.name), 0);
+    s->setAttribute(Qt::WA_QuitOnClose, false);
+    s->setAttribute(Qt::WA_DeleteOnClose, true);
+    s->show();
+}
@@ -14,25 +14,39 @@
 
 #include <ncprocessor.h>
 
-#include <qstandarditemmodel.h>
-
 #include "xdftreeview.h"
 
 
-class NCTreeViewItem;
-
-
 class NCTreeView : public XDFTreeView, NCProcessor
 {
     Q_OBJECT
 
+public:
+    enum ItemType {
+        File,
+        Variable,
+        Dimension,
+        Attribute,
+        Group
+    };
+
 private:
+    /*
+     * Storage details of a variable, kept in the node's record since only
+     * variables have them.  For chunked variables the chunk sizes follow.
+     */
+    struct VariableRecord {
+        short storage;
+        short shuffle;
+        short deflate;
+        short deflate_level;
+    };
+
     QColor file_color;
     QColor var_color;
     QColor dim_color;
     QColor attr_color;
-
-    QStandardItemModel *model;
+    QColor group_color;
 
     void *functionDim(const void *parent, const void *after,
                       int dim_id, const int *flags);
@@ -40,8 +54,16 @@ private:
                         int id, int att_num, const int *flags);
     void *functionVarID(const void *parent, const void *after,
                         int var_id, const int *flags);
+    void *functionGroup(const void *parent, const void *after,
+                        int grp_id, const int *flags);
+
+    int functionCanceled();
+    void functionProgress(long done, long total);
+
+    int populate(int id);
 
-    void colorize(QTreeWidgetItem *item, bool color);
+    int loadPreview(int nc_id, int id, char *value, int size);
+    int loadPreviews(const QVector<int> &ids, QList<QByteArray> &values);
 
 public:
     NCTreeView(const char *file_name, QWidget *parent = 0);
@@ -49,33 +71,15 @@ public:
 
     void load();
 
-public slots:
-    void showDataTable();
-    void showDataTable(NCTreeViewItem *item, int column);
-};
+protected:
+    QString nodeText(int id, int column);
+    QColor nodeColor(int id);
 
+    int loadItems(int root);
 
-class NCTreeViewItem : public XDFTreeViewItem
-{
-public:
-    enum ItemType {
-        File,
-        Variable,
-        Dimension,
-        Attribute
-    };
-
-private:
-    ItemType type_;
-
-public:
-    NCTreeViewItem(NCTreeView *parent, ItemType type_,
-                   const char *name_);
-    NCTreeViewItem(NCTreeViewItem *parent, NCTreeViewItem *after,
-                   ItemType type_, const char *name_);
-    ~NCTreeViewItem();
-
-    ItemType type();
+public slots:
+    void showDataTable(int id);
+    void showStatistics(int id);
 };
 
 #endif /* NCTREEVIEW_H */
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFARENA_H
+#define XDFARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * An append only array of plain data stored in fixed size chunks that are
+ * never moved, so elements may be read by one thread while another appends.
+ * Elements are addressed by int index.  A run allocated with allocate() is
+ * contiguous and at most 1 << chunk_bits elements long.
+ */
+template <class T, int chunk_bits>
+class XDFArena
+{
+private:
+    static const int chunk_size = 1 << chunk_bits;
+    static const int max_chunks = chunk_bits < 14 ? 1 << 16 : (1 << 30) >> chunk_bits;
+
+    T **chunks;
+
+    int n_chunks;
+    int n;
+
+public:
+    XDFArena() : chunks(NULL), n_chunks(0), n(0) { }
+    ~XDFArena() { clear(); }
+
+    int size() const { return n; }
+
+    int allocate(int count)
+    {
+        int i;
+
+        if (chunks == NULL)
+            chunks = (T **) calloc(max_chunks, sizeof(T *));
+
+        if (count <= 0 || count > chunk_size)
+            return -1;
+
+        if ((n & (chunk_size - 1)) + count > chunk_size)
+            n = (n + chunk_size - 1) & ~(chunk_size - 1);
+
+        if ((n >> chunk_bits) == max_chunks)
+            return -1;
+
+        while (n_chunks <= (n + count - 1) >> chunk_bits)
+            chunks[n_chunks++] = (T *) malloc(chunk_size * sizeof(T));
+
+        i  = n;
+        n += count;
+
+        return i;
+    }
+
+    int append(const T &x)
+    {
+        int i;
+
+        if ((i = allocate(1)) >= 0)
+            (*this)[i] = x;
+
+        return i;
+    }
+
+    int append(const T *x, int count)
+    {
+        int i;
+
+        if ((i = allocate(count)) >= 0)
+            memcpy(&(*this)[i], x, count * sizeof(T));
+
+        return i;
+    }
+
+    T &operator[](int i)
+    {
+        return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+    }
+
+    const T &operator[](int i) const
+    {
+        return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+    }
+
+    /* Bytes held, for reporting. */
+    size_t capacity() const
+    {
+        return (size_t) n_chunks * chunk_size * sizeof(T);
+    }
+
+    void clear()
+    {
+        int i;
+
+        for (i = 0; i < n_chunks; ++i)
+            free(chunks[i]);
+        free(chunks);
+
+        chunks   = NULL;
+        n_chunks = 0;
+        n        = 0;
+    }
+};
+
+#endif /* XDFARENA_H */
@@ -0,0 +1,505 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hdf5.h>
+#include <zlib.h>
+
+#include <qmutex.h>
+#include <qrunnable.h>
+#include <qthread.h>
+#include <qthreadpool.h>
+#include <qwaitcondition.h>
+
+#include "xdfv.h"
+#include "xdfchunkreader.h"
+#include "xdftilecache.h"
+
+
+/*
+ * The chunks of a read() in flight, which read() waits for.
+ */
+struct XDFChunkBatch {
+    QMutex mutex;
+    QWaitCondition changed;
+    int n_pending;
+    int status;
+};
+
+
+
+/*
+ * Decodes one raw chunk and copies the part of it in a region into place.
+ */
+class XDFChunkJob : public QRunnable
+{
+private:
+    XDFChunkReader *reader;
+    XDFChunkBatch *batch;
+
+    int n_dims;
+    size_t data_size;
+    size_t chunk_offset[8];
+    size_t chunk_count[8];
+
+    void *raw;
+    size_t raw_size;
+    unsigned int filter_mask;
+
+    const size_t *offset;
+    const size_t *count;
+    void *data;
+
+public:
+    XDFChunkJob(XDFChunkReader *reader, XDFChunkBatch *batch, int n_dims,
+                size_t data_size, const hsize_t *chunk_offset,
+                const hsize_t *chunk_dims, void *raw, size_t raw_size,
+                unsigned int filter_mask, const size_t *offset,
+                const size_t *count, void *data);
+
+    void run();
+};
+
+
+
+XDFChunkJob::XDFChunkJob(XDFChunkReader *reader_, XDFChunkBatch *batch_,
+                         int n_dims_, size_t data_size_,
+                         const hsize_t *chunk_offset_, const hsize_t *chunk_dims_,
+                         void *raw_, size_t raw_size_, unsigned int filter_mask_,
+                         const size_t *offset_, const size_t *count_, void *data_)
+    : reader(reader_), batch(batch_), n_dims(n_dims_), data_size(data_size_),
+      raw(raw_), raw_size(raw_size_), filter_mask(filter_mask_), offset(offset_),
+      count(count_), data(data_)
+{
+    int i;
+
+    for (i = 0; i < n_dims; ++i) {
+        chunk_offset[i] = chunk_offset_[i];
+        chunk_count [i] = chunk_dims_  [i];
+    }
+
+    setAutoDelete(true);
+}
+
+
+
+void XDFChunkJob::run()
+{
+    int r;
+
+    void *chunk;
+
+    r = reader->decode(raw, raw_size, filter_mask, &chunk);
+    if (r == 0) {
+        XDFTileCache::copyTile(n_dims, data_size, chunk, chunk_offset, chunk_count,
+                               data, offset, count);
+        free(chunk);
+    }
+
+    batch->mutex.lock();
+    batch->n_pending--;
+    if (r < 0)
+        batch->status = -1;
+    batch->changed.wakeAll();
+    batch->mutex.unlock();
+}
+
+
+
+XDFChunkReader::XDFChunkReader()
+    : is_supported(false), n_dims(0), data_size(0), chunk_size(0), n_filters(0)
+{
+
+}
+
+
+
+/*
+ * The pool has as many threads as cores, less one for the thread reading the
+ * raw chunks.  It is only used from read() so the library lock guards its
+ * creation.
+ */
+QThreadPool *XDFChunkReader::pool()
+{
+    static QThreadPool *pool = NULL;
+
+    if (pool == NULL) {
+        pool = new QThreadPool;
+        pool->setMaxThreadCount(MAX(1, QThread::idealThreadCount() - 1));
+    }
+
+    return pool;
+}
+
+
+
+/*
+ * Gets the shape, chunking, and filters of the dataset and whether read() can
+ * be used for it.  Must be called holding the HDF5 library lock.
+ */
+int XDFChunkReader::init(hid_t dataset_id)
+{
+    int i;
+    int r;
+
+    unsigned int flags;
+    unsigned int cd_values[8];
+
+    size_t cd_nelmts;
+
+    hid_t datatype_id;
+    hid_t dataspace_id;
+    hid_t plist_id;
+
+    is_supported = false;
+    n_filters    = 0;
+
+    datatype_id = H5Dget_type(dataset_id);
+    if (datatype_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_type()\n");
+        return -1;
+    }
+
+    data_size = H5Tget_size(datatype_id);
+
+    r = H5Tdetect_class(datatype_id, H5T_VLEN) > 0 || H5Tis_variable_str(datatype_id) > 0;
+
+    H5Tclose(datatype_id);
+
+    if (r)
+        return 0;
+
+    dataspace_id = H5Dget_space(dataset_id);
+    if (dataspace_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_space()\n");
+        return -1;
+    }
+
+    n_dims = H5Sget_simple_extent_ndims(dataspace_id);
+    if (n_dims > 0 && n_dims <= 8)
+        H5Sget_simple_extent_dims(dataspace_id, dims, NULL);
+
+    H5Sclose(dataspace_id);
+
+    if (n_dims <= 0 || n_dims > 8)
+        return 0;
+
+    plist_id = H5Dget_create_plist(dataset_id);
+    if (plist_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_create_plist()\n");
+        return -1;
+    }
+
+    if (H5Pget_layout(plist_id) != H5D_CHUNKED ||
+        H5Pget_chunk(plist_id, n_dims, chunk_dims) != n_dims) {
+        H5Pclose(plist_id);
+        return 0;
+    }
+
+    chunk_size = data_size;
+    for (i = 0; i < n_dims; ++i)
+        chunk_size *= chunk_dims[i];
+
+    n_filters = H5Pget_nfilters(plist_id);
+    if (n_filters < 0 || n_filters > max_filters)
+        n_filters = 0;
+
+    r = n_filters > 0;
+    for (i = 0; i < n_filters; ++i) {
+        cd_nelmts = 8;
+        filters[i].id = H5Pget_filter2(plist_id, i, &flags, &cd_nelmts, cd_values, 0,
+                                       NULL, NULL);
+        if (filters[i].id == H5Z_FILTER_SHUFFLE)
+            filters[i].element_size = cd_nelmts > 0 ? cd_values[0] : data_size;
+        else if (filters[i].id != H5Z_FILTER_DEFLATE)
+            r = 0;
+    }
+
+    H5Pclose(plist_id);
+
+#if H5_VERSION_GE(1, 10, 3)
+    is_supported = r;
+#endif
+    return 0;
+}
+
+
+
+bool XDFChunkReader::isSupported()
+{
+    return is_supported;
+}
+
+
+
+/*
+ * Undoes the filters of the pipeline, last first, that were applied to a raw
+ * chunk, those not set in filter_mask.  Takes ownership of raw and returns the
+ * chunk in a buffer of chunk_size bytes to be freed by the caller.  Called
+ * from the workers so it must not call the HDF5 library.
+ */
+int XDFChunkReader::decode(void *raw, size_t raw_size, unsigned int filter_mask,
+                           void **chunk)
+{
+    int i;
+
+    size_t j;
+    size_t k;
+    size_t n;
+    size_t size;
+
+    uLongf length;
+
+    unsigned char *in;
+    unsigned char *out;
+
+    in   = (unsigned char *) raw;
+    size = raw_size;
+
+    for (i = n_filters - 1; i >= 0; --i) {
+        if (filter_mask & (1u << i))
+            continue;
+
+        out = (unsigned char *) malloc(chunk_size);
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed\n");
+            free(in);
+            return -1;
+        }
+
+        if (filters[i].id == H5Z_FILTER_DEFLATE) {
+            length = chunk_size;
+            if (uncompress(out, &length, in, size) != Z_OK) {
+                fprintf(stderr, "ERROR: uncompress()\n");
+                free(out);
+                free(in);
+                return -1;
+            }
+            size = length;
+        }
+        else {
+            if (size > chunk_size) {
+                fprintf(stderr, "ERROR: Invalid shuffled chunk size\n");
+                free(out);
+                free(in);
+                return -1;
+            }
+
+            n = size / filters[i].element_size;
+            for (j = 0; j < filters[i].element_size; ++j) {
+                for (k = 0; k < n; ++k)
+                    out[k * filters[i].element_size + j] = in[j * n + k];
+            }
+            memcpy(out + n * filters[i].element_size,
+                   in  + n * filters[i].element_size, size - n * filters[i].element_size);
+        }
+
+        free(in);
+        in = out;
+    }
+
+    if (size != chunk_size) {
+        fprintf(stderr, "ERROR: Invalid decoded chunk size\n");
+        free(in);
+        return -1;
+    }
+
+    *chunk = in;
+
+    return 0;
+}
+
+
+
+/*
+ * Reads the part of the chunk at chunk_offset in the region at offset of
+ * count elements into data with H5Dread().
+ */
+int XDFChunkReader::readFallback(hid_t dataset_id, const size_t *chunk_offset,
+                                 const size_t *offset, const size_t *count,
+                                 void *data)
+{
+    int i;
+    int r;
+
+    hid_t datatype_id;
+    hid_t filespace_id;
+    hid_t memspace_id;
+
+    hsize_t first[8];
+    hsize_t n[8];
+    hsize_t mem_first[8];
+    hsize_t mem_dims[8];
+
+    for (i = 0; i < n_dims; ++i) {
+        first[i] = MAX(offset[i], chunk_offset[i]);
+        n    [i] = MIN(offset[i] + count[i], chunk_offset[i] + chunk_dims[i]) - first[i];
+
+        mem_first[i] = first[i] - offset[i];
+        mem_dims [i] = count[i];
+    }
+
+    datatype_id  = H5Dget_type(dataset_id);
+    filespace_id = H5Dget_space(dataset_id);
+    memspace_id  = H5Screate_simple(n_dims, mem_dims, NULL);
+
+    r = datatype_id < 0 || filespace_id < 0 || memspace_id < 0 ||
+        H5Sselect_hyperslab(filespace_id, H5S_SELECT_SET, first, NULL, n, NULL) < 0 ||
+        H5Sselect_hyperslab(memspace_id, H5S_SELECT_SET, mem_first, NULL, n, NULL) < 0 ||
+        H5Dread(dataset_id, datatype_id, memspace_id, filespace_id, H5P_DEFAULT, data) < 0;
+
+    if (memspace_id >= 0)
+        H5Sclose(memspace_id);
+    if (filespace_id >= 0)
+        H5Sclose(filespace_id);
+    if (datatype_id >= 0)
+        H5Tclose(datatype_id);
+
+    if (r) {
+        fprintf(stderr, "ERROR: H5Dread()\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Reads n_regions regions, region i at offsets + i * n_dims of counts + i *
+ * n_dims elements into data[i] in row major order.  The raw chunks are read
+ * on the calling thread, at most two per worker ahead of the workers so that
+ * memory stays bounded, and this returns once all of them are in place.
+ */
+int XDFChunkReader::read(hid_t dataset_id, int n_regions, const size_t *offsets,
+                         const size_t *counts, void **data)
+{
+#if H5_VERSION_GE(1, 10, 3)
+    int i;
+    int j;
+    int r;
+
+    int max_pending;
+
+    uint32_t filter_mask;
+
+    size_t first[8];
+    size_t last[8];
+    size_t coords[8];
+    size_t chunk_offset_[8];
+
+    hsize_t chunk_offset[8];
+
+    hsize_t raw_size;
+
+    void *raw;
+
+    const size_t *offset;
+    const size_t *count;
+
+    XDFChunkBatch batch;
+
+    batch.n_pending = 0;
+    batch.status    = 0;
+
+    max_pending = 2 * pool()->maxThreadCount();
+
+    r = 0;
+
+    for (j = 0; j < n_regions && r == 0; ++j) {
+        offset = offsets + j * n_dims;
+        count  = counts  + j * n_dims;
+
+        for (i = 0; i < n_dims; ++i) {
+            if (count[i] == 0)
+                break;
+            first [i] = offset[i] / chunk_dims[i];
+            last  [i] = (offset[i] + count[i] - 1) / chunk_dims[i];
+            coords[i] = first[i];
+        }
+        if (i < n_dims)
+            continue;
+
+        while (1) {
+            for (i = 0; i < n_dims; ++i) {
+                chunk_offset [i] = coords[i] * chunk_dims[i];
+                chunk_offset_[i] = chunk_offset[i];
+            }
+
+            H5E_BEGIN_TRY {
+                if (H5Dget_chunk_storage_size(dataset_id, chunk_offset, &raw_size) < 0)
+                    raw_size = 0;
+            } H5E_END_TRY;
+
+            if (raw_size == 0) {
+                r = readFallback(dataset_id, chunk_offset_, offset, count, data[j]);
+                if (r < 0)
+                    break;
+            }
+            else {
+                raw = malloc(raw_size);
+                if (raw == NULL) {
+                    fprintf(stderr, "ERROR: Memory allocation failed\n");
+                    r = -1;
+                    break;
+                }
+
+                if (H5Dread_chunk(dataset_id, H5P_DEFAULT, chunk_offset, &filter_mask,
+                                  raw) < 0) {
+                    fprintf(stderr, "ERROR: H5Dread_chunk()\n");
+                    free(raw);
+                    r = -1;
+                    break;
+                }
+
+                batch.mutex.lock();
+                while (batch.n_pending >= max_pending)
+                    batch.changed.wait(&batch.mutex);
+                batch.n_pending++;
+                batch.mutex.unlock();
+
+                pool()->start(new XDFChunkJob(this, &batch, n_dims, data_size, chunk_offset,
+                                              chunk_dims, raw, raw_size, filter_mask,
+                                              offset, count, data[j]));
+            }
+
+            for (i = n_dims - 1; i >= 0; --i) {
+                if (++coords[i] <= last[i])
+                    break;
+                coords[i] = first[i];
+            }
+            if (i < 0)
+                break;
+        }
+    }
+
+    batch.mutex.lock();
+    while (batch.n_pending > 0)
+        batch.changed.wait(&batch.mutex);
+    batch.mutex.unlock();
+
+    if (r < 0 || batch.status < 0)
+        return -1;
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+
+int XDFChunkReader::read(hid_t dataset_id, const size_t *offset,
+                         const size_t *count, void *data)
+{
+    return read(dataset_id, 1, offset, count, &data);
+}
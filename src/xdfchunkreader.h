@@ -0,0 +1,77 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFCHUNKREADER_H
+#define XDFCHUNKREADER_H
+
+#include <hdf5.h>
+
+#include <qthreadpool.h>
+
+
+/*
+ * Reads regions of a chunked and compressed HDF5 dataset, in the datatype of
+ * the file, decompressing the chunks in parallel.  H5Dread() runs the filters
+ * of each chunk one at a time on the calling thread, so instead the raw
+ * chunks are read with H5Dread_chunk() and handed to a pool of worker threads
+ * shared by all readers, which undo the deflate and shuffle filters and copy
+ * the chunks into place while the next chunks are read.  The workers do not
+ * call the HDF5 library.  Chunks that are not allocated, or that went through
+ * a filter that is not supported, are read with H5Dread() instead.
+ *
+ * read() must be called holding the HDF5 library lock, as for H5Dread(), and
+ * isSupported() tells whether it may be used for the dataset given to init():
+ * a chunked dataset of fixed size elements with a pipeline of deflate and
+ * shuffle filters only.  Otherwise, or with HDF5 before 1.10.3, H5Dread()
+ * should be used.
+ */
+class XDFChunkReader
+{
+public:
+    struct Filter {
+        H5Z_filter_t id;
+        size_t element_size;
+    };
+
+private:
+    static const int max_dims    = 32;
+    static const int max_filters = 16;
+
+    bool is_supported;
+
+    int n_dims;
+    hsize_t dims[max_dims];
+    hsize_t chunk_dims[max_dims];
+    size_t data_size;
+    size_t chunk_size;
+
+    int n_filters;
+    Filter filters[max_filters];
+
+    static QThreadPool *pool();
+
+    int readFallback(hid_t dataset_id, const size_t *chunk_offset,
+                     const size_t *offset, const size_t *count, void *data);
+
+public:
+    XDFChunkReader();
+
+    int init(hid_t dataset_id);
+    bool isSupported();
+
+    int decode(void *raw, size_t raw_size, unsigned int filter_mask,
+               void **chunk);
+
+    int read(hid_t dataset_id, int n_regions, const size_t *offsets,
+             const size_t *counts, void **data);
+    int read(hid_t dataset_id, const size_t *offset, const size_t *count,
+             void *data);
+};
+
+#endif /* XDFCHUNKREADER_H */
@@ -0,0 +1,985 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <ghdf.h>
+#include <ghdf5.h>
+#include <gnetcdf.h>
+
+#include <qmutex.h>
+
+#include "xdfv.h"
+#include "xdfdump.h"
+#include "xdfkernel.h"
+#include "xdfmemberplan.h"
+
+
+XDFDumpEmitter::XDFDumpEmitter()
+    : format(Text), fp(NULL), file_name(NULL)
+{
+
+}
+
+
+
+XDFDumpEmitter::XDFDumpEmitter(Format format, FILE *fp)
+    : format(format), fp(fp), file_name(NULL)
+{
+
+}
+
+
+
+/*
+ * Writes s as text on one line, line breaks being replaced with '\' as in the
+ * tree views.
+ */
+void XDFDumpEmitter::writeString(const char *s)
+{
+    for ( ; *s != '\0'; ++s)
+        fputc(*s == '\n' || *s == '\r' ? '\\' : *s, fp);
+}
+
+
+
+/*
+ * The length of the UTF-8 sequence at the start of s, or 0 if it is not a
+ * valid one: truncated, overlong, a surrogate, or beyond U+10FFFF.
+ */
+int XDFDumpEmitter::utf8_length(const unsigned char *s)
+{
+    int i;
+    int n;
+
+    unsigned int min;
+    unsigned int code;
+
+    if (s[0] < 0x80)
+        return 1;
+    else if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        n = 2; min = 0x80;    code = s[0] & 0x1f;
+    }
+    else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        n = 3; min = 0x800;   code = s[0] & 0x0f;
+    }
+    else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        n = 4; min = 0x10000; code = s[0] & 0x07;
+    }
+    else
+        return 0;
+
+    for (i = 1; i < n; ++i) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+        code = (code << 6) | (s[i] & 0x3f);
+    }
+
+    if (code < min || code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff))
+        return 0;
+
+    return n;
+}
+
+
+
+/*
+ * Writes s as a JSON string.  Bytes that are not part of valid UTF-8, as in
+ * Latin-1 text, are written as the code point of the same value.
+ */
+void XDFDumpEmitter::writeQuoted(const char *s)
+{
+    int i;
+    int n;
+
+    fputc('"', fp);
+
+    for ( ; *s != '\0'; ++s) {
+        switch(*s) {
+            case '"':
+                fputs("\\\"", fp);
+                break;
+            case '\\':
+                fputs("\\\\", fp);
+                break;
+            case '\n':
+                fputs("\\n", fp);
+                break;
+            case '\r':
+                fputs("\\r", fp);
+                break;
+            case '\t':
+                fputs("\\t", fp);
+                break;
+            default:
+                if ((unsigned char) *s < 0x20)
+                    fprintf(fp, "\\u%04x", (unsigned char) *s);
+                else if ((unsigned char) *s < 0x80)
+                    fputc(*s, fp);
+                else if ((n = utf8_length((const unsigned char *) s)) == 0)
+                    fprintf(fp, "\\u%04x", (unsigned char) *s);
+                else {
+                    for (i = 0; i < n; ++i)
+                        fputc(s[i], fp);
+                    s += n - 1;
+                }
+                break;
+        }
+    }
+
+    fputc('"', fp);
+}
+
+
+
+/*
+ * Starts a file.  Returns the item of the file, the parent of its top level
+ * nodes.
+ */
+void *XDFDumpEmitter::beginFile(const char *file_name, XDFV::FileType file_type)
+{
+    const char *type_name;
+
+    items.clear();
+    names.clear();
+
+    this->file_name = file_name;
+
+    if (file_type == XDFV::HDF4)
+        type_name = "HDF4";
+    else if (file_type == XDFV::HDF5)
+        type_name = "HDF5";
+    else
+        type_name = "NetCDF";
+
+    return writeNode(NULL, "file", file_name, type_name);
+}
+
+
+
+void XDFDumpEmitter::endFile()
+{
+    items.clear();
+    names.clear();
+
+    if (fp)
+        fflush(fp);
+}
+
+
+
+/*
+ * Adds a node under parent, or the file if parent is NULL, writes it with
+ * write(), and returns its item.  data_type, value, and dims may be NULL, and
+ * size and n_dims negative, if the node does not have them.
+ */
+void *XDFDumpEmitter::writeNode(const void *parent, const char *kind, const char *name,
+                                const char *data_type, long long size, int n_dims,
+                                const long long *dims, const char *value)
+{
+    int i;
+
+    Item item;
+
+    if (parent == NULL) {
+        item.parent = -1;
+        item.depth  = 0;
+    }
+    else {
+        item.parent = ((const Item *) parent)->index;
+        item.depth  = ((const Item *) parent)->depth + 1;
+    }
+    item.index = items.size();
+    item.name  = names.add(name);
+
+    i = items.append(item);
+    if (i < 0) {
+        fprintf(stderr, "ERROR: XDFArena::append()\n");
+        return NULL;
+    }
+
+    write(i, item, kind, name, data_type, size, n_dims, dims, value);
+
+    return &items[i];
+}
+
+
+
+/*
+ * Writes node i as a line of text or JSON.
+ */
+void XDFDumpEmitter::write(int i, const Item &item, const char *kind, const char *name,
+                           const char *data_type, long long size, int n_dims,
+                           const long long *dims, const char *value)
+{
+    if (format == Text) {
+        for (int j = 0; j < item.depth; ++j)
+            fputs("  ", fp);
+
+        fprintf(fp, "%s ", kind);
+        writeString(name);
+
+        if (data_type)
+            fprintf(fp, "  %s", data_type);
+        if (size >= 0)
+            fprintf(fp, "  %lld", size);
+        if (n_dims >= 0) {
+            fputs("  [", fp);
+            for (int j = 0; j < n_dims; ++j)
+                fprintf(fp, j == 0 ? "%lld" : " x %lld", dims[j]);
+            fputc(']', fp);
+        }
+        if (value) {
+            fputs("  = ", fp);
+            writeString(value);
+        }
+    }
+    else {
+        fputs("{\"file\": ", fp);
+        writeQuoted(file_name);
+        fprintf(fp, ", \"depth\": %d, \"kind\": ", item.depth);
+        writeQuoted(kind);
+        fputs(", \"name\": ", fp);
+        writeQuoted(name);
+
+        if (data_type) {
+            fputs(", \"type\": ", fp);
+            writeQuoted(data_type);
+        }
+        if (size >= 0)
+            fprintf(fp, ", \"size\": %lld", size);
+        if (n_dims >= 0) {
+            fputs(", \"dims\": [", fp);
+            for (int j = 0; j < n_dims; ++j)
+                fprintf(fp, j == 0 ? "%lld" : ", %lld", dims[j]);
+            fputc(']', fp);
+        }
+        if (value) {
+            fputs(", \"value\": ", fp);
+            writeQuoted(value);
+        }
+
+        fputc('}', fp);
+    }
+
+    fputc('\n', fp);
+}
+
+
+
+const char *XDFDumpEmitter::name(const void *item) const
+{
+    return names.string(((const Item *) item)->name);
+}
+
+
+
+/*
+ * Dumps a file with the processor of its type.  Returns the return value of
+ * the processor, zero or one of the XDFProcessor::ErrorCode values, or -1.
+ */
+int XDFDumpEmitter::dumpFile(XDFV::FileType file_type, const char *file_name, int sds)
+{
+    int r;
+
+    void *root;
+
+    QMutexLocker locker(XDFV::libraryMutex(file_type));
+
+    root = beginFile(file_name, file_type);
+    if (root == NULL)
+        return -1;
+
+    if (file_type == XDFV::HDF4) {
+        HDFDumper dumper(this);
+        r = dumper.procHDFFile(file_name, NULL, root, sds);
+    }
+    else if (file_type == XDFV::HDF5) {
+        HDF5Dumper dumper(this);
+        r = dumper.procHDF5File(file_name, root, 0);
+    }
+    else if (file_type == XDFV::NetCDF) {
+        NCDumper dumper(this);
+        r = dumper.procNCFile(file_name, NULL, root);
+    }
+    else
+        r = -1;
+
+    endFile();
+
+    return r;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+void *HDFDumper::writeAttr(const void *parent, const char *attr_name, int32 data_type,
+                          int32 count, const void *data)
+{
+    char temp[LN];
+
+    long long dims[1];
+
+    if (XDFKernel::formatArray(XDFKernel::hdfType(data_type), data, count, temp, LN) < 0)
+        temp[0] = '\0';
+
+    dims[0] = count;
+
+    return emitter->writeNode(parent, "attribute", attr_name, hdf_data_type_name(data_type),
+                              -1, 1, dims, temp);
+}
+
+
+
+void *HDFDumper::functionSDDim(const void *parent, const void *after,
+                               int dim_index, int32 dim_id, const int32 *flags)
+{
+    char dim_name[MAX_NC_NAME];
+
+    int32 length;
+    int32 data_type;
+    int32 num_attrs;
+
+    if (SDdiminfo(dim_id, dim_name, &length, &data_type, &num_attrs) == FAIL) {
+        fprintf(stderr, "ERROR: SDdiminfo()\n");
+        return NULL;
+    }
+
+    return emitter->writeNode(parent, "dimension", dim_name, NULL, length);
+}
+
+
+
+void *HDFDumper::functionSDAttrs(const void *parent, const void *after,
+                                 int32 id, int32 attr_index, const int32 *flags)
+{
+    char attr_name[MAX_NC_NAME];
+
+    int32 data_type;
+    int32 count;
+
+    void *data;
+    void *item;
+
+    if (SDattrinfo(id, attr_index, attr_name, &data_type, &count) == FAIL) {
+        fprintf(stderr, "ERROR: SDattrinfo()\n");
+        return NULL;
+    }
+
+    data = malloc(DFKNTsize(data_type) * count);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed, attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    if (SDreadattr(id, attr_index, data) == FAIL) {
+        fprintf(stderr, "ERROR: SDreadattr(), attr_name = %s\n", attr_name);
+        free(data);
+        return NULL;
+    }
+
+    item = writeAttr(parent, attr_name, data_type, count, data);
+
+    free(data);
+
+    return item;
+}
+
+
+
+void *HDFDumper::functionSDIndex(const void *parent, const void *after,
+                                 int32 sds_index, int32 sds_id, const int32 *flags)
+{
+    char sds_name[MAX_NC_NAME];
+
+    int32 rank;
+    int32 dim_sizes[MAX_VAR_DIMS];
+
+    int32 data_type;
+    int32 num_attrs;
+
+    long long dims[MAX_VAR_DIMS];
+
+    if (SDgetinfo(sds_id, sds_name, &rank, dim_sizes, &data_type, &num_attrs) == FAIL) {
+        fprintf(stderr, "ERROR: SDgetinfo()\n");
+        return NULL;
+    }
+
+    for (int i = 0; i < rank; ++i)
+        dims[i] = dim_sizes[i];
+
+    return emitter->writeNode(parent, "dataset", sds_name, hdf_data_type_name(data_type),
+                              -1, rank, dims);
+}
+
+
+
+void *HDFDumper::functionVRef(const void *parent, const void *after, void **after2,
+                              int32 vgroup_id, const int32 *flags)
+{
+    char vgroup_name[VGNAMELENMAX];
+
+    char attr_name[MAX_NC_NAME];
+
+    int32 num_attrs;
+
+    int32 data_type;
+    int32 count;
+    int32 length;
+
+    void *data;
+    void *item;
+
+    if (Vgetname(vgroup_id, vgroup_name) == FAIL) {
+        fprintf(stderr, "ERROR: Vgetname()\n");
+        return NULL;
+    }
+
+    item = emitter->writeNode(parent, "vgroup", vgroup_name);
+    if (item == NULL)
+        return NULL;
+
+    num_attrs = Vnattrs(vgroup_id);
+    if (num_attrs == FAIL) {
+        fprintf(stderr, "ERROR: Vnattrs(), vgroup_name = %s\n", vgroup_name);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_attrs; ++i) {
+        if (Vattrinfo(vgroup_id, i, attr_name, &data_type, &count, &length) == FAIL) {
+            fprintf(stderr, "ERROR: Vattrinfo(), vgroup_name = %s\n", vgroup_name);
+            return NULL;
+        }
+
+        data = malloc(DFKNTsize(data_type) * count);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed, vgroup_name = %s\n",
+                    vgroup_name);
+            return NULL;
+        }
+
+        if (Vgetattr(vgroup_id, i, data) == FAIL) {
+            fprintf(stderr, "ERROR: Vgetattr(), vgroup_name = %s, attr_name = %s\n",
+                    vgroup_name, attr_name);
+            free(data);
+            return NULL;
+        }
+
+        writeAttr(item, attr_name, data_type, count, data);
+
+        free(data);
+    }
+
+    *after2 = NULL;
+
+    return item;
+}
+
+
+
+void *HDFDumper::functionVSRef(const void *parent, const void *after,
+                               int32 vdata_id, const int32 *flags)
+{
+    char vdata_name[VSNAMELENMAX];
+    char attr_name[MAX_NC_NAME];
+
+    char field_name_list[VSFIELDMAX * (FIELDNAMELENMAX + 1)];
+
+    int32 n_fields;
+    int32 n_records;
+    int32 vdata_size;
+
+    int32 num_attrs;
+
+    int32 data_type;
+    int32 count;
+    int32 length;
+
+    void *data;
+    void *item;
+
+    long long dims[2];
+
+    if (VSinquire(vdata_id, &n_records, NULL, NULL, &vdata_size, vdata_name) == FAIL) {
+        fprintf(stderr, "ERROR: VSinquire()\n");
+        return NULL;
+    }
+
+    n_fields = VSgetfields(vdata_id, field_name_list);
+    if (n_fields == FAIL) {
+        fprintf(stderr, "ERROR: VSgetfields(), vdata_name = %s\n", vdata_name);
+        return NULL;
+    }
+
+    dims[0] = n_records;
+    dims[1] = n_fields;
+
+    item = emitter->writeNode(parent, "vdata", vdata_name, NULL, vdata_size, 2, dims,
+                              field_name_list);
+    if (item == NULL)
+        return NULL;
+
+    num_attrs = VSnattrs(vdata_id);
+    if (num_attrs == FAIL) {
+        fprintf(stderr, "ERROR: VSnattrs(), vdata_name = %s\n", vdata_name);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_attrs; ++i) {
+        if (VSattrinfo(vdata_id, -1, i, attr_name, &data_type, &count, &length) == FAIL) {
+            fprintf(stderr, "ERROR: VSattrinfo(), vdata_name = %s\n", vdata_name);
+            return NULL;
+        }
+
+        data = malloc(DFKNTsize(data_type) * count);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed, vdata_name = %s\n", vdata_name);
+            return NULL;
+        }
+
+        if (VSgetattr(vdata_id, -1, i, data) == FAIL) {
+            fprintf(stderr, "ERROR: VSgetattr(), vdata_name = %s, attr_name = %s\n",
+                    vdata_name, attr_name);
+            free(data);
+            return NULL;
+        }
+
+        writeAttr(item, attr_name, data_type, count, data);
+
+        free(data);
+    }
+
+    return item;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+void *HDF5Dumper::functionH5A(const void *parent, const void *after,
+                              hid_t attr_id, const char *attr_name)
+{
+    char temp[LN];
+
+    int n_dims;
+
+    size_t data_size;
+
+    hssize_t n_points;
+
+    void *data;
+    void *item;
+
+    hid_t datatype_id;
+    hid_t dataspace_id;
+
+    hsize_t dims[H5S_MAX_RANK];
+
+    long long dims2[H5S_MAX_RANK];
+
+    datatype_id = H5Aget_type(attr_id);
+    if (datatype_id < 0) {
+        fprintf(stderr, "ERROR: H5Aget_type(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    data_size = H5Tget_size(datatype_id);
+    if (data_size == 0) {
+        fprintf(stderr, "ERROR: H5Tget_size(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    dataspace_id = H5Aget_space(attr_id);
+    if (dataspace_id < 0) {
+        fprintf(stderr, "ERROR: H5Aget_space(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    n_dims = H5Sget_simple_extent_dims(dataspace_id, dims, NULL);
+    if (n_dims < 0) {
+        fprintf(stderr, "ERROR: H5Sget_simple_extent_dims(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    for (int i = 0; i < n_dims; ++i)
+        dims2[i] = dims[i];
+
+    n_points = H5Sget_simple_extent_npoints(dataspace_id);
+    if (n_points < 0) {
+        fprintf(stderr, "ERROR: H5Sget_simple_extent_npoints(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    temp[0] = '\0';
+
+    /*
+     * Attributes are read whole.  Variable length values are allocated by the
+     * library and are reclaimed once formatted.
+     */
+    if (n_points > 0) {
+        data = malloc(n_points * data_size);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed, attr_name = %s\n", attr_name);
+            return NULL;
+        }
+
+        if (H5Aread(attr_id, datatype_id, data) < 0) {
+            fprintf(stderr, "ERROR: H5Aread(), attr_name = %s\n", attr_name);
+            free(data);
+            return NULL;
+        }
+
+        if (XDFMemberPlan::arrayToString(datatype_id, data, n_points, temp, LN) < 0)
+            temp[0] = '\0';
+
+        if (H5Tdetect_class(datatype_id, H5T_VLEN) > 0 || H5Tis_variable_str(datatype_id) > 0)
+            H5Dvlen_reclaim(datatype_id, dataspace_id, H5P_DEFAULT, data);
+
+        free(data);
+    }
+
+    item = emitter->writeNode(parent, "attribute", attr_name,
+                              hdf5_data_class_name(H5Tget_class(datatype_id)),
+                              data_size, n_dims, dims2, temp);
+
+    if (H5Sclose(dataspace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    if (H5Tclose(datatype_id) < 0) {
+        fprintf(stderr, "ERROR: H5Tclose(), attr_name = %s\n", attr_name);
+        return NULL;
+    }
+
+    return item;
+}
+
+
+
+void *HDF5Dumper::functionH5D(const void *parent, const void *after,
+                              hid_t dataset_id, const char *dataset_name)
+{
+    char temp[LN];
+
+    int n_dims;
+
+    size_t data_size;
+
+    void *item;
+
+    hid_t datatype_id;
+    hid_t dataspace_id;
+
+    hsize_t dims[H5S_MAX_RANK];
+
+    long long dims2[H5S_MAX_RANK];
+
+    if (H5Iget_name(dataset_id, temp, LN) < 0) {
+        fprintf(stderr, "ERROR: H5Iget_name()\n");
+        return NULL;
+    }
+
+    datatype_id = H5Dget_type(dataset_id);
+    if (datatype_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_type(), dataset_name = %s\n", dataset_name);
+        return NULL;
+    }
+
+    data_size = H5Tget_size(datatype_id);
+    if (data_size == 0) {
+        fprintf(stderr, "ERROR: H5Tget_size(), dataset_name = %s\n", dataset_name);
+        return NULL;
+    }
+
+    dataspace_id = H5Dget_space(dataset_id);
+    if (dataspace_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_space(), dataset_name = %s\n", dataset_name);
+        return NULL;
+    }
+
+    n_dims = H5Sget_simple_extent_dims(dataspace_id, dims, NULL);
+    if (n_dims < 0) {
+        fprintf(stderr, "ERROR: H5Sget_simple_extent_dims(), dataset_name = %s\n",
+                dataset_name);
+        return NULL;
+    }
+
+    for (int i = 0; i < n_dims; ++i)
+        dims2[i] = dims[i];
+
+    item = emitter->writeNode(parent, "dataset", temp,
+                              hdf5_data_class_name(H5Tget_class(datatype_id)),
+                              data_size, n_dims, dims2);
+
+    if (H5Sclose(dataspace_id) < 0) {
+        fprintf(stderr, "ERROR: H5Sclose(), dataset_name = %s\n", dataset_name);
+        return NULL;
+    }
+
+    if (H5Tclose(datatype_id) < 0) {
+        fprintf(stderr, "ERROR: H5Tclose(), dataset_name = %s\n", dataset_name);
+        return NULL;
+    }
+
+    return item;
+}
+
+
+
+void *HDF5Dumper::functionH5G(const void *parent, const void *after,
+                              hid_t group_id, const char *group_name)
+{
+    char temp[LN];
+
+    if (H5Iget_name(group_id, temp, LN) < 0) {
+        fprintf(stderr, "ERROR: H5Iget_name()\n");
+        return NULL;
+    }
+
+    return emitter->writeNode(parent, "group", temp);
+}
+
+
+
+/*
+ * A link that is not followed, with its target, or for a hard link to an
+ * object dumped elsewhere, the name of that object.
+ */
+void *HDF5Dumper::functionH5L(const void *parent, const void *after,
+                              const char *link_name, H5L_type_t link_type,
+                              const char *target, const void *target_item)
+{
+    const char *type_name;
+
+    if (link_type == H5L_TYPE_HARD)
+        type_name = "hard";
+    else if (link_type == H5L_TYPE_SOFT)
+        type_name = "soft";
+    else if (link_type == H5L_TYPE_EXTERNAL)
+        type_name = "external";
+    else
+        type_name = "user-defined";
+
+    if (target_item != NULL)
+        target = emitter->name(target_item);
+    else if (target != NULL && target[0] == '\0')
+        target = NULL;
+
+    return emitter->writeNode(parent, "link", link_name, type_name, -1, -1, NULL, target);
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+void *NCDumper::functionDim(const void *parent, const void *after,
+                            int dim_id, const int *flags)
+{
+    char dim_name[NC_MAX_NAME + 1];
+
+    int status;
+
+    size_t length;
+
+    status = nc_inq_dim(nc_id, dim_id, dim_name, &length);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_dim(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    return emitter->writeNode(parent, "dimension", dim_name, NULL, length);
+}
+
+
+
+void *NCDumper::functionAttrs(const void *parent, const void *after,
+                              int id, int att_num, const int *flags)
+{
+    char temp[LN];
+
+    char att_name[NC_MAX_NAME + 1];
+
+    int status;
+
+    void *data;
+
+    size_t length;
+
+    nc_type xtype;
+
+    long long dims[1];
+
+    status = nc_inq_attname(nc_id, id, att_num, att_name);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_attname(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    status = nc_inq_att(nc_id, id, att_name, &xtype, &length);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_att(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    temp[0] = '\0';
+
+    if (length > 0) {
+        data = malloc(netcdf_data_type_size(xtype) * length);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: Memory allocation failed, att_name = %s\n", att_name);
+            return NULL;
+        }
+
+        status = nc_get_att(nc_id, id, att_name, data);
+        if (status != NC_NOERR) {
+            fprintf(stderr, "ERROR: nc_get_att(), %s\n", nc_strerror(status));
+            free(data);
+            return NULL;
+        }
+
+        if (XDFKernel::formatArray(XDFKernel::netcdfType(xtype), data, length, temp, LN) < 0)
+            temp[0] = '\0';
+
+        if (xtype == NC_STRING)
+            nc_free_string(length, (char **) data);
+
+        free(data);
+    }
+
+    dims[0] = length;
+
+    return emitter->writeNode(parent, "attribute", att_name, netcdf_data_type_name(xtype),
+                              -1, 1, dims, temp);
+}
+
+
+
+void *NCDumper::functionVarID(const void *parent, const void *after,
+                              int var_id, const int *flags)
+{
+    char var_name[NC_MAX_NAME + 1];
+
+    char *full_name;
+
+    int i;
+
+    int status;
+
+    int n_dims;
+    int dim_ids[NC_MAX_VAR_DIMS];
+
+    int n_atts;
+
+    size_t length;
+    size_t full_length;
+
+    nc_type xtype;
+
+    long long dims[NC_MAX_VAR_DIMS];
+
+    void *item;
+
+    status = nc_inq_var(nc_id, var_id, var_name, &xtype, &n_dims, dim_ids, &n_atts);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_var(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    for (i = 0; i < n_dims; ++i) {
+        status = nc_inq_dimlen(nc_id, dim_ids[i], &length);
+        if (status != NC_NOERR) {
+            fprintf(stderr, "ERROR: nc_inq_dimlen(), %s\n", nc_strerror(status));
+            return NULL;
+        }
+
+        dims[i] = length;
+    }
+
+    /*
+     * Variables in a subgroup are named by their full path as in the tree
+     * views.
+     */
+    status = nc_inq_grpname_full(nc_id, &full_length, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    full_name = (char *) malloc(full_length + strlen(var_name) + 2);
+
+    if (full_length <= 1)
+        strcpy(full_name, var_name);
+    else {
+        status = nc_inq_grpname_full(nc_id, NULL, full_name);
+        if (status != NC_NOERR) {
+            fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+            free(full_name);
+            return NULL;
+        }
+        strcat(full_name, "/");
+        strcat(full_name, var_name);
+    }
+
+    item = emitter->writeNode(parent, "variable", full_name, netcdf_data_type_name(xtype),
+                              -1, n_dims, dims);
+
+    free(full_name);
+
+    return item;
+}
+
+
+
+/*
+ * Unlike the tree view, which enumerates groups when they are expanded, the
+ * group is descended into right away so that its nodes follow it.
+ */
+void *NCDumper::functionGroup(const void *parent, const void *after,
+                              int grp_id, const int *flags)
+{
+    char *full_name;
+
+    int status;
+
+    size_t full_length;
+
+    void *item;
+
+    status = nc_inq_grpname_full(grp_id, &full_length, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        return NULL;
+    }
+
+    full_name = (char *) malloc(full_length + 1);
+
+    status = nc_inq_grpname_full(grp_id, NULL, full_name);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grpname_full(), %s\n", nc_strerror(status));
+        free(full_name);
+        return NULL;
+    }
+
+    item = emitter->writeNode(parent, "group", full_name);
+
+    free(full_name);
+
+    if (item == NULL)
+        return NULL;
+
+    if (descendGroup(item, grp_id) < 0) {
+        fprintf(stderr, "ERROR: descendGroup()\n");
+        return NULL;
+    }
+
+    return item;
+}
@@ -0,0 +1,157 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFDUMP_H
+#define XDFDUMP_H
+
+#include <stdio.h>
+
+#include <hdf5processor.h>
+#include <hdfprocessor.h>
+#include <ncprocessor.h>
+
+#include "xdfv.h"
+#include "xdfarena.h"
+#include "xdfstringpool.h"
+
+
+/*
+ * Writes the tree of a file to a stream as it is scanned by the processors,
+ * one line per node, without building a tree model or any widgets.  As text
+ * each node is indented under its parent.  As JSON each line is an object
+ * with the file, the depth, the kind, and the name of the node and, if it has
+ * them, its type, size, dimensions, and value, so that the output of many
+ * files can be concatenated and filtered line by line.  Only the depth and
+ * name of each node are kept, for the lifetime of the file.  Subclasses may
+ * override write() to store the nodes some other way.
+ */
+class XDFDumpEmitter
+{
+public:
+    enum Format {
+        Text,
+        JSON
+    };
+
+protected:
+    struct Item {
+        int index;
+        int parent;
+        int depth;
+        int name;
+    };
+
+private:
+    Format format;
+    FILE *fp;
+
+    const char *file_name;
+
+    XDFArena<Item, 12> items;
+    XDFStringPool names;
+
+    static int utf8_length(const unsigned char *s);
+
+    void writeString(const char *s);
+    void writeQuoted(const char *s);
+
+protected:
+    XDFDumpEmitter();
+
+    virtual void write(int i, const Item &item, const char *kind, const char *name,
+                       const char *data_type, long long size, int n_dims,
+                       const long long *dims, const char *value);
+
+public:
+    XDFDumpEmitter(Format format, FILE *fp = stdout);
+    virtual ~XDFDumpEmitter() { }
+
+    virtual void *beginFile(const char *file_name, XDFV::FileType file_type);
+    void endFile();
+
+    void *writeNode(const void *parent, const char *kind, const char *name,
+                    const char *data_type = NULL, long long size = -1,
+                    int n_dims = -1, const long long *dims = NULL,
+                    const char *value = NULL);
+
+    const char *name(const void *item) const;
+
+    int dumpFile(XDFV::FileType file_type, const char *file_name, int sds);
+};
+
+
+
+class HDFDumper : public HDFProcessor
+{
+private:
+    XDFDumpEmitter *emitter;
+
+    void *writeAttr(const void *parent, const char *attr_name, int32 data_type,
+                   int32 count, const void *data);
+
+protected:
+    void *functionSDDim(const void *parent, const void *after,
+                        int dim_index, int32 dim_id, const int32 *flags);
+    void *functionSDAttrs(const void *parent, const void *after,
+                          int32 id, int32 attr_index, const int32 *flags);
+    void *functionSDIndex(const void *parent, const void *after,
+                          int32 sds_index, int32 sds_id, const int32 *flags);
+    void *functionVRef(const void *parent, const void *after,
+                       void **after2, int32 vgroup_id, const int32 *flags);
+    void *functionVSRef(const void *parent, const void *after,
+                        int32 vdata_id, const int32 *flags);
+
+public:
+    HDFDumper(XDFDumpEmitter *emitter) : emitter(emitter) { }
+};
+
+
+
+class HDF5Dumper : public HDF5Processor
+{
+private:
+    XDFDumpEmitter *emitter;
+
+protected:
+    void *functionH5A(const void *parent, const void *after,
+                      hid_t attr_id, const char *attr_name);
+    void *functionH5D(const void *parent, const void *after,
+                      hid_t dataset_id, const char *dataset_name);
+    void *functionH5G(const void *parent, const void *after,
+                      hid_t group_id, const char *group_name);
+    void *functionH5L(const void *parent, const void *after,
+                      const char *link_name, H5L_type_t link_type,
+                      const char *target, const void *target_item);
+
+public:
+    HDF5Dumper(XDFDumpEmitter *emitter) : emitter(emitter) { }
+};
+
+
+
+class NCDumper : public NCProcessor
+{
+private:
+    XDFDumpEmitter *emitter;
+
+protected:
+    void *functionDim(const void *parent, const void *after,
+                      int dim_id, const int *flags);
+    void *functionAttrs(const void *parent, const void *after,
+                        int id, int att_num, const int *flags);
+    void *functionVarID(const void *parent, const void *after,
+                        int var_id, const int *flags);
+    void *functionGroup(const void *parent, const void *after,
+                        int grp_id, const int *flags);
+
+public:
+    NCDumper(XDFDumpEmitter *emitter) : emitter(emitter) { }
+};
+
+#endif /* XDFDUMP_H */
@@ -0,0 +1,454 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <hdf5.h>
+#include <mfhdf.h>
+#include <netcdf.h>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qtimer.h>
+
+#include "xdfv.h"
+#include "xdfhandlepool.h"
+
+
+XDFHandlePool::XDFHandlePool()
+{
+    sweep_timer = new QTimer(this);
+    connect(sweep_timer, SIGNAL(timeout()), this, SLOT(sweep()));
+    sweep_timer->start(sweep_interval);
+}
+
+
+
+/*
+ * The pool's timer runs in the thread that first calls instance(), which must
+ * be the GUI thread, see main().
+ */
+XDFHandlePool *XDFHandlePool::instance()
+{
+    static XDFHandlePool *pool = new XDFHandlePool;
+
+    return pool;
+}
+
+
+
+XDFV::FileType XDFHandlePool::library(Kind kind)
+{
+    if (kind == SDFile || kind == SDDataset || kind == VFile || kind == VData)
+        return XDFV::HDF4;
+
+    return XDFV::HDF5;
+}
+
+
+
+QByteArray XDFHandlePool::handleKey(Kind kind, const char *file_name,
+                                    const char *object_name, int index)
+{
+    char temp[32];
+
+    QByteArray key;
+
+    snprintf(temp, 32, "%d:%d:", kind, index);
+
+    key.append(temp, strlen(temp));
+    key.append(file_name, strlen(file_name) + 1);
+    if (object_name)
+        key.append(object_name, strlen(object_name) + 1);
+
+    return key;
+}
+
+
+
+/*
+ * SDs are opened by index, or by name if object_name is not NULL, and vdatas
+ * by name.
+ */
+int XDFHandlePool::open(Handle *handle, const char *file_name,
+                        const char *object_name, int index)
+{
+    int status;
+
+    int nc_id;
+
+    int32 vdata_ref;
+
+    switch (handle->kind) {
+        case HDF5File:
+            handle->id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+            if (handle->id < 0) {
+                fprintf(stderr, "ERROR: H5Fopen(), file_name = %s\n", file_name);
+                return -1;
+            }
+            break;
+        case HDF5Dataset:
+            handle->file = acquire(HDF5File, file_name);
+            if (handle->file == NULL)
+                return -1;
+
+            handle->id = H5Dopen(handle->file->id, object_name, H5P_DEFAULT);
+            if (handle->id < 0) {
+                fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", object_name);
+                release(handle->file);
+                return -1;
+            }
+            break;
+        case NCFile:
+            status = nc_open(file_name, NC_NOWRITE, &nc_id);
+            if (status != NC_NOERR) {
+                fprintf(stderr, "ERROR: nc_open(), file_name = %s, %s\n", file_name,
+                        nc_strerror(status));
+                return -1;
+            }
+            handle->id = nc_id;
+            break;
+        case SDFile:
+            handle->id = SDstart(file_name, DFACC_READ);
+            if (handle->id == FAIL) {
+                fprintf(stderr, "ERROR: SDstart(), file_name = %s\n", file_name);
+                return -1;
+            }
+            break;
+        case SDDataset:
+            handle->file = acquire(SDFile, file_name);
+            if (handle->file == NULL)
+                return -1;
+
+            if (object_name) {
+                index = SDnametoindex(handle->file->id, object_name);
+                if (index == FAIL) {
+                    fprintf(stderr, "ERROR: SDnametoindex(), sds_name = %s\n", object_name);
+                    release(handle->file);
+                    return -1;
+                }
+            }
+
+            handle->id = SDselect(handle->file->id, index);
+            if (handle->id == FAIL) {
+                fprintf(stderr, "ERROR: SDselect()\n");
+                release(handle->file);
+                return -1;
+            }
+            break;
+        case VFile:
+            handle->id = Hopen(file_name, DFACC_READ, DEF_NDDS);
+            if (handle->id == FAIL) {
+                fprintf(stderr, "ERROR: Hopen(), file_name = %s\n", file_name);
+                return -1;
+            }
+
+            if (Vstart(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: Vstart(), file_name = %s\n", file_name);
+                Hclose(handle->id);
+                return -1;
+            }
+            break;
+        case VData:
+            handle->file = acquire(VFile, file_name);
+            if (handle->file == NULL)
+                return -1;
+
+            vdata_ref = VSfind(handle->file->id, object_name);
+            if (vdata_ref == FAIL || vdata_ref == 0) {
+                fprintf(stderr, "ERROR: VSfind()\n");
+                release(handle->file);
+                return -1;
+            }
+
+            handle->id = VSattach(handle->file->id, vdata_ref, "r");
+            if (handle->id == FAIL) {
+                fprintf(stderr, "ERROR: VSattach()\n");
+                release(handle->file);
+                return -1;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+
+
+int XDFHandlePool::close(Handle *handle)
+{
+    int r = 0;
+
+    int status;
+
+    switch (handle->kind) {
+        case HDF5File:
+            if (H5Fclose(handle->id) < 0) {
+                fprintf(stderr, "ERROR: H5Fclose()\n");
+                r = -1;
+            }
+            break;
+        case HDF5Dataset:
+            if (H5Dclose(handle->id) < 0) {
+                fprintf(stderr, "ERROR: H5Dclose()\n");
+                r = -1;
+            }
+            break;
+        case NCFile:
+            status = nc_close(handle->id);
+            if (status != NC_NOERR) {
+                fprintf(stderr, "ERROR: nc_close(), %s\n", nc_strerror(status));
+                r = -1;
+            }
+            break;
+        case SDFile:
+            if (SDend(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: SDend()\n");
+                r = -1;
+            }
+            break;
+        case SDDataset:
+            if (SDendaccess(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: SDendaccess()\n");
+                r = -1;
+            }
+            break;
+        case VFile:
+            if (Vend(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: Vend()\n");
+                r = -1;
+            }
+            if (Hclose(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: Hclose()\n");
+                r = -1;
+            }
+            break;
+        case VData:
+            if (VSdetach(handle->id) == FAIL) {
+                fprintf(stderr, "ERROR: VSdetach()\n");
+                r = -1;
+            }
+            break;
+    }
+
+    if (handle->file)
+        release(handle->file);
+
+    return r;
+}
+
+
+
+/*
+ * Returns the handle with a new reference, opening it if it is not open, or
+ * NULL if it could not be opened.
+ */
+XDFHandlePool::Handle *XDFHandlePool::acquire(Kind kind, const char *file_name,
+                                              const char *object_name, int index)
+{
+    QByteArray key = handleKey(kind, file_name, object_name, index);
+
+    Handle *handle;
+
+    QHash<QByteArray, Handle *>::iterator i;
+
+    mutex.lock();
+
+    i = handles.find(key);
+    if (i != handles.end()) {
+        handle = i.value();
+        handle->n_refs++;
+        mutex.unlock();
+        return handle;
+    }
+
+    mutex.unlock();
+
+    handle = new Handle;
+    handle->kind      = kind;
+    handle->id        = -1;
+    handle->n_refs    = 1;
+    handle->is_stale  = false;
+    handle->key       = key;
+    handle->file_name = file_name;
+    handle->file      = NULL;
+
+    if (open(handle, file_name, object_name, index) < 0) {
+        delete handle;
+        return NULL;
+    }
+
+    mutex.lock();
+    handles.insert(key, handle);
+    mutex.unlock();
+
+    return handle;
+}
+
+
+
+void XDFHandlePool::release(Handle *handle)
+{
+    if (handle == NULL)
+        return;
+
+    mutex.lock();
+
+    if (--handle->n_refs > 0) {
+        mutex.unlock();
+        return;
+    }
+
+    if (! handle->is_stale) {
+        handle->idle.start();
+        mutex.unlock();
+        return;
+    }
+
+    stale_handles.removeAll(handle);
+
+    mutex.unlock();
+
+    close(handle);
+    delete handle;
+}
+
+
+
+/*
+ * Called when a file is reloaded, with the library lock held, after which the
+ * handles of the file that are open are no longer given out.  The library
+ * would reuse a file that is still open, and the metadata it has cached, when
+ * the file is opened again so every handle of the file must be closed before
+ * it is scanned again.  Those that are not referenced are closed here and
+ * invalidated() is emitted for the views that hold the others to release
+ * them.  The views acquire their handles again when they next read.
+ */
+void XDFHandlePool::invalidate(const char *file_name)
+{
+    QList<Handle *> idle;
+
+    QHash<QByteArray, Handle *>::iterator i;
+
+    mutex.lock();
+
+    i = handles.begin();
+    while (i != handles.end()) {
+        if (strcmp(i.value()->file_name.constData(), file_name) == 0) {
+            i.value()->is_stale = true;
+            if (i.value()->n_refs == 0)
+                idle.append(i.value());
+            else
+                stale_handles.append(i.value());
+            i = handles.erase(i);
+        }
+        else
+            ++i;
+    }
+
+    mutex.unlock();
+
+    closeHandles(idle);
+
+    emit invalidated(QByteArray(file_name));
+}
+
+
+
+/*
+ * Closes handles that are no longer referenced.  Datasets are closed first
+ * which releases their files.
+ */
+void XDFHandlePool::closeHandles(const QList<Handle *> &idle)
+{
+    int i;
+
+    for (i = 0; i < idle.size(); ++i) {
+        if (idle[i]->file) {
+            close(idle[i]);
+            delete idle[i];
+        }
+    }
+
+    for (i = 0; i < idle.size(); ++i) {
+        if (! idle[i]->file) {
+            close(idle[i]);
+            delete idle[i];
+        }
+    }
+}
+
+
+
+/*
+ * Closes the stale handles and the handles that have been idle for more than
+ * idle_timeout ms that belong to a library.  Must be called with the library
+ * lock held.
+ */
+void XDFHandlePool::closeIdle(XDFV::FileType file_type)
+{
+    int i;
+
+    QList<Handle *> idle;
+
+    QHash<QByteArray, Handle *>::iterator j;
+
+    mutex.lock();
+
+    i = 0;
+    while (i < stale_handles.size()) {
+        if (library(stale_handles[i]->kind) == file_type &&
+            stale_handles[i]->n_refs == 0) {
+            idle.append(stale_handles[i]);
+            stale_handles.removeAt(i);
+        }
+        else
+            ++i;
+    }
+
+    j = handles.begin();
+    while (j != handles.end()) {
+        if (library(j.value()->kind) == file_type && j.value()->n_refs == 0 &&
+            j.value()->idle.hasExpired(idle_timeout)) {
+            idle.append(j.value());
+            j = handles.erase(j);
+        }
+        else
+            ++j;
+    }
+
+    mutex.unlock();
+
+    closeHandles(idle);
+}
+
+
+
+/*
+ * Libraries that are busy are swept next time around rather than waited for.
+ */
+void XDFHandlePool::sweep()
+{
+    QMutex *library_mutex;
+
+    library_mutex = XDFV::libraryMutex(XDFV::HDF4);
+    if (library_mutex->tryLock()) {
+        closeIdle(XDFV::HDF4);
+        library_mutex->unlock();
+    }
+
+    library_mutex = XDFV::libraryMutex(XDFV::HDF5);
+    if (library_mutex->tryLock()) {
+        closeIdle(XDFV::HDF5);
+        library_mutex->unlock();
+    }
+}
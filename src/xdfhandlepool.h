@@ -0,0 +1,103 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFHANDLEPOOL_H
+#define XDFHANDLEPOOL_H
+
+#include <qbytearray.h>
+#include <qelapsedtimer.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qobject.h>
+#include <qtimer.h>
+
+#include "xdfv.h"
+
+
+/*
+ * Open file and dataset handles shared by all the tree and table views in the
+ * process, so that a file is not opened again for every read.  Handles are
+ * keyed by kind, file name, and object and are reference counted.  A handle
+ * that is no longer referenced is kept open for idle_timeout ms in case it is
+ * used again.  Dataset handles hold a reference to the handle of their file.
+ *
+ * acquire() and release() open and close handles and so must be called while
+ * holding the library lock of the handle's kind, see XDFV::libraryMutex().
+ * Idle handles are closed from the GUI thread, only when the library lock is
+ * free.  A file that is reloaded is invalidated, which closes its handles
+ * that are not referenced and asks the views that hold the others to release
+ * them, after which acquire() opens new handles.
+ */
+class XDFHandlePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind {
+        HDF5File,
+        HDF5Dataset,
+        NCFile,
+        SDFile,
+        SDDataset,
+        VFile,
+        VData
+    };
+
+    struct Handle {
+        Kind kind;
+        long long id;
+        int n_refs;
+        bool is_stale;
+        QByteArray key;
+        QByteArray file_name;
+        Handle *file;
+        QElapsedTimer idle;
+    };
+
+private:
+    static const int idle_timeout   = 30000;
+    static const int sweep_interval = 5000;
+
+    QMutex mutex;
+    QHash<QByteArray, Handle *> handles;
+    QList<Handle *> stale_handles;
+
+    QTimer *sweep_timer;
+
+    XDFHandlePool();
+
+    static XDFV::FileType library(Kind kind);
+    static QByteArray handleKey(Kind kind, const char *file_name,
+                                const char *object_name, int index);
+
+    int open(Handle *handle, const char *file_name, const char *object_name,
+             int index);
+    int close(Handle *handle);
+
+    void closeHandles(const QList<Handle *> &idle);
+    void closeIdle(XDFV::FileType file_type);
+
+public:
+    static XDFHandlePool *instance();
+
+    Handle *acquire(Kind kind, const char *file_name,
+                    const char *object_name = NULL, int index = -1);
+    void release(Handle *handle);
+
+    void invalidate(const char *file_name);
+
+signals:
+    void invalidated(const QByteArray &file_name);
+
+private slots:
+    void sweep();
+};
+
+#endif /* XDFHANDLEPOOL_H */
@@ -0,0 +1,563 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <qcursor.h>
+#include <qevent.h>
+#include <qimage.h>
+#include <qmutex.h>
+#include <qpainter.h>
+#include <qtimer.h>
+
+#include "xdfv.h"
+#include "xdfimageview.h"
+#include "xdfpyramid.h"
+#include "xdftableview.h"
+
+
+XDFImageView::XDFImageView(XDFTableView *table, QWidget *parent)
+    : QWidget(parent), table(table), zoom(0), x0(0.), y0(0.), is_fitted(false),
+      image_level(-1), image_factor(1), image_row(0), image_col(0), image_rows(0),
+      image_cols(0), retry_posted(false), is_dragging(false)
+{
+    setColormap(Gray);
+}
+
+
+
+XDFImageView::~XDFImageView()
+{
+
+}
+
+
+
+/*
+ * The color table has the colormap in entries 1 to 255.  Entry 0 is for values
+ * that are not finite and is transparent.
+ */
+void XDFImageView::setColormap(Colormap colormap)
+{
+    int i;
+    int j;
+
+    int n;
+
+    double t;
+
+    const uchar (*anchors)[3];
+
+    static const uchar gray[2][3] = {
+        {  0,   0,   0}, {255, 255, 255}
+    };
+    static const uchar jet[9][3] = {
+        {  0,   0, 128}, {  0,   0, 255}, {  0, 128, 255}, {  0, 255, 255},
+        {128, 255, 128}, {255, 255,   0}, {255, 128,   0}, {255,   0,   0},
+        {128,   0,   0}
+    };
+    static const uchar viridis[9][3] = {
+        { 68,   1,  84}, { 71,  45, 123}, { 59,  82, 139}, { 44, 114, 142},
+        { 33, 145, 140}, { 40, 174, 128}, { 94, 201,  98}, {170, 220,  50},
+        {253, 231,  37}
+    };
+
+    switch (colormap) {
+        case Gray:
+            anchors = gray;
+            n = 2;
+            break;
+        case Jet:
+            anchors = jet;
+            n = 9;
+            break;
+        case Viridis:
+        default:
+            anchors = viridis;
+            n = 9;
+            break;
+    }
+
+    color_table.resize(256);
+
+    color_table[0] = qRgba(0, 0, 0, 0);
+
+    for (i = 1; i < 256; ++i) {
+        t  = (i - 1) / 254. * (n - 1);
+        j  = qMin((int) t, n - 2);
+        t -= j;
+        color_table[i] = qRgb((int) (anchors[j][0] + t * (anchors[j + 1][0] - anchors[j][0]) + .5),
+                              (int) (anchors[j][1] + t * (anchors[j + 1][1] - anchors[j][1]) + .5),
+                              (int) (anchors[j][2] + t * (anchors[j + 1][2] - anchors[j][2]) + .5));
+    }
+
+    if (image_level >= 0)
+        renderImage();
+
+    update();
+}
+
+
+
+/*
+ * Called when the table is configured.  The image is fit to the view when it
+ * is next shown.
+ */
+void XDFImageView::reset()
+{
+    is_fitted   = false;
+    image_level = -1;
+
+    values.clear();
+    image = QImage();
+
+    update();
+}
+
+
+
+/*
+ * Called when the pyramid of the table is built, after which the image is
+ * made again from it when zoomed out and with the range of the whole slice.
+ */
+void XDFImageView::refresh()
+{
+    image_level = -1;
+
+    update();
+}
+
+
+
+/*
+ * The minimum and maximum of the finite values.  min is greater than max if
+ * there are none.  The values are taken lanes at a time, each lane with its
+ * own minimum and maximum and without branches, so that the loop is
+ * vectorized by the compiler, see the Makefile.
+ */
+void XDFImageView::valueRange(const float *values, int n, float *min, float *max)
+{
+    int i;
+    int j;
+
+    float v;
+    float a;
+    float b;
+
+    float min_[lanes];
+    float max_[lanes];
+
+    for (j = 0; j < lanes; ++j) {
+        min_[j] =  INFINITY;
+        max_[j] = -INFINITY;
+    }
+
+    for (i = 0; i + lanes <= n; i += lanes) {
+        for (j = 0; j < lanes; ++j) {
+            v = values[i + j];
+            a = v - v == 0.f ? v :  INFINITY;
+            b = v - v == 0.f ? v : -INFINITY;
+            min_[j] = a < min_[j] ? a : min_[j];
+            max_[j] = b > max_[j] ? b : max_[j];
+        }
+    }
+
+    for ( ; i < n; ++i) {
+        v = values[i];
+        if (v - v == 0.f) {
+            min_[0] = qMin(v, min_[0]);
+            max_[0] = qMax(v, max_[0]);
+        }
+    }
+
+    for (j = 1; j < lanes; ++j) {
+        min_[0] = qMin(min_[j], min_[0]);
+        max_[0] = qMax(max_[j], max_[0]);
+    }
+
+    *min = min_[0];
+    *max = max_[0];
+}
+
+
+
+/*
+ * Maps the values to color table indices, min to 1 and min + 254 / scale to
+ * 255, clamping values outside of the range and mapping values that are not
+ * finite to 0.  As valueRange(), written to be vectorized.
+ */
+void XDFImageView::normalize(const float *values, int n, float min, float scale,
+                             uchar *indices)
+{
+    int i;
+
+    float v;
+    float t;
+
+    for (i = 0; i < n; ++i) {
+        v = values[i];
+        t = (v - min) * scale + 1.5f;
+        t = t > 1.f   ? t : 1.f;
+        t = t < 255.f ? t : 255.f;
+        indices[i] = (int) t * (v - v == 0.f);
+    }
+}
+
+
+
+double XDFImageView::scale()
+{
+    return ldexp(1., zoom);
+}
+
+
+
+/*
+ * Zooms to the largest power of two at which the whole slice fits in the view
+ * and centers it.
+ */
+void XDFImageView::fit()
+{
+    if (width() == 0 || height() == 0)
+        return;
+
+    zoom = max_zoom;
+    while (zoom > min_zoom && (table->n_cols * scale() > width() ||
+                               table->n_rows * scale() > height()))
+        zoom--;
+
+    x0 = table->n_cols / 2. - width()  / (2. * scale());
+    y0 = table->n_rows / 2. - height() / (2. * scale());
+
+    is_fitted = true;
+}
+
+
+
+/*
+ * Reads the values of n_rows by n_cols cells at row and col of level of the
+ * pyramid, or of the slice itself for level 0, into values.  Returns 1 if the
+ * library is busy, in which case values is left as it was.
+ */
+int XDFImageView::readImage(int level, int row, int col, int n_rows, int n_cols)
+{
+    int i;
+    int j;
+
+    int n;
+
+    float *ptr;
+
+    double *buffer;
+
+    QMutex *mutex;
+
+    if (level > 0) {
+        const XDFPyramid::Level &l = table->pyramid.level(level - 1);
+
+        values.resize(n_rows * n_cols);
+        ptr = values.data();
+
+        for (i = 0; i < n_rows; ++i) {
+            for (j = 0; j < n_cols; ++j)
+                *ptr++ = l.mean[(row + i) * l.n_cols + col + j];
+        }
+
+        return 0;
+    }
+
+    mutex = XDFV::libraryMutex(table->file_type);
+
+    if (! mutex->tryLock())
+        return 1;
+
+    buffer = (double *) malloc((size_t) read_rows * n_cols * sizeof(double));
+    if (buffer == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        mutex->unlock();
+        return -1;
+    }
+
+    values.resize(n_rows * n_cols);
+    ptr = values.data();
+
+    for (i = 0; i < n_rows; i += read_rows) {
+        n = qMin(read_rows, n_rows - i);
+
+        if (table->readValues(table->generation, row + i, n, col, n_cols, buffer) < 0) {
+            free(buffer);
+            mutex->unlock();
+            return -1;
+        }
+
+        for (j = 0; j < n * n_cols; ++j)
+            *ptr++ = buffer[j];
+    }
+
+    free(buffer);
+
+    mutex->unlock();
+
+    return 0;
+}
+
+
+
+/*
+ * Maps the values to the image with the color table, over the range of the
+ * whole slice if the pyramid has been built or otherwise of the values.
+ */
+void XDFImageView::renderImage()
+{
+    int i;
+
+    float min;
+    float max;
+    float scale;
+
+    if (table->pyramid.levelCount() > 0) {
+        const XDFPyramid::Level &l = table->pyramid.level(table->pyramid.levelCount() - 1);
+        min = l.min[0];
+        max = l.max[0];
+    }
+    else
+        valueRange(values.constData(), values.size(), &min, &max);
+
+    if (! (min <= max)) {
+        min = 0.f;
+        max = 0.f;
+    }
+
+    scale = max > min ? 254.f / (max - min) : 0.f;
+
+    image = QImage(image_cols, image_rows, QImage::Format_Indexed8);
+    image.setColorTable(color_table);
+
+    for (i = 0; i < image_rows; ++i)
+        normalize(values.constData() + i * image_cols, image_cols, min, scale,
+                  image.scanLine(i));
+}
+
+
+
+/*
+ * Makes the image of the cells in view, at the level of the pyramid with the
+ * largest cells no larger than a pixel, unless the image has them already.
+ * Returns false if there is no image to show, with a message in message if
+ * there is something to say.
+ */
+bool XDFImageView::updateImage()
+{
+    int i;
+    int r;
+
+    int level;
+    int factor;
+    int n_rows;
+    int n_cols;
+
+    int row1;
+    int row2;
+    int col1;
+    int col2;
+
+    int margin_rows;
+    int margin_cols;
+
+    double s = scale();
+
+    message = QString();
+
+    level  = 0;
+    factor = 1;
+    n_rows = table->n_rows;
+    n_cols = table->n_cols;
+
+    for (i = 0; i < table->pyramid.levelCount(); ++i) {
+        if (table->pyramid.level(i).factor * s > 1.)
+            break;
+
+        level  = i + 1;
+        factor = table->pyramid.level(i).factor;
+        n_rows = table->pyramid.level(i).n_rows;
+        n_cols = table->pyramid.level(i).n_cols;
+    }
+
+    row1 = qMax(0,      (int) floor(y0 / factor));
+    row2 = qMin(n_rows, (int) ceil((y0 + height() / s) / factor));
+    col1 = qMax(0,      (int) floor(x0 / factor));
+    col2 = qMin(n_cols, (int) ceil((x0 + width()  / s) / factor));
+
+    if (row1 >= row2 || col1 >= col2)
+        return false;
+
+    if (level == image_level &&
+        row1 >= image_row && row2 <= image_row + image_rows &&
+        col1 >= image_col && col2 <= image_col + image_cols)
+        return true;
+
+    if ((qint64) (row2 - row1) * (col2 - col1) > max_cells) {
+        message = "Zoom in, or wait for the overview to be built, to see the image.";
+        return false;
+    }
+
+    /*
+     * Half the view is read past each side so that panning a little does not
+     * read again.
+     */
+    margin_rows = (row2 - row1) / 2;
+    margin_cols = (col2 - col1) / 2;
+    if ((qint64) (row2 - row1 + 2 * margin_rows) *
+                 (col2 - col1 + 2 * margin_cols) > max_cells) {
+        margin_rows = 0;
+        margin_cols = 0;
+    }
+
+    row1 = qMax(0,      row1 - margin_rows);
+    row2 = qMin(n_rows, row2 + margin_rows);
+    col1 = qMax(0,      col1 - margin_cols);
+    col2 = qMin(n_cols, col2 + margin_cols);
+
+    r = readImage(level, row1, col1, row2 - row1, col2 - col1);
+    if (r > 0) {
+        if (! retry_posted) {
+            retry_posted = true;
+            QTimer::singleShot(retry_interval, this, SLOT(retryImage()));
+        }
+        return image_level >= 0;
+    }
+
+    if (r < 0) {
+        image_level = -1;
+        message = "The values could not be read as numbers.";
+        return false;
+    }
+
+    image_level  = level;
+    image_factor = factor;
+    image_row    = row1;
+    image_col    = col1;
+    image_rows   = row2 - row1;
+    image_cols   = col2 - col1;
+
+    renderImage();
+
+    return true;
+}
+
+
+
+void XDFImageView::retryImage()
+{
+    retry_posted = false;
+
+    update();
+}
+
+
+
+void XDFImageView::paintEvent(QPaintEvent *event)
+{
+    double s;
+
+    QPainter painter(this);
+
+    painter.fillRect(rect(), palette().color(QPalette::Dark));
+
+    if (table->n_rows == 0 || table->n_cols == 0)
+        return;
+
+    if (! is_fitted)
+        fit();
+
+    if (! updateImage()) {
+        if (! message.isEmpty())
+            painter.drawText(rect(), Qt::AlignCenter | Qt::TextWordWrap, message);
+        return;
+    }
+
+    s = scale() * image_factor;
+
+    painter.drawImage(QRectF((image_col * s - x0 * scale()),
+                             (image_row * s - y0 * scale()),
+                             image_cols * s, image_rows * s), image);
+}
+
+
+
+/*
+ * Zooms in or out a factor of two keeping the element under the cursor in
+ * place.
+ */
+void XDFImageView::wheelEvent(QWheelEvent *event)
+{
+    int delta;
+
+    double x;
+    double y;
+
+    QPoint pos;
+
+#if QT_VERSION >= 0x050000
+    delta = event->angleDelta().y();
+#else
+    delta = event->delta();
+#endif
+    if (delta == 0)
+        return;
+
+    pos = mapFromGlobal(QCursor::pos());
+
+    x = x0 + pos.x() / scale();
+    y = y0 + pos.y() / scale();
+
+    zoom = qBound(min_zoom, zoom + (delta > 0 ? 1 : -1), max_zoom);
+
+    x0 = x - pos.x() / scale();
+    y0 = y - pos.y() / scale();
+
+    update();
+
+    event->accept();
+}
+
+
+
+void XDFImageView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton)
+        return;
+
+    is_dragging = true;
+    drag_pos    = event->pos();
+}
+
+
+
+void XDFImageView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (! is_dragging)
+        return;
+
+    x0 -= (event->pos().x() - drag_pos.x()) / scale();
+    y0 -= (event->pos().y() - drag_pos.y()) / scale();
+
+    drag_pos = event->pos();
+
+    update();
+}
+
+
+
+void XDFImageView::mouseReleaseEvent(QMouseEvent *event)
+{
+    is_dragging = false;
+}
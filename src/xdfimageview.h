@@ -0,0 +1,108 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFIMAGEVIEW_H
+#define XDFIMAGEVIEW_H
+
+#include <qevent.h>
+#include <qimage.h>
+#include <qpoint.h>
+#include <qstring.h>
+#include <qvector.h>
+#include <qwidget.h>
+
+
+class XDFTableView;
+
+
+/*
+ * An image of the slice of an XDFTableView, one element per pixel at a zoom
+ * of one, colored with a colormap over the range of the values.  Only the
+ * elements in view, and a margin around them for panning, are read, with
+ * XDFTableView::readValues() and so through the tile cache.  Zoomed out the
+ * image is made from the means of the level of the table's XDFPyramid with
+ * cells no larger than a pixel, if it has been built, so that the whole of a
+ * large slice can be seen without reading it.  The range is that of the whole
+ * slice from the pyramid, or otherwise of the values read.  The wheel zooms
+ * by powers of two and dragging pans.
+ */
+class XDFImageView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum Colormap {
+        Gray,
+        Jet,
+        Viridis
+    };
+
+private:
+    static const int min_zoom       = -16;
+    static const int max_zoom       = 6;
+    static const int max_cells      = 16 * 1024 * 1024;
+    static const int read_rows      = 256;
+    static const int retry_interval = 100;
+    static const int lanes          = 8;
+
+    XDFTableView *table;
+
+    QVector<QRgb> color_table;
+
+    int zoom;
+    double x0;
+    double y0;
+    bool is_fitted;
+
+    int image_level;
+    int image_factor;
+    int image_row;
+    int image_col;
+    int image_rows;
+    int image_cols;
+    QVector<float> values;
+    QImage image;
+
+    QString message;
+
+    bool retry_posted;
+
+    bool is_dragging;
+    QPoint drag_pos;
+
+    double scale();
+    void fit();
+    int readImage(int level, int row, int col, int n_rows, int n_cols);
+    void renderImage();
+    bool updateImage();
+
+public:
+    XDFImageView(XDFTableView *table, QWidget *parent = 0);
+    ~XDFImageView();
+
+    void setColormap(Colormap colormap);
+    void reset();
+    void refresh();
+
+    static void valueRange(const float *values, int n, float *min, float *max);
+    static void normalize(const float *values, int n, float min, float scale,
+                          uchar *indices);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void wheelEvent(QWheelEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+
+private slots:
+    void retryImage();
+};
+
+#endif /* XDFIMAGEVIEW_H */
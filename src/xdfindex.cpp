@@ -0,0 +1,513 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "xdfv.h"
+#include "xdfindex.h"
+
+
+const char *const XDFIndex::extension = ".xdfi";
+
+
+
+XDFIndex::XDFIndex()
+    : map(NULL), map_size(0), header(NULL), file_path(NULL), nodes(NULL),
+      order(NULL), dim_data(NULL), string_data(NULL)
+{
+
+}
+
+
+
+XDFIndex::~XDFIndex()
+{
+    close();
+}
+
+
+
+/*
+ * Maps an index.  Returns false if it cannot be read or is not a valid index.
+ */
+bool XDFIndex::open(const char *index_name)
+{
+    int fd;
+
+    struct stat st;
+
+    close();
+
+    fd = ::open(index_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    map_size = st.st_size;
+
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+        map = NULL;
+        return false;
+    }
+
+    if (! validate()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+void XDFIndex::close()
+{
+    if (map != NULL)
+        munmap(map, map_size);
+
+    map      = NULL;
+    map_size = 0;
+
+    header      = NULL;
+    file_path   = NULL;
+    nodes       = NULL;
+    order       = NULL;
+    dim_data    = NULL;
+    string_data = NULL;
+
+    search_index.clear();
+}
+
+
+
+/*
+ * Checks that every offset in the index is within bounds so that a truncated
+ * or otherwise damaged index is never used.
+ */
+bool XDFIndex::validate()
+{
+    int i;
+
+    unsigned long long offset;
+
+    const char *base;
+
+    base   = (const char *) map;
+    header = (const Header *) base;
+
+    if (memcmp(header->magic, "XDFVINDX", 8) != 0 || header->version != version)
+        return false;
+
+    if (header->path_size    <= 0 || header->path_size  % 8 != 0 ||
+        header->n_nodes      <= 0 ||
+        header->n_dims       <  0 ||
+        header->order_size   <  0 || header->order_size % 8 != 0 ||
+        header->order_size   != (header->n_nodes * (int) sizeof(int) + 7) / 8 * 8 ||
+        header->strings_size <  0)
+        return false;
+
+    offset  = sizeof(Header);
+    offset += header->path_size;
+    offset += (unsigned long long) header->n_nodes * sizeof(Node);
+    offset += header->order_size;
+    offset += (unsigned long long) header->n_dims  * sizeof(long long);
+    offset += header->strings_size;
+    if (offset != map_size)
+        return false;
+
+    offset = sizeof(Header);
+    if (base[offset + header->path_size - 1] != '\0')
+        return false;
+    file_path = base + offset;
+
+    offset += header->path_size;
+    nodes = (const Node *) (base + offset);
+
+    offset += (unsigned long long) header->n_nodes * sizeof(Node);
+    order = (const int *) (base + offset);
+
+    offset += header->order_size;
+    dim_data = (const long long *) (base + offset);
+
+    offset += (unsigned long long) header->n_dims * sizeof(long long);
+    string_data = base + offset;
+
+    if (header->strings_size > 0 && string_data[header->strings_size - 1] != '\0')
+        return false;
+
+    for (i = 0; i < header->n_nodes; ++i) {
+        const Node &node = nodes[i];
+
+        if (i == 0 ? node.parent != -1 : node.parent < 0 || node.parent >= i)
+            return false;
+
+        if (node.kind      < 0  || node.kind      >= header->strings_size ||
+            node.name      < 0  || node.name      >= header->strings_size ||
+            node.path      < 0  || node.path      >= header->strings_size ||
+            node.data_type < -1 || node.data_type >= header->strings_size ||
+            node.value     < -1 || node.value     >= header->strings_size)
+            return false;
+
+        if (node.n_dims < -1 || (node.n_dims > 0 && node.dims < 0) ||
+            node.dims < -1 || node.dims + node.n_dims > header->n_dims)
+            return false;
+
+        if (order[i] < 0 || order[i] >= header->n_nodes)
+            return false;
+    }
+
+    return true;
+}
+
+
+
+/*
+ * Returns true if the file has the size and modification time it had when it
+ * was indexed.
+ */
+bool XDFIndex::isCurrent(const char *file_name) const
+{
+    struct stat st;
+
+    if (stat(file_name, &st) < 0)
+        return false;
+
+    return header->file_size  == st.st_size         &&
+           header->mtime      == st.st_mtim.tv_sec  &&
+           header->mtime_nsec == st.st_mtim.tv_nsec;
+}
+
+
+
+/*
+ * Returns the position in path order of the first node whose path is not less
+ * than prefix, or nodeCount() if there is none.  The nodes whose paths start
+ * with prefix follow it.
+ */
+int XDFIndex::lowerBound(const char *prefix) const
+{
+    int i;
+    int j;
+    int k;
+
+    i = 0;
+    j = header->n_nodes;
+    while (i < j) {
+        k = (i + j) / 2;
+        if (strcmp(string_data + nodes[order[k]].path, prefix) < 0)
+            i = k + 1;
+        else
+            j = k;
+    }
+
+    return i;
+}
+
+
+
+/*
+ * Returns the first node with path, or -1 if there is none.
+ */
+int XDFIndex::find(const char *path) const
+{
+    int i;
+
+    i = lowerBound(path);
+    if (i == header->n_nodes || strcmp(string_data + nodes[order[i]].path, path) != 0)
+        return -1;
+
+    return order[i];
+}
+
+
+
+/*
+ * Returns the first node from node from on whose path matches pattern, or -1
+ * if there is none.  A pattern with any of '*', '?', or '[' is a glob matched
+ * against the whole path, in which '*' also matches '/'.  Any other pattern
+ * matches paths that contain it.
+ */
+int XDFIndex::match(const char *pattern, int from) const
+{
+    int i;
+
+    bool glob;
+
+    glob = strpbrk(pattern, "*?[") != NULL;
+
+    for (i = from; i < header->n_nodes; ++i) {
+        if (glob ? fnmatch(pattern, string_data + nodes[i].path, 0) == 0 :
+                   strstr(string_data + nodes[i].path, pattern) != NULL)
+            return i;
+    }
+
+    return -1;
+}
+
+
+
+/*
+ * Adds the nodes other than the file node to the search index.
+ */
+void XDFIndex::buildSearchIndex()
+{
+    int i;
+
+    search_index.clear();
+
+    for (i = 1; i < header->n_nodes; ++i)
+        search_index.add(i, string(nodes[i].name), string(nodes[i].value));
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+struct PathLess {
+    const XDFIndex::Node *nodes;
+    const char *strings;
+
+    bool operator()(int a, int b) const
+    {
+        int r;
+
+        r = strcmp(strings + nodes[a].path, strings + nodes[b].path);
+
+        return r < 0 || (r == 0 && a < b);
+    }
+};
+
+
+
+XDFIndexWriter::XDFIndexWriter()
+    : file_type(XDFV::Unknown)
+{
+
+}
+
+
+
+int XDFIndexWriter::addString(const char *s)
+{
+    int offset;
+
+    QByteArray key;
+
+    if (s == NULL)
+        return -1;
+
+    key = QByteArray::fromRawData(s, strlen(s));
+
+    if (string_offsets.contains(key))
+        return string_offsets[key];
+
+    offset = strings.size();
+    strings.append(s, key.size() + 1);
+
+    string_offsets[QByteArray(s)] = offset;
+
+    return offset;
+}
+
+
+
+void *XDFIndexWriter::beginFile(const char *file_name, XDFV::FileType file_type)
+{
+    this->file_type = file_type;
+
+    nodes.clear();
+    dims.clear();
+    strings.clear();
+    string_offsets.clear();
+
+    return XDFDumpEmitter::beginFile(file_name, file_type);
+}
+
+
+
+void XDFIndexWriter::write(int i, const Item &item, const char *kind, const char *name,
+                           const char *data_type, long long size, int n_dims,
+                           const long long *dims, const char *value)
+{
+    const char *parent_path;
+
+    QByteArray path;
+
+    XDFIndex::Node node;
+
+    if (item.parent < 0)
+        path = "";
+    else if (name[0] == '/')
+        path = name;
+    else {
+        parent_path = strings.constData() + nodes[item.parent].path;
+        path = parent_path;
+        if (path.size() == 0 || path[path.size() - 1] != '/')
+            path += '/';
+        path += name;
+    }
+
+    node.parent    = item.parent;
+    node.kind      = addString(kind);
+    node.name      = addString(name);
+    node.path      = addString(path.constData());
+    node.data_type = addString(data_type);
+    node.value     = addString(value);
+    node.n_dims    = n_dims;
+    node.size      = size;
+
+    if (n_dims <= 0)
+        node.dims = -1;
+    else {
+        node.dims = this->dims.size();
+        for (int j = 0; j < n_dims; ++j)
+            this->dims.append(dims[j]);
+    }
+
+    nodes.append(node);
+}
+
+
+
+/*
+ * Writes the nodes of the last file scanned to an index for the file.  The
+ * index is written to a temporary file and renamed into place so that a
+ * reader never sees a partial index.  Returns 0 on success and -1 on error.
+ */
+int XDFIndexWriter::save(const char *file_name, const char *index_name)
+{
+    char *path;
+    char *temp;
+
+    int i;
+    int n;
+    int fd;
+
+    FILE *fp;
+
+    QVector<int> order;
+
+    PathLess less;
+
+    XDFIndex::Header header;
+
+    struct stat st;
+
+    static const char zeros[8] = {0};
+
+    if (nodes.size() == 0)
+        return -1;
+
+    path = realpath(file_name, NULL);
+    if (path == NULL) {
+        fprintf(stderr, "ERROR: realpath(), file_name = %s\n", file_name);
+        return -1;
+    }
+
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "ERROR: stat(), file_name = %s\n", path);
+        free(path);
+        return -1;
+    }
+
+    order.resize(nodes.size());
+    for (i = 0; i < nodes.size(); ++i)
+        order[i] = i;
+
+    less.nodes   = nodes.constData();
+    less.strings = strings.constData();
+    std::sort(order.begin(), order.end(), less);
+
+    memset(&header, 0, sizeof(XDFIndex::Header));
+    memcpy(header.magic, "XDFVINDX", 8);
+    header.version      = XDFIndex::version;
+    header.file_type    = file_type;
+    header.path_size    = (strlen(path) + 8) / 8 * 8;
+    header.n_nodes      = nodes.size();
+    header.file_size    = st.st_size;
+    header.mtime        = st.st_mtim.tv_sec;
+    header.mtime_nsec   = st.st_mtim.tv_nsec;
+    header.n_dims       = dims.size();
+    header.order_size   = (nodes.size() * sizeof(int) + 7) / 8 * 8;
+    header.strings_size = strings.size();
+
+    temp = (char *) malloc(PATH_MAX * sizeof(char));
+
+    snprintf(temp, PATH_MAX, "%s.XXXXXX", index_name);
+
+    fd = mkstemp(temp);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: mkstemp(), file_name = %s\n", temp);
+        free(temp);
+        free(path);
+        return -1;
+    }
+
+    fchmod(fd, 0644);
+
+    fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: fdopen(), file_name = %s\n", temp);
+        ::close(fd);
+        unlink(temp);
+        free(temp);
+        free(path);
+        return -1;
+    }
+
+    n = strlen(path) + 1;
+
+    fwrite(&header, sizeof(XDFIndex::Header), 1, fp);
+    fwrite(path, 1, n, fp);
+    fwrite(zeros, 1, header.path_size - n, fp);
+    fwrite(nodes.data(), sizeof(XDFIndex::Node), nodes.size(), fp);
+    fwrite(order.data(), sizeof(int), order.size(), fp);
+    fwrite(zeros, 1, header.order_size - order.size() * sizeof(int), fp);
+    fwrite(dims.data(), sizeof(long long), dims.size(), fp);
+    fwrite(strings.data(), 1, strings.size(), fp);
+
+    free(path);
+
+    if (ferror(fp) | fclose(fp)) {
+        fprintf(stderr, "ERROR: fwrite(), file_name = %s\n", temp);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    if (rename(temp, index_name) < 0) {
+        fprintf(stderr, "ERROR: rename(), file_name = %s\n", index_name);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    free(temp);
+
+    return 0;
+}
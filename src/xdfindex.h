@@ -0,0 +1,144 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFINDEX_H
+#define XDFINDEX_H
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qvector.h>
+
+#include "xdfv.h"
+#include "xdfdump.h"
+#include "xdfsearchindex.h"
+
+
+/*
+ * A compact index of every group, variable, dimension, and attribute of a
+ * file, written by XDFIndexWriter and mapped read only to be searched without
+ * opening the file.  The index records the path, size, and modification time
+ * of the file so that a stale index can be told from a current one.
+ *
+ * Nodes are stored in preorder with node 0 the file node.  The path of a node
+ * is that of its parent and its name joined by '/', or its name if that is
+ * already a full path, and the nodes are also listed in the order of their
+ * paths so that a path or a prefix of paths can be found by binary search.
+ * Strings and dims are offsets into the sections that follow the nodes, or -1
+ * for none.  buildSearchIndex() indexes the names and values of the nodes so
+ * that they can be found without reading every node.
+ */
+class XDFIndex
+{
+public:
+    struct Node {
+        int parent;
+        int kind;
+        int name;
+        int path;
+        int data_type;
+        int value;
+        int dims;
+        int n_dims;
+        long long size;
+    };
+
+    static const char *const extension;
+
+private:
+    struct Header {
+        char magic[8];
+        int version;
+        int file_type;
+        int path_size;
+        int n_nodes;
+        long long file_size;
+        long long mtime;
+        long long mtime_nsec;
+        int n_dims;
+        int order_size;
+        long long strings_size;
+    };
+
+    static const int version = 1;
+
+    void *map;
+    size_t map_size;
+
+    const Header *header;
+    const char *file_path;
+    const Node *nodes;
+    const int *order;
+    const long long *dim_data;
+    const char *string_data;
+
+    XDFSearchIndex search_index;
+
+    bool validate();
+
+    friend class XDFIndexWriter;
+
+public:
+    XDFIndex();
+    ~XDFIndex();
+
+    bool open(const char *index_name);
+    void close();
+
+    bool isCurrent(const char *file_name) const;
+
+    const char *fileName() const { return file_path; }
+    XDFV::FileType fileType() const { return (XDFV::FileType) header->file_type; }
+
+    int nodeCount() const { return header->n_nodes; }
+    const Node &node(int i) const { return nodes[i]; }
+    const char *string(int offset) const { return offset < 0 ? NULL : string_data + offset; }
+    const long long *dims(int offset) const { return dim_data + offset; }
+
+    int find(const char *path) const;
+    int lowerBound(const char *prefix) const;
+    int sorted(int i) const { return order[i]; }
+
+    int match(const char *pattern, int from) const;
+
+    void buildSearchIndex();
+    XDFSearchIndex &searchIndex() { return search_index; }
+};
+
+
+
+/*
+ * Collects the nodes of a file as they are scanned by the processors and
+ * saves them as an XDFIndex.
+ */
+class XDFIndexWriter : public XDFDumpEmitter
+{
+private:
+    XDFV::FileType file_type;
+
+    QVector<XDFIndex::Node> nodes;
+    QVector<long long> dims;
+    QByteArray strings;
+    QHash<QByteArray, int> string_offsets;
+
+    int addString(const char *s);
+
+protected:
+    void write(int i, const Item &item, const char *kind, const char *name,
+               const char *data_type, long long size, int n_dims,
+               const long long *dims, const char *value);
+
+public:
+    XDFIndexWriter();
+
+    void *beginFile(const char *file_name, XDFV::FileType file_type);
+
+    int save(const char *file_name, const char *index_name);
+};
+
+#endif /* XDFINDEX_H */
@@ -0,0 +1,428 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+
+#include <qhash.h>
+
+#include "xdfv.h"
+#include "xdfindex.h"
+#include "xdfinventory.h"
+#include "xdfmainwindow.h"
+
+
+XDFInventory::XDFInventory(const char *index_dir, int n_workers)
+    : index_dir(index_dir), n_workers(n_workers < 1 ? 1 : n_workers)
+{
+
+}
+
+
+
+/*
+ * Adds the files under the directory path, whose indexes go under the
+ * directory index_name.
+ */
+int XDFInventory::walk(const QByteArray &path, const QByteArray &index_name)
+{
+    DIR *dir;
+
+    QByteArray name;
+    QList<QByteArray> names;
+
+    struct dirent *entry;
+
+    struct stat st;
+
+    dir = opendir(path.constData());
+    if (dir == NULL) {
+        fprintf(stderr, "ERROR: opendir(), path = %s\n", path.constData());
+        return -1;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            names.append(QByteArray(entry->d_name));
+    }
+
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+
+    for (int i = 0; i < names.size(); ++i) {
+        name = path + '/' + names[i];
+
+        if (lstat(name.constData(), &st) < 0)
+            continue;
+
+        /*
+         * Links to files are followed but not links to directories, which
+         * could make the walk loop.
+         */
+        if (S_ISDIR(st.st_mode))
+            walk(name, index_name + '/' + names[i]);
+        else if (S_ISREG(st.st_mode) ||
+                 (S_ISLNK(st.st_mode) && stat(name.constData(), &st) == 0 &&
+                  S_ISREG(st.st_mode))) {
+            file_names.append(name);
+            index_names.append(index_name + '/' + names[i] + XDFIndex::extension);
+        }
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Adds a file or the files under a directory.  Their indexes go under the
+ * index directory in a directory named after the last component of path.
+ */
+int XDFInventory::addPath(const char *path)
+{
+    const char *base;
+
+    QByteArray name;
+    QByteArray index_name;
+
+    struct stat st;
+
+    name = path;
+    while (name.size() > 1 && name.endsWith('/'))
+        name.chop(1);
+
+    if (stat(name.constData(), &st) < 0) {
+        fprintf(stderr, "ERROR: File does not exist: %s\n", path);
+        return -1;
+    }
+
+    base = strrchr(name.constData(), '/');
+    base = base == NULL ? name.constData() : base + 1;
+
+    index_name = QByteArray(index_dir) + '/' + base;
+
+    if (S_ISDIR(st.st_mode))
+        return walk(name, index_name);
+
+    file_names.append(name);
+    index_names.append(index_name + XDFIndex::extension);
+
+    return 0;
+}
+
+
+
+/*
+ * Creates the directories leading to index_name that do not exist.
+ */
+int XDFInventory::makeDirs(const char *index_name)
+{
+    char *temp;
+    char *p;
+
+    temp = strdup(index_name);
+
+    for (p = strchr(temp + 1, '/'); p != NULL; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        if (mkdir(temp, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "ERROR: mkdir(), path = %s\n", temp);
+            free(temp);
+            return -1;
+        }
+        *p = '/';
+    }
+
+    free(temp);
+
+    return 0;
+}
+
+
+
+/*
+ * Scans a file and writes its index.  Called in a child process.
+ */
+XDFInventory::Result XDFInventory::indexFile(const char *file_name, const char *index_name)
+{
+    XDFV::FileType file_type;
+
+    XDFIndex index;
+
+    XDFIndexWriter writer;
+
+    if (index.open(index_name) && index.isCurrent(file_name))
+        return Current;
+
+    index.close();
+
+    try {
+        file_type = XDFMainWindow::file_type_from_extension(file_name);
+    }
+    catch (XDFMainWindow::ErrorCode e) {
+        fprintf(stderr, "ERROR: File does not exist: %s\n", file_name);
+        return Failed;
+    }
+
+    if (file_type == XDFV::Unknown)
+        return NotDataFile;
+
+    if (makeDirs(index_name))
+        return Failed;
+
+    switch(writer.dumpFile(file_type, file_name, 0)) {
+        case 0:
+            break;
+        case XDFProcessor::FileNotFound:
+            fprintf(stderr, "ERROR: File does not exist: %s\n", file_name);
+            return Failed;
+        case XDFProcessor::UnableToOpenFile:
+            fprintf(stderr, "ERROR: Unable to open file, invalid format or file "
+                    "corrupt: %s\n", file_name);
+            return Failed;
+        default:
+            fprintf(stderr, "ERROR: Unable to index %s\n", file_name);
+            return Failed;
+    }
+
+    if (writer.save(file_name, index_name))
+        return Failed;
+
+    return Indexed;
+}
+
+
+
+/*
+ * Indexes the files added, each in a child process, and prints a summary.
+ * Returns the number of files that could not be indexed or -1 on error.
+ */
+int XDFInventory::run()
+{
+    int i;
+    int j;
+    int n_running;
+    int status;
+    int result;
+    int counts[Current + 1];
+
+    pid_t pid;
+
+    QHash<pid_t, int> workers;
+
+    for (i = 0; i <= Current; ++i)
+        counts[i] = 0;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    i = 0;
+    n_running = 0;
+
+    while (i < file_names.size() || n_running > 0) {
+        if (i < file_names.size() && n_running < n_workers) {
+            pid = fork();
+            if (pid == 0) {
+                result = indexFile(file_names[i].constData(), index_names[i].constData());
+                fflush(stderr);
+                _exit(result);
+            }
+
+            if (pid > 0) {
+                workers[pid] = i++;
+                n_running++;
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: fork(), file_name = %s\n", file_names[i].constData());
+            if (n_running == 0) {
+                counts[Failed]++;
+                i++;
+                continue;
+            }
+        }
+
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ERROR: waitpid()\n");
+            return -1;
+        }
+
+        if (! workers.contains(pid))
+            continue;
+
+        j = workers.take(pid);
+        n_running--;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) <= Current)
+            result = WEXITSTATUS(status);
+        else {
+            if (WIFSIGNALED(status))
+                fprintf(stderr, "ERROR: Worker killed by signal %d: %s\n",
+                        WTERMSIG(status), file_names[j].constData());
+            result = Failed;
+        }
+
+        counts[result]++;
+    }
+
+    printf("%d indexed, %d current, %d not HDF or NetCDF, %d failed\n",
+           counts[Indexed], counts[Current], counts[NotDataFile], counts[Failed]);
+
+    return counts[Failed];
+}
+
+
+
+static void print_node(const XDFIndex &index, int i, FILE *fp)
+{
+    const XDFIndex::Node &node = index.node(i);
+
+    fprintf(fp, "%s: %s %s", index.fileName(), index.string(node.kind),
+            index.string(node.path));
+
+    if (node.data_type >= 0)
+        fprintf(fp, "  %s", index.string(node.data_type));
+    if (node.size >= 0)
+        fprintf(fp, "  %lld", node.size);
+    if (node.n_dims >= 0) {
+        fputs("  [", fp);
+        for (int j = 0; j < node.n_dims; ++j)
+            fprintf(fp, j == 0 ? "%lld" : " x %lld", index.dims(node.dims)[j]);
+        fputc(']', fp);
+    }
+    if (node.value >= 0) {
+        fputs("  = ", fp);
+        for (const char *s = index.string(node.value); *s != '\0'; ++s)
+            fputc(*s == '\n' || *s == '\r' ? '\\' : *s, fp);
+    }
+
+    fputc('\n', fp);
+}
+
+
+
+/*
+ * Adds path if it is a file, or the indexes under it if it is a directory, to
+ * index_names in order.  Returns -1 if path does not exist.
+ */
+int XDFInventory::findIndexes(const char *path, QList<QByteArray> &index_names)
+{
+    int i;
+
+    DIR *dir;
+
+    QByteArray name;
+    QList<QByteArray> names;
+
+    struct dirent *entry;
+
+    struct stat st;
+
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "ERROR: File does not exist: %s\n", path);
+        return -1;
+    }
+
+    if (! S_ISDIR(st.st_mode)) {
+        index_names.append(QByteArray(path));
+        return 0;
+    }
+
+    dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "ERROR: opendir(), path = %s\n", path);
+        return 0;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            names.append(QByteArray(entry->d_name));
+    }
+
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+
+    for (i = 0; i < names.size(); ++i) {
+        name = QByteArray(path) + '/' + names[i];
+        if (stat(name.constData(), &st) == 0 &&
+            (S_ISDIR(st.st_mode) || names[i].endsWith(XDFIndex::extension)))
+            findIndexes(name.constData(), index_names);
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Prints the nodes whose paths match pattern, as for XDFIndex::match(), in the
+ * index path or in the indexes under the directory path.  A pattern that
+ * starts with '/' and has no wildcards matches the paths that start with it,
+ * which are found by binary search.  Returns the number of nodes printed or
+ * -1 if path does not exist.
+ */
+int XDFInventory::search(const char *pattern, const char *path, FILE *fp)
+{
+    int i;
+    int j;
+    int n;
+    int length;
+
+    QList<QByteArray> index_names;
+
+    XDFIndex index;
+
+    if (findIndexes(path, index_names) < 0)
+        return -1;
+
+    n = 0;
+
+    for (j = 0; j < index_names.size(); ++j) {
+        if (! index.open(index_names[j].constData())) {
+            fprintf(stderr, "ERROR: Invalid index: %s\n", index_names[j].constData());
+            continue;
+        }
+
+        if (! index.isCurrent(index.fileName()))
+            fprintf(stderr, "WARNING: File changed since it was indexed: %s\n",
+                    index.fileName());
+
+        if (pattern[0] == '/' && strpbrk(pattern, "*?[") == NULL) {
+            length = strlen(pattern);
+            for (i = index.lowerBound(pattern); i < index.nodeCount(); ++i) {
+                if (strncmp(index.string(index.node(index.sorted(i)).path), pattern,
+                            length) != 0)
+                    break;
+                print_node(index, index.sorted(i), fp);
+                n++;
+            }
+        }
+        else {
+            for (i = index.match(pattern, 0); i >= 0; i = index.match(pattern, i + 1)) {
+                print_node(index, i, fp);
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
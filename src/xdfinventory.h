@@ -0,0 +1,62 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFINVENTORY_H
+#define XDFINVENTORY_H
+
+#include <stdio.h>
+
+#include <qbytearray.h>
+#include <qlist.h>
+
+
+/*
+ * Indexes every HDF4, HDF5, and NetCDF file under a set of files and
+ * directories into a tree of XDFIndex files that mirrors them, and searches
+ * such a tree.  The format libraries are not thread safe so each file is
+ * scanned in a child process of its own, with up to n_workers at a time, and
+ * a file that crashes its library only loses its own index.  The libraries
+ * are never called in the parent.  Files whose index is current are skipped.
+ * The GUI searches the indexes it is given in its find results, see
+ * XDFMainWindow::openIndex().
+ */
+class XDFInventory
+{
+public:
+    enum Result {
+        Indexed,
+        Failed,
+        NotDataFile,
+        Current
+    };
+
+private:
+    const char *index_dir;
+    int n_workers;
+
+    QList<QByteArray> file_names;
+    QList<QByteArray> index_names;
+
+    int walk(const QByteArray &path, const QByteArray &index_name);
+
+    static int makeDirs(const char *index_name);
+    static Result indexFile(const char *file_name, const char *index_name);
+
+public:
+    XDFInventory(const char *index_dir, int n_workers);
+
+    int addPath(const char *path);
+
+    int run();
+
+    static int findIndexes(const char *path, QList<QByteArray> &index_names);
+    static int search(const char *pattern, const char *path, FILE *fp);
+};
+
+#endif /* XDFINVENTORY_H */
@@ -0,0 +1,342 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include <hdf5.h>
+#include <mfhdf.h>
+#include <netcdf.h>
+
+#include "xdfv.h"
+#include "xdfkernel.h"
+#include "xdfnumberformat.h"
+
+
+/*
+ * Formats a single value, truncated to length - 1 characters.
+ */
+class XDFValueFormatter
+{
+public:
+    const XDFNumberFormat *number_format;
+    char *string;
+    int length;
+    int n;
+
+    template <typename T>
+    bool operator()(T value)
+    {
+        n = number_format->format(value, string, length);
+
+        return false;
+    }
+};
+
+
+
+/*
+ * Formats values separated by ", " for as long as they fit whole in length - 1
+ * characters.
+ */
+class XDFArrayFormatter
+{
+public:
+    const XDFNumberFormat *number_format;
+    char *string;
+    int length;
+    int n;
+
+    template <typename T>
+    bool operator()(T value)
+    {
+        int m;
+        int n_sep;
+
+        n_sep = n == 0 ? 0 : 2;
+
+        if (n + n_sep >= length - 1)
+            return false;
+
+        m = number_format->format(value, string + n + n_sep, length - n - n_sep);
+        if (m < 0 || n + n_sep + m >= length) {
+            string[n] = '\0';
+            return false;
+        }
+
+        if (n_sep > 0)
+            memcpy(string + n, ", ", n_sep);
+
+        n += n_sep + m;
+
+        return true;
+    }
+};
+
+
+
+/*
+ * Converts values to double.  Characters and strings are not numbers.
+ */
+class XDFDoubleConverter
+{
+public:
+    double *values;
+    size_t stride;
+
+    template <typename T>
+    bool operator()(T value)
+    {
+        *values = value;
+        values += stride;
+
+        return true;
+    }
+
+    bool operator()(char value)
+    {
+        return false;
+    }
+
+    bool operator()(const char *value)
+    {
+        return false;
+    }
+};
+
+
+
+/*
+ * The class and size of the datatype are enough as the values are read in the
+ * datatype of the file.  Only the datatype is queried, no native type is
+ * created to be compared and closed.
+ */
+XDFKernel::Type XDFKernel::hdf5Type(hid_t datatype_id)
+{
+    size_t size;
+
+    H5T_class_t data_class;
+
+    H5T_sign_t sign;
+
+    data_class = H5Tget_class(datatype_id);
+    size       = H5Tget_size(datatype_id);
+
+    if (data_class == H5T_INTEGER) {
+        sign = H5Tget_sign(datatype_id);
+        if (sign == H5T_SGN_2) {
+            switch(size) {
+                case 1:
+                    return Int8;
+                case 2:
+                    return Int16;
+                case 4:
+                    return Int32;
+                case 8:
+                    return Int64;
+            }
+        }
+        else if (sign == H5T_SGN_NONE) {
+            switch(size) {
+                case 1:
+                    return UInt8;
+                case 2:
+                    return UInt16;
+                case 4:
+                    return UInt32;
+                case 8:
+                    return UInt64;
+            }
+        }
+    }
+    else if (data_class == H5T_FLOAT) {
+        if (size == sizeof(float))
+            return Float;
+        else if (size == sizeof(double))
+            return Double;
+    }
+
+    return Unknown;
+}
+
+
+
+XDFKernel::Type XDFKernel::netcdfType(nc_type xtype)
+{
+    switch(xtype) {
+        case NC_BYTE:
+            return Int8;
+        case NC_UBYTE:
+            return UInt8;
+        case NC_CHAR:
+            return Char;
+        case NC_SHORT:
+            return Int16;
+        case NC_USHORT:
+            return UInt16;
+        case NC_INT:
+            return Int32;
+        case NC_UINT:
+            return UInt32;
+        case NC_INT64:
+            return Int64;
+        case NC_UINT64:
+            return UInt64;
+        case NC_FLOAT:
+            return Float;
+        case NC_DOUBLE:
+            return Double;
+        case NC_STRING:
+            return String;
+        default:
+            return Unknown;
+    }
+}
+
+
+
+XDFKernel::Type XDFKernel::hdfType(int32 data_type)
+{
+    switch(data_type) {
+        case DFNT_CHAR8:
+        case DFNT_UCHAR8:
+            return Char;
+        case DFNT_INT8:
+            return Int8;
+        case DFNT_UINT8:
+            return UInt8;
+        case DFNT_INT16:
+            return Int16;
+        case DFNT_UINT16:
+            return UInt16;
+        case DFNT_INT32:
+            return Int32;
+        case DFNT_UINT32:
+            return UInt32;
+        case DFNT_FLOAT32:
+            return Float;
+        case DFNT_FLOAT64:
+            return Double;
+        default:
+            return Unknown;
+    }
+}
+
+
+
+size_t XDFKernel::typeSize(Type type)
+{
+    switch(type) {
+        case Int8:
+        case UInt8:
+        case Char:
+            return 1;
+        case Int16:
+        case UInt16:
+            return 2;
+        case Int32:
+        case UInt32:
+        case Float:
+            return 4;
+        case Int64:
+        case UInt64:
+        case Double:
+            return 8;
+        case String:
+            return sizeof(char *);
+        default:
+            return 0;
+    }
+}
+
+
+
+/*
+ * Formats the value of type type at ptr into string with number_format.
+ * Returns the length of the string or -1 if the type is Unknown.
+ */
+int XDFKernel::format(Type type, const void *ptr, char *string, int length,
+                      const XDFNumberFormat &number_format)
+{
+    XDFValueFormatter formatter;
+
+    formatter.number_format = &number_format;
+    formatter.string        = string;
+    formatter.length        = length;
+    formatter.n             = -1;
+
+    string[0] = '\0';
+
+    if (visit(type, ptr, 1, 0, formatter) < 0)
+        return -1;
+
+    if (formatter.n < 0)
+        return -1;
+
+    return MIN(formatter.n, length - 1);
+}
+
+
+
+/*
+ * Formats n values of type type at data into string with number_format,
+ * separated by ", ", as many as fit whole.  An array of characters is text and
+ * is copied as is.  Returns the length of the string or -1 if the type is
+ * Unknown.
+ */
+int XDFKernel::formatArray(Type type, const void *data, size_t n, char *string,
+                           int length, const XDFNumberFormat &number_format)
+{
+    XDFArrayFormatter formatter;
+
+    string[0] = '\0';
+
+    if (type == Char) {
+        n = MIN(n, (size_t) length - 1);
+
+        strncpy(string, (const char *) data, n);
+
+        string[n] = '\0';
+
+        return strlen(string);
+    }
+
+    formatter.number_format = &number_format;
+    formatter.string        = string;
+    formatter.length        = length;
+    formatter.n             = 0;
+
+    if (visit(type, data, n, typeSize(type), formatter) < 0)
+        return -1;
+
+    return formatter.n;
+}
+
+
+
+/*
+ * Converts n values of type type at data, stride bytes apart, to doubles
+ * values_stride values apart.  Returns -1 if the type is Unknown or is not a
+ * number.
+ */
+int XDFKernel::toDouble(Type type, const void *data, size_t n, size_t stride,
+                        double *values, size_t values_stride)
+{
+    int r;
+
+    XDFDoubleConverter converter;
+
+    converter.values = values;
+    converter.stride = values_stride;
+
+    r = visit(type, data, n, stride, converter);
+    if (r < 0 || (size_t) r < n)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFKERNEL_H
+#define XDFKERNEL_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <hdf5.h>
+#include <mfhdf.h>
+#include <netcdf.h>
+
+#include "xdfnumberformat.h"
+
+
+/*
+ * Typed kernels over buffers of values read from a file.  The type of the
+ * values, given by the library as an HDF5 datatype, a NetCDF type, or an HDF4
+ * data type, is resolved once to a Type and visit() then runs a loop
+ * specialized for that type over the whole buffer, calling the visitor with
+ * each value as its C type, instead of looking up the type again for each
+ * value.  Values are stride bytes apart and need not be aligned.  A visitor
+ * is a class with an operator() for each C type, or a template one, that
+ * returns false to stop the loop.  format(), formatArray(), and toDouble()
+ * are the kernels used by the table views, the tree previews, and the
+ * statistics, the first two formatting with an XDFNumberFormat.  Types that
+ * are not a Type, such as HDF5 strings and compound types, are Unknown and
+ * are left to the format specific code.
+ */
+class XDFKernel
+{
+public:
+    enum Type {
+        Unknown,
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Float,
+        Double,
+        Char,
+        String
+    };
+
+    static Type hdf5Type(hid_t datatype_id);
+    static Type netcdfType(nc_type xtype);
+    static Type hdfType(int32 data_type);
+    static size_t typeSize(Type type);
+
+    template <typename T, typename Visitor>
+    static size_t visitTyped(const void *data, size_t n, size_t stride,
+                             Visitor &visitor);
+    template <typename Visitor>
+    static int visit(Type type, const void *data, size_t n, size_t stride,
+                     Visitor &visitor);
+
+    static int format(Type type, const void *ptr, char *string, int length,
+                      const XDFNumberFormat &number_format = XDFNumberFormat());
+    static int formatArray(Type type, const void *data, size_t n, char *string,
+                           int length,
+                           const XDFNumberFormat &number_format = XDFNumberFormat());
+    static int toDouble(Type type, const void *data, size_t n, size_t stride,
+                        double *values, size_t values_stride);
+};
+
+
+
+/*
+ * The loop for one type.  Returns the number of values visited, less than n
+ * if the visitor stopped early.
+ */
+template <typename T, typename Visitor>
+size_t XDFKernel::visitTyped(const void *data, size_t n, size_t stride,
+                             Visitor &visitor)
+{
+    size_t i;
+
+    const char *ptr;
+
+    T value;
+
+    ptr = (const char *) data;
+
+    for (i = 0; i < n; ++i) {
+        memcpy(&value, ptr, sizeof(T));
+        if (! visitor(value))
+            break;
+        ptr += stride;
+    }
+
+    return i;
+}
+
+
+
+/*
+ * Visits n values of type type at data.  Returns the number of values
+ * visited or -1 if the type is Unknown.
+ */
+template <typename Visitor>
+int XDFKernel::visit(Type type, const void *data, size_t n, size_t stride,
+                     Visitor &visitor)
+{
+    switch(type) {
+        case Int8:
+            return visitTyped<signed char>(data, n, stride, visitor);
+        case UInt8:
+            return visitTyped<unsigned char>(data, n, stride, visitor);
+        case Int16:
+            return visitTyped<short>(data, n, stride, visitor);
+        case UInt16:
+            return visitTyped<unsigned short>(data, n, stride, visitor);
+        case Int32:
+            return visitTyped<int>(data, n, stride, visitor);
+        case UInt32:
+            return visitTyped<unsigned int>(data, n, stride, visitor);
+        case Int64:
+            return visitTyped<long long>(data, n, stride, visitor);
+        case UInt64:
+            return visitTyped<unsigned long long>(data, n, stride, visitor);
+        case Float:
+            return visitTyped<float>(data, n, stride, visitor);
+        case Double:
+            return visitTyped<double>(data, n, stride, visitor);
+        case Char:
+            return visitTyped<char>(data, n, stride, visitor);
+        case String:
+            return visitTyped<const char *>(data, n, stride, visitor);
+        default:
+            return -1;
+    }
+}
+
+#endif /* XDFKERNEL_H */
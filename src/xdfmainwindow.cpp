@@ -11,8 +11,11 @@
 #include <hdf5.h>
 #include <netcdf.h>
 
+#include <algorithm>
+
 #include <qboxlayout.h>
 #include <qdialog.h>
+#include <qfile.h>
 #include <qfiledialog.h>
 #include <qframe.h>
 #include <qlabel.h>
@@ -25,6 +28,7 @@
 #include "hdftreeview.h"
 #include "hdf5treeview.h"
 #include "nctreeview.h"
+#include "xdfinventory.h"
 #include "xdfmainwindow.h"
 #include "xdftreeview.h"
 
@@ -36,6 +40,7 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
 
     QMenu *file_menu;
     QAction *open_file_action;
+    QAction *open_index_action;
     QAction *reload_file_action;
     QAction *quit_action;
 
@@ -94,6 +99,8 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
     open_file_action = file_menu->addAction("Open file");
     open_file_action->setShortcut(QKeySequence("Ctrl+o"));
 
+    open_index_action = file_menu->addAction("Open index");
+
     reload_file_action = file_menu->addAction("Reload file");
     reload_file_action->setShortcut(QKeySequence("Ctrl+r"));
 
@@ -220,6 +227,15 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
     find_line_edit = new QLineEdit(find_frame);
     find_horiz_layout->addWidget(find_line_edit);
 
+    find_syntax_combo_box = new QComboBox(find_frame);
+    find_syntax_combo_box->addItem("Text");
+    find_syntax_combo_box->addItem("Glob");
+    find_syntax_combo_box->addItem("Regex");
+    find_syntax_combo_box->setToolTip("Match names and values that contain the text, that "
+                                      "match the glob, or in which the regular expression "
+                                      "matches.  With a '/' match paths instead.");
+    find_horiz_layout->addWidget(find_syntax_combo_box);
+
     find_push_button = new QPushButton("Find", find_frame);
     find_horiz_layout->addWidget(find_push_button);
     find_prev_push_button = new QPushButton("Find Prev", find_frame);
@@ -230,11 +246,22 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
 
     find_horiz_layout->addWidget(find_close_push_button);
 
-/*
+    find_results = new QListWidget(central_widget);
+    find_results->setMaximumHeight(150);
+    find_results->hide();
+    vertical_layout->addWidget(find_results);
+
+    find_timer = new QTimer(this);
+    find_timer->setSingleShot(true);
+    find_timer->setInterval(find_delay);
+
     file_watcher = new QFileSystemWatcher(this);
-*/
+
+    reload_timer = new QTimer(this);
+    reload_timer->setSingleShot(true);
 
     QObject::connect(open_file_action,          SIGNAL(triggered()),   this,          SLOT(openFile()));
+    QObject::connect(open_index_action,         SIGNAL(triggered()),   this,          SLOT(openIndex()));
     QObject::connect(reload_file_action,        SIGNAL(triggered()),   this,          SLOT(reloadCurrentFile()));
     QObject::connect(quit_action,               SIGNAL(triggered()),   this,          SLOT(close()));
 
@@ -247,6 +274,11 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
     QObject::connect(find_all_action,           SIGNAL(triggered()),   this,          SLOT(findAll()));
     QObject::connect(find_all_push_button,      SIGNAL(clicked()),     this,          SLOT(findAll()));
     QObject::connect(find_close_push_button,    SIGNAL(clicked()),     find_frame,    SLOT(hide()));
+    QObject::connect(find_close_push_button,    SIGNAL(clicked()),     find_results,  SLOT(hide()));
+    QObject::connect(find_line_edit,            SIGNAL(textChanged(const QString &)), find_timer, SLOT(start()));
+    QObject::connect(find_syntax_combo_box,     SIGNAL(currentIndexChanged(int)), find_timer, SLOT(start()));
+    QObject::connect(find_timer,                SIGNAL(timeout()),     this,          SLOT(updateFindResults()));
+    QObject::connect(find_results,              SIGNAL(itemActivated(QListWidgetItem *)), this, SLOT(showFindResult(QListWidgetItem *)));
 
     QObject::connect(expand_all_action,         SIGNAL(triggered()),   tab_tree_view, SLOT(expandAll()));
     QObject::connect(expand_all_tabs_action,    SIGNAL(triggered()),   tab_tree_view, SLOT(expandAllTabs()));
@@ -264,16 +296,16 @@ XDFMainWindow::XDFMainWindow(QWidget *parent)
     QObject::connect(tab_tree_view,             SIGNAL(colorizedChanged(bool)), view_in_color_action, SLOT(setChecked(bool)));
 
     QObject::connect(about_action,              SIGNAL(triggered()),   this,          SLOT(showAbout()));
-/*
-    QObject::connect(file_watcher,              SIGNAL(fileChanged(const QString &)), this, SLOT(reloadFile(const QString &)));
-*/
+    QObject::connect(file_watcher,              SIGNAL(fileChanged(const QString &)), this, SLOT(fileChanged(const QString &)));
+    QObject::connect(reload_timer,              SIGNAL(timeout()),     this,          SLOT(reloadChangedFiles()));
 }
 
 
 
 XDFMainWindow::~XDFMainWindow()
 {
-
+    for (int i = 0; i < indexes.size(); ++i)
+        delete indexes[i];
 }
 
 
@@ -307,6 +339,42 @@ char *XDFMainWindow::cut_fn(const char *in, char *out)
 
 
 
+/*
+ * Looks for the HDF5 superblock signature at offset 0, 512, 1024, 2048, etc.
+ * as H5Fis_hdf5() does, but without waiting on the HDF5 library, which may be
+ * busy loading another file.
+ */
+bool XDFMainWindow::is_hdf5_file(QString file_name)
+{
+    static const char signature[8] = {'\211', 'H', 'D', 'F', '\r', '\n', '\032', '\n'};
+
+    char buffer[8];
+
+    long offset;
+
+    FILE *fp;
+
+    fp = fopen(file_name.toLatin1().data(), "r");
+    if (fp == NULL)
+        return false;
+
+    for (offset = 0; ; offset = offset == 0 ? 512 : offset * 2) {
+        if (fseek(fp, offset, SEEK_SET) != 0 || fread(buffer, 1, 8, fp) != 8)
+            break;
+
+        if (memcmp(buffer, signature, 8) == 0) {
+            fclose(fp);
+            return true;
+        }
+    }
+
+    fclose(fp);
+
+    return false;
+}
+
+
+
 XDFV::FileType XDFMainWindow::file_type_from_extension(QString file_name)
 {
     FILE *fp;
@@ -321,7 +389,7 @@ XDFV::FileType XDFMainWindow::file_type_from_extension(QString file_name)
         throw FileNotFound;
     fclose(fp);
 
-    if (H5Fis_hdf5(file_name.toLatin1().data()) > 0)
+    if (is_hdf5_file(file_name))
         return XDFV::HDF5;
 
     if (fi.suffix() == "h5")
@@ -342,9 +410,13 @@ void XDFMainWindow::openFile()
 
     XDFV::FileType file_type = XDFV::Unknown;
 
-    file_names = QFileDialog::getOpenFileNames(this, "", "", "(*.hdf *.h5 *.nc)");
+    file_names = QFileDialog::getOpenFileNames(this, "", "", "(*.hdf *.h5 *.nc *.xdfi)");
 
     for (int i = 0; i < file_names.size(); ++i) {
+        if (file_names.at(i).endsWith(XDFIndex::extension)) {
+            openIndex(file_names.at(i).toLatin1().data());
+            continue;
+        }
         try {
             if ((file_type = file_type_from_extension(file_names.at(i))) == XDFV::Unknown) {
                 messageBox.critical(this, "XDFV Error", "Unknown file extension.");
@@ -400,27 +472,19 @@ void XDFMainWindow::openFile(XDFV::FileType file_type, const char *file_name, in
 
     XDFTreeView *xdf_tree_view = NULL;
 
-    try {
-        if (file_type == XDFV::HDF4)
-            xdf_tree_view = new HDFTreeView(file_name, flag, tabTreeView());
-        else if (file_type == XDFV::HDF5)
-            xdf_tree_view = new HDF5TreeView(file_name, tabTreeView());
-        else if (file_type == XDFV::NetCDF)
-            xdf_tree_view = new NCTreeView  (file_name, tabTreeView());
-        else {
-            fprintf(stderr, "ERROR: Unknown file type\n");
-            exit(1);
-        }
-    }
-    catch (int e) {
-        if (e == XDFProcessor::FileNotFound)
-            throw FileNotFound;
-        else if (e == XDFProcessor::UnableToOpenFile)
-            throw UnableToOpenFile;
+    if (file_type == XDFV::HDF4)
+        xdf_tree_view = new HDFTreeView(file_name, flag, tabTreeView());
+    else if (file_type == XDFV::HDF5)
+        xdf_tree_view = new HDF5TreeView(file_name, tabTreeView()->lazyLoad(), tabTreeView());
+    else if (file_type == XDFV::NetCDF)
+        xdf_tree_view = new NCTreeView  (file_name, tabTreeView());
+    else {
+        fprintf(stderr, "ERROR: Unknown file type\n");
+        exit(1);
     }
 
-    if (tabTreeView()->defaultExpanded())
-        xdf_tree_view->expandAll();
+    QObject::connect(xdf_tree_view, SIGNAL(loadFinished(int)), this, SLOT(loadFinished(int)));
+
     xdf_tree_view->setFontSize(tabTreeView()->fontSize());
     xdf_tree_view->colorizeAll(tabTreeView()->isColorized());
 
@@ -428,31 +492,137 @@ void XDFMainWindow::openFile(XDFV::FileType file_type, const char *file_name, in
     index = tabTreeView()->addTab(xdf_tree_view, cut_fn(file_name, temp));
     tabTreeView()->setCurrentIndex(index);
     tabTreeView()->setTabToolTip(index, file_name);
+    tabTreeView()->showLoadProgress(xdf_tree_view);
     free(temp);
-/*
+
     file_watcher->addPath(file_name);
-*/
 }
 
 
 
-void XDFMainWindow::reloadFile(XDFTreeView *view)
+void XDFMainWindow::openIndex()
 {
-    view->clear();
+    QString path;
 
-    try {
-        view->load();
+    path = QFileDialog::getExistingDirectory(this, "Open index");
+    if (path.isEmpty())
+        return;
+
+    openIndex(path.toLatin1().data());
+}
+
+
+
+/*
+ * Adds the index path, or the indexes under the directory path as written by
+ * --inventory, to the indexes whose nodes are listed in the find results.
+ * Indexes are searched as they are, without opening their files.
+ */
+void XDFMainWindow::openIndex(const char *path)
+{
+    int i;
+    int j;
+    int n;
+
+    QMessageBox messageBox;
+
+    QList<QByteArray> index_names;
+
+    XDFIndex *index;
+
+    if (XDFInventory::findIndexes(path, index_names) < 0) {
+        messageBox.critical(this, "XDFV Error", "File does not exist.");
+        return;
     }
-    catch (int e) {
-        if (e == XDFProcessor::FileNotFound)
-            throw FileNotFound;
-        else if (e == XDFProcessor::UnableToOpenFile)
-            throw UnableToOpenFile;
+
+    n = 0;
+
+    for (i = 0; i < index_names.size(); ++i) {
+        index = new XDFIndex;
+        if (! index->open(index_names[i].constData())) {
+            fprintf(stderr, "ERROR: Invalid index: %s\n", index_names[i].constData());
+            delete index;
+            continue;
+        }
+
+        index->buildSearchIndex();
+
+        for (j = 0; j < indexes.size(); ++j) {
+            if (strcmp(indexes[j]->fileName(), index->fileName()) == 0)
+                break;
+        }
+
+        if (j < indexes.size()) {
+            delete indexes[j];
+            indexes[j] = index;
+        }
+        else
+            indexes.append(index);
+
+        n++;
+    }
+
+    if (n == 0) {
+        messageBox.critical(this, "XDFV Error", "No valid index found.");
+        return;
+    }
+
+    find_frame->show();
+    find_line_edit->setFocus();
+
+    updateFindResults();
+}
+
+
+
+void XDFMainWindow::reloadFile(XDFTreeView *view)
+{
+    view->reload();
+
+    tabTreeView()->showLoadProgress(view);
+}
+
+
+
+/*
+ * Trees are loaded in the background so errors opening a file are reported
+ * here, when the view's loader returns, rather than thrown from openFile().
+ */
+void XDFMainWindow::loadFinished(int status)
+{
+    int index;
+
+    QMessageBox messageBox;
+
+    XDFTreeView *view = (XDFTreeView *) sender();
+
+    /*
+     * A file that is being rewritten may not be readable for a moment.  The
+     * tree is kept as it was and the next change reloads it again.
+     */
+    if (view->isReloading())
+        return;
+
+    if (status == XDFProcessor::FileNotFound ||
+        status == XDFProcessor::UnableToOpenFile) {
+        index = tabTreeView()->indexOf(view);
+        if (index >= 0)
+            tabTreeView()->removeTab(index);
+        view->deleteLater();
+
+        if (status == XDFProcessor::FileNotFound)
+            messageBox.critical(this, "XDFV Error", "File does not exist.");
+        else
+            messageBox.critical(this, "XDFV Error", "Unable to open file, invalid format or file corrupt.");
+        return;
     }
 
-    if (tabTreeView()->defaultExpanded())
+    if (status == 0 && tabTreeView()->defaultExpanded())
         view->expandAll();
-    view->colorizeAll(tabTreeView()->isColorized());
+
+    if (status == 0 && ! pending_path.isEmpty() &&
+        QFileInfo(view->filename()).canonicalFilePath() == pending_file)
+        selectPendingPath(view);
 }
 
 
@@ -470,6 +640,44 @@ void XDFMainWindow::reloadFile(const QString &file_name)
 
 
 
+/*
+ * Files that are being written change many times in a row so they are only
+ * reloaded once they have not changed for reload_delay ms.
+ */
+void XDFMainWindow::fileChanged(const QString &file_name)
+{
+    if (! changed_files.contains(file_name))
+        changed_files.append(file_name);
+
+    reload_timer->start(reload_delay);
+}
+
+
+
+void XDFMainWindow::reloadChangedFiles()
+{
+    int i;
+
+    QStringList file_names;
+
+    file_names = changed_files;
+    changed_files.clear();
+
+    for (i = 0; i < file_names.size(); ++i) {
+        /*
+         * Files that are replaced rather than modified in place are no
+         * longer watched.
+         */
+        if (! file_watcher->files().contains(file_names[i]) &&
+            QFile::exists(file_names[i]))
+            file_watcher->addPath(file_names[i]);
+
+        reloadFile(file_names[i]);
+    }
+}
+
+
+
 void XDFMainWindow::reloadCurrentFile()
 {
     reloadFile((XDFTreeView *) (tabTreeView()->currentWidget()));
@@ -477,6 +685,14 @@ void XDFMainWindow::reloadCurrentFile()
 
 
 
+XDFSearchQuery XDFMainWindow::findQuery()
+{
+    return XDFSearchQuery(find_line_edit->text(),
+                          (XDFSearchQuery::Syntax) find_syntax_combo_box->currentIndex());
+}
+
+
+
 void XDFMainWindow::find()
 {
     if (! find_frame->isVisible()) {
@@ -484,12 +700,10 @@ void XDFMainWindow::find()
         return;
     }
 
-    QString name = find_line_edit->text();
-
-    if (name.trimmed().isEmpty())
+    if (find_line_edit->text().trimmed().isEmpty())
         return;
 
-    tabTreeView()->find(name);
+    tabTreeView()->find(findQuery());
 }
 
 
@@ -501,12 +715,10 @@ void XDFMainWindow::findPrev()
         return;
     }
 
-    QString name = find_line_edit->text();
-
-    if (name.trimmed().isEmpty())
+    if (find_line_edit->text().trimmed().isEmpty())
         return;
 
-    tabTreeView()->findPrev(name);
+    tabTreeView()->findPrev(findQuery());
 }
 
 
@@ -518,12 +730,265 @@ void XDFMainWindow::findAll()
         return;
     }
 
-    QString name = find_line_edit->text();
+    if (find_line_edit->text().trimmed().isEmpty())
+        return;
+
+    tabTreeView()->selectAll(findQuery());
+
+    find_timer->stop();
+    updateFindResults();
+}
+
+
+
+static bool index_hit_less(const XDFIndexHit &a, const XDFIndexHit &b)
+{
+    return a.rank < b.rank;
+}
+
+
+
+/*
+ * Returns the Rank of a match of query in node i of index or -1 for none, as
+ * XDFTreeView::matchNode() does for a tree.
+ */
+static int match_index_node(const XDFSearchQuery &query, const XDFIndex *index, int i)
+{
+    int own;
+    int rank;
+
+    const char *name;
+    const char *path;
+
+    const XDFIndex::Node &node = index->node(i);
+
+    name = index->string(node.name);
+    path = index->string(node.path);
+
+    if (query.isPath()) {
+        own = name[0] == '/' ? 0 : strlen(path) - strlen(name);
+        return query.matchPath(path, own);
+    }
+
+    rank = query.matchName(name);
+    if (rank < 0 && node.value >= 0)
+        rank = query.matchValue(index->string(node.value));
+
+    return rank;
+}
+
+
+
+/*
+ * Finds the nodes of the open indexes that match query, as the tabs are
+ * searched, and puts them in index_hits best ranked first.  The index of a
+ * file that is open in a tab is skipped as the tab is searched instead.
+ * Candidates are looked up in the search index of each index, or by path
+ * prefix if the query has one, and only if the query has neither is every
+ * node checked.  Returns how many were found.
+ */
+int XDFMainWindow::searchIndexes(const XDFSearchQuery &query)
+{
+    int i;
+    int j;
+    int n;
+
+    const char *prefix;
+
+    QStringList open_files;
+
+    QVector<int> ids;
+
+    XDFIndexHit hit;
+
+    index_hits.clear();
+
+    if (! query.isValid())
+        return 0;
+
+    for (i = 0; i < tabTreeView()->count(); ++i)
+        open_files.append(QFileInfo(((XDFTreeView *) tabTreeView()->widget(i))->filename()).
+                          canonicalFilePath());
+
+    prefix = query.pathPrefix().constData();
+    n      = query.pathPrefix().size();
+
+    for (i = 0; i < indexes.size(); ++i) {
+        if (open_files.contains(QString::fromLocal8Bit(indexes[i]->fileName())))
+            continue;
+
+        hit.index = indexes[i];
+
+        if (! indexes[i]->searchIndex().lookup(query.requiredLiterals(), ids)) {
+            ids.clear();
+            if (n > 0) {
+                for (j = indexes[i]->lowerBound(prefix); j < indexes[i]->nodeCount(); ++j) {
+                    const XDFIndex::Node &node = indexes[i]->node(indexes[i]->sorted(j));
+                    if (strncmp(indexes[i]->string(node.path), prefix, n) != 0)
+                        break;
+                    ids.append(indexes[i]->sorted(j));
+                }
+                std::sort(ids.begin(), ids.end());
+            }
+            else {
+                for (j = 1; j < indexes[i]->nodeCount(); ++j)
+                    ids.append(j);
+            }
+        }
+
+        for (j = 0; j < ids.size(); ++j) {
+            if (ids[j] == 0)
+                continue;
+            if ((hit.rank = match_index_node(query, indexes[i], ids[j])) >= 0) {
+                hit.node = ids[j];
+                index_hits.append(hit);
+            }
+        }
+    }
+
+    std::stable_sort(index_hits.begin(), index_hits.end(), index_hit_less);
+
+    return index_hits.size();
+}
+
+
+
+/*
+ * Lists the nodes of all tabs that match the find text, best ranked first,
+ * followed by those of the open indexes.  Called as the text is typed, once
+ * it has not changed for find_delay ms.
+ */
+void XDFMainWindow::updateFindResults()
+{
+    int i;
+    int n;
+    int n_indexed;
+
+    QString text;
+
+    XDFSearchQuery query = findQuery();
+
+    find_hits.clear();
+    index_hits.clear();
+    find_results->clear();
+
+    if (! find_frame->isVisible() || find_line_edit->text().trimmed().isEmpty()) {
+        find_results->hide();
+        return;
+    }
+
+    n = tabTreeView()->search(query, find_hits);
+    if (n > max_find_results)
+        find_hits.resize(max_find_results);
+
+    n_indexed = searchIndexes(query);
+    if (find_hits.size() + n_indexed > max_find_results)
+        index_hits.resize(max_find_results - find_hits.size());
+
+    n += n_indexed;
+
+    for (i = 0; i < find_hits.size(); ++i) {
+        const XDFSearchHit &hit = find_hits[i];
+
+        text = QFileInfo(hit.view->filename()).fileName() + ": " +
+               QString::fromUtf8(hit.view->nodePath(hit.id).constData());
+
+        find_results->addItem(text);
+    }
+
+    for (i = 0; i < index_hits.size(); ++i) {
+        const XDFIndexHit &hit = index_hits[i];
+
+        text = QFileInfo(QString::fromLocal8Bit(hit.index->fileName())).fileName() + ": " +
+               QString::fromUtf8(hit.index->string(hit.index->node(hit.node).path)) +
+               "  (index)";
+
+        find_results->addItem(text);
+    }
+
+    if (n > max_find_results)
+        find_results->addItem(QString("... %1 more").arg(n - max_find_results));
 
-    if (name.trimmed().isEmpty())
+    find_results->setVisible(n > 0);
+}
+
+
+
+void XDFMainWindow::showFindResult(QListWidgetItem *item)
+{
+    int row;
+
+    row = find_results->row(item);
+    if (row < 0)
         return;
 
-    tabTreeView()->selectAll(name);
+    if (row < find_hits.size())
+        tabTreeView()->showHit(find_hits[row]);
+    else if (row - find_hits.size() < index_hits.size())
+        showIndexHit(index_hits[row - find_hits.size()]);
+}
+
+
+
+/*
+ * Opens the file of a node found in an index, or shows its tab if it is
+ * already open, and selects the node once the file has been loaded.  A node
+ * under a group that is loaded lazily is only found once it is expanded so
+ * then only the file is shown.
+ */
+void XDFMainWindow::showIndexHit(const XDFIndexHit &hit)
+{
+    int i;
+
+    QMessageBox messageBox;
+
+    XDFTreeView *view;
+
+    pending_file = QString::fromLocal8Bit(hit.index->fileName());
+    pending_path = hit.index->string(hit.index->node(hit.node).path);
+
+    for (i = 0; i < tabTreeView()->count(); ++i) {
+        view = (XDFTreeView *) tabTreeView()->widget(i);
+        if (QFileInfo(view->filename()).canonicalFilePath() == pending_file) {
+            tabTreeView()->setCurrentIndex(i);
+            if (! view->isLoading())
+                selectPendingPath(view);
+            return;
+        }
+    }
+
+    try {
+        openFile(pending_file.toLatin1().data(), 0);
+    }
+    catch (ErrorCode e) {
+        pending_path.clear();
+        if (e == FileNotFound)
+            messageBox.critical(this, "XDFV Error", "File does not exist.");
+        else
+            messageBox.critical(this, "XDFV Error", "Unknown file extension.");
+    }
+}
+
+
+
+/*
+ * Selects the node of view whose path is pending_path, see showIndexHit().
+ */
+void XDFMainWindow::selectPendingPath(XDFTreeView *view)
+{
+    QVector<XDFSearchHit> hits;
+
+    view->search(XDFSearchQuery(QString::fromUtf8(pending_path.constData()),
+                                XDFSearchQuery::Text), hits);
+
+    for (int i = 0; i < hits.size(); ++i) {
+        if (hits[i].rank == XDFSearchQuery::Exact) {
+            tabTreeView()->showHit(hits[i]);
+            break;
+        }
+    }
+
+    pending_path.clear();
 }
 
 
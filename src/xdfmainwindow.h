@@ -10,17 +10,36 @@
 #ifndef XDFMAINWINDOW_H
 #define XDFMAINWINDOW_H
 
+#include <qcombobox.h>
 #include <qfilesystemwatcher.h>
 #include <qlineedit.h>
+#include <qlistwidget.h>
 #include <qmainwindow.h>
 #include <qsplitter.h>
+#include <qstringlist.h>
 #include <qtabwidget.h>
+#include <qtimer.h>
+#include <qvector.h>
 
 #include "xdfv.h"
+#include "xdfindex.h"
 #include "xdftabtreeview.h"
 #include "xdftreeview.h"
 
 
+/*
+ * A node found in an XDFIndex by XDFMainWindow::searchIndexes() and its
+ * XDFSearchQuery::Rank.
+ */
+struct XDFIndexHit
+{
+    XDFIndex *index;
+    int node;
+    int rank;
+};
+
+
+
 class XDFMainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -35,17 +54,38 @@ public:
 private:
     static const size_t max_tab_size = 32;
 
+    static const int reload_delay = 1000;
+
+    static const int find_delay       = 150;
+    static const int max_find_results = 1000;
+
     QFrame *find_frame;
     QLineEdit *find_line_edit;
+    QComboBox *find_syntax_combo_box;
+    QListWidget *find_results;
+    QTimer *find_timer;
+    QVector<XDFSearchHit> find_hits;
+    QList<XDFIndex *> indexes;
+    QVector<XDFIndexHit> index_hits;
+    QString pending_file;
+    QByteArray pending_path;
     QFileSystemWatcher *file_watcher;
+    QTimer *reload_timer;
+    QStringList changed_files;
 
     XDFTabTreeView *tab_tree_view;
 
     char *cut_fn(const char *in, char *out);
 
-    XDFV::FileType file_type_from_extension(QString file_name);
+    XDFSearchQuery findQuery();
+    int searchIndexes(const XDFSearchQuery &query);
+    void showIndexHit(const XDFIndexHit &hit);
+    void selectPendingPath(XDFTreeView *view);
 
 public:
+    static bool is_hdf5_file(QString file_name);
+    static XDFV::FileType file_type_from_extension(QString file_name);
+
     XDFMainWindow(QWidget *parent = 0);
     ~XDFMainWindow();
 
@@ -55,13 +95,21 @@ public slots:
     void openFile();
     void openFile(const char *file_name, int flag);
     void openFile(XDFV::FileType file_type, const char *file_name, int flag);
+    void openIndex();
+    void openIndex(const char *path);
     void reloadFile(XDFTreeView *view);
     void reloadFile(const QString &file_name);
     void reloadCurrentFile();
+    void fileChanged(const QString &file_name);
+    void reloadChangedFiles();
+
+    void loadFinished(int status);
 
     void find();
     void findPrev();
     void findAll();
+    void updateFindResults();
+    void showFindResult(QListWidgetItem *item);
 
     void showAbout();
 };
@@ -0,0 +1,754 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hdf5.h>
+
+#include <ghdf5.h>
+
+#include <qbytearray.h>
+
+#include "xdfv.h"
+#include "xdfkernel.h"
+#include "xdfmemberplan.h"
+
+
+/*
+ * Appends the m characters of s to string, which holds n characters, as many
+ * as fit in length - 1.  Returns false if they did not all fit.
+ */
+static bool append(char *string, int length, int *n, const char *s, int m)
+{
+    bool fits;
+
+    fits = *n + m < length;
+    if (! fits)
+        m = length - 1 - *n;
+
+    if (m > 0) {
+        memcpy(string + *n, s, m);
+        *n += m;
+    }
+
+    string[*n] = '\0';
+
+    return fits;
+}
+
+
+
+XDFMemberPlan::XDFMemberPlan()
+    : is_compound(false), needs_swap(false), element_size(0)
+{
+
+}
+
+
+
+/*
+ * Analyzes datatype_id, replacing the members of any earlier datatype.
+ * Returns -1 if the library fails or the datatype has more than max_members
+ * members.
+ */
+int XDFMemberPlan::init(hid_t datatype_id)
+{
+    H5T_class_t data_class;
+
+    clear();
+
+    data_class = H5Tget_class(datatype_id);
+    if (data_class < 0) {
+        fprintf(stderr, "ERROR: H5Tget_class()\n");
+        return -1;
+    }
+
+    element_size = H5Tget_size(datatype_id);
+    if (element_size == 0) {
+        fprintf(stderr, "ERROR: H5Tget_size()\n");
+        return -1;
+    }
+
+    is_compound = data_class == H5T_COMPOUND;
+
+    if (addMembers(datatype_id, QByteArray(), 0, 1) < 0) {
+        clear();
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+void XDFMemberPlan::clear()
+{
+    is_compound  = false;
+    needs_swap   = false;
+    element_size = 0;
+
+    members.clear();
+
+    enum_values.clear();
+    enum_names.clear();
+}
+
+
+
+/*
+ * Adds the members of count values of type_id at offset in an element.
+ */
+int XDFMemberPlan::addMembers(hid_t type_id, const QByteArray &name, size_t offset,
+                              size_t count)
+{
+    char *member_name;
+
+    int i;
+    int n_members;
+    int n_dims;
+
+    size_t j;
+    size_t size;
+
+    hid_t base_id;
+    hid_t member_type_id;
+
+    hsize_t dims[H5S_MAX_RANK];
+
+    H5T_class_t data_class;
+
+    H5T_order_t native_order;
+
+    QByteArray prefix;
+    QByteArray full_name;
+
+    Member member;
+
+    if (members.size() >= max_members) {
+        fprintf(stderr, "ERROR: More than %d members\n", max_members);
+        return -1;
+    }
+
+    data_class = H5Tget_class(type_id);
+    if (data_class < 0) {
+        fprintf(stderr, "ERROR: H5Tget_class()\n");
+        return -1;
+    }
+
+    size = H5Tget_size(type_id);
+    if (size == 0) {
+        fprintf(stderr, "ERROR: H5Tget_size()\n");
+        return -1;
+    }
+
+    native_order = H5Tget_order(H5T_NATIVE_INT);
+
+    if (data_class == H5T_COMPOUND) {
+        n_members = H5Tget_nmembers(type_id);
+        if (n_members < 0) {
+            fprintf(stderr, "ERROR: H5Tget_nmembers()\n");
+            return -1;
+        }
+
+        for (j = 0; j < count; ++j) {
+            prefix = name;
+            if (count > 1)
+                prefix += "[" + QByteArray::number((qulonglong) j) + "]";
+
+            for (i = 0; i < n_members; ++i) {
+                member_name = H5Tget_member_name(type_id, i);
+                if (member_name == NULL) {
+                    fprintf(stderr, "ERROR: H5Tget_member_name()\n");
+                    return -1;
+                }
+
+                if (prefix.isEmpty())
+                    full_name = member_name;
+                else
+                    full_name = prefix + "." + member_name;
+
+                H5free_memory(member_name);
+
+                member_type_id = H5Tget_member_type(type_id, i);
+                if (member_type_id < 0) {
+                    fprintf(stderr, "ERROR: H5Tget_member_type()\n");
+                    return -1;
+                }
+
+                if (addMembers(member_type_id, full_name,
+                               offset + j * size + H5Tget_member_offset(type_id, i), 1) < 0) {
+                    H5Tclose(member_type_id);
+                    return -1;
+                }
+
+                if (H5Tclose(member_type_id) < 0) {
+                    fprintf(stderr, "ERROR: H5Tclose()\n");
+                    return -1;
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    if (data_class == H5T_ARRAY) {
+        n_dims = H5Tget_array_ndims(type_id);
+        if (n_dims < 0 || H5Tget_array_dims2(type_id, dims) < 0) {
+            fprintf(stderr, "ERROR: H5Tget_array_dims2()\n");
+            return -1;
+        }
+
+        for (i = 0; i < n_dims; ++i)
+            count *= dims[i];
+
+        base_id = H5Tget_super(type_id);
+        if (base_id < 0) {
+            fprintf(stderr, "ERROR: H5Tget_super()\n");
+            return -1;
+        }
+
+        if (addMembers(base_id, name, offset, count) < 0) {
+            H5Tclose(base_id);
+            return -1;
+        }
+
+        if (H5Tclose(base_id) < 0) {
+            fprintf(stderr, "ERROR: H5Tclose()\n");
+            return -1;
+        }
+
+        return 0;
+    }
+
+    member.name       = name;
+    member.kind       = Bytes;
+    member.offset     = offset;
+    member.size       = size;
+    member.count      = count;
+    member.type       = XDFKernel::Unknown;
+    member.swap       = false;
+    member.first_name = 0;
+    member.n_names    = 0;
+
+    switch(data_class) {
+        case H5T_INTEGER:
+        case H5T_FLOAT:
+            member.type = XDFKernel::hdf5Type(type_id);
+            if (member.type != XDFKernel::Unknown) {
+                member.kind = Number;
+                member.swap = size > 1 && H5Tget_order(type_id) != native_order;
+            }
+            break;
+        case H5T_STRING:
+            if (H5Tis_variable_str(type_id) > 0) {
+                member.kind = VarString;
+                member.size = sizeof(char *);
+            }
+            else
+                member.kind = String;
+            break;
+        case H5T_ENUM:
+        case H5T_VLEN:
+            base_id = H5Tget_super(type_id);
+            if (base_id < 0) {
+                fprintf(stderr, "ERROR: H5Tget_super()\n");
+                return -1;
+            }
+
+            member.type = XDFKernel::hdf5Type(base_id);
+            if (member.type != XDFKernel::Unknown)
+                member.swap = XDFKernel::typeSize(member.type) > 1 &&
+                              H5Tget_order(base_id) != native_order;
+
+            if (H5Tclose(base_id) < 0) {
+                fprintf(stderr, "ERROR: H5Tclose()\n");
+                return -1;
+            }
+
+            if (data_class == H5T_VLEN) {
+                member.kind = VLen;
+                member.size = sizeof(hvl_t);
+            }
+            else if (member.type != XDFKernel::Unknown) {
+                member.kind = Enum;
+                if (addEnum(type_id, &member) < 0)
+                    return -1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (member.swap)
+        needs_swap = true;
+
+    members.append(member);
+
+    return 0;
+}
+
+
+
+/*
+ * Reads the names and values of an enum so that values can be named without
+ * the library.
+ */
+int XDFMemberPlan::addEnum(hid_t type_id, Member *member)
+{
+    char *name;
+
+    unsigned char value[8];
+
+    int i;
+    int n;
+
+    long long v;
+
+    n = H5Tget_nmembers(type_id);
+    if (n < 0) {
+        fprintf(stderr, "ERROR: H5Tget_nmembers()\n");
+        return -1;
+    }
+
+    member->first_name = enum_values.size();
+    member->n_names    = 0;
+
+    for (i = 0; i < n; ++i) {
+        if (H5Tget_member_value(type_id, i, value) < 0) {
+            fprintf(stderr, "ERROR: H5Tget_member_value()\n");
+            return -1;
+        }
+
+        if (member->swap)
+            swapValues(value, member->size, 1);
+
+        if (! integerValue(member->type, value, &v))
+            continue;
+
+        name = H5Tget_member_name(type_id, i);
+        if (name == NULL) {
+            fprintf(stderr, "ERROR: H5Tget_member_name()\n");
+            return -1;
+        }
+
+        enum_values.append(v);
+        enum_names.append(name);
+
+        H5free_memory(name);
+
+        member->n_names++;
+    }
+
+    return 0;
+}
+
+
+
+bool XDFMemberPlan::integerValue(XDFKernel::Type type, const void *ptr, long long *value)
+{
+    signed char i8;
+    unsigned char u8;
+    short i16;
+    unsigned short u16;
+    int i32;
+    unsigned int u32;
+    long long i64;
+
+    switch(type) {
+        case XDFKernel::Int8:
+            memcpy(&i8, ptr, sizeof(i8));
+            *value = i8;
+            return true;
+        case XDFKernel::UInt8:
+            memcpy(&u8, ptr, sizeof(u8));
+            *value = u8;
+            return true;
+        case XDFKernel::Int16:
+            memcpy(&i16, ptr, sizeof(i16));
+            *value = i16;
+            return true;
+        case XDFKernel::UInt16:
+            memcpy(&u16, ptr, sizeof(u16));
+            *value = u16;
+            return true;
+        case XDFKernel::Int32:
+            memcpy(&i32, ptr, sizeof(i32));
+            *value = i32;
+            return true;
+        case XDFKernel::UInt32:
+            memcpy(&u32, ptr, sizeof(u32));
+            *value = u32;
+            return true;
+        case XDFKernel::Int64:
+        case XDFKernel::UInt64:
+            memcpy(&i64, ptr, sizeof(i64));
+            *value = i64;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+
+void XDFMemberPlan::swapValues(void *data, size_t size, size_t count)
+{
+    size_t i;
+    size_t j;
+
+    unsigned char t;
+    unsigned char *p;
+
+    p = (unsigned char *) data;
+
+    for (i = 0; i < count; ++i) {
+        for (j = 0; j < size / 2; ++j) {
+            t              = p[j];
+            p[j]           = p[size - 1 - j];
+            p[size - 1 - j] = t;
+        }
+        p += size;
+    }
+}
+
+
+
+bool XDFMemberPlan::isCompound() const
+{
+    return is_compound;
+}
+
+
+
+int XDFMemberPlan::count() const
+{
+    return members.size();
+}
+
+
+
+const XDFMemberPlan::Member &XDFMemberPlan::member(int i) const
+{
+    return members[i];
+}
+
+
+
+/*
+ * The bytes of a member in an element, all the values of an array.
+ */
+size_t XDFMemberPlan::memberSize(int i) const
+{
+    return members[i].size * members[i].count;
+}
+
+
+
+size_t XDFMemberPlan::maxMemberSize() const
+{
+    int i;
+
+    size_t size = 0;
+
+    for (i = 0; i < members.size(); ++i)
+        size = MAX(size, memberSize(i));
+
+    return size;
+}
+
+
+
+/*
+ * Puts the members of n elements at data that are not in the native byte
+ * order, including the values of variable length sequences, into it.
+ */
+void XDFMemberPlan::toNativeOrder(void *data, size_t n) const
+{
+    int j;
+
+    size_t i;
+    size_t k;
+
+    char *element;
+
+    hvl_t vl;
+
+    if (! needs_swap)
+        return;
+
+    for (i = 0; i < n; ++i) {
+        element = (char *) data + i * element_size;
+
+        for (j = 0; j < members.size(); ++j) {
+            const Member &m = members[j];
+
+            if (! m.swap)
+                continue;
+
+            if (m.kind == VLen) {
+                for (k = 0; k < m.count; ++k) {
+                    memcpy(&vl, element + m.offset + k * m.size, sizeof(hvl_t));
+                    if (vl.p != NULL)
+                        swapValues(vl.p, XDFKernel::typeSize(m.type), vl.len);
+                }
+            }
+            else
+                swapValues(element + m.offset, m.size, m.count);
+        }
+    }
+}
+
+
+
+/*
+ * Copies member i of the element at element to value, memberSize(i) bytes.
+ */
+void XDFMemberPlan::copyMember(int i, const void *element, void *value) const
+{
+    memcpy(value, (const char *) element + members[i].offset, memberSize(i));
+}
+
+
+
+/*
+ * Formats count values of member at ptr, in brackets if there is more than
+ * one.
+ */
+int XDFMemberPlan::formatValues(const Member &member, const void *ptr, size_t count,
+                                char *string, int length,
+                                const XDFNumberFormat &number_format) const
+{
+    char temp[LN];
+
+    const char *p;
+    const char *s;
+
+    int i;
+    int m;
+    int n;
+
+    size_t j;
+
+    long long v;
+
+    hvl_t vl;
+
+    n = 0;
+    string[0] = '\0';
+
+    if (count > 1) {
+        if (! append(string, length, &n, "[", 1))
+            return n;
+
+        if (member.kind == Number) {
+            m = XDFKernel::formatArray(member.type, ptr, count, string + n, length - n,
+                                       number_format);
+            if (m < 0)
+                return -1;
+            n += m;
+            append(string, length, &n, "]", 1);
+            return n;
+        }
+    }
+
+    for (j = 0; j < count; ++j) {
+        if (j > 0 && ! append(string, length, &n, ", ", 2))
+            return n;
+
+        p = (const char *) ptr + j * member.size;
+
+        switch(member.kind) {
+            case Number:
+                m = XDFKernel::format(member.type, p, temp, LN, number_format);
+                break;
+            case Enum:
+                m = -1;
+                if (integerValue(member.type, p, &v)) {
+                    for (i = 0; i < member.n_names; ++i) {
+                        if (enum_values[member.first_name + i] == v) {
+                            m = snprintf(temp, LN, "%s",
+                                         enum_names[member.first_name + i].constData());
+                            break;
+                        }
+                    }
+                }
+                if (m < 0)
+                    m = XDFKernel::format(member.type, p, temp, LN, number_format);
+                break;
+            case String:
+                m = 0;
+                temp[m++] = '\'';
+                for (i = 0; i < (int) member.size && i < LN - 3 && p[i] != '\0'; ++i)
+                    temp[m++] = p[i];
+                temp[m++] = '\'';
+                temp[m]   = '\0';
+                break;
+            case VarString:
+                memcpy(&s, p, sizeof(char *));
+                m = snprintf(temp, LN, "'%s'", s == NULL ? "" : s);
+                break;
+            case VLen:
+                memcpy(&vl, p, sizeof(hvl_t));
+                if (member.type == XDFKernel::Unknown)
+                    m = snprintf(temp, LN, "[%lu values]", (unsigned long) vl.len);
+                else {
+                    temp[0] = '[';
+                    m = XDFKernel::formatArray(member.type, vl.p, vl.len, temp + 1, LN - 2,
+                                               number_format);
+                    if (m >= 0) {
+                        m++;
+                        temp[m++] = ']';
+                        temp[m]   = '\0';
+                    }
+                }
+                break;
+            default:
+                m = 2;
+                temp[0] = '0';
+                temp[1] = 'x';
+                for (i = 0; i < (int) member.size && i < max_bytes; ++i)
+                    m += snprintf(temp + m, LN - m, "%02x", (unsigned char) p[i]);
+                if (i < (int) member.size)
+                    m += snprintf(temp + m, LN - m, "...");
+                break;
+        }
+
+        if (m < 0)
+            return -1;
+
+        if (! append(string, length, &n, temp, MIN(m, LN - 1)))
+            return n;
+    }
+
+    if (count > 1)
+        append(string, length, &n, "]", 1);
+
+    return n;
+}
+
+
+
+/*
+ * Formats member i at value, as copied by copyMember() or in an element at
+ * the member's offset.  Returns the length of the string or -1 on error.
+ */
+int XDFMemberPlan::formatMember(int i, const void *value, char *string, int length,
+                                const XDFNumberFormat &number_format) const
+{
+    return formatValues(members[i], value, members[i].count, string, length, number_format);
+}
+
+
+
+/*
+ * Formats all the members of the element at element, in braces for a
+ * compound.
+ */
+int XDFMemberPlan::formatElement(const void *element, char *string, int length,
+                                 const XDFNumberFormat &number_format) const
+{
+    char temp[LN];
+
+    int i;
+    int m;
+    int n;
+
+    if (! is_compound && members.size() == 1)
+        return formatMember(0, element, string, length, number_format);
+
+    n = 0;
+    string[0] = '\0';
+
+    if (! append(string, length, &n, "{", 1))
+        return n;
+
+    for (i = 0; i < members.size(); ++i) {
+        if (i > 0 && ! append(string, length, &n, ", ", 2))
+            return n;
+
+        m = formatMember(i, (const char *) element + members[i].offset, temp, LN,
+                         number_format);
+        if (m < 0)
+            return -1;
+
+        if (! append(string, length, &n, temp, m))
+            return n;
+    }
+
+    append(string, length, &n, "}", 1);
+
+    return n;
+}
+
+
+
+/*
+ * Formats n elements at data separated by ", ", as many as fit whole, as
+ * XDFKernel::formatArray() does, except that the first element is truncated
+ * rather than left out.
+ */
+int XDFMemberPlan::formatArray(const void *data, size_t n, char *string, int length,
+                               const XDFNumberFormat &number_format) const
+{
+    char temp[LN];
+
+    int m;
+    int n_sep;
+    int n_string;
+
+    size_t i;
+
+    n_string = 0;
+    string[0] = '\0';
+
+    for (i = 0; i < n; ++i) {
+        m = formatElement((const char *) data + i * element_size, temp, LN, number_format);
+        if (m < 0)
+            return -1;
+
+        n_sep = i == 0 ? 0 : 2;
+        if (i > 0 && n_string + n_sep + m >= length)
+            break;
+
+        append(string, length, &n_string, ", ", n_sep);
+        append(string, length, &n_string, temp, m);
+    }
+
+    return n_string;
+}
+
+
+
+/*
+ * Formats n values of an attribute or dataset read in datatype_id, after
+ * putting them into the native byte order, with the XDFKernel for their type,
+ * looked up once, or for the classes that are not one of its types, such as
+ * compounds, enums, and variable length types, with a plan of the datatype.
+ * hdf5_array_to_string() is left for datatypes the plan fails on.
+ */
+int XDFMemberPlan::arrayToString(hid_t datatype_id, void *data, size_t n, char *string,
+                                 int length)
+{
+    XDFKernel::Type type;
+
+    XDFMemberPlan plan;
+
+    if (plan.init(datatype_id) < 0)
+        return hdf5_array_to_string(datatype_id, data, n, string, length);
+
+    plan.toNativeOrder(data, n);
+
+    type = XDFKernel::hdf5Type(datatype_id);
+    if (type != XDFKernel::Unknown)
+        return XDFKernel::formatArray(type, data, n, string, length);
+
+    return plan.formatArray(data, n, string, length);
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFMEMBERPLAN_H
+#define XDFMEMBERPLAN_H
+
+#include <hdf5.h>
+
+#include <qbytearray.h>
+#include <qlist.h>
+#include <qvector.h>
+
+#include "xdfkernel.h"
+#include "xdfnumberformat.h"
+
+
+/*
+ * An HDF5 datatype analyzed once into a flat list of members, so that values
+ * read in the datatype can be formatted from the raw bytes without calling
+ * the library again.  Compound types are flattened, members of nested
+ * compounds being named "outer.inner" and the elements of arrays of compounds
+ * "name[i]".  Each member is a number, an enum, a fixed or variable length
+ * string, a variable length sequence, or, for bitfields, opaque types,
+ * references, and numbers that are not an XDFKernel::Type, raw bytes shown in
+ * hexadecimal.  An array of anything other than compounds is a single member
+ * of count values.  Members that are not in the native byte order are
+ * swapped in place by toNativeOrder() after a read.  A datatype that is not a
+ * compound is a single member named after nothing at offset zero.
+ */
+class XDFMemberPlan
+{
+public:
+    enum Kind {
+        Number,
+        Enum,
+        String,
+        VarString,
+        VLen,
+        Bytes
+    };
+
+    struct Member {
+        QByteArray name;
+        Kind kind;
+        size_t offset;
+        size_t size;
+        size_t count;
+        XDFKernel::Type type;
+        bool swap;
+        int first_name;
+        int n_names;
+    };
+
+private:
+    static const int max_members = 1024;
+    static const int max_bytes   = 32;
+
+    bool is_compound;
+    bool needs_swap;
+    size_t element_size;
+
+    QVector<Member> members;
+
+    QVector<long long> enum_values;
+    QList<QByteArray> enum_names;
+
+    int addMembers(hid_t type_id, const QByteArray &name, size_t offset, size_t count);
+    int addEnum(hid_t type_id, Member *member);
+
+    static bool integerValue(XDFKernel::Type type, const void *ptr, long long *value);
+    static void swapValues(void *data, size_t size, size_t count);
+
+    int formatValues(const Member &member, const void *ptr, size_t count,
+                     char *string, int length,
+                     const XDFNumberFormat &number_format) const;
+
+public:
+    XDFMemberPlan();
+
+    int init(hid_t datatype_id);
+    void clear();
+
+    bool isCompound() const;
+    int count() const;
+    const Member &member(int i) const;
+    size_t memberSize(int i) const;
+    size_t maxMemberSize() const;
+
+    void toNativeOrder(void *data, size_t n) const;
+    void copyMember(int i, const void *element, void *value) const;
+
+    int formatMember(int i, const void *value, char *string, int length,
+                     const XDFNumberFormat &number_format = XDFNumberFormat()) const;
+    int formatElement(const void *element, char *string, int length,
+                      const XDFNumberFormat &number_format = XDFNumberFormat()) const;
+    int formatArray(const void *data, size_t n, char *string, int length,
+                    const XDFNumberFormat &number_format = XDFNumberFormat()) const;
+
+    static int arrayToString(hid_t datatype_id, void *data, size_t n, char *string,
+                             int length);
+};
+
+#endif /* XDFMEMBERPLAN_H */
@@ -0,0 +1,673 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xdfv.h"
+#include "xdfnumberformat.h"
+
+
+/*
+ * A floating point number f * 2^e with a 64 bit significand, for Grisu2.
+ */
+struct XDFDiyFp {
+    unsigned long long f;
+    int e;
+};
+
+
+/*
+ * Normalized 10^k for k = -348, -340, ..., 340.
+ */
+static const XDFDiyFp cached_powers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, {0xbaaee17fa23ebf76ULL, -1193},
+    {0x8b16fb203055ac76ULL, -1166}, {0xcf42894a5dce35eaULL, -1140},
+    {0x9a6bb0aa55653b2dULL, -1113}, {0xe61acf033d1a45dfULL, -1087},
+    {0xab70fe17c79ac6caULL, -1060}, {0xff77b1fcbebcdc4fULL, -1034},
+    {0xbe5691ef416bd60cULL, -1007}, {0x8dd01fad907ffc3cULL,  -980},
+    {0xd3515c2831559a83ULL,  -954}, {0x9d71ac8fada6c9b5ULL,  -927},
+    {0xea9c227723ee8bcbULL,  -901}, {0xaecc49914078536dULL,  -874},
+    {0x823c12795db6ce57ULL,  -847}, {0xc21094364dfb5637ULL,  -821},
+    {0x9096ea6f3848984fULL,  -794}, {0xd77485cb25823ac7ULL,  -768},
+    {0xa086cfcd97bf97f4ULL,  -741}, {0xef340a98172aace5ULL,  -715},
+    {0xb23867fb2a35b28eULL,  -688}, {0x84c8d4dfd2c63f3bULL,  -661},
+    {0xc5dd44271ad3cdbaULL,  -635}, {0x936b9fcebb25c996ULL,  -608},
+    {0xdbac6c247d62a584ULL,  -582}, {0xa3ab66580d5fdaf6ULL,  -555},
+    {0xf3e2f893dec3f126ULL,  -529}, {0xb5b5ada8aaff80b8ULL,  -502},
+    {0x87625f056c7c4a8bULL,  -475}, {0xc9bcff6034c13053ULL,  -449},
+    {0x964e858c91ba2655ULL,  -422}, {0xdff9772470297ebdULL,  -396},
+    {0xa6dfbd9fb8e5b88fULL,  -369}, {0xf8a95fcf88747d94ULL,  -343},
+    {0xb94470938fa89bcfULL,  -316}, {0x8a08f0f8bf0f156bULL,  -289},
+    {0xcdb02555653131b6ULL,  -263}, {0x993fe2c6d07b7facULL,  -236},
+    {0xe45c10c42a2b3b06ULL,  -210}, {0xaa242499697392d3ULL,  -183},
+    {0xfd87b5f28300ca0eULL,  -157}, {0xbce5086492111aebULL,  -130},
+    {0x8cbccc096f5088ccULL,  -103}, {0xd1b71758e219652cULL,   -77},
+    {0x9c40000000000000ULL,   -50}, {0xe8d4a51000000000ULL,   -24},
+    {0xad78ebc5ac620000ULL,     3}, {0x813f3978f8940984ULL,    30},
+    {0xc097ce7bc90715b3ULL,    56}, {0x8f7e32ce7bea5c70ULL,    83},
+    {0xd5d238a4abe98068ULL,   109}, {0x9f4f2726179a2245ULL,   136},
+    {0xed63a231d4c4fb27ULL,   162}, {0xb0de65388cc8ada8ULL,   189},
+    {0x83c7088e1aab65dbULL,   216}, {0xc45d1df942711d9aULL,   242},
+    {0x924d692ca61be758ULL,   269}, {0xda01ee641a708deaULL,   295},
+    {0xa26da3999aef774aULL,   322}, {0xf209787bb47d6b85ULL,   348},
+    {0xb454e4a179dd1877ULL,   375}, {0x865b86925b9bc5c2ULL,   402},
+    {0xc83553c5c8965d3dULL,   428}, {0x952ab45cfa97a0b3ULL,   455},
+    {0xde469fbd99a05fe3ULL,   481}, {0xa59bc234db398c25ULL,   508},
+    {0xf6c69a72a3989f5cULL,   534}, {0xb7dcbf5354e9beceULL,   561},
+    {0x88fcf317f22241e2ULL,   588}, {0xcc20ce9bd35c78a5ULL,   614},
+    {0x98165af37b2153dfULL,   641}, {0xe2a0b5dc971f303aULL,   667},
+    {0xa8d9d1535ce3b396ULL,   694}, {0xfb9b7cd9a4a7443cULL,   720},
+    {0xbb764c4ca7a44410ULL,   747}, {0x8bab8eefb6409c1aULL,   774},
+    {0xd01fef10a657842cULL,   800}, {0x9b10a4e5e9913129ULL,   827},
+    {0xe7109bfba19c0c9dULL,   853}, {0xac2820d9623bf429ULL,   880},
+    {0x80444b5e7aa7cf85ULL,   907}, {0xbf21e44003acdd2dULL,   933},
+    {0x8e679c2f5e44ff8fULL,   960}, {0xd433179d9c8cb841ULL,   986},
+    {0x9e19db92b4e31ba9ULL,  1013}, {0xeb96bf6ebadf77d9ULL,  1039},
+    {0xaf87023b9bf0ee6bULL,  1066},
+};
+
+static const unsigned int powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+
+
+/*
+ * Copies the n characters of temp to string as snprintf() would.
+ */
+static int copy_out(const char *temp, int n, char *string, int length)
+{
+    int m;
+
+    if (length <= 0)
+        return n;
+
+    m = MIN(n, length - 1);
+
+    memcpy(string, temp, m);
+    string[m] = '\0';
+
+    return n;
+}
+
+
+
+static int format_unsigned(unsigned long long value, bool negative, char *string,
+                           int length)
+{
+    char temp[24];
+
+    int n;
+
+    n = sizeof(temp);
+
+    do {
+        temp[--n] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    if (negative)
+        temp[--n] = '-';
+
+    return copy_out(temp + n, sizeof(temp) - n, string, length);
+}
+
+
+
+static int format_signed(long long value, char *string, int length)
+{
+    if (value < 0)
+        return format_unsigned(0ULL - (unsigned long long) value, true, string, length);
+
+    return format_unsigned(value, false, string, length);
+}
+
+
+
+/*
+ * Formats the size bytes of value as hexadecimal digits, all of them.
+ */
+static int format_hex(unsigned long long value, int size, char *string, int length)
+{
+    char temp[24];
+
+    int i;
+    int n;
+
+    n = 2 + 2 * size;
+
+    temp[0] = '0';
+    temp[1] = 'x';
+    for (i = n - 1; i >= 2; --i) {
+        temp[i] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    }
+
+    return copy_out(temp, n, string, length);
+}
+
+
+
+/*
+ * Formats value with printf() and then puts back a decimal point of the locale
+ * that is not '.'.
+ */
+static int format_printf(const char *format, int precision, double value, char *string,
+                         int length)
+{
+    char temp[LN];
+
+    char *p;
+
+    int n;
+
+    const char *point;
+
+    n = snprintf(temp, LN, format, precision, value);
+    if (n < 0)
+        return -1;
+    n = MIN(n, LN - 1);
+
+    point = localeconv()->decimal_point;
+    if (point[0] != '.' && point[0] != '\0' && point[1] == '\0') {
+        p = strchr(temp, point[0]);
+        if (p != NULL)
+            *p = '.';
+    }
+
+    return copy_out(temp, n, string, length);
+}
+
+
+
+static XDFDiyFp diy_normalize(XDFDiyFp x)
+{
+    while (! (x.f & 0xff00000000000000ULL)) {
+        x.f <<= 8;
+        x.e  -= 8;
+    }
+
+    while (! (x.f & 0x8000000000000000ULL)) {
+        x.f <<= 1;
+        x.e  -= 1;
+    }
+
+    return x;
+}
+
+
+
+/*
+ * The product rounded to 64 bits.
+ */
+static XDFDiyFp diy_multiply(XDFDiyFp x, XDFDiyFp y)
+{
+    unsigned long long a;
+    unsigned long long b;
+    unsigned long long c;
+    unsigned long long d;
+    unsigned long long t;
+
+    XDFDiyFp r;
+
+    a = x.f >> 32;
+    b = x.f & 0xffffffffULL;
+    c = y.f >> 32;
+    d = y.f & 0xffffffffULL;
+
+    t = ((b * d) >> 32) + ((a * d) & 0xffffffffULL) + ((b * c) & 0xffffffffULL) +
+        (1ULL << 31);
+
+    r.f = a * c + ((a * d) >> 32) + ((b * c) >> 32) + (t >> 32);
+    r.e = x.e + y.e + 64;
+
+    return r;
+}
+
+
+
+/*
+ * The cached power 10^-K that brings a number with binary exponent e into the
+ * range -60 to -32 of the binary exponent.
+ */
+static XDFDiyFp cached_power(int e, int *K)
+{
+    int i;
+    int k;
+
+    double dk;
+
+    dk = (-61 - e) * 0.30102999566398114 + 347;
+    k  = (int) dk;
+    if (dk - k > 0.)
+        k++;
+
+    i = (k >> 3) + 1;
+
+    *K = -(-348 + i * 8);
+
+    return cached_powers[i];
+}
+
+
+
+/*
+ * Moves the last digit down while that leaves it closer to the number and
+ * still inside the boundaries.
+ */
+static void grisu_round(char *digits, int n, unsigned long long delta,
+                        unsigned long long rest, unsigned long long ten_kappa,
+                        unsigned long long wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        digits[n - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+
+
+/*
+ * Generates the shortest digits of the upper boundary Mp that stay within
+ * delta of it, rounded toward W.
+ */
+static void digit_gen(XDFDiyFp W, XDFDiyFp Mp, unsigned long long delta, char *digits,
+                      int *n, int *K)
+{
+    unsigned int d;
+    unsigned int p1;
+
+    int kappa;
+    int shift;
+
+    unsigned long long one;
+    unsigned long long p2;
+    unsigned long long wp_w;
+    unsigned long long t;
+
+    shift = -Mp.e;
+    one   = 1ULL << shift;
+    wp_w  = Mp.f - W.f;
+    p1    = (unsigned int) (Mp.f >> shift);
+    p2    = Mp.f & (one - 1);
+
+    kappa = 1;
+    while (kappa < 10 && p1 >= powers_of_ten[kappa])
+        kappa++;
+
+    *n = 0;
+
+    while (kappa > 0) {
+        d   = p1 / powers_of_ten[kappa - 1];
+        p1 %= powers_of_ten[kappa - 1];
+        if (d != 0 || *n != 0)
+            digits[(*n)++] = '0' + d;
+        kappa--;
+        t = ((unsigned long long) p1 << shift) + p2;
+        if (t <= delta) {
+            *K += kappa;
+            grisu_round(digits, *n, delta, t,
+                        (unsigned long long) powers_of_ten[kappa] << shift, wp_w);
+            return;
+        }
+    }
+
+    while (1) {
+        p2    *= 10;
+        delta *= 10;
+        d = (unsigned int) (p2 >> shift);
+        if (d != 0 || *n != 0)
+            digits[(*n)++] = '0' + d;
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            grisu_round(digits, *n, delta, p2, one,
+                        -kappa < 10 ? wp_w * powers_of_ten[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+
+
+/*
+ * Digits of f * 2^e that round-trip, shortest in almost all cases, that is the
+ * value is digits * 10^K, given whether the next lower number is closer than
+ * the next higher one, which is so at a power of two.
+ */
+static void grisu2(unsigned long long f, int e, bool lower_closer, char *digits,
+                   int *n, int *K)
+{
+    XDFDiyFp v;
+    XDFDiyFp w_m;
+    XDFDiyFp w_p;
+    XDFDiyFp c_mk;
+    XDFDiyFp W;
+    XDFDiyFp Wm;
+    XDFDiyFp Wp;
+
+    v.f = f;
+    v.e = e;
+
+    w_p.f = (f << 1) + 1;
+    w_p.e = e - 1;
+    w_p   = diy_normalize(w_p);
+
+    if (lower_closer) {
+        w_m.f = (f << 2) - 1;
+        w_m.e = e - 2;
+    }
+    else {
+        w_m.f = (f << 1) - 1;
+        w_m.e = e - 1;
+    }
+    w_m.f <<= w_m.e - w_p.e;
+    w_m.e   = w_p.e;
+
+    c_mk = cached_power(w_p.e, K);
+
+    W  = diy_multiply(diy_normalize(v), c_mk);
+    Wp = diy_multiply(w_p, c_mk);
+    Wm = diy_multiply(w_m, c_mk);
+
+    Wm.f++;
+    Wp.f--;
+
+    digit_gen(W, Wp, Wp.f - Wm.f, digits, n, K);
+}
+
+
+
+/*
+ * Lays out the n digits of digits * 10^K, in positional notation when the
+ * decimal point falls near the digits and otherwise in exponential notation
+ * as "%e" would, with the exponent at least two digits.
+ */
+static int format_digits(bool negative, const char *digits, int n, int K, char *string,
+                         int length)
+{
+    char temp[48];
+
+    int i;
+    int m;
+    int exponent;
+    int point;
+
+    m = 0;
+
+    if (negative)
+        temp[m++] = '-';
+
+    point = n + K;
+
+    if (point >= n && point <= 15) {
+        memcpy(temp + m, digits, n);
+        m += n;
+        for (i = n; i < point; ++i)
+            temp[m++] = '0';
+    }
+    else if (point > 0 && point <= 15) {
+        memcpy(temp + m, digits, point);
+        m += point;
+        temp[m++] = '.';
+        memcpy(temp + m, digits + point, n - point);
+        m += n - point;
+    }
+    else if (point > -5 && point <= 0) {
+        temp[m++] = '0';
+        temp[m++] = '.';
+        for (i = point; i < 0; ++i)
+            temp[m++] = '0';
+        memcpy(temp + m, digits, n);
+        m += n;
+    }
+    else {
+        temp[m++] = digits[0];
+        if (n > 1) {
+            temp[m++] = '.';
+            memcpy(temp + m, digits + 1, n - 1);
+            m += n - 1;
+        }
+        exponent = point - 1;
+        temp[m++] = 'e';
+        if (exponent < 0) {
+            temp[m++] = '-';
+            exponent = -exponent;
+        }
+        else
+            temp[m++] = '+';
+        if (exponent >= 100)
+            temp[m++] = '0' + exponent / 100;
+        temp[m++] = '0' + exponent / 10 % 10;
+        temp[m++] = '0' + exponent % 10;
+    }
+
+    return copy_out(temp, m, string, length);
+}
+
+
+
+static int format_special(bool negative, bool is_nan, char *string, int length)
+{
+    if (is_nan)
+        return copy_out("nan", 3, string, length);
+    else if (negative)
+        return copy_out("-inf", 4, string, length);
+    else
+        return copy_out("inf", 3, string, length);
+}
+
+
+
+XDFNumberFormat::XDFNumberFormat(Notation notation, int precision)
+    : notation(notation), precision(precision)
+{
+
+}
+
+
+
+int XDFNumberFormat::format(signed char value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex((unsigned char) value, sizeof(value), string, length);
+
+    return format_signed(value, string, length);
+}
+
+
+
+int XDFNumberFormat::format(unsigned char value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex(value, sizeof(value), string, length);
+
+    return format_unsigned(value, false, string, length);
+}
+
+
+
+int XDFNumberFormat::format(short value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex((unsigned short) value, sizeof(value), string, length);
+
+    return format_signed(value, string, length);
+}
+
+
+
+int XDFNumberFormat::format(unsigned short value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex(value, sizeof(value), string, length);
+
+    return format_unsigned(value, false, string, length);
+}
+
+
+
+int XDFNumberFormat::format(int value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex((unsigned int) value, sizeof(value), string, length);
+
+    return format_signed(value, string, length);
+}
+
+
+
+int XDFNumberFormat::format(unsigned int value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex(value, sizeof(value), string, length);
+
+    return format_unsigned(value, false, string, length);
+}
+
+
+
+int XDFNumberFormat::format(long long value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex((unsigned long long) value, sizeof(value), string, length);
+
+    return format_signed(value, string, length);
+}
+
+
+
+int XDFNumberFormat::format(unsigned long long value, char *string, int length) const
+{
+    if (notation == Hex)
+        return format_hex(value, sizeof(value), string, length);
+
+    return format_unsigned(value, false, string, length);
+}
+
+
+
+int XDFNumberFormat::format(float value, char *string, int length) const
+{
+    switch(notation) {
+        case Fixed:
+            return format_printf("%.*f", precision, value, string, length);
+        case Scientific:
+            return format_printf("%.*e", precision, value, string, length);
+        default:
+            return shortest(value, string, length);
+    }
+}
+
+
+
+int XDFNumberFormat::format(double value, char *string, int length) const
+{
+    switch(notation) {
+        case Fixed:
+            return format_printf("%.*f", precision, value, string, length);
+        case Scientific:
+            return format_printf("%.*e", precision, value, string, length);
+        default:
+            return shortest(value, string, length);
+    }
+}
+
+
+
+int XDFNumberFormat::format(char value, char *string, int length) const
+{
+    return copy_out(&value, 1, string, length);
+}
+
+
+
+int XDFNumberFormat::format(const char *value, char *string, int length) const
+{
+    if (value == NULL)
+        return copy_out("", 0, string, length);
+
+    return copy_out(value, strlen(value), string, length);
+}
+
+
+
+int XDFNumberFormat::shortest(float value, char *string, int length)
+{
+    char digits[24];
+
+    int n;
+    int K;
+    int biased_e;
+
+    unsigned int bits;
+    unsigned int significand;
+
+    bool negative;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    negative    = (bits >> 31) != 0;
+    biased_e    = (bits >> 23) & 0xff;
+    significand = bits & 0x7fffff;
+
+    if (biased_e == 0xff)
+        return format_special(negative, significand != 0, string, length);
+
+    if (biased_e == 0 && significand == 0)
+        return copy_out(negative ? "-0" : "0", negative ? 2 : 1, string, length);
+
+    if (biased_e != 0)
+        grisu2(significand | 0x800000, biased_e - 150, significand == 0 && biased_e > 1,
+               digits, &n, &K);
+    else
+        grisu2(significand, -149, false, digits, &n, &K);
+
+    return format_digits(negative, digits, n, K, string, length);
+}
+
+
+
+int XDFNumberFormat::shortest(double value, char *string, int length)
+{
+    char digits[24];
+
+    int n;
+    int K;
+    int biased_e;
+
+    unsigned long long bits;
+    unsigned long long significand;
+
+    bool negative;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    negative    = (bits >> 63) != 0;
+    biased_e    = (bits >> 52) & 0x7ff;
+    significand = bits & 0xfffffffffffffULL;
+
+    if (biased_e == 0x7ff)
+        return format_special(negative, significand != 0, string, length);
+
+    if (biased_e == 0 && significand == 0)
+        return copy_out(negative ? "-0" : "0", negative ? 2 : 1, string, length);
+
+    if (biased_e != 0)
+        grisu2(significand | 0x10000000000000ULL, biased_e - 1075,
+               significand == 0 && biased_e > 1, digits, &n, &K);
+    else
+        grisu2(significand, -1074, false, digits, &n, &K);
+
+    return format_digits(negative, digits, n, K, string, length);
+}
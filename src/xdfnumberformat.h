@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFNUMBERFORMAT_H
+#define XDFNUMBERFORMAT_H
+
+
+/*
+ * How the values of a view are formatted.  Shortest gives digits that
+ * round-trip to the same float or double, shortest in almost all cases, with
+ * Grisu2 digit generation rather than printf(), and is the default.  Fixed and
+ * Scientific give precision digits after the decimal point as "%.*f" and "%.*e"
+ * do.  Hex gives the bit pattern of integers, with floats formatted as for
+ * Shortest.  Integers are otherwise formatted in decimal without printf().  The
+ * output does not depend on the locale, the decimal point is always '.'.  Like
+ * snprintf(), format() returns the length of the whole formatted value, which
+ * is truncated to length - 1 characters if it is longer.
+ */
+class XDFNumberFormat
+{
+public:
+    enum Notation {
+        Shortest,
+        Fixed,
+        Scientific,
+        Hex
+    };
+
+    static const int max_precision = 17;
+
+    Notation notation;
+    int precision;
+
+    XDFNumberFormat(Notation notation = Shortest, int precision = 6);
+
+    int format(signed char value, char *string, int length) const;
+    int format(unsigned char value, char *string, int length) const;
+    int format(short value, char *string, int length) const;
+    int format(unsigned short value, char *string, int length) const;
+    int format(int value, char *string, int length) const;
+    int format(unsigned int value, char *string, int length) const;
+    int format(long long value, char *string, int length) const;
+    int format(unsigned long long value, char *string, int length) const;
+    int format(float value, char *string, int length) const;
+    int format(double value, char *string, int length) const;
+    int format(char value, char *string, int length) const;
+    int format(const char *value, char *string, int length) const;
+
+    static int shortest(float value, char *string, int length);
+    static int shortest(double value, char *string, int length);
+};
+
+#endif /* XDFNUMBERFORMAT_H */
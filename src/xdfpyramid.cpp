@@ -0,0 +1,463 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qmutex.h>
+
+#include "xdfv.h"
+#include "xdfpyramid.h"
+#include "xdftableview.h"
+
+
+QMutex XDFPyramid::mutex;
+QHash<QByteArray, XDFPyramid::Cached> XDFPyramid::pyramids;
+unsigned long long XDFPyramid::use_count = 0;
+
+
+
+/*
+ * Sets up the first level for a slice of n_rows by n_cols elements with no
+ * values added.
+ */
+void XDFPyramid::init(int n_rows, int n_cols)
+{
+    int factor;
+
+    Level level;
+
+    factor = 2;
+    while ((qint64) ((n_rows + factor - 1) / factor) *
+                    ((n_cols + factor - 1) / factor) > max_base_cells)
+        factor *= 2;
+
+    level.n_rows = (n_rows + factor - 1) / factor;
+    level.n_cols = (n_cols + factor - 1) / factor;
+    level.factor = factor;
+
+    level.min  .fill(NAN, level.n_rows * level.n_cols);
+    level.max  .fill(NAN, level.n_rows * level.n_cols);
+    level.mean .fill(NAN, level.n_rows * level.n_cols);
+    level.count.fill(0,   level.n_rows * level.n_cols);
+
+    levels.clear();
+    levels.append(level);
+}
+
+
+
+/*
+ * Adds the values of the part of the slice at row and col of n_rows by n_cols
+ * elements, row by row.  row and col must be multiples of the factor of the
+ * first level and the part must be made up of whole cells, or end at the end
+ * of the slice, as each cell is computed from the values of one part only.
+ */
+void XDFPyramid::addValues(int row, int col, int n_rows, int n_cols,
+                           const double *values)
+{
+    int i;
+    int j;
+    int k;
+    int l;
+
+    int i1;
+    int i2;
+    int j1;
+    int j2;
+
+    int n;
+
+    double v;
+    double min;
+    double max;
+    double sum;
+
+    Level &level = levels[0];
+
+    for (i = row / level.factor; i * level.factor < row + n_rows; ++i) {
+        i1 = i * level.factor - row;
+        i2 = qMin(i1 + level.factor, n_rows);
+
+        for (j = col / level.factor; j * level.factor < col + n_cols; ++j) {
+            j1 = j * level.factor - col;
+            j2 = qMin(j1 + level.factor, n_cols);
+
+            n   = 0;
+            min = 0.;
+            max = 0.;
+            sum = 0.;
+
+            for (k = i1; k < i2; ++k) {
+                for (l = j1; l < j2; ++l) {
+                    v = values[(size_t) k * n_cols + l];
+                    if (! isfinite(v))
+                        continue;
+                    if (n == 0 || v < min)
+                        min = v;
+                    if (n == 0 || v > max)
+                        max = v;
+                    sum += v;
+                    n++;
+                }
+            }
+
+            k = i * level.n_cols + j;
+
+            level.count[k] = n;
+            if (n > 0) {
+                level.min [k] = min;
+                level.max [k] = max;
+                level.mean[k] = sum / n;
+            }
+        }
+    }
+}
+
+
+
+/*
+ * Computes the levels after the first from the first, each from the cells of
+ * the level before, two by two.
+ */
+void XDFPyramid::finish()
+{
+    int i;
+    int j;
+    int k;
+    int l;
+    int m;
+
+    int n;
+
+    double min;
+    double max;
+    double sum;
+
+    Level level;
+
+    while (levels.last().n_rows > 1 || levels.last().n_cols > 1) {
+        const Level &prev = levels.last();
+
+        level.n_rows = (prev.n_rows + 1) / 2;
+        level.n_cols = (prev.n_cols + 1) / 2;
+        level.factor = prev.factor * 2;
+
+        level.min  .fill(NAN, level.n_rows * level.n_cols);
+        level.max  .fill(NAN, level.n_rows * level.n_cols);
+        level.mean .fill(NAN, level.n_rows * level.n_cols);
+        level.count.fill(0,   level.n_rows * level.n_cols);
+
+        for (i = 0; i < level.n_rows; ++i) {
+            for (j = 0; j < level.n_cols; ++j) {
+                n   = 0;
+                min = 0.;
+                max = 0.;
+                sum = 0.;
+
+                for (k = 2 * i; k < 2 * i + 2 && k < prev.n_rows; ++k) {
+                    for (l = 2 * j; l < 2 * j + 2 && l < prev.n_cols; ++l) {
+                        m = k * prev.n_cols + l;
+                        if (prev.count[m] == 0)
+                            continue;
+                        if (n == 0 || prev.min[m] < min)
+                            min = prev.min[m];
+                        if (n == 0 || prev.max[m] > max)
+                            max = prev.max[m];
+                        sum += (double) prev.mean[m] * prev.count[m];
+                        n   += prev.count[m];
+                    }
+                }
+
+                m = i * level.n_cols + j;
+
+                level.count[m] = n;
+                if (n > 0) {
+                    level.min [m] = min;
+                    level.max [m] = max;
+                    level.mean[m] = sum / n;
+                }
+            }
+        }
+
+        levels.append(level);
+    }
+}
+
+
+
+int XDFPyramid::levelCount() const
+{
+    return levels.size();
+}
+
+
+
+const XDFPyramid::Level &XDFPyramid::level(int i) const
+{
+    return levels[i];
+}
+
+
+
+bool XDFPyramid::find(const QByteArray &key, XDFPyramid *pyramid)
+{
+    QHash<QByteArray, Cached>::iterator i;
+
+    QMutexLocker locker(&mutex);
+
+    i = pyramids.find(key);
+    if (i == pyramids.end())
+        return false;
+
+    i.value().last_used = ++use_count;
+
+    pyramid->levels = i.value().levels;
+
+    return true;
+}
+
+
+
+/*
+ * The least recently used pyramid is evicted past max_pyramids.
+ */
+void XDFPyramid::insert(const QByteArray &key, const XDFPyramid &pyramid)
+{
+    Cached cached;
+
+    QHash<QByteArray, Cached>::iterator i;
+    QHash<QByteArray, Cached>::iterator oldest;
+
+    QMutexLocker locker(&mutex);
+
+    pyramids.remove(key);
+
+    while (pyramids.size() >= max_pyramids) {
+        oldest = pyramids.begin();
+        for (i = pyramids.begin(); i != pyramids.end(); ++i) {
+            if (i.value().last_used < oldest.value().last_used)
+                oldest = i;
+        }
+
+        pyramids.erase(oldest);
+    }
+
+    cached.levels    = pyramid.levels;
+    cached.last_used = ++use_count;
+
+    pyramids.insert(key, cached);
+}
+
+
+
+XDFPyramidBuilder::XDFPyramidBuilder()
+    : current(NULL), is_canceled(false), is_stopping(false)
+{
+
+}
+
+
+
+XDFPyramidBuilder *XDFPyramidBuilder::instance()
+{
+    static XDFPyramidBuilder *builder = new XDFPyramidBuilder;
+
+    return builder;
+}
+
+
+
+/*
+ * Requests the pyramid with key of the view's slice of n_rows by n_cols as it
+ * is configured in generation.
+ */
+void XDFPyramidBuilder::request(XDFTableView *view, int generation,
+                                const QByteArray &key, int n_rows, int n_cols)
+{
+    int i;
+
+    Request request;
+
+    QMutexLocker locker(&mutex);
+
+    i = 0;
+    while (i < requests.size()) {
+        if (requests[i].view == view)
+            requests.removeAt(i);
+        else
+            ++i;
+    }
+
+    request.view       = view;
+    request.generation = generation;
+    request.key        = key;
+    request.n_rows     = n_rows;
+    request.n_cols     = n_cols;
+    requests.append(request);
+
+    if (! isRunning())
+        start(QThread::LowPriority);
+
+    changed.wakeAll();
+}
+
+
+
+/*
+ * Drops the view's queued request and stops and waits for the pyramid being
+ * built for it, if any.
+ */
+void XDFPyramidBuilder::cancel(XDFTableView *view)
+{
+    int i;
+
+    QMutexLocker locker(&mutex);
+
+    i = 0;
+    while (i < requests.size()) {
+        if (requests[i].view == view)
+            requests.removeAt(i);
+        else
+            ++i;
+    }
+
+    if (current == view) {
+        is_canceled = true;
+        while (current == view)
+            changed.wait(&mutex);
+    }
+}
+
+
+
+void XDFPyramidBuilder::stop()
+{
+    mutex.lock();
+    is_stopping = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
+
+
+
+/*
+ * Returns -1 if the build was canceled, the view was configured again, or a
+ * piece could not be read.
+ */
+int XDFPyramidBuilder::build(const Request &request, XDFPyramid *pyramid)
+{
+    int r;
+
+    int row;
+    int col;
+    int n_rows;
+    int n_cols;
+
+    int piece_rows;
+    int piece_cols;
+
+    bool locked;
+
+    double *values;
+
+    QMutex *library_mutex;
+
+    pyramid->init(request.n_rows, request.n_cols);
+
+    piece_rows = pyramid->level(0).factor * qMax(1, piece_side / pyramid->level(0).factor);
+    piece_cols = piece_rows;
+
+    values = (double *) malloc((size_t) piece_rows * piece_cols * sizeof(double));
+    if (values == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        return -1;
+    }
+
+    library_mutex = XDFV::libraryMutex(request.view->file_type);
+
+    for (row = 0; row < request.n_rows; row += piece_rows) {
+        for (col = 0; col < request.n_cols; col += piece_cols) {
+            n_rows = qMin(piece_rows, request.n_rows - row);
+            n_cols = qMin(piece_cols, request.n_cols - col);
+
+            locked = false;
+            while (! is_stopping && ! is_canceled) {
+                locked = library_mutex->tryLock(lock_interval);
+                if (locked)
+                    break;
+            }
+
+            if (! locked) {
+                free(values);
+                return -1;
+            }
+
+            r = request.view->readValues(request.generation, row, n_rows, col, n_cols,
+                                         values);
+
+            library_mutex->unlock();
+
+            if (r < 0) {
+                free(values);
+                return -1;
+            }
+
+            pyramid->addValues(row, col, n_rows, n_cols, values);
+        }
+    }
+
+    free(values);
+
+    pyramid->finish();
+
+    return 0;
+}
+
+
+
+void XDFPyramidBuilder::run()
+{
+    Request request;
+
+    XDFPyramid pyramid;
+
+    for ( ; ; ) {
+        mutex.lock();
+        while (requests.isEmpty() && ! is_stopping)
+            changed.wait(&mutex);
+        if (is_stopping) {
+            mutex.unlock();
+            break;
+        }
+        request = requests.takeFirst();
+        current = request.view;
+        is_canceled = false;
+        mutex.unlock();
+
+        if (XDFPyramid::find(request.key, &pyramid))
+            emit built(request.key);
+        else if (build(request, &pyramid) == 0) {
+            XDFPyramid::insert(request.key, pyramid);
+            emit built(request.key);
+        }
+
+        pyramid = XDFPyramid();
+
+        mutex.lock();
+        current = NULL;
+        changed.wakeAll();
+        mutex.unlock();
+    }
+}
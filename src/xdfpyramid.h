@@ -0,0 +1,134 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFPYRAMID_H
+#define XDFPYRAMID_H
+
+#include <atomic>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qthread.h>
+#include <qvector.h>
+#include <qwaitcondition.h>
+
+
+class XDFTableView;
+
+
+/*
+ * A multi-resolution overview of a two dimensional slice of a dataset.  Each
+ * level divides the slice into cells of factor by factor elements and holds the
+ * minimum, maximum, and mean of the finite values in each cell and their
+ * number, fill values having been read as NaN, see XDFTableView::readValues().
+ * The first level has the smallest power of two factor for which it has at most
+ * max_base_cells cells, and each level after it halves the one before in each
+ * direction down to a single cell.  Overviews are built by the
+ * XDFPyramidBuilder and are kept, keyed by the dataset and the slice, up to
+ * max_pyramids of them, so that they are shared by all the views of the same
+ * slice.  Levels are implicitly shared so a pyramid found stays valid after it
+ * is evicted.
+ */
+class XDFPyramid
+{
+public:
+    struct Level {
+        int n_rows;
+        int n_cols;
+        int factor;
+        QVector<float> min;
+        QVector<float> max;
+        QVector<float> mean;
+        QVector<int> count;
+    };
+
+private:
+    struct Cached {
+        QList<Level> levels;
+        unsigned long long last_used;
+    };
+
+    static const int max_base_cells = 1 << 20;
+    static const int max_pyramids   = 16;
+
+    static QMutex mutex;
+    static QHash<QByteArray, Cached> pyramids;
+    static unsigned long long use_count;
+
+    QList<Level> levels;
+
+public:
+    void init(int n_rows, int n_cols);
+    void addValues(int row, int col, int n_rows, int n_cols, const double *values);
+    void finish();
+
+    int levelCount() const;
+    const Level &level(int i) const;
+
+    static bool find(const QByteArray &key, XDFPyramid *pyramid);
+    static void insert(const QByteArray &key, const XDFPyramid &pyramid);
+};
+
+
+
+/*
+ * Builds XDFPyramids in the background for the table views on a single worker
+ * thread shared by all the views.  The slice is read in pieces of whole cells
+ * of the first level with XDFTableView::readValues(), taking the library lock
+ * for each piece only, so that the views stay responsive while a large
+ * dataset is being read.  When a pyramid is done it is added to the cache and
+ * built() is emitted with its key.  A view's request replaces its earlier
+ * request and a request for a pyramid that is already cached is not built
+ * again.
+ */
+class XDFPyramidBuilder : public QThread
+{
+    Q_OBJECT
+
+private:
+    struct Request {
+        XDFTableView *view;
+        int generation;
+        QByteArray key;
+        int n_rows;
+        int n_cols;
+    };
+
+    static const int piece_side    = 1024;
+    static const int lock_interval = 100;
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QList<Request> requests;
+    XDFTableView *current;
+    std::atomic<bool> is_canceled;
+    std::atomic<bool> is_stopping;
+
+    XDFPyramidBuilder();
+
+    int build(const Request &request, XDFPyramid *pyramid);
+
+protected:
+    void run();
+
+public:
+    static XDFPyramidBuilder *instance();
+
+    void request(XDFTableView *view, int generation, const QByteArray &key,
+                 int n_rows, int n_cols);
+    void cancel(XDFTableView *view);
+    void stop();
+
+signals:
+    void built(QByteArray key);
+};
+
+#endif /* XDFPYRAMID_H */
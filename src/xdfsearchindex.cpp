@@ -0,0 +1,542 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "xdfv.h"
+#include "xdfsearchindex.h"
+
+
+XDFSearchQuery::XDFSearchQuery(const QString &pattern, Syntax syntax)
+    : pattern(pattern.toUtf8()), syntax(syntax)
+{
+    int i;
+
+    is_path = this->pattern.contains('/');
+
+    if (syntax == Text) {
+        i = this->pattern.lastIndexOf('/');
+        literals.append(this->pattern.mid(i + 1));
+    }
+    else if (syntax == Glob) {
+        if (! is_path)
+            findGlobLiterals();
+        else
+            findPathPrefix();
+    }
+    else {
+        regexp = QRegExp(pattern);
+        if (! is_path)
+            findRegExpLiterals();
+        else
+            findPathPrefix();
+    }
+}
+
+
+
+/*
+ * The runs of characters between wildcards and bracket expressions.
+ */
+void XDFSearchQuery::findGlobLiterals()
+{
+    int i;
+    int n;
+
+    const char *s;
+
+    QByteArray run;
+
+    s = pattern.constData();
+    n = pattern.size();
+
+    for (i = 0; i < n; ++i) {
+        if (s[i] == '*' || s[i] == '?' || s[i] == '[') {
+            if (s[i] == '[') {
+                if (i + 1 < n && s[i + 1] == '!')
+                    ++i;
+                if (i + 1 < n && s[i + 1] == ']')
+                    ++i;
+                while (i + 1 < n && s[i + 1] != ']')
+                    ++i;
+                ++i;
+            }
+            literals.append(run);
+            run.clear();
+        }
+        else if (s[i] == '\\' && i + 1 < n)
+            run += s[++i];
+        else
+            run += s[i];
+    }
+
+    literals.append(run);
+}
+
+
+
+/*
+ * The runs of plain characters outside of any group.  A character followed by
+ * '*', '?', or a '{}' repeat may not occur so it ends the run before it.  An
+ * escape for a class or code, such as '\d', '\x41', or '\0101', and a '[]' set,
+ * in which a leading ']' is a member, end the run without adding to it.  With
+ * '|' no run is required.
+ */
+void XDFSearchQuery::findRegExpLiterals()
+{
+    int i;
+    int j;
+    int n;
+    int depth;
+
+    const char *s;
+
+    QByteArray run;
+
+    if (pattern.contains('|'))
+        return;
+
+    s = pattern.constData();
+    n = pattern.size();
+
+    depth = 0;
+
+    for (i = 0; i < n; ++i) {
+        switch(s[i]) {
+            case '{':
+                while (i + 1 < n && s[i + 1] != '}')
+                    ++i;
+                ++i;
+                run.chop(1);
+                literals.append(run);
+                run.clear();
+                break;
+            case '*':
+            case '?':
+                run.chop(1);
+                literals.append(run);
+                run.clear();
+                break;
+            case '(':
+                depth++;
+                literals.append(run);
+                run.clear();
+                break;
+            case ')':
+                depth--;
+                break;
+            case '[':
+                ++i;
+                if (i < n && s[i] == '^')
+                    ++i;
+                if (i < n && s[i] == ']')
+                    ++i;
+                for ( ; i < n && s[i] != ']'; ++i) {
+                    if (s[i] == '\\')
+                        ++i;
+                }
+                literals.append(run);
+                run.clear();
+                break;
+            case '\\':
+                if (i + 1 < n && ! isalnum((unsigned char) s[i + 1])) {
+                    if (depth == 0)
+                        run += s[i + 1];
+                    ++i;
+                    break;
+                }
+                ++i;
+                if (i < n && s[i] == 'x') {
+                    for (j = 0; j < 4 && i + 1 < n &&
+                         isxdigit((unsigned char) s[i + 1]); ++j)
+                        ++i;
+                }
+                else if (i < n && s[i] == '0') {
+                    for (j = 0; j < 3 && i + 1 < n &&
+                         s[i + 1] >= '0' && s[i + 1] <= '7'; ++j)
+                        ++i;
+                }
+                literals.append(run);
+                run.clear();
+                break;
+            case '.':
+            case '+':
+            case '^':
+            case '$':
+                literals.append(run);
+                run.clear();
+                break;
+            default:
+                if (depth == 0)
+                    run += s[i];
+                break;
+        }
+    }
+
+    literals.append(run);
+}
+
+
+
+/*
+ * The plain characters at the start of a Glob, or of a RegExp after a leading
+ * '^', up to the first special character.  As for findRegExpLiterals() a
+ * character followed by '*', '?', or a '{}' repeat is not included.  With '|'
+ * there is no prefix.
+ */
+void XDFSearchQuery::findPathPrefix()
+{
+    int i;
+    int n;
+
+    const char *s;
+    const char *special;
+
+    s = pattern.constData();
+    n = pattern.size();
+
+    if (syntax == Glob) {
+        special = "*?[";
+        i = 0;
+    }
+    else {
+        if (pattern.contains('|') || s[0] != '^')
+            return;
+        special = ".*?+^$()[]{}";
+        i = 1;
+    }
+
+    for ( ; i < n; ++i) {
+        if (strchr(special, s[i]) != NULL) {
+            if (syntax == RegExp && (s[i] == '*' || s[i] == '?' || s[i] == '{'))
+                prefix.chop(1);
+            break;
+        }
+        if (s[i] == '\\') {
+            if (syntax == RegExp && (i + 1 >= n || isalnum((unsigned char) s[i + 1])))
+                break;
+            ++i;
+        }
+        if (i < n)
+            prefix += s[i];
+    }
+}
+
+
+
+bool XDFSearchQuery::isValid() const
+{
+    if (pattern.isEmpty())
+        return false;
+
+    return syntax != RegExp || regexp.isValid();
+}
+
+
+
+/*
+ * Finds the match in s that ends last and returns its start and end offsets,
+ * in bytes for Text and Glob and in characters for RegExp.
+ */
+bool XDFSearchQuery::matches(const char *s, int *start, int *end) const
+{
+    int i;
+
+    const char *p;
+    const char *q;
+
+    QString string;
+
+    if (syntax == Text) {
+        q = NULL;
+        for (p = s; (p = strstr(p, pattern.constData())) != NULL; ++p)
+            q = p;
+        if (q == NULL)
+            return false;
+        *start = q - s;
+        *end   = *start + pattern.size();
+        return true;
+    }
+
+    if (syntax == Glob) {
+        if (fnmatch(pattern.constData(), s, 0) != 0)
+            return false;
+        *start = 0;
+        *end   = strlen(s);
+        return true;
+    }
+
+    string = QString::fromUtf8(s);
+
+    *end = -1;
+    for (i = regexp.indexIn(string); i >= 0; i = regexp.indexIn(string, i + 1)) {
+        if (i + regexp.matchedLength() > *end) {
+            *start = i;
+            *end   = i + regexp.matchedLength();
+        }
+    }
+
+    return *end >= 0;
+}
+
+
+
+/*
+ * Returns the Rank of a match in a node's name or -1 for none.
+ */
+int XDFSearchQuery::matchName(const char *name) const
+{
+    int start;
+    int end;
+
+    QString string;
+
+    if (syntax == RegExp) {
+        string = QString::fromUtf8(name);
+        if (regexp.exactMatch(string))
+            return Exact;
+        start = regexp.indexIn(string);
+        return start < 0 ? -1 : start == 0 ? Prefix : Name;
+    }
+
+    if (! matches(name, &start, &end))
+        return -1;
+
+    if (syntax == Glob)
+        return Name;
+
+    if (start == 0)
+        return name[end] == '\0' ? Exact : Prefix;
+
+    return Name;
+}
+
+
+
+/*
+ * Returns the Rank of a match in a node's path or -1 for none.  own is the
+ * offset in bytes of the node's own name in path.
+ */
+int XDFSearchQuery::matchPath(const char *path, int own) const
+{
+    int start;
+    int end;
+
+    if (! matches(path, &start, &end))
+        return -1;
+
+    if (syntax == Glob)
+        return Path;
+
+    if (syntax == RegExp)
+        own = QString::fromUtf8(path, own).size();
+
+    if (end <= own)
+        return -1;
+
+    return start == 0 && path[end] == '\0' ? Exact : Path;
+}
+
+
+
+int XDFSearchQuery::matchValue(const char *value) const
+{
+    int start;
+    int end;
+
+    return matches(value, &start, &end) ? Value : -1;
+}
+
+
+
+/*******************************************************************************
+ *
+ ******************************************************************************/
+void XDFSearchIndex::addTrigrams(int id, const char *s, int n)
+{
+    int i;
+
+    unsigned int trigram;
+
+    for (i = 0; i + 3 <= n; ++i) {
+        trigram = (unsigned char) s[i] << 16 | (unsigned char) s[i + 1] << 8 |
+                  (unsigned char) s[i + 2];
+
+        Postings &p = postings[trigram];
+
+        if (p.ids.isEmpty())
+            p.is_sorted = true;
+        else if (p.ids.last() == id)
+            continue;
+        else if (p.ids.last() > id)
+            p.is_sorted = false;
+
+        p.ids.append(id);
+    }
+}
+
+
+
+/*
+ * Indexes the name and value of a node.  A node that changes is added again
+ * and its old entries left to be weeded out by the caller.
+ */
+void XDFSearchIndex::add(int id, const char *name, const char *value)
+{
+    int n;
+
+    addTrigrams(id, name, strlen(name));
+
+    if (value == NULL)
+        return;
+
+    n = strlen(value);
+    if (n > max_value_size) {
+        long_values.append(id);
+        n = max_value_size;
+    }
+
+    addTrigrams(id, value, n);
+}
+
+
+
+void XDFSearchIndex::clear()
+{
+    postings.clear();
+    long_values.clear();
+}
+
+
+
+const QVector<int> *XDFSearchIndex::find(unsigned int trigram)
+{
+    QHash<unsigned int, Postings>::iterator i;
+
+    i = postings.find(trigram);
+    if (i == postings.end())
+        return NULL;
+
+    if (! i->is_sorted) {
+        std::sort(i->ids.begin(), i->ids.end());
+        i->ids.erase(std::unique(i->ids.begin(), i->ids.end()), i->ids.end());
+        i->is_sorted = true;
+    }
+
+    return &i->ids;
+}
+
+
+
+static bool size_less(const QVector<int> *a, const QVector<int> *b)
+{
+    return a->size() < b->size();
+}
+
+
+
+/*
+ * Looks up the nodes whose name or value may contain all of literals, in
+ * ascending order.  Literals shorter than a trigram are ignored.  Returns
+ * false, and no nodes, if none are long enough, in which case every node is
+ * a candidate.
+ */
+bool XDFSearchIndex::lookup(const QList<QByteArray> &literals, QVector<int> &ids)
+{
+    int i;
+    int j;
+    int k;
+
+    unsigned int trigram;
+
+    bool missing;
+
+    const QVector<int> *list;
+
+    QVector<const QVector<int> *> lists;
+    QVector<int> result;
+
+    ids.clear();
+
+    missing = false;
+
+    for (i = 0; i < literals.size(); ++i) {
+        const QByteArray &s = literals[i];
+
+        for (j = 0; j + 3 <= s.size(); ++j) {
+            trigram = (unsigned char) s[j] << 16 | (unsigned char) s[j + 1] << 8 |
+                      (unsigned char) s[j + 2];
+            list = find(trigram);
+            if (list == NULL)
+                missing = true;
+            else
+                lists.append(list);
+        }
+    }
+
+    if (lists.size() == 0 && ! missing)
+        return false;
+
+    if (! missing) {
+        std::sort(lists.begin(), lists.end(), size_less);
+
+        ids = *lists[0];
+        for (i = 1; i < lists.size() && ids.size() > 0; ++i) {
+            result.clear();
+            for (j = 0, k = 0; j < ids.size() && k < lists[i]->size(); ) {
+                if (ids[j] < lists[i]->at(k))
+                    ++j;
+                else if (ids[j] > lists[i]->at(k))
+                    ++k;
+                else {
+                    result.append(ids[j]);
+                    ++j;
+                    ++k;
+                }
+            }
+            ids = result;
+        }
+    }
+
+    if (long_values.size() > 0) {
+        std::sort(long_values.begin(), long_values.end());
+        long_values.erase(std::unique(long_values.begin(), long_values.end()),
+                          long_values.end());
+
+        result.resize(ids.size() + long_values.size());
+        result.erase(std::set_union(ids.begin(), ids.end(), long_values.begin(),
+                                    long_values.end(), result.begin()), result.end());
+        ids = result;
+    }
+
+    return true;
+}
+
+
+
+/* Bytes held, for reporting. */
+size_t XDFSearchIndex::memoryUsage() const
+{
+    size_t size;
+
+    QHash<unsigned int, Postings>::const_iterator i;
+
+    size = postings.size() * (sizeof(unsigned int) + sizeof(Postings) + 2 * sizeof(void *));
+
+    for (i = postings.constBegin(); i != postings.constEnd(); ++i)
+        size += i->ids.capacity() * sizeof(int);
+
+    size += long_values.capacity() * sizeof(int);
+
+    return size;
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFSEARCHINDEX_H
+#define XDFSEARCHINDEX_H
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qregexp.h>
+#include <qstring.h>
+#include <qvector.h>
+
+
+/*
+ * A pattern to find nodes by.  As Text the pattern matches names or values
+ * that contain it, as Glob names or values that it matches whole, and as
+ * RegExp names or values in which it matches.  A pattern with a '/' is
+ * matched against the paths of nodes instead, the path of a node being that
+ * of its parent and its name joined by '/', and only matches a node if the
+ * match ends in the node's own name, or for a Glob if it matches the whole
+ * path.  Matches are ranked by where they were found, see Rank.
+ *
+ * requiredLiterals() are strings that every name or value the pattern matches
+ * contains, used to look up candidates in an XDFSearchIndex.  They are not
+ * always the longest such strings.  pathPrefix() is a string that every path
+ * a Glob, or a RegExp anchored with '^', matches starts with, used to look up
+ * candidates by path.
+ */
+class XDFSearchQuery
+{
+public:
+    enum Syntax {
+        Text,
+        Glob,
+        RegExp
+    };
+
+    enum Rank {
+        Exact,
+        Prefix,
+        Name,
+        Path,
+        Value
+    };
+
+private:
+    QByteArray pattern;
+    Syntax syntax;
+    bool is_path;
+
+    QRegExp regexp;
+
+    QList<QByteArray> literals;
+    QByteArray prefix;
+
+    void findGlobLiterals();
+    void findRegExpLiterals();
+    void findPathPrefix();
+
+    bool matches(const char *s, int *start, int *end) const;
+
+public:
+    XDFSearchQuery(const QString &pattern, Syntax syntax);
+
+    bool isValid() const;
+    bool isPath() const { return is_path; }
+
+    const QList<QByteArray> &requiredLiterals() const { return literals; }
+    const QByteArray &pathPrefix() const { return prefix; }
+
+    int matchName(const char *name) const;
+    int matchPath(const char *path, int own) const;
+    int matchValue(const char *value) const;
+};
+
+
+
+/*
+ * An index of the trigrams in the names and values of the nodes of a tree,
+ * from which the nodes that may contain a set of strings are looked up
+ * without reading every node.  The index may hold nodes that have since been
+ * removed or changed, so the candidates it returns must be checked.  Values
+ * are indexed up to max_value_size bytes and nodes with longer values are
+ * always candidates.
+ */
+class XDFSearchIndex
+{
+private:
+    struct Postings {
+        QVector<int> ids;
+        bool is_sorted;
+    };
+
+    static const int max_value_size = 256;
+
+    QHash<unsigned int, Postings> postings;
+
+    QVector<int> long_values;
+
+    void addTrigrams(int id, const char *s, int n);
+    const QVector<int> *find(unsigned int trigram);
+
+public:
+    void add(int id, const char *name, const char *value);
+    void clear();
+
+    bool lookup(const QList<QByteArray> &literals, QVector<int> &ids);
+
+    size_t memoryUsage() const;
+};
+
+#endif /* XDFSEARCHINDEX_H */
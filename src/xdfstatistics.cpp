@@ -0,0 +1,792 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hdf5.h>
+#include <mfhdf.h>
+#include <netcdf.h>
+
+#include <qmutex.h>
+
+#include "ghdf.h"
+#include "gnetcdf.h"
+#include "xdfv.h"
+#include "xdfkernel.h"
+#include "xdfstatistics.h"
+
+
+XDFStatistics::XDFStatistics(XDFV::FileType file_type_,
+                             const char *file_name_, const char *object_name_)
+    : file_type(file_type_), n_dims(0), split_dim(-1), split_count(1),
+      value_size(sizeof(double)), file_id(-1), dataset_id(-1), type_id(-1),
+      nc_id(-1), grp_id(-1), var_id(-1),
+      sd_id(FAIL), sds_id(FAIL), data_type(0), buffer(NULL)
+{
+    file_name   = strdup(file_name_);
+    object_name = strdup(object_name_);
+}
+
+
+
+XDFStatistics::~XDFStatistics()
+{
+    free(file_name);
+    free(object_name);
+}
+
+
+
+/*
+ * The default never cancels.
+ */
+bool XDFStatistics::canceled()
+{
+    return false;
+}
+
+
+
+/*
+ * The default does not report progress.
+ */
+void XDFStatistics::progress(long long n_done, long long n_total)
+{
+
+}
+
+
+
+/*
+ * The fill value of an HDF5 dataset, its _FillValue attribute or else the fill
+ * value it was created with if one was set.  Returns false if there is none or
+ * it is not numeric.
+ */
+bool XDFStatistics::hdf5FillValue(hid_t dataset_id, double *fill_value)
+{
+    bool has_fill = false;
+
+    hid_t attr_id;
+    hid_t plist_id;
+
+    H5D_fill_value_t fill_status;
+
+    if (H5Aexists(dataset_id, "_FillValue") > 0) {
+        attr_id = H5Aopen(dataset_id, "_FillValue", H5P_DEFAULT);
+        if (attr_id >= 0) {
+            has_fill = H5Aread(attr_id, H5T_NATIVE_DOUBLE, fill_value) >= 0;
+            H5Aclose(attr_id);
+        }
+
+        return has_fill;
+    }
+
+    plist_id = H5Dget_create_plist(dataset_id);
+    if (plist_id < 0)
+        return false;
+
+    if (H5Pfill_value_defined(plist_id, &fill_status) >= 0 &&
+        fill_status == H5D_FILL_VALUE_USER_DEFINED)
+        has_fill = H5Pget_fill_value(plist_id, H5T_NATIVE_DOUBLE, fill_value) >= 0;
+
+    H5Pclose(plist_id);
+
+    return has_fill;
+}
+
+
+
+/*
+ * The fill value of a NetCDF variable of type xtype, its _FillValue attribute
+ * or else the default fill value unless filling is off.
+ */
+bool XDFStatistics::ncFillValue(int grp_id, int var_id, int xtype, double *fill_value)
+{
+    unsigned char fill[16];
+
+    int no_fill;
+
+    memset(fill, 0, sizeof(fill));
+
+    if (nc_get_att_double(grp_id, var_id, "_FillValue", fill_value) == NC_NOERR)
+        return true;
+
+    if (nc_inq_var_fill(grp_id, var_id, &no_fill, fill) == NC_NOERR && ! no_fill)
+        return netcdf_scaler_to_double(xtype, fill, 0, fill_value) == 0;
+
+    return false;
+}
+
+
+
+/*
+ * The fill value of an HDF4 SDS of type data_type if one has been set.
+ */
+bool XDFStatistics::hdfFillValue(int32 sds_id, int32 data_type, double *fill_value)
+{
+    unsigned char fill[16];
+
+    memset(fill, 0, sizeof(fill));
+
+    if (SDgetfillvalue(sds_id, fill) == FAIL)
+        return false;
+
+    return hdf_scaler_to_double(data_type, fill, 0, fill_value) == 0;
+}
+
+
+
+/*
+ * Opens the object and gets its dimensions, chunk dimensions, and fill value.
+ * Must be called holding the library lock.
+ */
+int XDFStatistics::open(Result *result)
+{
+    char name[MAX_NC_NAME];
+
+    unsigned char fill[16];
+
+    int i;
+    int r;
+    int status;
+    int storage;
+
+    int dimids[NC_MAX_VAR_DIMS];
+
+    int32 n_attrs;
+    int32 chunk_flag;
+
+    int32 int32_dims[MAX_VAR_DIMS];
+
+    hid_t space_id;
+    hid_t plist_id;
+
+    hsize_t hsize_dims[H5S_MAX_RANK];
+
+    nc_type xtype;
+
+    H5T_class_t data_class;
+
+    HDF_CHUNK_DEF chunk_def;
+
+    memset(fill, 0, sizeof(fill));
+
+    for (i = 0; i < max_dims; ++i)
+        chunk_dims[i] = 0;
+
+    switch (file_type) {
+        case XDFV::HDF5:
+            file_id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+            if (file_id < 0) {
+                fprintf(stderr, "ERROR: H5Fopen(), file_name = %s\n", file_name);
+                return -1;
+            }
+
+            dataset_id = H5Dopen(file_id, object_name, H5P_DEFAULT);
+            if (dataset_id < 0) {
+                fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", object_name);
+                return -1;
+            }
+
+            type_id = H5Dget_type(dataset_id);
+            data_class = H5Tget_class(type_id);
+            if (data_class != H5T_INTEGER && data_class != H5T_FLOAT) {
+                fprintf(stderr, "ERROR: Dataset is not numeric: %s\n", object_name);
+                return -1;
+            }
+
+            value_size = MAX(sizeof(double), H5Tget_size(type_id));
+
+            if (chunk_reader.init(dataset_id) < 0)
+                return -1;
+
+            space_id = H5Dget_space(dataset_id);
+            n_dims = H5Sget_simple_extent_ndims(space_id);
+            if (n_dims < 0 || n_dims > max_dims) {
+                fprintf(stderr, "ERROR: H5Sget_simple_extent_ndims()\n");
+                H5Sclose(space_id);
+                return -1;
+            }
+            H5Sget_simple_extent_dims(space_id, hsize_dims, NULL);
+            H5Sclose(space_id);
+
+            for (i = 0; i < n_dims; ++i)
+                dims[i] = hsize_dims[i];
+
+            plist_id = H5Dget_create_plist(dataset_id);
+            if (H5Pget_layout(plist_id) == H5D_CHUNKED) {
+                H5Pget_chunk(plist_id, n_dims, hsize_dims);
+                for (i = 0; i < n_dims; ++i)
+                    chunk_dims[i] = hsize_dims[i];
+            }
+            H5Pclose(plist_id);
+
+            result->has_fill = hdf5FillValue(dataset_id, &result->fill_value);
+            break;
+        case XDFV::NetCDF:
+            status = nc_open(file_name, NC_NOWRITE, &nc_id);
+            if (status != NC_NOERR) {
+                fprintf(stderr, "ERROR: nc_open(), file_name = %s, %s\n", file_name,
+                        nc_strerror(status));
+                nc_id = -1;
+                return -1;
+            }
+
+            if (netcdf_inq_varid_path(nc_id, object_name, &grp_id, &var_id)) {
+                fprintf(stderr, "ERROR: netcdf_inq_varid_path(), var_name = %s\n",
+                        object_name);
+                return -1;
+            }
+
+            if ((status = nc_inq_var(grp_id, var_id, name, &xtype, &n_dims, dimids,
+                                     NULL)) != NC_NOERR) {
+                fprintf(stderr, "ERROR: nc_inq_var(), %s\n", nc_strerror(status));
+                return -1;
+            }
+
+            if (netcdf_scaler_to_double(xtype, fill, 0, &result->fill_value)) {
+                fprintf(stderr, "ERROR: Variable is not numeric: %s\n", object_name);
+                return -1;
+            }
+
+            if (n_dims > max_dims) {
+                fprintf(stderr, "ERROR: Too many dimensions: %s\n", object_name);
+                return -1;
+            }
+
+            for (i = 0; i < n_dims; ++i)
+                nc_inq_dimlen(grp_id, dimids[i], &dims[i]);
+
+            if (nc_inq_var_chunking(grp_id, var_id, &storage, chunk_dims) != NC_NOERR ||
+                storage != NC_CHUNKED) {
+                for (i = 0; i < n_dims; ++i)
+                    chunk_dims[i] = 0;
+            }
+
+            result->has_fill = ncFillValue(grp_id, var_id, xtype, &result->fill_value);
+            break;
+        case XDFV::HDF4:
+            sd_id = SDstart(file_name, DFACC_READ);
+            if (sd_id == FAIL) {
+                fprintf(stderr, "ERROR: SDstart(), file_name = %s\n", file_name);
+                return -1;
+            }
+
+            r = SDnametoindex(sd_id, object_name);
+            if (r == FAIL) {
+                fprintf(stderr, "ERROR: SDnametoindex(), sds_name = %s\n", object_name);
+                return -1;
+            }
+
+            sds_id = SDselect(sd_id, r);
+            if (sds_id == FAIL) {
+                fprintf(stderr, "ERROR: SDselect()\n");
+                return -1;
+            }
+
+            if (SDgetinfo(sds_id, name, &r, int32_dims, &data_type, &n_attrs) == FAIL) {
+                fprintf(stderr, "ERROR: SDgetinfo()\n");
+                return -1;
+            }
+
+            if (hdf_scaler_to_double(data_type, fill, 0, &result->fill_value)) {
+                fprintf(stderr, "ERROR: SDS is not numeric: %s\n", object_name);
+                return -1;
+            }
+
+            n_dims = r;
+            if (n_dims > max_dims) {
+                fprintf(stderr, "ERROR: Too many dimensions: %s\n", object_name);
+                return -1;
+            }
+
+            for (i = 0; i < n_dims; ++i)
+                dims[i] = int32_dims[i];
+
+            if (SDgetchunkinfo(sds_id, &chunk_def, &chunk_flag) != FAIL &&
+                chunk_flag & HDF_CHUNK) {
+                for (i = 0; i < n_dims; ++i)
+                    chunk_dims[i] = chunk_def.chunk_lengths[i];
+            }
+
+            result->has_fill = hdfFillValue(sds_id, data_type, &result->fill_value);
+
+            buffer = malloc((size_t) max_slab_size * hdf_data_type_size(data_type));
+            if (buffer == NULL) {
+                fprintf(stderr, "ERROR: Memory allocation failed\n");
+                return -1;
+            }
+            break;
+        default:
+            fprintf(stderr, "ERROR: Unknown file type\n");
+            return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Reads the slab at offset of count elements as doubles.  Must be called
+ * holding the library lock.
+ */
+int XDFStatistics::readSlab(const size_t *offset, const size_t *count,
+                            double *values)
+{
+    int i;
+    int status;
+
+    int32 start32[MAX_VAR_DIMS];
+    int32 count32[MAX_VAR_DIMS];
+
+    size_t n;
+
+    hid_t space_id;
+    hid_t mem_space_id;
+
+    hsize_t hsize_offset[H5S_MAX_RANK];
+    hsize_t hsize_count [H5S_MAX_RANK];
+
+    n = 1;
+    for (i = 0; i < n_dims; ++i)
+        n *= count[i];
+
+    switch (file_type) {
+        case XDFV::HDF5:
+            for (i = 0; i < n_dims; ++i) {
+                hsize_offset[i] = offset[i];
+                hsize_count [i] = count [i];
+            }
+
+            if (chunk_reader.isSupported()) {
+                if (chunk_reader.read(dataset_id, offset, count, values) < 0 ||
+                    H5Tconvert(type_id, H5T_NATIVE_DOUBLE, n, values, NULL, H5P_DEFAULT) < 0)
+                    status = -1;
+                else
+                    status = 0;
+            }
+            else if (n_dims == 0)
+                status = H5Dread(dataset_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL,
+                                 H5P_DEFAULT, values);
+            else {
+                space_id = H5Dget_space(dataset_id);
+                H5Sselect_hyperslab(space_id, H5S_SELECT_SET, hsize_offset, NULL,
+                                    hsize_count, NULL);
+                mem_space_id = H5Screate_simple(n_dims, hsize_count, NULL);
+                status = H5Dread(dataset_id, H5T_NATIVE_DOUBLE, mem_space_id, space_id,
+                                 H5P_DEFAULT, values);
+                H5Sclose(mem_space_id);
+                H5Sclose(space_id);
+            }
+            if (status < 0) {
+                fprintf(stderr, "ERROR: H5Dread(), dataset_name = %s\n", object_name);
+                return -1;
+            }
+            break;
+        case XDFV::NetCDF:
+            if ((status = nc_get_vara_double(grp_id, var_id, offset, count, values)) !=
+                NC_NOERR) {
+                fprintf(stderr, "ERROR: nc_get_vara_double(), %s\n", nc_strerror(status));
+                return -1;
+            }
+            break;
+        case XDFV::HDF4:
+            for (i = 0; i < n_dims; ++i) {
+                start32[i] = offset[i];
+                count32[i] = count [i];
+            }
+
+            if (SDreaddata(sds_id, start32, NULL, count32, buffer) == FAIL) {
+                fprintf(stderr, "ERROR: SDreaddata(), sds_name = %s\n", object_name);
+                return -1;
+            }
+
+            if (XDFKernel::toDouble(XDFKernel::hdfType(data_type), buffer, n,
+                                    hdf_data_type_size(data_type), values, 1) < 0) {
+                fprintf(stderr, "ERROR: XDFKernel::toDouble(), sds_name = %s\n", object_name);
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Closes what open() opened, also after it failed.  Must be called holding the
+ * library lock.
+ */
+void XDFStatistics::close()
+{
+    if (type_id >= 0)
+        H5Tclose(type_id);
+    if (dataset_id >= 0)
+        H5Dclose(dataset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (nc_id >= 0)
+        nc_close(nc_id);
+    if (sds_id != FAIL)
+        SDendaccess(sds_id);
+    if (sd_id != FAIL)
+        SDend(sd_id);
+    if (buffer)
+        free(buffer);
+
+    file_id    = -1;
+    dataset_id = -1;
+    type_id    = -1;
+    nc_id      = -1;
+    sd_id      = FAIL;
+    sds_id     = FAIL;
+    buffer     = NULL;
+}
+
+
+
+/*
+ * Chooses the dimension to split at, the first going backwards for which the
+ * object is larger than max_slab_size values, and the number of its elements
+ * per slab, a multiple of its chunk dimension if that fits, and sets up the
+ * first slab.
+ */
+void XDFStatistics::firstSlab(size_t *offset, size_t *count)
+{
+    int i;
+
+    size_t inner;
+
+    inner = 1;
+    for (split_dim = n_dims - 1; split_dim >= 0; --split_dim) {
+        if (inner * dims[split_dim] > (size_t) max_slab_size)
+            break;
+        inner *= dims[split_dim];
+    }
+
+    if (split_dim >= 0) {
+        split_count = max_slab_size / inner;
+        if (split_count == 0)
+            split_count = 1;
+        if (chunk_dims[split_dim] > 0 && split_count >= chunk_dims[split_dim])
+            split_count -= split_count % chunk_dims[split_dim];
+    }
+
+    for (i = 0; i < n_dims; ++i) {
+        offset[i] = 0;
+        if (i < split_dim)
+            count[i] = 1;
+        else if (i == split_dim)
+            count[i] = MIN(split_count, dims[i]);
+        else
+            count[i] = dims[i];
+    }
+}
+
+
+
+/*
+ * Advances to the next slab, returning false past the last.
+ */
+bool XDFStatistics::nextSlab(size_t *offset, size_t *count)
+{
+    int i;
+
+    if (split_dim < 0)
+        return false;
+
+    offset[split_dim] += split_count;
+    if (offset[split_dim] < dims[split_dim]) {
+        count[split_dim] = MIN(split_count, dims[split_dim] - offset[split_dim]);
+        return true;
+    }
+
+    offset[split_dim] = 0;
+    count [split_dim] = MIN(split_count, dims[split_dim]);
+
+    for (i = split_dim - 1; i >= 0; --i) {
+        if (++offset[i] < dims[i])
+            return true;
+        offset[i] = 0;
+    }
+
+    return false;
+}
+
+
+
+/*
+ * Accumulates n values.  The counts, sums, minima, and maxima are kept in
+ * lanes and the tests are turned into masks of 0 or 1 so that the loops have
+ * no branches and are vectorized.  The last values, if fewer than lanes, are
+ * padded with NaNs which are then taken off the count.  A second pass over the
+ * values, still in cache, gives the sum of the squared deviations from their
+ * mean, which is combined with those of the values before as in Chan et al.
+ * to keep the standard deviation accurate.
+ */
+void XDFStatistics::addValues(const double *values, size_t n, Result *result)
+{
+    int j;
+
+    size_t i;
+    size_t m;
+
+    double v;
+    double d;
+    double lo;
+    double hi;
+    double fill;
+    double mean;
+    double n_sum;
+    double delta;
+
+    double is_finite;
+    double is_nan;
+    double is_fill;
+    double is_valid;
+
+    const double *p;
+
+    double tail  [lanes];
+    double count [lanes];
+    double sum   [lanes];
+    double min   [lanes];
+    double max   [lanes];
+    double n_nan [lanes];
+    double n_inf [lanes];
+    double n_fill[lanes];
+    double m2    [lanes];
+
+    fill = result->has_fill ? result->fill_value : NAN;
+
+    m = n - n % lanes;
+
+    for (j = 0; j < lanes; ++j) {
+        tail  [j] = m + j < n ? values[m + j] : NAN;
+        count [j] = 0.;
+        sum   [j] = 0.;
+        min   [j] = INFINITY;
+        max   [j] = -INFINITY;
+        n_nan [j] = 0.;
+        n_inf [j] = 0.;
+        n_fill[j] = 0.;
+        m2    [j] = 0.;
+    }
+
+    for (i = 0; i < n; i += lanes) {
+        p = i < m ? values + i : tail;
+
+        for (j = 0; j < lanes; ++j) {
+            v = p[j];
+
+            is_finite = v - v == 0. ? 1. : 0.;
+            is_nan    = v != v      ? 1. : 0.;
+            is_fill   = v == fill   ? 1. : 0.;
+            is_valid  = is_finite - is_finite * is_fill;
+
+            lo = is_valid != 0. ? v :  INFINITY;
+            hi = is_valid != 0. ? v : -INFINITY;
+
+            count [j] += is_valid;
+            sum   [j] += is_valid != 0. ? v : 0.;
+            min   [j]  = lo < min[j] ? lo : min[j];
+            max   [j]  = hi > max[j] ? hi : max[j];
+            n_nan [j] += is_nan;
+            n_inf [j] += 1. - is_valid - is_nan - is_fill;
+            n_fill[j] += is_fill;
+        }
+    }
+
+    if (m < n)
+        n_nan[0] -= lanes - (n - m);
+
+    n_sum = 0.;
+    mean  = 0.;
+    for (j = 0; j < lanes; ++j) {
+        n_sum += count[j];
+        mean  += sum  [j];
+    }
+
+    if (n_sum > 0.)
+        mean /= n_sum;
+
+    for (i = 0; i < n; i += lanes) {
+        p = i < m ? values + i : tail;
+
+        for (j = 0; j < lanes; ++j) {
+            v = p[j];
+            d = v - v == 0. && v != fill ? v - mean : 0.;
+            m2[j] += d * d;
+        }
+    }
+
+    for (j = 0; j < lanes; ++j) {
+        result->n_valid += count [j];
+        result->n_nan   += n_nan [j];
+        result->n_inf   += n_inf [j];
+        result->n_fill  += n_fill[j];
+        result->min      = MIN(result->min, min[j]);
+        result->max      = MAX(result->max, max[j]);
+        if (j > 0)
+            m2[0] += m2[j];
+    }
+
+    result->n_values += n;
+
+    if (n_sum > 0.) {
+        delta     = mean - sum_mean;
+        sum_mean += delta * n_sum / (sum_n + n_sum);
+        sum_m2   += m2[0] + delta * delta * sum_n * n_sum / (sum_n + n_sum);
+        sum_n    += n_sum;
+    }
+}
+
+
+
+/*
+ * Returns 0 when done, 1 if canceled, and -1 on error.
+ */
+int XDFStatistics::compute(Result *result)
+{
+    int i;
+    int r;
+
+    size_t n;
+
+    long long n_total;
+
+    size_t offset[max_dims];
+    size_t count [max_dims];
+
+    double *values;
+
+    QMutex *mutex;
+
+    result->n_values   = 0;
+    result->n_valid    = 0;
+    result->n_nan      = 0;
+    result->n_inf      = 0;
+    result->n_fill     = 0;
+    result->has_fill   = false;
+    result->fill_value = 0.;
+    result->min        = INFINITY;
+    result->max        = -INFINITY;
+    result->mean       = NAN;
+    result->stddev     = NAN;
+
+    sum_n    = 0.;
+    sum_mean = 0.;
+    sum_m2   = 0.;
+
+    mutex = XDFV::libraryMutex(file_type);
+
+    mutex->lock();
+    r = open(result);
+    if (r < 0)
+        close();
+    mutex->unlock();
+    if (r < 0)
+        return -1;
+
+    values = (double *) malloc((size_t) max_slab_size * value_size);
+    if (values == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        mutex->lock();
+        close();
+        mutex->unlock();
+        return -1;
+    }
+
+    n_total = 1;
+    for (i = 0; i < n_dims; ++i)
+        n_total *= dims[i];
+
+    firstSlab(offset, count);
+
+    r = 0;
+    if (n_total > 0) {
+        do {
+            if (canceled()) {
+                r = 1;
+                break;
+            }
+
+            n = 1;
+            for (i = 0; i < n_dims; ++i)
+                n *= count[i];
+
+            mutex->lock();
+            r = readSlab(offset, count, values);
+            mutex->unlock();
+            if (r < 0)
+                break;
+
+            addValues(values, n, result);
+
+            progress(result->n_values, n_total);
+        } while (nextSlab(offset, count));
+    }
+
+    free(values);
+
+    mutex->lock();
+    close();
+    mutex->unlock();
+
+    if (r != 0)
+        return r;
+
+    if (result->n_valid == 0) {
+        result->min = NAN;
+        result->max = NAN;
+    }
+    else {
+        result->mean   = sum_mean;
+        result->stddev = sqrt(sum_m2 / sum_n);
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Writes the result as lines of "name: value", as shown by the statistics
+ * dialog and printed by --statistics.
+ */
+void XDFStatistics::format(const Result &result, char *string, size_t length)
+{
+    char fill[64];
+
+    if (result.has_fill)
+        snprintf(fill, 64, "%.9g", result.fill_value);
+    else
+        strcpy(fill, "none");
+
+    snprintf(string, length,
+             "values:     %lld\n"
+             "valid:      %lld\n"
+             "NaN:        %lld\n"
+             "infinite:   %lld\n"
+             "fill:       %lld (fill value: %s)\n"
+             "min:        %.9g\n"
+             "max:        %.9g\n"
+             "mean:       %.9g\n"
+             "stddev:     %.9g\n",
+             result.n_values, result.n_valid, result.n_nan, result.n_inf,
+             result.n_fill, fill, result.min, result.max, result.mean,
+             result.stddev);
+}
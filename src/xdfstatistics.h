@@ -0,0 +1,115 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFSTATISTICS_H
+#define XDFSTATISTICS_H
+
+#include <hdf5.h>
+#include <mfhdf.h>
+
+#include "xdfv.h"
+#include "xdfchunkreader.h"
+
+
+class QMutex;
+
+
+/*
+ * Statistics of the whole of an HDF5 dataset, NetCDF variable, or HDF4 SDS.
+ * The object is read in slabs of at most max_slab_size values, whole along
+ * the trailing dimensions and, for chunked objects, aligned to the chunks
+ * along the dimension that is split, so that memory stays bounded whatever
+ * the size of the object.  The library lock is taken for each slab only and
+ * compressed HDF5 datasets are read with an XDFChunkReader.  Values equal to
+ * the fill value, the _FillValue attribute or else the fill value of the
+ * object, are counted apart from NaNs and infinities and the rest are
+ * accumulated.  The class does not depend on the GUI and can be used
+ * headless.  Subclasses may override canceled() and progress(), which are
+ * called between slabs, to stop early and to follow the progress.
+ */
+class XDFStatistics
+{
+public:
+    struct Result {
+        long long n_values;
+        long long n_valid;
+        long long n_nan;
+        long long n_inf;
+        long long n_fill;
+        bool has_fill;
+        double fill_value;
+        double min;
+        double max;
+        double mean;
+        double stddev;
+    };
+
+private:
+    static const int max_dims      = 32;
+    static const int max_slab_size = 2 * 1024 * 1024;
+    static const int lanes         = 4;
+
+    XDFV::FileType file_type;
+    char *file_name;
+    char *object_name;
+
+    int n_dims;
+    size_t dims[max_dims];
+    size_t chunk_dims[max_dims];
+    int split_dim;
+    size_t split_count;
+
+    size_t value_size;
+
+    hid_t file_id;
+    hid_t dataset_id;
+    hid_t type_id;
+    XDFChunkReader chunk_reader;
+
+    int nc_id;
+    int grp_id;
+    int var_id;
+
+    int32 sd_id;
+    int32 sds_id;
+    int32 data_type;
+    void *buffer;
+
+    double sum_n;
+    double sum_mean;
+    double sum_m2;
+
+    int open(Result *result);
+    int readSlab(const size_t *offset, const size_t *count, double *values);
+    void close();
+
+    void firstSlab(size_t *offset, size_t *count);
+    bool nextSlab(size_t *offset, size_t *count);
+
+    void addValues(const double *values, size_t n, Result *result);
+
+protected:
+    virtual bool canceled();
+    virtual void progress(long long n_done, long long n_total);
+
+public:
+    XDFStatistics(XDFV::FileType file_type, const char *file_name,
+                  const char *object_name);
+    virtual ~XDFStatistics();
+
+    int compute(Result *result);
+
+    static void format(const Result &result, char *string, size_t length);
+
+    static bool hdf5FillValue(hid_t dataset_id, double *fill_value);
+    static bool ncFillValue(int grp_id, int var_id, int xtype, double *fill_value);
+    static bool hdfFillValue(int32 sds_id, int32 data_type, double *fill_value);
+};
+
+#endif /* XDFSTATISTICS_H */
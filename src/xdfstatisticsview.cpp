@@ -0,0 +1,144 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <qboxlayout.h>
+#include <qfont.h>
+
+#include "xdfv.h"
+#include "xdfstatistics.h"
+#include "xdfstatisticsview.h"
+
+
+XDFStatisticsThread::XDFStatisticsThread(XDFV::FileType file_type,
+                                         const char *file_name,
+                                         const char *object_name)
+    : XDFStatistics(file_type, file_name, object_name), is_canceled(false),
+      percent(-1), status(-1)
+{
+
+}
+
+
+
+bool XDFStatisticsThread::canceled()
+{
+    return is_canceled;
+}
+
+
+
+void XDFStatisticsThread::progress(long long n_done, long long n_total)
+{
+    int p;
+
+    p = (int) (100. * n_done / n_total);
+    if (p != percent) {
+        percent = p;
+        emit progressed(percent);
+    }
+}
+
+
+
+void XDFStatisticsThread::run()
+{
+    status = compute(&result);
+}
+
+
+
+void XDFStatisticsThread::cancel()
+{
+    is_canceled = true;
+}
+
+
+
+int XDFStatisticsThread::computeStatus()
+{
+    return status;
+}
+
+
+
+const XDFStatistics::Result &XDFStatisticsThread::computeResult()
+{
+    return result;
+}
+
+
+
+XDFStatisticsView::XDFStatisticsView(XDFV::FileType file_type,
+                                     const char *file_name,
+                                     const char *object_name,
+                                     QWidget *parent)
+    : QWidget(parent)
+{
+    QFont font;
+    font.setFamily("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+
+    QVBoxLayout *verticalLayout = new QVBoxLayout(this);
+
+    verticalLayout->addWidget(new QLabel(object_name, this));
+
+    progress_bar = new QProgressBar(this);
+    progress_bar->setRange(0, 100);
+    progress_bar->setValue(0);
+    verticalLayout->addWidget(progress_bar);
+
+    result_label = new QLabel(this);
+    result_label->setFont(font);
+    result_label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    result_label->hide();
+    verticalLayout->addWidget(result_label);
+
+    close_button = new QPushButton("Cancel", this);
+    verticalLayout->addWidget(close_button);
+    QObject::connect(close_button, SIGNAL(clicked()), this, SLOT(close()));
+
+    setWindowTitle(QString("Statistics: %1").arg(object_name));
+
+    thread = new XDFStatisticsThread(file_type, file_name, object_name);
+    QObject::connect(thread, SIGNAL(progressed(int)), progress_bar, SLOT(setValue(int)));
+    QObject::connect(thread, SIGNAL(finished()), this, SLOT(finishCompute()));
+    thread->start(QThread::LowPriority);
+}
+
+
+
+XDFStatisticsView::~XDFStatisticsView()
+{
+    thread->cancel();
+    thread->wait();
+
+    delete thread;
+}
+
+
+
+void XDFStatisticsView::finishCompute()
+{
+    char string[LN];
+
+    progress_bar->hide();
+
+    if (thread->computeStatus() == 0) {
+        XDFStatistics::format(thread->computeResult(), string, LN);
+        result_label->setText(QString(string).trimmed());
+    }
+    else if (thread->computeStatus() == 1)
+        result_label->setText("Canceled.");
+    else
+        result_label->setText("Unable to read the data, see the error output.");
+
+    result_label->show();
+
+    close_button->setText("Close");
+}
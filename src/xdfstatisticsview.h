@@ -0,0 +1,86 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFSTATISTICSVIEW_H
+#define XDFSTATISTICSVIEW_H
+
+#include <atomic>
+
+#include <qwidget.h>
+#include <qlabel.h>
+#include <qprogressbar.h>
+#include <qpushbutton.h>
+#include <qthread.h>
+
+#include "xdfv.h"
+#include "xdfstatistics.h"
+
+
+/*
+ * Computes XDFStatistics on a worker thread, emitting progressed() as the
+ * percentage done changes.
+ */
+class XDFStatisticsThread : public QThread, public XDFStatistics
+{
+    Q_OBJECT
+
+private:
+    std::atomic<bool> is_canceled;
+    int percent;
+
+    int status;
+    Result result;
+
+protected:
+    bool canceled();
+    void progress(long long n_done, long long n_total);
+
+    void run();
+
+public:
+    XDFStatisticsThread(XDFV::FileType file_type, const char *file_name,
+                        const char *object_name);
+
+    void cancel();
+
+    int computeStatus();
+    const Result &computeResult();
+
+signals:
+    void progressed(int percent);
+};
+
+
+
+/*
+ * A window that shows the statistics of an object, computed in the background
+ * with a progress bar until they are done.  Closing the window cancels the
+ * computation.
+ */
+class XDFStatisticsView : public QWidget
+{
+    Q_OBJECT
+
+private:
+    XDFStatisticsThread *thread;
+
+    QLabel *result_label;
+    QProgressBar *progress_bar;
+    QPushButton *close_button;
+
+public:
+    XDFStatisticsView(XDFV::FileType file_type, const char *file_name,
+                      const char *object_name, QWidget *parent = 0);
+    ~XDFStatisticsView();
+
+private slots:
+    void finishCompute();
+};
+
+#endif /* XDFSTATISTICSVIEW_H */
@@ -0,0 +1,175 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "xdfv.h"
+#include "xdfstringpool.h"
+
+
+XDFStringPool::XDFStringPool()
+    : table(NULL), table_size(0), n_entries(0), n_bytes_saved(0)
+{
+
+}
+
+
+
+XDFStringPool::~XDFStringPool()
+{
+    free(table);
+}
+
+
+
+/*
+ * FNV-1a.
+ */
+unsigned int XDFStringPool::hash(const char *s, int n)
+{
+    int i;
+
+    unsigned int h;
+
+    h = 2166136261u;
+    for (i = 0; i < n; ++i) {
+        h ^= (unsigned char) s[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+
+void XDFStringPool::grow()
+{
+    int i;
+    int j;
+    int n;
+
+    Entry *table2;
+
+    n = table_size == 0 ? 1024 : table_size * 2;
+
+    table2 = (Entry *) malloc(n * sizeof(Entry));
+    for (i = 0; i < n; ++i)
+        table2[i].id = -1;
+
+    for (i = 0; i < table_size; ++i) {
+        if (table[i].id < 0)
+            continue;
+
+        j = table[i].hash & (n - 1);
+        while (table2[j].id >= 0)
+            j = (j + 1) & (n - 1);
+
+        table2[j] = table[i];
+    }
+
+    free(table);
+
+    table      = table2;
+    table_size = n;
+}
+
+
+
+/*
+ * Adds s without looking for an equal string, for strings that are known to
+ * be unique.  Strings longer than max_string_size - 1 are truncated.
+ */
+int XDFStringPool::add(const char *s)
+{
+    int i;
+    int n;
+
+    n = strlen(s);
+    if (n > max_string_size - 1)
+        n = max_string_size - 1;
+
+    i = strings.allocate(n + 1);
+    if (i < 0) {
+        fprintf(stderr, "ERROR: XDFArena::allocate()\n");
+        exit(1);
+    }
+
+    memcpy(&strings[i], s, n);
+    strings[i + n] = '\0';
+
+    return i;
+}
+
+
+
+int XDFStringPool::intern(const char *s)
+{
+    int i;
+    int n;
+
+    unsigned int h;
+
+    n = strlen(s);
+    if (n > max_string_size - 1)
+        n = max_string_size - 1;
+
+    if (2 * (n_entries + 1) > table_size)
+        grow();
+
+    h = hash(s, n);
+
+    i = h & (table_size - 1);
+    while (table[i].id >= 0) {
+        if (table[i].hash == h && strncmp(&strings[table[i].id], s, n) == 0 &&
+            strings[table[i].id + n] == '\0') {
+            n_bytes_saved += n + 1;
+            return table[i].id;
+        }
+
+        i = (i + 1) & (table_size - 1);
+    }
+
+    table[i].hash = h;
+    table[i].id   = add(s);
+
+    n_entries++;
+
+    return table[i].id;
+}
+
+
+
+size_t XDFStringPool::capacity() const
+{
+    return strings.capacity() + table_size * sizeof(Entry);
+}
+
+
+
+/*
+ * The number of bytes that would have been used without interning.
+ */
+size_t XDFStringPool::bytesSaved() const
+{
+    return n_bytes_saved;
+}
+
+
+
+void XDFStringPool::clear()
+{
+    strings.clear();
+
+    free(table);
+
+    table         = NULL;
+    table_size    = 0;
+    n_entries     = 0;
+    n_bytes_saved = 0;
+}
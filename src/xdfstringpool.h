@@ -0,0 +1,59 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFSTRINGPOOL_H
+#define XDFSTRINGPOOL_H
+
+#include "xdfarena.h"
+
+
+/*
+ * Strings stored in an XDFArena and addressed by int id.  intern() returns
+ * the id of an equal string already in the pool, if any, so that names and
+ * values that repeat throughout a file are stored once.  As with XDFArena
+ * strings may be read by one thread while another adds to the pool.
+ */
+class XDFStringPool
+{
+private:
+    struct Entry {
+        unsigned int hash;
+        int id;
+    };
+
+    static const int max_string_size = 1 << 16;
+
+    XDFArena<char, 16> strings;
+
+    Entry *table;
+    int table_size;
+    int n_entries;
+
+    size_t n_bytes_saved;
+
+    static unsigned int hash(const char *s, int n);
+
+    void grow();
+
+public:
+    XDFStringPool();
+    ~XDFStringPool();
+
+    int add(const char *s);
+    int intern(const char *s);
+
+    const char *string(int id) const { return &strings[id]; }
+
+    size_t capacity() const;
+    size_t bytesSaved() const;
+
+    void clear();
+};
+
+#endif /* XDFSTRINGPOOL_H */
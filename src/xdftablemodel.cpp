@@ -0,0 +1,111 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include "xdfv.h"
+#include "xdftablemodel.h"
+#include "xdftableview.h"
+
+
+XDFTableModel::XDFTableModel(XDFTableView *view)
+    : QAbstractTableModel(view), view(view), i_row(0), n_rows(0), row_step(1),
+      i_col(0), n_cols(0), col_step(1)
+{
+
+}
+
+
+
+XDFTableModel::~XDFTableModel()
+{
+
+}
+
+
+
+/*
+ * Sets the shape of the table.  Rows and columns are labeled with their index
+ * in the dataset, starting at i_row and i_col and every row_step and col_step
+ * indices, unless labels are given.
+ */
+void XDFTableModel::setTable(int i_row_, int n_rows_, int row_step_,
+                             int i_col_, int n_cols_, int col_step_,
+                             const QStringList *v_labels_, const QStringList *h_labels_)
+{
+    beginResetModel();
+
+    i_row    = i_row_;
+    n_rows   = n_rows_;
+    row_step = row_step_;
+    i_col    = i_col_;
+    n_cols   = n_cols_;
+    col_step = col_step_;
+
+    v_labels = v_labels_ ? *v_labels_ : QStringList();
+    h_labels = h_labels_ ? *h_labels_ : QStringList();
+
+    endResetModel();
+}
+
+
+
+void XDFTableModel::cellsChanged()
+{
+    if (n_rows > 0 && n_cols > 0)
+        emit dataChanged(index(0, 0), index(n_rows - 1, n_cols - 1));
+}
+
+
+
+int XDFTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return n_rows;
+}
+
+
+
+int XDFTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return n_cols;
+}
+
+
+
+QVariant XDFTableModel::data(const QModelIndex &index, int role) const
+{
+    if (! index.isValid())
+        return QVariant();
+
+    return view->cellData(index.row(), index.column(), role);
+}
+
+
+
+QVariant XDFTableModel::headerData(int section, Qt::Orientation orientation,
+                                   int role) const
+{
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    if (orientation == Qt::Horizontal) {
+        if (section < h_labels.size())
+            return h_labels[section];
+        return QString::number(i_col + section * col_step);
+    }
+    else {
+        if (section < v_labels.size())
+            return v_labels[section];
+        return QString::number(i_row + section * row_step);
+    }
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFTABLEMODEL_H
+#define XDFTABLEMODEL_H
+
+#include <qabstractitemmodel.h>
+#include <qstringlist.h>
+
+
+class XDFTableView;
+
+
+/*
+ * The cells of the slice shown by an XDFTableView.  The model holds no data.
+ * Cells are formatted by the view on demand in XDFTableView::cellData() so
+ * that only the cells on screen are ever read and formatted.
+ */
+class XDFTableModel : public QAbstractTableModel
+{
+private:
+    XDFTableView *view;
+
+    int i_row;
+    int n_rows;
+    int row_step;
+    int i_col;
+    int n_cols;
+    int col_step;
+
+    QStringList v_labels;
+    QStringList h_labels;
+
+public:
+    XDFTableModel(XDFTableView *view);
+    ~XDFTableModel();
+
+    void setTable(int i_row, int n_rows, int row_step,
+                  int i_col, int n_cols, int col_step,
+                  const QStringList *v_labels, const QStringList *h_labels);
+    void cellsChanged();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+};
+
+#endif /* XDFTABLEMODEL_H */
@@ -7,28 +7,47 @@
  *
  ******************************************************************************/
 
+#include <math.h>
+
 #include <qboxlayout.h>
+#include <qcombobox.h>
 #include <qframe.h>
 #include <qgroupbox.h>
+#include <qheaderview.h>
 #include <qlineedit.h>
 #include <qmessagebox.h>
+#include <qmutex.h>
 #include <qpushbutton.h>
+#include <qspinbox.h>
+#include <qscrollbar.h>
+#include <qtimer.h>
 
 #include "xdfv.h"
+#include "xdfimageview.h"
+#include "xdfpyramid.h"
+#include "xdftablemodel.h"
 #include "xdftableview.h"
 
 
-XDFTableView::XDFTableView(QWidget *parent)
-    : QWidget(parent), column_width(110)
+XDFTableView::XDFTableView(XDFV::FileType file_type, QWidget *parent)
+    : QWidget(parent), column_width(110), file_type(file_type), notation_box(NULL),
+      precision_box(NULL), level_box(NULL), image_button(NULL), colormap_box(NULL),
+      table_view(NULL), table_model(NULL), image_view(NULL), slice_n_dims(0),
+      row_dim(-1), col_dim(-1), i_row(0), n_rows(0), i_col(0), n_cols(0), cell_size(0),
+      has_fill(false), fill_value(0.), cache_size(0), use_count(0), retry_posted(false), generation(0), scroll_row(0),
+      scroll_col(0), row_direction(0), col_direction(0), prefetch_posted(false), level(0)
 {
-
+    QObject::connect(this, SIGNAL(blocksPrefetched()), this, SLOT(addPrefetched()),
+                     Qt::QueuedConnection);
+    QObject::connect(XDFPyramidBuilder::instance(), SIGNAL(built(QByteArray)),
+                     this, SLOT(pyramidBuilt(QByteArray)), Qt::QueuedConnection);
 }
 
 
 
 XDFTableView::~XDFTableView()
 {
-
+    clearBlocks();
 }
 
 
@@ -40,9 +59,35 @@ int XDFTableView::columnWidth()
 
 
 
-QTableWidget *XDFTableView::tableWidget()
+QTableView *XDFTableView::tableView()
+{
+    return table_view;
+}
+
+
+
+size_t XDFTableView::cellSize()
+{
+    return cell_size;
+}
+
+
+
+/*
+ * Sets the fill value of the object shown, which readValues() leaves out of
+ * the pyramid and the image.
+ */
+void XDFTableView::setFillValue(bool has_fill_, double fill_value_)
 {
-    return table_widget;
+    has_fill   = has_fill_;
+    fill_value = fill_value_;
+}
+
+
+
+const XDFNumberFormat &XDFTableView::numberFormat()
+{
+    return number_format;
 }
 
 
@@ -80,6 +125,40 @@ void XDFTableView::buildWidget(const char *name, int n)
         QObject::connect(lineEdit[i], SIGNAL(returnPressed()), this, SLOT(refreshTable()));
     }
 
+    notation_box = new QComboBox(frame);
+    notation_box->addItem("Shortest");
+    notation_box->addItem("Fixed");
+    notation_box->addItem("Scientific");
+    notation_box->addItem("Hex");
+    horizontalLayout->addWidget(notation_box);
+    QObject::connect(notation_box, SIGNAL(activated(int)), this, SLOT(setNotation(int)));
+
+    precision_box = new QSpinBox(frame);
+    precision_box->setRange(0, XDFNumberFormat::max_precision);
+    precision_box->setValue(number_format.precision);
+    precision_box->setEnabled(false);
+    horizontalLayout->addWidget(precision_box);
+    QObject::connect(precision_box, SIGNAL(valueChanged(int)), this, SLOT(setPrecision(int)));
+
+    level_box = new QComboBox(frame);
+    level_box->addItem("Full resolution");
+    level_box->setEnabled(false);
+    horizontalLayout->addWidget(level_box);
+    QObject::connect(level_box, SIGNAL(activated(int)), this, SLOT(setLevel(int)));
+
+    image_button = new QPushButton("Image", frame);
+    image_button->setCheckable(true);
+    horizontalLayout->addWidget(image_button);
+    QObject::connect(image_button, SIGNAL(toggled(bool)), this, SLOT(showImage(bool)));
+
+    colormap_box = new QComboBox(frame);
+    colormap_box->addItem("Gray");
+    colormap_box->addItem("Jet");
+    colormap_box->addItem("Viridis");
+    colormap_box->setEnabled(false);
+    horizontalLayout->addWidget(colormap_box);
+    QObject::connect(colormap_box, SIGNAL(activated(int)), this, SLOT(setColormap(int)));
+
     pushButton = new QPushButton("Refresh", frame);
     horizontalLayout->addWidget(pushButton);
     QObject::connect(pushButton, SIGNAL(clicked()), this, SLOT(refreshTable()));
@@ -87,8 +166,23 @@ void XDFTableView::buildWidget(const char *name, int n)
     horizontalSpacer2 = new QSpacerItem(40, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
     horizontalLayout->addItem(horizontalSpacer2);
 
-    table_widget = new QTableWidget(this);
-    verticalLayout->addWidget(table_widget);
+    table_model = new XDFTableModel(this);
+
+    table_view = new QTableView(this);
+    table_view->setModel(table_model);
+    table_view->horizontalHeader()->setDefaultSectionSize(columnWidth());
+    verticalLayout->addWidget(table_view);
+
+    QObject::connect(table_view->verticalScrollBar(), SIGNAL(valueChanged(int)),
+                     this, SLOT(scrolled()));
+    QObject::connect(table_view->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+                     this, SLOT(scrolled()));
+    QObject::connect(table_view, SIGNAL(doubleClicked(const QModelIndex &)),
+                     this, SLOT(zoomIn(const QModelIndex &)));
+
+    image_view = new XDFImageView(this, this);
+    image_view->hide();
+    verticalLayout->addWidget(image_view);
 
     this->setWindowTitle(name);
 }
@@ -121,13 +215,23 @@ int XDFTableView::indexStringToSize_t(QString s, int i_dimen, size_t n, size_t *
 
 
 
-int XDFTableView::parseRange(int i, size_t dim, size_t *offset, size_t *count)
+/*
+ * Parses the range of dimension i, "i", "i1:i2", or "i1:i2:step" where blank
+ * sides default to the full range and a step of one.  Returns the first
+ * index, the number of indices selected, and the step between them.
+ */
+int XDFTableView::parseRange(int i, size_t dim, size_t *offset, size_t *count,
+                             size_t *stride)
 {
+    bool ok;
+
     int r;
 
+    size_t last;
+
     QStringList list = lineEdit[i]->text().split(":");
 
-    if (list.count() > 2) {
+    if (list.count() > 3) {
         QMessageBox crap(QMessageBox::Critical, "",
             QString("Invalid range: %1.").arg(lineEdit[i]->text().trimmed()),
             QMessageBox::Ok, this);
@@ -135,6 +239,8 @@ int XDFTableView::parseRange(int i, size_t dim, size_t *offset, size_t *count)
         return -1;
     }
 
+    *stride = 1;
+
     if (list.count() == 1) {
         r = indexStringToSize_t(list[0], i, dim, offset);
         if (r) return r;
@@ -149,12 +255,32 @@ int XDFTableView::parseRange(int i, size_t dim, size_t *offset, size_t *count)
         }
 
         if (list[1].trimmed() == "")
-            *count = dim - *offset;
+            last = dim - 1;
         else {
-            r = indexStringToSize_t(list[1], i, dim, count);
+            r = indexStringToSize_t(list[1], i, dim, &last);
             if (r) return r;
-            *count = *count - *offset + 1;
         }
+
+        if (list.count() == 3 && list[2].trimmed() != "") {
+            *stride = list[2].trimmed().toULong(&ok);
+            if (! ok || *stride == 0) {
+                QMessageBox crap(QMessageBox::Critical, "",
+                    QString("Invalid range step for dimension %1: %2.").
+                    arg(i).arg(list[2].trimmed()), QMessageBox::Ok, this);
+                crap.exec();
+                return -1;
+            }
+        }
+
+        if (last < *offset) {
+            QMessageBox crap(QMessageBox::Critical, "",
+                QString("Invalid range: %1.").arg(lineEdit[i]->text().trimmed()),
+                QMessageBox::Ok, this);
+            crap.exec();
+            return -1;
+        }
+
+        *count = (last - *offset) / *stride + 1;
     }
 
     return 0;
@@ -164,12 +290,15 @@ int XDFTableView::parseRange(int i, size_t dim, size_t *offset, size_t *count)
 
 int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_rows,
                              int *i_col, int *n_cols, size_t *offset, size_t *count,
-                             size_t *length)
+                             size_t *stride, size_t *length)
 {
     int i;
 
     int count2;
 
+    row_dim = -1;
+    col_dim = -1;
+
     if (n_dims == 0) {
         *i_row  = 0;
         *i_col  = 0;
@@ -180,9 +309,11 @@ int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_
         *length = 1;
     }
     else if (n_dims == 1) {
-        if (parseRange(0, dims[0], &offset[0], &count[0]))
+        if (parseRange(0, dims[0], &offset[0], &count[0], &stride[0]))
             return -1;
 
+        col_dim = 0;
+
         *i_row  = 0;
         *i_col  = offset[0];
 
@@ -192,11 +323,14 @@ int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_
         *length = count[0];
     }
     else if (n_dims == 2) {
-        if (parseRange(0, dims[0], &offset[0], &count[0]))
+        if (parseRange(0, dims[0], &offset[0], &count[0], &stride[0]))
             return -1;
-        if (parseRange(1, dims[1], &offset[1], &count[1]))
+        if (parseRange(1, dims[1], &offset[1], &count[1], &stride[1]))
             return -1;
 
+        row_dim = 0;
+        col_dim = 1;
+
         *i_row  = offset[0];
         *n_rows = count [0];
 
@@ -206,7 +340,7 @@ int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_
     else {
         count2 = 0;
         for (i = 0; i < n_dims; ++i) {
-            if (parseRange(i, dims[i], &offset[i], &count[i]))
+            if (parseRange(i, dims[i], &offset[i], &count[i], &stride[i]))
                 return -1;
             if (count[i] > 1)
                 count2++;
@@ -220,25 +354,34 @@ int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_
             return -1;
         }
 
-        *i_col  = 0;
-        *n_cols = 1;
-
+        /*
+         * The columns are the last dimension with a range and the rows the
+         * one before it, if any.
+         */
         for (i = n_dims - 1; i >= 0; --i) {
-            *i_col  = offset[i];
             if (count[i] > 1) {
-                *n_cols = count[i];
-                --i;
-                break;
+                if (col_dim < 0)
+                    col_dim = i;
+                else {
+                    row_dim = i;
+                    break;
+                }
             }
         }
 
-        *i_row  = 0;
-        *n_rows = 1;
+        if (col_dim < 0)
+            col_dim = n_dims - 1;
 
-        for (           ; i >= 0; --i) {
-            *i_row  = offset[i];
-            if (count[i] > 1)
-                *n_rows = count [i];
+        *i_col  = offset[col_dim];
+        *n_cols = count [col_dim];
+
+        if (row_dim < 0) {
+            *i_row  = 0;
+            *n_rows = 1;
+        }
+        else {
+            *i_row  = offset[row_dim];
+            *n_rows = count [row_dim];
         }
     }
 
@@ -246,6 +389,13 @@ int XDFTableView::parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_
     for (i = 0; i < n_dims; ++i)
         *length *= count[i];
 
+    slice_n_dims = n_dims;
+    for (i = 0; i < n_dims; ++i) {
+        slice_offset[i] = offset[i];
+        slice_count [i] = count [i];
+        slice_stride[i] = stride[i];
+    }
+
     return 0;
 }
 
@@ -258,30 +408,866 @@ void XDFTableView::refreshTable()
 
 
 
-void XDFTableView::configureTable(int i_row, int n_rows, int i_col, int n_cols,
-                                  QStringList *v_labels, QStringList *h_labels)
+/*
+ * Sets the table to the slice from the last parseSlice() with cells of
+ * cell_size bytes as read by readBlock().  The pyramid of the slice is taken
+ * from the cache or requested if the slice is large enough to need one.
+ */
+void XDFTableView::configureTable(int i_row_, int n_rows_, int i_col_, int n_cols_,
+                                  size_t cell_size_,
+                                  QStringList *v_labels_, QStringList *h_labels_)
+{
+    int i;
+
+    QByteArray key;
+
+    clearBlocks();
+
+    generation++;
+
+    scroll_row    = 0;
+    scroll_col    = 0;
+    row_direction = 0;
+    col_direction = 0;
+
+    i_row     = i_row_;
+    n_rows    = n_rows_;
+    i_col     = i_col_;
+    n_cols    = n_cols_;
+    cell_size = cell_size_;
+
+    v_labels = v_labels_ ? *v_labels_ : QStringList();
+    h_labels = h_labels_ ? *h_labels_ : QStringList();
+
+    table_model->setTable(i_row, n_rows, row_dim >= 0 ? slice_stride[row_dim] : 1,
+                          i_col, n_cols, col_dim >= 0 ? slice_stride[col_dim] : 1,
+                          &v_labels, &h_labels);
+
+    level       = 0;
+    pyramid     = XDFPyramid();
+    pyramid_key = QByteArray();
+
+    level_box->clear();
+    level_box->addItem("Full resolution");
+    level_box->setEnabled(false);
+    level_box->setToolTip(QString());
+
+    image_view->reset();
+
+    if (row_dim < 0 || col_dim < 0 || (qint64) n_rows * n_cols < min_pyramid_cells)
+        return;
+
+    key = datasetKey();
+    if (key.isEmpty())
+        return;
+
+    /*
+     * The pyramid is of the slice so the key is the dataset's key followed by
+     * the range of each dimension.
+     */
+    for (i = 0; i < slice_n_dims; ++i) {
+        key.append((const char *) &slice_offset[i], sizeof(size_t));
+        key.append((const char *) &slice_count [i], sizeof(size_t));
+        key.append((const char *) &slice_stride[i], sizeof(size_t));
+    }
+    key.append((const char *) &row_dim, sizeof(int));
+    key.append((const char *) &col_dim, sizeof(int));
+
+    pyramid_key = key;
+
+    if (XDFPyramid::find(pyramid_key, &pyramid))
+        showLevels();
+    else {
+        level_box->setToolTip("The overview of the slice is being built.");
+        XDFPyramidBuilder::instance()->request(this, generation, pyramid_key,
+                                               n_rows, n_cols);
+    }
+}
+
+
+
+/*
+ * Converts a block of the table to the offset, count, and stride of each
+ * dimension of the dataset for reading it.
+ */
+void XDFTableView::blockSlice(int row, int n_rows, int col, int n_cols,
+                              size_t *offset, size_t *count, size_t *stride)
+{
+    int i;
+
+    for (i = 0; i < slice_n_dims; ++i) {
+        offset[i] = slice_offset[i];
+        count [i] = slice_count [i];
+        stride[i] = slice_stride[i];
+    }
+
+    if (row_dim >= 0) {
+        offset[row_dim] += row * stride[row_dim];
+        count [row_dim]  = n_rows;
+    }
+
+    if (col_dim >= 0) {
+        offset[col_dim] += col * stride[col_dim];
+        count [col_dim]  = n_cols;
+    }
+}
+
+
+
+/*
+ * Reads the cells of a block of the table, n_rows by n_cols starting at row
+ * and col, into data, row by row, cell_size bytes per cell.  Called with the
+ * library lock held.
+ */
+int XDFTableView::readBlock(int row, int n_rows, int col, int n_cols, void *data)
+{
+    return -1;
+}
+
+
+
+/*
+ * Formats the cell in column col at ptr in a block, by default with the
+ * XDFKernel for cellType() and the number format of the view.  Called with the
+ * library lock held.
+ */
+QString XDFTableView::cellText(int col, const void *ptr)
+{
+    char temp[LN];
+
+    if (XDFKernel::format(cellType(col), ptr, temp, LN, number_format) < 0)
+        return QString();
+
+    return temp;
+}
+
+
+
+/*
+ * Returns the type of the cells in column col, resolved once when the table is
+ * configured, or XDFKernel::Unknown if the cells are not one of its types.
+ * Must not call the libraries.
+ */
+XDFKernel::Type XDFTableView::cellType(int col)
+{
+    return XDFKernel::Unknown;
+}
+
+
+
+/*
+ * Returns the key of the dataset for the XDFPyramid cache, see
+ * XDFTileCache::datasetKey(), or an empty key if the dataset does not get a
+ * pyramid.  Called with the library lock held.
+ */
+QByteArray XDFTableView::datasetKey()
+{
+    return QByteArray();
+}
+
+
+
+/*
+ * Returns true if readBlock() formats the cells into text as it reads them,
+ * in which case the blocks are read again when the number format changes.
+ */
+bool XDFTableView::cellsAreText()
+{
+    return false;
+}
+
+
+
+void XDFTableView::clearBlocks()
+{
+    QHash<qint64, Block>::iterator i;
+
+    for (i = blocks.begin(); i != blocks.end(); ++i)
+        free(i.value().data);
+
+    blocks.clear();
+
+    cache_size = 0;
+}
+
+
+
+qint64 XDFTableView::blockKey(int b_row, int b_col)
+{
+    return (qint64) b_row << 32 | b_col;
+}
+
+
+
+/*
+ * Returns the number of rows and columns of the block in block row b_row and
+ * block column b_col, which are less than a full block at the end of the table.
+ */
+void XDFTableView::blockSize(int b_row, int b_col, int *n_rows_, int *n_cols_)
+{
+    *n_rows_ = qMin(block_rows, n_rows - b_row * block_rows);
+    *n_cols_ = qMin(block_cols, n_cols - b_col * block_cols);
+}
+
+
+
+/*
+ * Adds a block to the cache, first evicting the least recently used blocks
+ * until it fits.
+ */
+XDFTableView::Block *XDFTableView::insertBlock(qint64 key, const Block &block)
+{
+    qint64 lru_key;
+
+    unsigned long long lru;
+
+    QHash<qint64, Block>::iterator i;
+
+    while (cache_size + block.size > max_cache_size && blocks.size() > 0) {
+        lru     = ~0ULL;
+        lru_key = 0;
+        for (i = blocks.begin(); i != blocks.end(); ++i) {
+            if (i.value().last_used < lru) {
+                lru     = i.value().last_used;
+                lru_key = i.key();
+            }
+        }
+
+        cache_size -= blocks[lru_key].size;
+        free(blocks[lru_key].data);
+        blocks.remove(lru_key);
+    }
+
+    cache_size += block.size;
+
+    i = blocks.insert(key, block);
+
+    return &i.value();
+}
+
+
+
+/*
+ * Returns a pointer to the cell at row and col, reading the block it is in
+ * if need be, or NULL if the block could not be read.
+ */
+const void *XDFTableView::cell(int row, int col)
+{
+    int b_row;
+    int b_col;
+    int b_n_rows;
+
+    qint64 key;
+
+    Block block;
+    Block *ptr;
+
+    QHash<qint64, Block>::iterator i;
+
+    b_row = row / block_rows;
+    b_col = col / block_cols;
+
+    key = blockKey(b_row, b_col);
+
+    i = blocks.find(key);
+    if (i != blocks.end())
+        ptr = &i.value();
+    else {
+        blockSize(b_row, b_col, &b_n_rows, &block.n_cols);
+        block.size = (size_t) b_n_rows * block.n_cols * cell_size;
+
+        block.data = malloc(block.size);
+        if (block.data == NULL)
+            fprintf(stderr, "ERROR: Memory allocation failed\n");
+        else if (readBlock(b_row * block_rows, b_n_rows, b_col * block_cols, block.n_cols,
+                           block.data)) {
+            fprintf(stderr, "ERROR: readBlock(), row = %d, col = %d\n",
+                    b_row * block_rows, b_col * block_cols);
+            free(block.data);
+            block.data = NULL;
+        }
+
+        ptr = insertBlock(key, block);
+    }
+
+    ptr->last_used = ++use_count;
+
+    if (ptr->data == NULL)
+        return NULL;
+
+    return (char *) ptr->data +
+           ((size_t) (row - b_row * block_rows) * ptr->n_cols + (col - b_col * block_cols)) *
+           cell_size;
+}
+
+
+
+/*
+ * Rather than block the GUI while a loader holds the library, cells are left
+ * blank and the table is repainted shortly.
+ */
+QVariant XDFTableView::cellData(int row, int col, int role)
+{
+    const void *ptr;
+
+    QString text;
+
+    QMutex *mutex;
+
+    if (level > 0)
+        return levelData(row, col, role);
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    mutex = XDFV::libraryMutex(file_type);
+
+    if (! mutex->tryLock()) {
+        if (! retry_posted) {
+            retry_posted = true;
+            QTimer::singleShot(retry_interval, this, SLOT(retryCells()));
+        }
+        return QVariant();
+    }
+
+    ptr = cell(row, col);
+    if (ptr != NULL)
+        text = cellText(col, ptr);
+
+    mutex->unlock();
+
+    return text;
+}
+
+
+
+void XDFTableView::retryCells()
+{
+    retry_posted = false;
+
+    table_model->cellsChanged();
+}
+
+
+
+/*
+ * Requests the blocks past the visible ones in the direction the table was
+ * last scrolled in, in each direction, that are not cached yet.
+ */
+void XDFTableView::scrolled()
+{
+    int i;
+    int j;
+    int k;
+
+    int first_row;
+    int last_row;
+    int first_col;
+    int last_col;
+
+    int n_block_rows;
+    int n_block_cols;
+
+    QList<QPair<int, int> > requests;
+
+    if (n_rows == 0 || n_cols == 0 || level > 0)
+        return;
+
+    first_row = table_view->rowAt(0);
+    if (first_row < 0)
+        first_row = 0;
+    last_row = table_view->rowAt(table_view->viewport()->height() - 1);
+    if (last_row < 0)
+        last_row = n_rows - 1;
+
+    first_col = table_view->columnAt(0);
+    if (first_col < 0)
+        first_col = 0;
+    last_col = table_view->columnAt(table_view->viewport()->width() - 1);
+    if (last_col < 0)
+        last_col = n_cols - 1;
+
+    if (first_row != scroll_row)
+        row_direction = first_row > scroll_row ? 1 : -1;
+    if (first_col != scroll_col)
+        col_direction = first_col > scroll_col ? 1 : -1;
+
+    scroll_row = first_row;
+    scroll_col = first_col;
+
+    first_row /= block_rows;
+    last_row  /= block_rows;
+    first_col /= block_cols;
+    last_col  /= block_cols;
+
+    n_block_rows = (n_rows + block_rows - 1) / block_rows;
+    n_block_cols = (n_cols + block_cols - 1) / block_cols;
+
+    for (k = 1; k <= prefetch_blocks && row_direction != 0; ++k) {
+        i = row_direction > 0 ? last_row + k : first_row - k;
+        if (i < 0 || i >= n_block_rows)
+            break;
+        for (j = first_col; j <= last_col; ++j) {
+            if (! blocks.contains(blockKey(i, j)))
+                requests.append(qMakePair(i, j));
+        }
+    }
+
+    for (k = 1; k <= prefetch_blocks && col_direction != 0; ++k) {
+        j = col_direction > 0 ? last_col + k : first_col - k;
+        if (j < 0 || j >= n_block_cols)
+            break;
+        for (i = first_row; i <= last_row; ++i) {
+            if (! blocks.contains(blockKey(i, j)))
+                requests.append(qMakePair(i, j));
+        }
+    }
+
+    XDFTablePrefetcher::instance()->request(this, generation, requests);
+}
+
+
+
+/*
+ * Reads a block for the XDFTablePrefetcher and posts it to the view, unless
+ * the table has been configured again since it was requested.  Called on the
+ * prefetcher's thread with the library lock held.
+ */
+void XDFTableView::prefetchBlock(int generation_, int b_row, int b_col)
 {
-    tableWidget()->setRowCount(n_rows);
-    tableWidget()->setColumnCount(n_cols);
+    int b_n_rows;
 
-    if (v_labels == NULL) {
-        QStringList v_labels_;
-        for (int i = 0; i < n_rows; ++i)
-            v_labels_ << QString("%1").arg(i_row + i);
-        tableWidget()->setVerticalHeaderLabels(v_labels_);
+    Prefetched p;
+
+    if (generation_ != generation)
+        return;
+
+    blockSize(b_row, b_col, &b_n_rows, &p.block.n_cols);
+
+    p.generation = generation_;
+    p.key        = blockKey(b_row, b_col);
+    p.block.size = (size_t) b_n_rows * p.block.n_cols * cell_size;
+
+    p.block.data = malloc(p.block.size);
+    if (p.block.data == NULL)
+        return;
+
+    if (readBlock(b_row * block_rows, b_n_rows, b_col * block_cols, p.block.n_cols,
+                  p.block.data)) {
+        free(p.block.data);
+        return;
     }
-    else
-        tableWidget()->setVerticalHeaderLabels(*v_labels);
 
-    if (h_labels == NULL) {
-        QStringList h_labels_;
-        for (int i = 0; i < n_cols; ++i)
-            h_labels_ << QString("%1").arg(i_col + i);
-        tableWidget()->setHorizontalHeaderLabels(h_labels_);
+    prefetch_mutex.lock();
+    prefetched.append(p);
+    if (! prefetch_posted) {
+        prefetch_posted = true;
+        emit blocksPrefetched();
     }
-    else
-        tableWidget()->setHorizontalHeaderLabels(*h_labels);
+    prefetch_mutex.unlock();
+}
+
+
+
+void XDFTableView::addPrefetched()
+{
+    int i;
+
+    QList<Prefetched> list;
+
+    prefetch_mutex.lock();
+    list = prefetched;
+    prefetched.clear();
+    prefetch_posted = false;
+    prefetch_mutex.unlock();
+
+    for (i = 0; i < list.size(); ++i) {
+        if (list[i].generation != generation || blocks.contains(list[i].key))
+            free(list[i].block.data);
+        else
+            insertBlock(list[i].key, list[i].block)->last_used = ++use_count;
+    }
+}
+
+
+
+/*
+ * Drops the view's prefetch and pyramid requests and waits for the block
+ * being read for it, if any.  Must be called at the start of the destructors
+ * of the format specific views, before they take the library lock, as the
+ * prefetcher and the pyramid builder call their readBlock().
+ */
+void XDFTableView::stopPrefetch()
+{
+    int i;
+
+    XDFTablePrefetcher::instance()->cancel(this);
+    XDFPyramidBuilder::instance()->cancel(this);
+
+    prefetch_mutex.lock();
+    for (i = 0; i < prefetched.size(); ++i)
+        free(prefetched[i].block.data);
+    prefetched.clear();
+    prefetch_mutex.unlock();
+}
+
+
+
+/*
+ * Reads the cells of a block of the table, as readBlock(), and converts them to
+ * values for the XDFPyramidBuilder, a column at a time, unless the table has
+ * been configured again since the pyramid was requested.  Fill values are
+ * returned as NaN so that they are left out like other values that are not
+ * finite.  Called on the builder's thread with the library lock held.
+ */
+int XDFTableView::readValues(int generation_, int row, int n_rows_, int col, int n_cols_,
+                             double *values)
+{
+    int j;
+
+    size_t i;
+    size_t n;
+
+    char *data;
+
+    if (generation_ != generation)
+        return -1;
+
+    data = (char *) malloc((size_t) n_rows_ * n_cols_ * cell_size);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: Memory allocation failed\n");
+        return -1;
+    }
+
+    if (readBlock(row, n_rows_, col, n_cols_, data)) {
+        fprintf(stderr, "ERROR: readBlock(), row = %d, col = %d\n", row, col);
+        free(data);
+        return -1;
+    }
+
+    for (j = 0; j < n_cols_; ++j) {
+        if (XDFKernel::toDouble(cellType(col + j), data + j * cell_size, n_rows_,
+                                n_cols_ * cell_size, values + j, n_cols_) < 0) {
+            free(data);
+            return -1;
+        }
+    }
+
+    free(data);
+
+    if (has_fill) {
+        n = (size_t) n_rows_ * n_cols_;
+        for (i = 0; i < n; ++i) {
+            if (values[i] == fill_value)
+                values[i] = NAN;
+        }
+    }
+
+    return 0;
+}
+
+
+
+void XDFTableView::showLevels()
+{
+    int i;
+
+    level_box->clear();
+    level_box->addItem("Full resolution");
+    for (i = 0; i < pyramid.levelCount(); ++i)
+        level_box->addItem(QString("1:%1").arg(pyramid.level(i).factor));
+    level_box->setEnabled(true);
+    level_box->setToolTip(QString());
+}
+
+
+
+/*
+ * Cells of a level show the mean with the minimum and maximum in the tool tip.
+ * Cells with no finite values are left blank.
+ */
+QVariant XDFTableView::levelData(int row, int col, int role)
+{
+    int i;
+
+    const XDFPyramid::Level &l = pyramid.level(level - 1);
+
+    i = row * l.n_cols + col;
+
+    if (l.count[i] == 0)
+        return QVariant();
+
+    if (role == Qt::DisplayRole)
+        return QString::number(l.mean[i], 'g', 7);
+
+    if (role == Qt::ToolTipRole)
+        return QString("min = %1\nmax = %2\nmean = %3\nn = %4").
+               arg(l.min[i], 0, 'g', 7).arg(l.max[i], 0, 'g', 7).
+               arg(l.mean[i], 0, 'g', 7).arg(l.count[i]);
+
+    return QVariant();
+}
+
+
+
+/*
+ * Shows level level_ of the pyramid, or the full resolution cells for level 0.
+ * The rows and columns of a level are labeled with the index of their first
+ * element.
+ */
+void XDFTableView::setLevel(int level_)
+{
+    if (level_ == level || level_ > pyramid.levelCount())
+        return;
+
+    level = level_;
+
+    level_box->setCurrentIndex(level);
+
+    if (level == 0) {
+        table_model->setTable(i_row, n_rows, slice_stride[row_dim],
+                              i_col, n_cols, slice_stride[col_dim], &v_labels, &h_labels);
+        return;
+    }
+
+    const XDFPyramid::Level &l = pyramid.level(level - 1);
+
+    table_model->setTable(i_row, l.n_rows, slice_stride[row_dim] * l.factor,
+                          i_col, l.n_cols, slice_stride[col_dim] * l.factor, NULL, NULL);
+}
+
+
+
+/*
+ * Goes from a cell of a level to the first of its full resolution cells.
+ */
+void XDFTableView::zoomIn(const QModelIndex &index)
+{
+    int row;
+    int col;
+
+    if (level == 0 || ! index.isValid())
+        return;
+
+    row = index.row()    * pyramid.level(level - 1).factor;
+    col = index.column() * pyramid.level(level - 1).factor;
+
+    setLevel(0);
+
+    table_view->scrollTo(table_model->index(row, col), QAbstractItemView::PositionAtCenter);
+    table_view->setCurrentIndex(table_model->index(row, col));
+}
+
 
-    for (int i = 0; i < n_cols; ++i)
-        tableWidget()->setColumnWidth(i, columnWidth());
+
+void XDFTableView::pyramidBuilt(QByteArray key)
+{
+    if (key != pyramid_key || pyramid.levelCount() > 0)
+        return;
+
+    if (XDFPyramid::find(pyramid_key, &pyramid)) {
+        showLevels();
+        image_view->refresh();
+    }
+}
+
+
+
+/*
+ * Switches between the table and the image of the slice.
+ */
+void XDFTableView::showImage(bool show)
+{
+    table_view->setVisible(! show);
+    image_view->setVisible(show);
+    colormap_box->setEnabled(show);
+}
+
+
+
+void XDFTableView::setColormap(int colormap)
+{
+    image_view->setColormap((XDFImageView::Colormap) colormap);
+}
+
+
+
+/*
+ * Only the formatting changes, the cached blocks are kept and the cells are
+ * formatted again as they are repainted, unless they are already text.
+ */
+void XDFTableView::setNotation(int notation)
+{
+    number_format.notation = (XDFNumberFormat::Notation) notation;
+
+    precision_box->setEnabled(notation == XDFNumberFormat::Fixed ||
+                              notation == XDFNumberFormat::Scientific);
+
+    formatChanged();
+}
+
+
+
+void XDFTableView::setPrecision(int precision)
+{
+    number_format.precision = precision;
+
+    formatChanged();
+}
+
+
+
+void XDFTableView::formatChanged()
+{
+    if (cellsAreText()) {
+        clearBlocks();
+        generation++;
+    }
+
+    table_model->cellsChanged();
+}
+
+
+
+XDFTablePrefetcher::XDFTablePrefetcher()
+    : current(NULL), is_canceled(false), is_stopping(false)
+{
+
+}
+
+
+
+XDFTablePrefetcher *XDFTablePrefetcher::instance()
+{
+    static XDFTablePrefetcher *prefetcher = new XDFTablePrefetcher;
+
+    return prefetcher;
+}
+
+
+
+/*
+ * Replaces the view's queued requests with blocks, given as block row and
+ * block column.  The oldest requests are dropped past max_requests.
+ */
+void XDFTablePrefetcher::request(XDFTableView *view, int generation,
+                                 const QList<QPair<int, int> > &blocks)
+{
+    int i;
+
+    Request request;
+
+    QMutexLocker locker(&mutex);
+
+    i = 0;
+    while (i < requests.size()) {
+        if (requests[i].view == view)
+            requests.removeAt(i);
+        else
+            ++i;
+    }
+
+    for (i = 0; i < blocks.size(); ++i) {
+        request.view       = view;
+        request.generation = generation;
+        request.b_row      = blocks[i].first;
+        request.b_col      = blocks[i].second;
+        requests.append(request);
+    }
+
+    while (requests.size() > max_requests)
+        requests.removeFirst();
+
+    if (! requests.isEmpty() && ! isRunning())
+        start();
+
+    changed.wakeAll();
+}
+
+
+
+/*
+ * Drops the view's queued requests and waits for the block being read for it,
+ * if any.
+ */
+void XDFTablePrefetcher::cancel(XDFTableView *view)
+{
+    int i;
+
+    QMutexLocker locker(&mutex);
+
+    i = 0;
+    while (i < requests.size()) {
+        if (requests[i].view == view)
+            requests.removeAt(i);
+        else
+            ++i;
+    }
+
+    if (current == view) {
+        is_canceled = true;
+        while (current == view)
+            changed.wait(&mutex);
+    }
+}
+
+
+
+void XDFTablePrefetcher::stop()
+{
+    mutex.lock();
+    is_stopping = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
+
+
+
+void XDFTablePrefetcher::run()
+{
+    bool locked;
+
+    QMutex *library_mutex;
+
+    Request request;
+
+    for ( ; ; ) {
+        mutex.lock();
+        while (requests.isEmpty() && ! is_stopping)
+            changed.wait(&mutex);
+        if (is_stopping) {
+            mutex.unlock();
+            break;
+        }
+        request = requests.takeFirst();
+        current = request.view;
+        is_canceled = false;
+        mutex.unlock();
+
+        /*
+         * A tree loader may hold the library for a long time so check now and
+         * then whether the view is going away.
+         */
+        library_mutex = XDFV::libraryMutex(request.view->file_type);
+
+        locked = false;
+        while (! is_stopping && ! is_canceled) {
+            locked = library_mutex->tryLock(lock_interval);
+            if (locked)
+                break;
+        }
+
+        if (locked) {
+            request.view->prefetchBlock(request.generation, request.b_row, request.b_col);
+
+            library_mutex->unlock();
+        }
+
+        mutex.lock();
+        current = NULL;
+        changed.wakeAll();
+        mutex.unlock();
+    }
 }
@@ -10,41 +10,245 @@
 #ifndef XDFTABLEVIEW_H
 #define XDFTABLEVIEW_H
 
+#include <atomic>
+
+#include <qbytearray.h>
+#include <qcombobox.h>
+#include <qhash.h>
 #include <qlineedit.h>
-#include <qtablewidget.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qpair.h>
+#include <qpushbutton.h>
+#include <qspinbox.h>
+#include <qstringlist.h>
+#include <qtableview.h>
+#include <qthread.h>
+#include <qwaitcondition.h>
 #include <qwidget.h>
 
+#include "xdfv.h"
+#include "xdfkernel.h"
+#include "xdfnumberformat.h"
+#include "xdfpyramid.h"
+
+
+class XDFTableModel;
+class XDFImageView;
+class XDFPyramidBuilder;
+class XDFTablePrefetcher;
+
+
+/*
+ * A table of a one or two dimensional slice of a dataset.  Nothing is read when
+ * the slice is set.  Instead the cells are read by the format specific views in
+ * blocks of block_rows by block_cols with readBlock() as they are first
+ * displayed and formatted one at a time with cellText(), with the type of the
+ * cells of a column resolved beforehand by cellType() and the notation chosen
+ * for the view as an XDFNumberFormat.  Blocks are kept, least recently used
+ * first out, up to max_cache_size bytes.  As the table is scrolled the next
+ * prefetch_blocks blocks in the direction of the scroll are read ahead by the
+ * XDFTablePrefetcher.  For large two dimensional slices an XDFPyramid is built
+ * in the background, after which the table can be switched to one of its levels
+ * to see the whole slice at once, and a cell of a level double clicked to zoom
+ * back into the full resolution cells.  The slice can also be shown as an image
+ * with an XDFImageView.
+ */
 class XDFTableView : public QWidget
 {
     Q_OBJECT
 
+    friend class XDFImageView;
+    friend class XDFPyramidBuilder;
+    friend class XDFTablePrefetcher;
+
 private:
+    struct Block {
+        void *data;
+        size_t size;
+        int n_cols;
+        unsigned long long last_used;
+    };
+
+    struct Prefetched {
+        int generation;
+        qint64 key;
+        Block block;
+    };
+
+    static const int block_rows = 128;
+    static const int block_cols = 128;
+
+    static const size_t max_cache_size = 64 * 1024 * 1024;
+
+    static const int retry_interval = 100;
+
+    static const int prefetch_blocks = 2;
+
+    static const int min_pyramid_cells = 1 << 20;
+
     int column_width;
 
+    XDFV::FileType file_type;
+
     QLineEdit *lineEdit[8];
-    QTableWidget *table_widget;
+    QComboBox *notation_box;
+    QSpinBox *precision_box;
+    QComboBox *level_box;
+    QPushButton *image_button;
+    QComboBox *colormap_box;
+    QTableView *table_view;
+    XDFTableModel *table_model;
+    XDFImageView *image_view;
+
+    int slice_n_dims;
+    size_t slice_offset[8];
+    size_t slice_count[8];
+    size_t slice_stride[8];
+    int row_dim;
+    int col_dim;
+
+    int i_row;
+    int n_rows;
+    int i_col;
+    int n_cols;
+    size_t cell_size;
+    bool has_fill;
+    double fill_value;
+    XDFNumberFormat number_format;
+    QStringList v_labels;
+    QStringList h_labels;
+
+    QHash<qint64, Block> blocks;
+    size_t cache_size;
+    unsigned long long use_count;
+
+    bool retry_posted;
+
+    int generation;
+
+    int scroll_row;
+    int scroll_col;
+    int row_direction;
+    int col_direction;
+
+    QMutex prefetch_mutex;
+    QList<Prefetched> prefetched;
+    bool prefetch_posted;
+
+    int level;
+    XDFPyramid pyramid;
+    QByteArray pyramid_key;
 
     int indexStringToSize_t(QString s, int i_dimen, size_t n, size_t *i);
-    int parseRange(int i, size_t dim, size_t *offset, size_t *count);
+    int parseRange(int i, size_t dim, size_t *offset, size_t *count, size_t *stride);
+
+    static qint64 blockKey(int b_row, int b_col);
+    void blockSize(int b_row, int b_col, int *n_rows, int *n_cols);
+    Block *insertBlock(qint64 key, const Block &block);
+
+    const void *cell(int row, int col);
+    void clearBlocks();
+    void formatChanged();
+
+    void prefetchBlock(int generation, int b_row, int b_col);
+
+    int readValues(int generation, int row, int n_rows, int col, int n_cols,
+                   double *values);
+    void showLevels();
+    QVariant levelData(int row, int col, int role);
 
 protected:
-    QTableWidget *tableWidget();
+    QTableView *tableView();
+    size_t cellSize();
+    void setFillValue(bool has_fill, double fill_value);
+    const XDFNumberFormat &numberFormat();
     void buildWidget(const char *, int n);
     int parseSlice(int n_dims, const size_t *dims, int *i_row, int *n_rows,
                    int *i_col, int *n_cols, size_t *offset, size_t *count,
-                   size_t *length);
+                   size_t *stride, size_t *length);
     void configureTable(int i_row, int n_rows, int i_col, int n_cols,
+                        size_t cell_size,
                         QStringList *v_labels = NULL,
                         QStringList *h_labels = NULL);
+    void blockSlice(int row, int n_rows, int col, int n_cols,
+                    size_t *offset, size_t *count, size_t *stride);
+    void stopPrefetch();
+
+    virtual int readBlock(int row, int n_rows, int col, int n_cols, void *data);
+    virtual QString cellText(int col, const void *ptr);
+    virtual XDFKernel::Type cellType(int col);
+    virtual QByteArray datasetKey();
+    virtual bool cellsAreText();
 
 public:
-    XDFTableView(QWidget *parent = 0);
+    XDFTableView(XDFV::FileType file_type, QWidget *parent = 0);
     ~XDFTableView();
 
     int columnWidth();
 
+    QVariant cellData(int row, int col, int role);
+
+signals:
+    void blocksPrefetched();
+
 public slots:
     void refreshTable();
+
+private slots:
+    void retryCells();
+    void scrolled();
+    void addPrefetched();
+    void setNotation(int notation);
+    void setPrecision(int precision);
+    void setLevel(int level);
+    void showImage(bool show);
+    void setColormap(int colormap);
+    void zoomIn(const QModelIndex &index);
+    void pyramidBuilt(QByteArray key);
+};
+
+
+
+/*
+ * Reads blocks ahead of the table views with XDFTableView::prefetchBlock() on
+ * a single worker thread shared by all the views, so that the libraries are
+ * never entered by more than one prefetch at a time and a view's next blocks
+ * are usually read by the time they are scrolled into view.  A view's
+ * requests replace its earlier requests that have not been read yet.
+ */
+class XDFTablePrefetcher : public QThread
+{
+private:
+    struct Request {
+        XDFTableView *view;
+        int generation;
+        int b_row;
+        int b_col;
+    };
+
+    static const int max_requests  = 64;
+    static const int lock_interval = 100;
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QList<Request> requests;
+    XDFTableView *current;
+    std::atomic<bool> is_canceled;
+    std::atomic<bool> is_stopping;
+
+    XDFTablePrefetcher();
+
+protected:
+    void run();
+
+public:
+    static XDFTablePrefetcher *instance();
+
+    void request(XDFTableView *view, int generation,
+                 const QList<QPair<int, int> > &blocks);
+    void cancel(XDFTableView *view);
+    void stop();
 };
 
 #endif /* XDFTABLEVIEW_H */
@@ -7,7 +7,13 @@
  *
  ******************************************************************************/
 
+#include <algorithm>
+
+#include <qboxlayout.h>
 #include <qmenu.h>
+#include <qprogressbar.h>
+#include <qtabbar.h>
+#include <qtoolbutton.h>
 
 #include "xdfv.h"
 #include "xdftabtreeview.h"
@@ -15,7 +21,7 @@
 
 
 XDFTabTreeView::XDFTabTreeView(QWidget *parent)
-    : QTabWidget(parent), default_expanded(false), is_colorized(false)
+    : QTabWidget(parent), default_expanded(false), lazy_load(false), is_colorized(false)
 {
     setTabsClosable(true);
 /*
@@ -69,26 +75,83 @@ void XDFTabTreeView::copyItemName()
 
 
 
-void XDFTabTreeView::find(QString &name)
+/*
+ * Selects the next node that matches query, from the current node of the
+ * current tab on through the tabs after it.
+ */
+void XDFTabTreeView::find(const XDFSearchQuery &query)
 {
-    if (count() > 0)
-        ((XDFTreeView *) currentWidget())->find(name);
+    for (int i = currentIndex(); i >= 0 && i < count(); ++i) {
+        if (((XDFTreeView *) widget(i))->find(query, i != currentIndex())) {
+            setCurrentIndex(i);
+            return;
+        }
+    }
 }
 
 
 
-void XDFTabTreeView::findPrev(QString &name)
+void XDFTabTreeView::findPrev(const XDFSearchQuery &query)
 {
-    if (count() > 0)
-        ((XDFTreeView *) currentWidget())->findPrev(name);
+    for (int i = currentIndex(); i >= 0; --i) {
+        if (((XDFTreeView *) widget(i))->findPrev(query, i != currentIndex())) {
+            setCurrentIndex(i);
+            return;
+        }
+    }
 }
 
 
 
-void XDFTabTreeView::selectAll(QString &name)
+void XDFTabTreeView::selectAll(const XDFSearchQuery &query)
 {
     if (count() > 0)
-        ((XDFTreeView *) currentWidget())->selectAll(name);
+        ((XDFTreeView *) currentWidget())->selectAll(query);
+}
+
+
+
+static bool hit_less(const XDFSearchHit &a, const XDFSearchHit &b)
+{
+    return a.rank < b.rank;
+}
+
+
+
+/*
+ * Appends the nodes of all tabs that match query to hits, best ranked first
+ * and in the order of the tabs within a rank.  Returns how many were found.
+ */
+int XDFTabTreeView::search(const XDFSearchQuery &query, QVector<XDFSearchHit> &hits)
+{
+    int n;
+
+    n = hits.size();
+
+    for (int i = 0; i < count(); ++i)
+        ((XDFTreeView *) widget(i))->search(query, hits);
+
+    std::stable_sort(hits.begin() + n, hits.end(), hit_less);
+
+    return hits.size() - n;
+}
+
+
+
+/*
+ * Shows the tab of a hit and selects its node if both are still there.
+ */
+void XDFTabTreeView::showHit(const XDFSearchHit &hit)
+{
+    int index;
+
+    index = indexOf(hit.view);
+    if (index < 0)
+        return;
+
+    setCurrentIndex(index);
+
+    hit.view->selectNode(hit.id);
 }
 
 
@@ -107,6 +170,20 @@ bool XDFTabTreeView::defaultExpanded()
 
 
 
+void XDFTabTreeView::setLazyLoad(bool lazy)
+{
+     lazy_load = lazy;
+}
+
+
+
+bool XDFTabTreeView::lazyLoad()
+{
+     return lazy_load;
+}
+
+
+
 void XDFTabTreeView::expandAll()
 {
     if (count() > 0)
@@ -147,6 +224,71 @@ void XDFTabTreeView::showDataTable()
 
 
 
+/*
+ * Puts a progress bar and a cancel button on the tab of a view that is
+ * loading.  They are removed when the view emits loadFinished().
+ */
+void XDFTabTreeView::showLoadProgress(XDFTreeView *view)
+{
+    int index;
+
+    QWidget *widget;
+    QHBoxLayout *layout;
+    QProgressBar *progress_bar;
+    QToolButton *cancel_button;
+
+    index = indexOf(view);
+    if (index < 0 || ! view->isLoading())
+        return;
+
+    widget = new QWidget(tabBar());
+
+    layout = new QHBoxLayout(widget);
+    layout->setSpacing(2);
+    layout->setContentsMargins(0,0,0,0);
+
+    progress_bar = new QProgressBar(widget);
+    progress_bar->setRange(0, 0);
+    progress_bar->setTextVisible(false);
+    progress_bar->setFixedSize(48, 12);
+    layout->addWidget(progress_bar);
+
+    cancel_button = new QToolButton(widget);
+    cancel_button->setText("x");
+    cancel_button->setToolTip("Cancel loading");
+    cancel_button->setAutoRaise(true);
+    layout->addWidget(cancel_button);
+
+    tabBar()->setTabButton(index, QTabBar::LeftSide, widget);
+
+    QObject::connect(view, SIGNAL(loadRangeChanged(int, int)), progress_bar, SLOT(setRange(int, int)));
+    QObject::connect(view, SIGNAL(loadProgress(int)),          progress_bar, SLOT(setValue(int)));
+    QObject::connect(cancel_button, SIGNAL(clicked()),         view,         SLOT(cancelLoad()));
+    QObject::connect(view, SIGNAL(loadFinished(int)),          this,         SLOT(hideLoadProgress()), Qt::UniqueConnection);
+}
+
+
+
+void XDFTabTreeView::hideLoadProgress()
+{
+    int index;
+
+    QWidget *widget;
+
+    index = indexOf((QWidget *) sender());
+    if (index < 0)
+        return;
+
+    widget = tabBar()->tabButton(index, QTabBar::LeftSide);
+    if (widget == NULL)
+        return;
+
+    tabBar()->setTabButton(index, QTabBar::LeftSide, NULL);
+    widget->deleteLater();
+}
+
+
+
 void XDFTabTreeView::changeToNextTab()
 {
     setCurrentIndex(currentIndex() + 1);
@@ -164,6 +306,7 @@ void XDFTabTreeView::changeToPreviousTab()
 
 void XDFTabTreeView::closeTab(int index)
 {
+        ((XDFTreeView *) widget(index))->stopLoad();
         removeTab(index);
 }
 
@@ -172,7 +315,7 @@ void XDFTabTreeView::closeTab(int index)
 void XDFTabTreeView::closeCurrentTab()
 {
     if (count() > 0)
-        removeTab(indexOf(currentWidget()));
+        closeTab(indexOf(currentWidget()));
 }
 
 
@@ -11,6 +11,9 @@
 #define XDFTABTREEVIEW_H
 
 #include <qtabwidget.h>
+#include <qvector.h>
+
+#include "xdftreeview.h"
 
 
 class XDFTabTreeView : public QTabWidget
@@ -19,6 +22,7 @@ class XDFTabTreeView : public QTabWidget
 
 private:
     bool default_expanded;
+    bool lazy_load;
 
     int font_size;
     int default_font_size;
@@ -30,12 +34,19 @@ public:
     ~XDFTabTreeView();
 
     bool defaultExpanded();
+    bool lazyLoad();
 
     int fontSize();
     int defaultFontSize();
 
     bool isColorized();
 
+    void find(const XDFSearchQuery &query);
+    void findPrev(const XDFSearchQuery &query);
+    void selectAll(const XDFSearchQuery &query);
+    int search(const XDFSearchQuery &query, QVector<XDFSearchHit> &hits);
+    void showHit(const XDFSearchHit &hit);
+
 signals:
     void colorizedChanged(bool);
 
@@ -44,11 +55,8 @@ public slots:
 
     void copyItemName();
 
-    void find(QString &name);
-    void findPrev(QString &name);
-    void selectAll(QString &name);
-
     void setDefaultExpanded(bool expanded);
+    void setLazyLoad(bool lazy);
     void expandAll();
     void expandAllTabs();
     void collapseAll();
@@ -56,6 +64,9 @@ public slots:
 
     void showDataTable();
 
+    void showLoadProgress(XDFTreeView *view);
+    void hideLoadProgress();
+
     void changeToNextTab();
     void changeToPreviousTab();
     void closeTab(int index);
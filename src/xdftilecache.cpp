@@ -0,0 +1,238 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qmutex.h>
+
+#include "xdfv.h"
+#include "xdftilecache.h"
+
+
+QMutex XDFTileCache::mutex;
+QHash<QByteArray, XDFTileCache::Tile> XDFTileCache::tiles;
+std::list<QByteArray> XDFTileCache::uses;
+
+size_t XDFTileCache::max_size = 256 * 1024 * 1024;
+size_t XDFTileCache::cache_size = 0;
+
+
+
+void XDFTileCache::setMaxSize(size_t size)
+{
+    QMutexLocker locker(&mutex);
+
+    max_size = size;
+
+    evict(0);
+}
+
+
+
+size_t XDFTileCache::maxSize()
+{
+    QMutexLocker locker(&mutex);
+
+    return max_size;
+}
+
+
+
+/*
+ * The size and modification time of the file are part of the key so that the
+ * tiles of a file that has changed are not found again and age out.
+ */
+QByteArray XDFTileCache::datasetKey(const char *file_name, const char *dataset_name)
+{
+    char temp[LN];
+
+    struct stat st;
+
+    QByteArray key;
+
+    if (stat(file_name, &st) < 0)
+        memset(&st, 0, sizeof(st));
+
+    snprintf(temp, LN, "%lld:%lld.%09ld:", (long long) st.st_size,
+             (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+
+    key.append(file_name, strlen(file_name) + 1);
+    key.append(temp, strlen(temp));
+    key.append(dataset_name, strlen(dataset_name) + 1);
+
+    return key;
+}
+
+
+
+QByteArray XDFTileCache::tileKey(const QByteArray &dataset_key, int n_dims,
+                                 const size_t *coords)
+{
+    QByteArray key = dataset_key;
+
+    key.append((const char *) coords, n_dims * sizeof(size_t));
+
+    return key;
+}
+
+
+
+bool XDFTileCache::find(const QByteArray &key, QByteArray *data)
+{
+    QHash<QByteArray, Tile>::iterator i;
+
+    QMutexLocker locker(&mutex);
+
+    i = tiles.find(key);
+    if (i == tiles.end())
+        return false;
+
+    uses.splice(uses.end(), uses, i.value().use);
+
+    *data = i.value().data;
+
+    return true;
+}
+
+
+
+/*
+ * Tiles larger than the whole cache are not kept.
+ */
+void XDFTileCache::insert(const QByteArray &key, const QByteArray &data)
+{
+    size_t size = data.size();
+
+    Tile tile;
+
+    QHash<QByteArray, Tile>::iterator i;
+
+    QMutexLocker locker(&mutex);
+
+    if (size > max_size)
+        return;
+
+    i = tiles.find(key);
+    if (i != tiles.end()) {
+        cache_size -= i.value().data.size();
+        uses.erase(i.value().use);
+        tiles.erase(i);
+    }
+
+    evict(size);
+
+    tile.data = data;
+    tile.use  = uses.insert(uses.end(), key);
+
+    tiles.insert(key, tile);
+    cache_size += size;
+}
+
+
+
+void XDFTileCache::clear()
+{
+    QMutexLocker locker(&mutex);
+
+    tiles.clear();
+    uses.clear();
+    cache_size = 0;
+}
+
+
+
+/*
+ * Evict least recently used tiles, from the front of uses, until size more
+ * bytes fit.
+ */
+void XDFTileCache::evict(size_t size)
+{
+    QHash<QByteArray, Tile>::iterator i;
+
+    while (! uses.empty() && cache_size + size > max_size) {
+        i = tiles.find(uses.front());
+
+        cache_size -= i.value().data.size();
+        tiles.erase(i);
+
+        uses.pop_front();
+    }
+}
+
+
+
+/*
+ * Copy the part of a tile of n_dims dimensions at tile_offset of size
+ * tile_count that overlaps the region at offset of size count into data,
+ * which holds the region in row major order.  Elements are size bytes.
+ */
+void XDFTileCache::copyTile(int n_dims, size_t size, const void *tile,
+                            const size_t *tile_offset, const size_t *tile_count,
+                            void *data, const size_t *offset, const size_t *count)
+{
+    int i;
+
+    size_t first[8];
+    size_t last[8];
+    size_t index[8];
+
+    size_t tile_stride[8];
+    size_t data_stride[8];
+
+    size_t run;
+    size_t tile_i;
+    size_t data_i;
+
+    if (n_dims == 0) {
+        memcpy(data, tile, size);
+        return;
+    }
+
+    for (i = 0; i < n_dims; ++i) {
+        first[i] = offset[i] > tile_offset[i] ? offset[i] : tile_offset[i];
+        last [i] = offset[i] + count[i] < tile_offset[i] + tile_count[i] ?
+                   offset[i] + count[i] : tile_offset[i] + tile_count[i];
+        if (first[i] >= last[i])
+            return;
+
+        index[i] = first[i];
+    }
+
+    tile_stride[n_dims - 1] = 1;
+    data_stride[n_dims - 1] = 1;
+    for (i = n_dims - 2; i >= 0; --i) {
+        tile_stride[i] = tile_stride[i + 1] * tile_count[i + 1];
+        data_stride[i] = data_stride[i + 1] * count     [i + 1];
+    }
+
+    run = (last[n_dims - 1] - first[n_dims - 1]) * size;
+
+    while (1) {
+        tile_i = 0;
+        data_i = 0;
+        for (i = 0; i < n_dims; ++i) {
+            tile_i += (index[i] - tile_offset[i]) * tile_stride[i];
+            data_i += (index[i] - offset     [i]) * data_stride[i];
+        }
+
+        memcpy((char *) data + data_i * size, (const char *) tile + tile_i * size, run);
+
+        for (i = n_dims - 2; i >= 0; --i) {
+            if (++index[i] < last[i])
+                break;
+            index[i] = first[i];
+        }
+        if (i < 0)
+            break;
+    }
+}
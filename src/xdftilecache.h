@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFTILECACHE_H
+#define XDFTILECACHE_H
+
+#include <stddef.h>
+
+#include <list>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qmutex.h>
+
+
+/*
+ * Tiles of dataset values read by the table views, shared by all the views in
+ * the process.  A tile is a chunk of a dataset, or for datasets that are not
+ * chunked a fixed size block of it, stored in row major order.  Tiles are
+ * keyed by the dataset, see datasetKey(), and the coordinates of the chunk,
+ * see tileKey(), and are kept, least recently used first out, up to maxSize()
+ * bytes.  The keys are also kept in order of use, least recently used first,
+ * so that a tile is found, used, or evicted in constant time.  The cache may
+ * be used from any thread.  Tiles are implicitly shared so a tile found stays
+ * valid after it is evicted.
+ */
+class XDFTileCache
+{
+private:
+    struct Tile {
+        QByteArray data;
+        std::list<QByteArray>::iterator use;
+    };
+
+    static QMutex mutex;
+    static QHash<QByteArray, Tile> tiles;
+    static std::list<QByteArray> uses;
+
+    static size_t max_size;
+    static size_t cache_size;
+
+    static void evict(size_t size);
+
+public:
+    static void setMaxSize(size_t size);
+    static size_t maxSize();
+
+    static QByteArray datasetKey(const char *file_name, const char *dataset_name);
+    static QByteArray tileKey(const QByteArray &dataset_key, int n_dims,
+                              const size_t *coords);
+
+    static bool find(const QByteArray &key, QByteArray *data);
+    static void insert(const QByteArray &key, const QByteArray &data);
+    static void clear();
+
+    static void copyTile(int n_dims, size_t size, const void *tile,
+                         const size_t *tile_offset, const size_t *tile_count,
+                         void *data, const size_t *offset, const size_t *count);
+};
+
+#endif /* XDFTILECACHE_H */
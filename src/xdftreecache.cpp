@@ -0,0 +1,558 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <qbytearray.h>
+#include <qhash.h>
+#include <qvector.h>
+
+#include "xdfv.h"
+#include "xdftreecache.h"
+#include "xdftreemodel.h"
+
+
+bool XDFTreeCache::is_enabled = true;
+
+
+
+XDFTreeCache::XDFTreeCache(const char *file_name, XDFV::FileType file_type,
+                           int options)
+    : path(NULL), cache_name(NULL), file_type(file_type), options(options),
+      file_size(0), mtime(0), mtime_nsec(0), map(NULL), map_size(0),
+      header(NULL), nodes(NULL), dim_data(NULL), record_data(NULL),
+      string_data(NULL)
+{
+    char *temp;
+
+    const char *dir;
+    const char *home;
+
+    unsigned long long h;
+
+    struct stat st;
+
+    if (! is_enabled)
+        return;
+
+    path = realpath(file_name, NULL);
+    if (path == NULL)
+        return;
+
+    if (stat(path, &st) < 0) {
+        free(path);
+        path = NULL;
+        return;
+    }
+
+    file_size  = st.st_size;
+    mtime      = st.st_mtim.tv_sec;
+    mtime_nsec = st.st_mtim.tv_nsec;
+
+    temp = (char *) malloc(LN * sizeof(char));
+
+    snprintf(temp, LN, "%d %d ", file_type, options);
+
+    h = hash(temp, 14695981039346656037ull);
+    h = hash(path, h);
+
+    free(temp);
+
+    dir  = getenv("XDG_CACHE_HOME");
+    home = getenv("HOME");
+
+    cache_name = (char *) malloc(PATH_MAX * sizeof(char));
+
+    if (dir != NULL && dir[0] == '/')
+        snprintf(cache_name, PATH_MAX, "%s/xdfv/%016llx", dir, h);
+    else if (home != NULL)
+        snprintf(cache_name, PATH_MAX, "%s/.cache/xdfv/%016llx", home, h);
+    else {
+        free(cache_name);
+        cache_name = NULL;
+    }
+}
+
+
+
+XDFTreeCache::~XDFTreeCache()
+{
+    close();
+
+    free(path);
+    free(cache_name);
+}
+
+
+
+void XDFTreeCache::setEnabled(bool enabled)
+{
+    is_enabled = enabled;
+}
+
+
+
+bool XDFTreeCache::isEnabled()
+{
+    return is_enabled;
+}
+
+
+
+/*
+ * FNV-1a, 64 bit.
+ */
+unsigned long long XDFTreeCache::hash(const char *s, unsigned long long h)
+{
+    for ( ; *s != '\0'; ++s) {
+        h ^= (unsigned char) *s;
+        h *= 1099511628211ull;
+    }
+
+    return h;
+}
+
+
+
+/*
+ * Maps the cache for the file if there is one and it is valid for the file as
+ * it is now.  Returns false otherwise, in which case the file must be scanned.
+ * The cache's modification time is set to now to mark it as recently used for
+ * evict().
+ */
+bool XDFTreeCache::open()
+{
+    int fd;
+
+    struct stat st;
+
+    if (cache_name == NULL)
+        return false;
+
+    fd = ::open(cache_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    map_size = st.st_size;
+
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED) {
+        ::close(fd);
+        map = NULL;
+        return false;
+    }
+
+    if (! validate()) {
+        ::close(fd);
+        close();
+        return false;
+    }
+
+    futimens(fd, NULL);
+
+    ::close(fd);
+
+    return true;
+}
+
+
+
+void XDFTreeCache::close()
+{
+    if (map != NULL)
+        munmap(map, map_size);
+
+    map      = NULL;
+    map_size = 0;
+
+    header      = NULL;
+    nodes       = NULL;
+    dim_data    = NULL;
+    record_data = NULL;
+    string_data = NULL;
+}
+
+
+
+/*
+ * Checks that the cache is for this file, that the file is unchanged, and that
+ * every offset in the cache is within bounds so that a stale, truncated, or
+ * otherwise damaged cache is never used.
+ */
+bool XDFTreeCache::validate()
+{
+    int i;
+
+    unsigned long long offset;
+
+    const char *base;
+
+    base   = (const char *) map;
+    header = (const Header *) base;
+
+    if (memcmp(header->magic, "XDFVTREE", 8) != 0 ||
+        header->version    != version    ||
+        header->file_type  != file_type  ||
+        header->options    != options    ||
+        header->file_size  != file_size  ||
+        header->mtime      != mtime      ||
+        header->mtime_nsec != mtime_nsec)
+        return false;
+
+    if (header->path_size    <= 0 || header->path_size % 8 != 0 ||
+        header->n_nodes      <= 0 ||
+        header->n_dims       <  0 ||
+        header->records_size <  0 || header->records_size % 8 != 0 ||
+        header->strings_size <  0)
+        return false;
+
+    offset  = sizeof(Header);
+    offset += header->path_size;
+    offset += (unsigned long long) header->n_nodes * sizeof(Node);
+    offset += (unsigned long long) header->n_dims  * sizeof(long long);
+    offset += header->records_size;
+    offset += header->strings_size;
+    if (offset != map_size)
+        return false;
+
+    offset = sizeof(Header);
+    if (base[offset + header->path_size - 1] != '\0' ||
+        strcmp(base + offset, path) != 0)
+        return false;
+
+    offset += header->path_size;
+    nodes = (const Node *) (base + offset);
+
+    offset += (unsigned long long) header->n_nodes * sizeof(Node);
+    dim_data = (const long long *) (base + offset);
+
+    offset += (unsigned long long) header->n_dims * sizeof(long long);
+    record_data = base + offset;
+
+    offset += header->records_size;
+    string_data = base + offset;
+
+    if (header->strings_size > 0 && string_data[header->strings_size - 1] != '\0')
+        return false;
+
+    for (i = 0; i < header->n_nodes; ++i) {
+        const Node &node = nodes[i];
+
+        if (i == 0 ? node.parent != -1 : node.parent < 0 || node.parent >= i)
+            return false;
+
+        if (node.name  < -1 || node.name  >= header->strings_size ||
+            node.label < -1 || node.label >= header->strings_size ||
+            node.value < -1 || node.value >= header->strings_size)
+            return false;
+
+        if (node.n_dims < 0 || (node.n_dims > 0 && node.dims < 0) ||
+            node.dims < -1 || node.dims + node.n_dims > header->n_dims)
+            return false;
+
+        if (node.record < -1 || (node.record >= 0 && (node.record_size < 0 ||
+            node.record + (long long) node.record_size > header->records_size)))
+            return false;
+    }
+
+    return true;
+}
+
+
+
+static int add_string(QHash<int, int> &offsets, QByteArray &strings,
+                      const XDFTreeModel *model, int id)
+{
+    int offset;
+
+    const char *s;
+
+    if (id < 0)
+        return -1;
+
+    if (offsets.contains(id))
+        return offsets[id];
+
+    s = model->string(id);
+
+    offset = strings.size();
+    strings.append(s, strlen(s) + 1);
+
+    offsets[id] = offset;
+
+    return offset;
+}
+
+
+
+/*
+ * Writes the tree under root to the cache.  The cache is written to a
+ * temporary file and renamed into place so that a reader never sees a partial
+ * cache.  Returns 0 on success and -1 on error.
+ */
+int XDFTreeCache::save(XDFTreeModel *model, int root)
+{
+    char *temp;
+
+    const char *dir;
+
+    int i;
+    int n;
+    int fd;
+    int id;
+    int *index;
+
+    FILE *fp;
+
+    QVector<Node> cache_nodes;
+    QVector<long long> cache_dims;
+    QByteArray records;
+    QByteArray strings;
+    QHash<int, int> string_offsets;
+
+    Header cache_header;
+
+    static const char zeros[8] = {0};
+
+    if (path == NULL || cache_name == NULL)
+        return -1;
+
+    n = model->nodeCount();
+
+    index = (int *) malloc(n * sizeof(int));
+    for (i = 0; i < n; ++i)
+        index[i] = -1;
+
+    for (id = root; id >= 0; id = model->nextNode(id)) {
+        const XDFTreeNode &node = model->node(id);
+
+        Node cache_node;
+
+        index[id] = cache_nodes.size();
+
+        cache_node.parent = id == root ? -1 : index[node.parent];
+        cache_node.name   = add_string(string_offsets, strings, model, node.name);
+        cache_node.label  = add_string(string_offsets, strings, model, node.label);
+        cache_node.value  = add_string(string_offsets, strings, model, node.value);
+
+        if (node.dims < 0)
+            cache_node.dims = -1;
+        else {
+            cache_node.dims = cache_dims.size();
+            for (i = 0; i < node.n_dims; ++i)
+                cache_dims.append(model->dims(node.dims)[i]);
+        }
+
+        if (node.record < 0) {
+            cache_node.record      = -1;
+            cache_node.record_size = 0;
+        }
+        else {
+            cache_node.record      = records.size();
+            cache_node.record_size = model->recordSize(node.record);
+            records.append((const char *) model->record(node.record),
+                           cache_node.record_size);
+            records.append(zeros, (8 - records.size() % 8) % 8);
+        }
+
+        cache_node.id        = node.id;
+        cache_node.count     = node.count;
+        cache_node.size      = node.size;
+        cache_node.type      = node.type;
+        cache_node.data_type = node.data_type;
+        cache_node.n_dims    = node.n_dims;
+        cache_node.flags     = node.flags & ~XDFTreeModel::PreviewRequested;
+
+        cache_nodes.append(cache_node);
+    }
+
+    free(index);
+
+    memset(&cache_header, 0, sizeof(Header));
+    memcpy(cache_header.magic, "XDFVTREE", 8);
+    cache_header.version      = version;
+    cache_header.file_type    = file_type;
+    cache_header.options      = options;
+    cache_header.path_size    = (strlen(path) + 8) / 8 * 8;
+    cache_header.file_size    = file_size;
+    cache_header.mtime        = mtime;
+    cache_header.mtime_nsec   = mtime_nsec;
+    cache_header.n_nodes      = cache_nodes.size();
+    cache_header.n_dims       = cache_dims.size();
+    cache_header.records_size = records.size();
+    cache_header.strings_size = strings.size();
+
+    temp = (char *) malloc(PATH_MAX * sizeof(char));
+
+    /*
+     * Create the cache directory and its parent if need be.
+     */
+    dir = strrchr(cache_name, '/');
+    snprintf(temp, PATH_MAX, "%.*s", (int) (dir - cache_name), cache_name);
+    if (mkdir(temp, 0700) < 0 && errno == ENOENT) {
+        *strrchr(temp, '/') = '\0';
+        mkdir(temp, 0700);
+        snprintf(temp, PATH_MAX, "%.*s", (int) (dir - cache_name), cache_name);
+        mkdir(temp, 0700);
+    }
+
+    snprintf(temp, PATH_MAX, "%s.XXXXXX", cache_name);
+
+    fd = mkstemp(temp);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: mkstemp(), file_name = %s\n", temp);
+        free(temp);
+        return -1;
+    }
+
+    fp = fdopen(fd, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: fdopen(), file_name = %s\n", temp);
+        ::close(fd);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    n = strlen(path) + 1;
+
+    fwrite(&cache_header, sizeof(Header), 1, fp);
+    fwrite(path, 1, n, fp);
+    fwrite(zeros, 1, cache_header.path_size - n, fp);
+    fwrite(cache_nodes.data(), sizeof(Node), cache_nodes.size(), fp);
+    fwrite(cache_dims.data(), sizeof(long long), cache_dims.size(), fp);
+    fwrite(records.data(), 1, records.size(), fp);
+    fwrite(strings.data(), 1, strings.size(), fp);
+
+    if (ferror(fp) | fclose(fp)) {
+        fprintf(stderr, "ERROR: fwrite(), file_name = %s\n", temp);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    if (rename(temp, cache_name) < 0) {
+        fprintf(stderr, "ERROR: rename(), file_name = %s\n", cache_name);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    free(temp);
+
+    evict();
+
+    return 0;
+}
+
+
+
+struct cache_entry {
+    long long mtime;
+    long long size;
+    QByteArray name;
+
+    bool operator<(const cache_entry &other) const {
+        return mtime < other.mtime;
+    }
+};
+
+
+
+/*
+ * Removes caches, least recently used first, until those in the directory of
+ * this one take at most max_total_size bytes.  This cache, just saved, is
+ * kept.  Temporary files of saves in progress have a '.' in their name and
+ * are left alone.
+ */
+void XDFTreeCache::evict()
+{
+    char *temp;
+
+    const char *name;
+
+    int i;
+    int n;
+
+    long long total;
+
+    DIR *dir;
+    struct dirent *dir_entry;
+
+    struct stat st;
+
+    QVector<cache_entry> entries;
+
+    name = strrchr(cache_name, '/');
+    n    = name - cache_name;
+    ++name;
+
+    temp = (char *) malloc(PATH_MAX * sizeof(char));
+
+    snprintf(temp, PATH_MAX, "%.*s", n, cache_name);
+
+    dir = opendir(temp);
+    if (dir == NULL) {
+        free(temp);
+        return;
+    }
+
+    total = 0;
+    while ((dir_entry = readdir(dir)) != NULL) {
+        if (strchr(dir_entry->d_name, '.') != NULL ||
+            strcmp(dir_entry->d_name, name) == 0)
+            continue;
+
+        snprintf(temp, PATH_MAX, "%.*s/%s", n, cache_name, dir_entry->d_name);
+        if (stat(temp, &st) < 0 || ! S_ISREG(st.st_mode))
+            continue;
+
+        cache_entry entry;
+
+        entry.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        entry.size  = st.st_size;
+        entry.name  = dir_entry->d_name;
+
+        entries.append(entry);
+
+        total += st.st_size;
+    }
+
+    closedir(dir);
+
+    if (stat(cache_name, &st) == 0)
+        total += st.st_size;
+
+    std::sort(entries.begin(), entries.end());
+
+    for (i = 0; i < entries.size() && total > max_total_size; ++i) {
+        snprintf(temp, PATH_MAX, "%.*s/%s", n, cache_name, entries[i].name.constData());
+        if (unlink(temp) == 0)
+            total -= entries[i].size;
+    }
+
+    free(temp);
+}
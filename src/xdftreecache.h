@@ -0,0 +1,116 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFTREECACHE_H
+#define XDFTREECACHE_H
+
+#include <sys/types.h>
+
+#include "xdfv.h"
+#include "xdftreemodel.h"
+
+
+/*
+ * An on-disk copy of the tree scanned from a file so that the file can be
+ * reopened without scanning it again.  Caches live in $XDG_CACHE_HOME/xdfv
+ * (~/.cache/xdfv by default), one per file, file type, and load options, and
+ * are only used if the file's size and modification time are unchanged since
+ * the scan.  A cache is mapped read only and its nodes are read in place.
+ * The caches together are kept under max_total_size bytes, the least recently
+ * used removed first.
+ *
+ * Nodes are stored in preorder with node 0 the file node.  Strings, dims, and
+ * records are offsets into the sections that follow the nodes, or -1 for none.
+ */
+class XDFTreeCache
+{
+public:
+    struct Node {
+        int parent;
+        int name;
+        int label;
+        int value;
+        int dims;
+        int record;
+        int record_size;
+        int id;
+        int count;
+        long long size;
+        short type;
+        short data_type;
+        short n_dims;
+        unsigned short flags;
+    };
+
+private:
+    struct Header {
+        char magic[8];
+        int version;
+        int file_type;
+        int options;
+        int path_size;
+        long long file_size;
+        long long mtime;
+        long long mtime_nsec;
+        int n_nodes;
+        int n_dims;
+        long long records_size;
+        long long strings_size;
+    };
+
+    static const int version = 5;
+
+    static const long long max_total_size = 256LL * 1024 * 1024;
+
+    static bool is_enabled;
+
+    char *path;
+    char *cache_name;
+
+    XDFV::FileType file_type;
+    int options;
+
+    long long file_size;
+    long long mtime;
+    long long mtime_nsec;
+
+    void *map;
+    size_t map_size;
+
+    const Header *header;
+    const Node *nodes;
+    const long long *dim_data;
+    const char *record_data;
+    const char *string_data;
+
+    static unsigned long long hash(const char *s, unsigned long long h);
+
+    bool validate();
+    void evict();
+
+public:
+    XDFTreeCache(const char *file_name, XDFV::FileType file_type, int options);
+    ~XDFTreeCache();
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    bool open();
+    void close();
+
+    int nodeCount() const { return header->n_nodes; }
+    const Node &node(int i) const { return nodes[i]; }
+    const char *string(int offset) const { return string_data + offset; }
+    const long long *dims(int offset) const { return dim_data + offset; }
+    const void *record(int offset) const { return record_data + offset; }
+
+    int save(XDFTreeModel *model, int root);
+};
+
+#endif /* XDFTREECACHE_H */
@@ -0,0 +1,525 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+
+#include "xdfv.h"
+#include "xdftreemodel.h"
+#include "xdftreeview.h"
+
+
+XDFTreeModel::XDFTreeModel(XDFTreeView *view)
+    : QAbstractItemModel(view), view(view)
+{
+
+}
+
+
+
+XDFTreeModel::~XDFTreeModel()
+{
+
+}
+
+
+
+void XDFTreeModel::setHeaderLabels(const QStringList &labels)
+{
+    beginResetModel();
+    header_labels = labels;
+    endResetModel();
+}
+
+
+
+void XDFTreeModel::clear()
+{
+    beginResetModel();
+
+    nodes.clear();
+    strings.clear();
+    dim_pool.clear();
+    record_pool.clear();
+
+    root_children.clear();
+    child_lists.clear();
+
+    search_index.clear();
+
+    endResetModel();
+}
+
+
+
+int XDFTreeModel::newNode(int type, const char *name, const char *label)
+{
+    int id;
+
+    XDFTreeNode node;
+
+    node.parent    = -1;
+    node.row       = -1;
+    node.children  = -1;
+    node.name      = addString(name);
+    node.label     = strcmp(label, name) == 0 ? node.name : addString(label);
+    node.value     = -1;
+    node.dims      = -1;
+    node.record    = -1;
+    node.size      = 0;
+    node.id        = 0;
+    node.count     = 0;
+    node.type      = type;
+    node.data_type = 0;
+    node.n_dims    = 0;
+    node.flags     = 0;
+
+    id = nodes.append(node);
+    if (id < 0) {
+        fprintf(stderr, "ERROR: XDFArena::append(), name = %s\n", name);
+        exit(1);
+    }
+
+    return id;
+}
+
+
+
+/*
+ * Short strings, such as names, units, and most attribute values, are interned
+ * so that each is stored once per file.
+ */
+int XDFTreeModel::addString(const char *s)
+{
+    if (strlen(s) < max_intern_size)
+        return strings.intern(s);
+
+    return strings.add(s);
+}
+
+
+
+int XDFTreeModel::addDims(int n_dims, const long long *dims)
+{
+    int i;
+
+    if (n_dims == 0)
+        return -1;
+
+    i = dim_pool.append(dims, n_dims);
+    if (i < 0) {
+        fprintf(stderr, "ERROR: XDFArena::append()\n");
+        exit(1);
+    }
+
+    return i;
+}
+
+
+
+/*
+ * Records are stored 8 byte aligned and preceded by their size.
+ */
+int XDFTreeModel::addRecord(const void *record, int size)
+{
+    int i;
+
+    i = record_pool.allocate(1 + (size + 7) / 8);
+    if (i < 0) {
+        fprintf(stderr, "ERROR: XDFArena::allocate()\n");
+        exit(1);
+    }
+
+    record_pool[i] = size;
+    memcpy(&record_pool[i + 1], record, size);
+
+    return i + 1;
+}
+
+
+
+XDFTreeNode &XDFTreeModel::node(int id)
+{
+    return nodes[id];
+}
+
+
+
+const char *XDFTreeModel::string(int id) const
+{
+    if (id < 0)
+        return "";
+
+    return strings.string(id);
+}
+
+
+
+const long long *XDFTreeModel::dims(int id) const
+{
+    return &dim_pool[id];
+}
+
+
+
+const void *XDFTreeModel::record(int id) const
+{
+    return &record_pool[id];
+}
+
+
+
+int XDFTreeModel::recordSize(int id) const
+{
+    return record_pool[id - 1];
+}
+
+
+
+int XDFTreeModel::nodeCount() const
+{
+    return nodes.size();
+}
+
+
+
+size_t XDFTreeModel::memoryUsage() const
+{
+    int i;
+
+    size_t size;
+
+    size = nodes.capacity() + strings.capacity() + dim_pool.capacity() +
+           record_pool.capacity() + search_index.memoryUsage();
+
+    size += root_children.capacity() * sizeof(int);
+    size += child_lists.capacity() * sizeof(QVector<int>);
+    for (i = 0; i < child_lists.size(); ++i)
+        size += child_lists[i].capacity() * sizeof(int);
+
+    return size;
+}
+
+
+
+const QVector<int> *XDFTreeModel::childList(int parent) const
+{
+    if (parent < 0)
+        return &root_children;
+
+    if (nodes[parent].children < 0)
+        return NULL;
+
+    return &child_lists[nodes[parent].children];
+}
+
+
+
+int XDFTreeModel::childCount(int parent) const
+{
+    const QVector<int> *list = childList(parent);
+
+    return list ? list->size() : 0;
+}
+
+
+
+int XDFTreeModel::child(int parent, int row) const
+{
+    return childList(parent)->at(row);
+}
+
+
+
+/*
+ * Returns the row that a node inserted after the sibling after would have.
+ * As with QTreeWidgetItem(parent, after) an after of -1 is the first row.
+ */
+int XDFTreeModel::childRowAfter(int parent, int after) const
+{
+    if (after < 0)
+        return 0;
+
+    return nodes[after].row + 1;
+}
+
+
+
+void XDFTreeModel::insertNodes(int parent, int row, const QVector<int> &ids)
+{
+    int i;
+    int n;
+
+    QVector<int> *list;
+
+    if (ids.size() == 0)
+        return;
+
+    beginInsertRows(nodeIndex(parent), row, row + ids.size() - 1);
+
+    if (parent < 0)
+        list = &root_children;
+    else {
+        if (nodes[parent].children < 0) {
+            nodes[parent].children = child_lists.size();
+            child_lists.append(QVector<int>());
+        }
+        list = &child_lists[nodes[parent].children];
+    }
+
+    if (row == list->size())
+        *list += ids;
+    else {
+        list->insert(row, ids.size(), -1);
+        for (i = 0; i < ids.size(); ++i)
+            (*list)[row + i] = ids[i];
+    }
+
+    for (i = 0; i < ids.size(); ++i) {
+        nodes[ids[i]].parent = parent;
+        indexNode(ids[i]);
+    }
+
+    n = list->size();
+    for (i = row; i < n; ++i)
+        nodes[list->at(i)].row = i;
+
+    endInsertRows();
+}
+
+
+
+/*
+ * Unlinks count nodes starting at row.  The nodes and their descendants stay
+ * in the arenas until the model is cleared.
+ */
+void XDFTreeModel::removeNodes(int parent, int row, int count)
+{
+    int i;
+    int n;
+
+    QVector<int> *list;
+
+    if (count == 0)
+        return;
+
+    beginRemoveRows(nodeIndex(parent), row, row + count - 1);
+
+    if (parent < 0)
+        list = &root_children;
+    else
+        list = &child_lists[nodes[parent].children];
+
+    list->remove(row, count);
+
+    n = list->size();
+    for (i = row; i < n; ++i)
+        nodes[list->at(i)].row = i;
+
+    endRemoveRows();
+}
+
+
+
+/*
+ * Adds the name and value of a node to the search index.  Called for each
+ * node as it is linked and again when its name or value changes.
+ */
+void XDFTreeModel::indexNode(int id)
+{
+    const XDFTreeNode &node = nodes[id];
+
+    search_index.add(id, string(node.label), node.value < 0 ? NULL : string(node.value));
+}
+
+
+
+XDFSearchIndex &XDFTreeModel::searchIndex()
+{
+    return search_index;
+}
+
+
+
+/*
+ * Returns true if a node is linked into the tree, which nodes from the search
+ * index may no longer be.
+ */
+bool XDFTreeModel::isLinked(int id) const
+{
+    int parent;
+
+    const QVector<int> *list;
+
+    while (id >= 0) {
+        parent = nodes[id].parent;
+        list   = childList(parent);
+        if (list == NULL || nodes[id].row < 0 || nodes[id].row >= list->size() ||
+            list->at(nodes[id].row) != id)
+            return false;
+        id = parent;
+    }
+
+    return true;
+}
+
+
+
+void XDFTreeModel::nodeChanged(int id)
+{
+    emit dataChanged(nodeIndex(id, 0), nodeIndex(id, header_labels.size() - 1));
+}
+
+
+
+/*
+ * Steps through the linked nodes in display order.  -1 is before the first
+ * node and after the last.
+ */
+int XDFTreeModel::nextNode(int id) const
+{
+    int parent;
+
+    if (childCount(id) > 0)
+        return child(id, 0);
+
+    while (id >= 0) {
+        parent = nodes[id].parent;
+        if (nodes[id].row + 1 < childCount(parent))
+            return child(parent, nodes[id].row + 1);
+        id = parent;
+    }
+
+    return -1;
+}
+
+
+
+int XDFTreeModel::prevNode(int id) const
+{
+    int n;
+
+    if (id < 0) {
+        id = -1;
+        while ((n = childCount(id)) > 0)
+            id = child(id, n - 1);
+        return id;
+    }
+
+    if (nodes[id].row == 0)
+        return nodes[id].parent;
+
+    id = child(nodes[id].parent, nodes[id].row - 1);
+    while ((n = childCount(id)) > 0)
+        id = child(id, n - 1);
+
+    return id;
+}
+
+
+
+int XDFTreeModel::nodeId(const QModelIndex &index) const
+{
+    if (! index.isValid())
+        return -1;
+
+    return (int) (intptr_t) index.internalPointer();
+}
+
+
+
+QModelIndex XDFTreeModel::nodeIndex(int id, int column) const
+{
+    if (id < 0)
+        return QModelIndex();
+
+    return createIndex(nodes[id].row, column, (void *) (intptr_t) id);
+}
+
+
+
+QModelIndex XDFTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    const QVector<int> *list = childList(nodeId(parent));
+
+    if (list == NULL || row < 0 || row >= list->size() ||
+        column < 0 || column >= header_labels.size())
+        return QModelIndex();
+
+    return createIndex(row, column, (void *) (intptr_t) list->at(row));
+}
+
+
+
+QModelIndex XDFTreeModel::parent(const QModelIndex &index) const
+{
+    if (! index.isValid())
+        return QModelIndex();
+
+    return nodeIndex(nodes[nodeId(index)].parent);
+}
+
+
+
+int XDFTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return 0;
+
+    return childCount(nodeId(parent));
+}
+
+
+
+int XDFTreeModel::columnCount(const QModelIndex &parent) const
+{
+    return header_labels.size();
+}
+
+
+
+/*
+ * Nodes whose children have not been enumerated yet still show an expand
+ * indicator.
+ */
+bool XDFTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    int id;
+
+    if (parent.column() > 0)
+        return false;
+
+    id = nodeId(parent);
+
+    if (id >= 0 && nodes[id].flags & Unpopulated)
+        return true;
+
+    return childCount(id) > 0;
+}
+
+
+
+QVariant XDFTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (! index.isValid())
+        return QVariant();
+
+    return view->nodeData(nodeId(index), index.column(), role);
+}
+
+
+
+QVariant XDFTreeModel::headerData(int section, Qt::Orientation orientation,
+                                  int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole ||
+        section < 0 || section >= header_labels.size())
+        return QVariant();
+
+    return header_labels[section];
+}
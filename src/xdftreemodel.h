@@ -0,0 +1,143 @@
+/*******************************************************************************
+ *
+ *    Copyright (C) 2015-2018 Greg McGarragh <greg.mcgarragh@colostate.edu>
+ *
+ *    This source code is licensed under the GNU General Public License (GPL),
+ *    Version 3.  See the file COPYING for more details.
+ *
+ ******************************************************************************/
+
+#ifndef XDFTREEMODEL_H
+#define XDFTREEMODEL_H
+
+#include <qabstractitemmodel.h>
+#include <qstringlist.h>
+#include <qvector.h>
+
+#include "xdfarena.h"
+#include "xdfsearchindex.h"
+#include "xdfstringpool.h"
+
+
+class XDFTreeView;
+
+
+/*
+ * A node of an XDFTreeModel.  Numbers are kept as numbers and only formatted by
+ * the view when displayed.  Strings, dimensions, and record are indexes into
+ * the model's string pool and arenas, or -1 for none.  A record holds format
+ * specific details that only some nodes have and must not refer to other model
+ * data so that it can be copied as is.  What id, count, size, and data_type
+ * hold depends on the format and the node type.  The value of a node flagged
+ * PreviewPending is read by the view once the node is first displayed.
+ */
+struct XDFTreeNode
+{
+    int parent;
+    int row;
+    int children;
+
+    int name;
+    int label;
+    int value;
+    int dims;
+    int record;
+
+    long long size;
+
+    int id;
+    int count;
+
+    short type;
+    short data_type;
+    short n_dims;
+    unsigned short flags;
+};
+
+
+class XDFTreeModel : public QAbstractItemModel
+{
+public:
+    enum NodeFlags {
+        HasDataTable     = 0x01,
+        Unpopulated      = 0x02,
+        PreviewPending   = 0x04,
+        PreviewRequested = 0x08
+    };
+
+private:
+    static const int max_intern_size = 256;
+
+    XDFTreeView *view;
+
+    QStringList header_labels;
+
+    XDFArena<XDFTreeNode, 12> nodes;
+    XDFStringPool strings;
+    XDFArena<long long, 12> dim_pool;
+    XDFArena<long long, 13> record_pool;
+
+    QVector<int> root_children;
+    QVector<QVector<int> > child_lists;
+
+    XDFSearchIndex search_index;
+
+    const QVector<int> *childList(int parent) const;
+
+public:
+    XDFTreeModel(XDFTreeView *view);
+    ~XDFTreeModel();
+
+    void setHeaderLabels(const QStringList &labels);
+    void clear();
+
+    /*
+     * Node, string, and dimension allocation.  These may be called from a
+     * loader thread, but only by one thread at a time.
+     */
+    int newNode(int type, const char *name, const char *label);
+    int addString(const char *s);
+    int addDims(int n_dims, const long long *dims);
+    int addRecord(const void *record, int size);
+
+    XDFTreeNode &node(int id);
+    const char *string(int id) const;
+    const long long *dims(int id) const;
+    const void *record(int id) const;
+    int recordSize(int id) const;
+
+    int nodeCount() const;
+
+    size_t memoryUsage() const;
+
+    /*
+     * Tree structure.  These are only called from the GUI thread.
+     */
+    int childCount(int parent) const;
+    int child(int parent, int row) const;
+    int childRowAfter(int parent, int after) const;
+    void insertNodes(int parent, int row, const QVector<int> &ids);
+    void removeNodes(int parent, int row, int count);
+    void nodeChanged(int id);
+
+    void indexNode(int id);
+    XDFSearchIndex &searchIndex();
+    bool isLinked(int id) const;
+
+    int nextNode(int id) const;
+    int prevNode(int id) const;
+
+    int nodeId(const QModelIndex &index) const;
+    QModelIndex nodeIndex(int id, int column = 0) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &index) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+};
+
+#endif /* XDFTREEMODEL_H */
@@ -7,225 +7,1251 @@
  *
  ******************************************************************************/
 
+#include <limits.h>
+
 #include <qaction.h>
 #include <qapplication.h>
 #include <qclipboard.h>
 #include <qmenu.h>
+#include <qtimer.h>
 
+#include "xdfprocessor.h"
 #include "xdfv.h"
+#include "xdfhandlepool.h"
+#include "xdftreecache.h"
+#include "xdftreemodel.h"
 #include "xdftreeview.h"
 
 
-XDFTreeViewItem::XDFTreeViewItem(XDFTreeView *parent, const char *name_)
-    : QTreeWidgetItem((QTreeWidget *) parent), has_data_table(false)
+XDFTreeView::XDFTreeView(const char *file_name_, XDFV::FileType file_type, QWidget *parent)
+    : QTreeView(parent), file_type(file_type), is_colorized(false),
+      is_loading(false), is_reloading(false), is_cacheable(false), cache_dirty(false),
+      load_canceled(false), load_progress(-1),
+      pending_posted(false), previews_posted(false)
+{
+    file_name = strdup(file_name_);
+
+    model = new XDFTreeModel(this);
+    setModel(model);
+
+    loader = new XDFTreeViewLoader(this);
+
+    preview_loader = new XDFPreviewLoader(this);
+/*
+    setAutoScroll(false);
+*/
+    setRootIsDecorated(true);
+    setSortingEnabled(false);
+    setUniformRowHeights(true);
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    QObject::connect(this, SIGNAL(customContextMenuRequested(const QPoint &)), this, SLOT(showContextMenu(const QPoint &)));
+    QObject::connect(this, SIGNAL(expanded(const QModelIndex &)), this, SLOT(populateItem(const QModelIndex &)));
+    QObject::connect(this, SIGNAL(itemsPending()), this, SLOT(addPendingNodes()), Qt::QueuedConnection);
+    QObject::connect(this, SIGNAL(previewsPending()), this, SLOT(addPreviews()), Qt::QueuedConnection);
+    QObject::connect(loader, SIGNAL(finished()), this, SLOT(finishLoad()));
+}
+
+
+
+XDFTreeView::~XDFTreeView()
+{
+    preview_loader->stop();
+
+    delete preview_loader;
+
+    if (cache_dirty)
+        saveCache();
+
+    if (is_loading) {
+        cancelLoad();
+        loader->wait();
+        discardLoad();
+    }
+
+    delete loader;
+
+    free(file_name);
+}
+
+
+
+const char *XDFTreeView::filename()
+{
+    return file_name;
+}
+
+
+
+XDFV::FileType XDFTreeView::fileType()
+{
+    return file_type;
+}
+
+
+
+XDFTreeModel *XDFTreeView::treeModel()
+{
+    return model;
+}
+
+
+
+int XDFTreeView::currentNode()
+{
+    return model->nodeId(currentIndex());
+}
+
+
+
+void XDFTreeView::setCurrentNode(int id)
+{
+    setCurrentIndex(model->nodeIndex(id));
+}
+
+
+
+void XDFTreeView::setHeaderLabels(const QStringList &labels)
+{
+    model->setHeaderLabels(labels);
+}
+
+
+
+void XDFTreeView::load()
+{
+
+}
+
+
+
+/*
+ * Scans the file again and merges the result into the existing tree so that
+ * expansion and selection are kept.  Only nodes that were added, removed, or
+ * changed are touched, see mergePendingNodes().
+ */
+void XDFTreeView::reload()
+{
+    QMutex *mutex;
+
+    stopLoad();
+
+    mutex = XDFV::libraryMutex(file_type);
+
+    mutex->lock();
+    XDFHandlePool::instance()->invalidate(file_name);
+    mutex->unlock();
+
+    if (model->childCount(-1) == 0) {
+        load();
+        return;
+    }
+
+    is_reloading = true;
+
+    startLoad(model->child(-1, 0));
+}
+
+
+
+void XDFTreeView::clear()
+{
+    preview_loader->cancel();
+
+    preview_mutex.lock();
+    previews.clear();
+    preview_mutex.unlock();
+
+    model->clear();
+}
+
+
+
+int XDFTreeView::loadItems(int root)
+{
+    return 0;
+}
+
+
+
+/*
+ * Options that change the tree loadItems() produces, e.g. lazy loading, so
+ * that trees loaded with different options are cached apart.
+ */
+int XDFTreeView::loadOptions()
+{
+    return 0;
+}
+
+
+
+/*
+ * Starts loadItems() on the loader thread.  Nodes it creates are handed to
+ * addNode() and are linked into the tree on the GUI thread in batches so that
+ * the tree fills in progressively.  loadFinished() is emitted once every node
+ * has been linked.
+ */
+void XDFTreeView::startLoad(int root)
+{
+    is_loading     = true;
+    is_cacheable   = false;
+    cache_dirty    = false;
+    load_canceled  = false;
+    load_progress  = -1;
+    pending_posted = false;
+
+    load_timer.start();
+
+    loader->setRoot(root);
+    loader->queue();
+    loader->start();
+}
+
+
+
+bool XDFTreeView::isLoading()
+{
+    return is_loading;
+}
+
+
+
+bool XDFTreeView::isReloading()
+{
+    return is_reloading;
+}
+
+
+
+bool XDFTreeView::isLoadCanceled()
+{
+    return load_canceled;
+}
+
+
+
+void XDFTreeView::reportProgress(long done, long total)
+{
+    int progress;
+
+    if (total <= 0)
+        return;
+
+    if (load_progress < 0)
+        emit loadRangeChanged(0, 100);
+
+    progress = (int) (100. * done / total);
+    if (progress != load_progress) {
+        load_progress = progress;
+        emit loadProgress(progress);
+    }
+}
+
+
+
+/*
+ * Adds node id under parent following after, where an after of -1 is the first
+ * row.  On the GUI thread the node is linked and indexed immediately, so its
+ * name, value, and dims must be set first.  On the loader thread it is queued
+ * and the caller may still modify it until the next node is added.  Returns id.
+ */
+int XDFTreeView::addNode(int parent, int after, int id)
+{
+    if (QThread::currentThread() == thread()) {
+        model->insertNodes(parent, model->childRowAfter(parent, after),
+                           QVector<int>() << id);
+        return id;
+    }
+
+    PendingNode pending = {parent, after, id};
+
+    load_batch.append(pending);
+
+    if (load_batch.size() > flush_size || load_timer.elapsed() > flush_interval)
+        flushNodes(false);
+
+    return id;
+}
+
+
+
+/*
+ * Called on the loader thread to hand the batch over to the GUI thread.  The
+ * most recent node is held back unless all is set, see addNode().
+ */
+void XDFTreeView::flushNodes(bool all)
+{
+    int i;
+    int n;
+
+    bool post;
+
+    n = all ? load_batch.size() : load_batch.size() - 1;
+    if (n <= 0)
+        return;
+
+    pending_mutex.lock();
+    for (i = 0; i < n; ++i)
+        pending_nodes.append(load_batch[i]);
+    post = ! pending_posted;
+    pending_posted = true;
+    pending_mutex.unlock();
+
+    load_batch.erase(load_batch.begin(), load_batch.begin() + n);
+
+    load_timer.restart();
+
+    if (post)
+        emit itemsPending();
+}
+
+
+
+/*
+ * Links up to max pending nodes into the tree.  Runs of siblings that follow
+ * one another are inserted with a single call.  Returns the number of nodes
+ * still pending.
+ */
+int XDFTreeView::linkPendingNodes(int max)
+{
+    int i;
+    int j;
+    int n;
+    int n_left;
+
+    QList<PendingNode> nodes;
+    QVector<int> run;
+
+    pending_mutex.lock();
+    n = qMin(max, pending_nodes.size());
+    nodes = pending_nodes.mid(0, n);
+    pending_nodes.erase(pending_nodes.begin(), pending_nodes.begin() + n);
+    n_left = pending_nodes.size();
+    pending_mutex.unlock();
+
+    for (i = 0; i < n; i = j) {
+        run.clear();
+
+        for (j = i; j < n; ++j) {
+            if (j > i && (nodes[j].parent != nodes[i].parent ||
+                          nodes[j].after  != nodes[j - 1].node))
+                break;
+
+            run.append(nodes[j].node);
+        }
+
+        model->insertNodes(nodes[i].parent,
+            model->childRowAfter(nodes[i].parent, nodes[i].after), run);
+    }
+
+    return n_left;
+}
+
+
+
+void XDFTreeView::addPendingNodes()
+{
+    pending_mutex.lock();
+    pending_posted = false;
+    pending_mutex.unlock();
+
+    if (is_reloading)
+        return;
+
+    if (linkPendingNodes(max_link_size) > 0)
+        QMetaObject::invokeMethod(this, "addPendingNodes", Qt::QueuedConnection);
+}
+
+
+
+/*
+ * Drops the nodes that were never linked.  They stay in the model's arenas
+ * until it is cleared.  The loader must not be running.
+ */
+void XDFTreeView::discardLoad()
+{
+    pending_nodes.clear();
+    load_batch.clear();
+}
+
+
+
+/*
+ * Called on the loader thread to recreate the tree under root from the nodes
+ * in cache.  Cached node 0 is root itself, which the view has already created.
+ */
+int XDFTreeView::restoreItems(XDFTreeCache *cache, int root)
+{
+    int i;
+    int n;
+    int id;
+    int status;
+
+    int *ids;
+    int *last_child;
+
+    n = cache->nodeCount();
+
+    ids        = (int *) malloc(n * sizeof(int));
+    last_child = (int *) malloc(n * sizeof(int));
+
+    for (i = 0; i < n; ++i)
+        last_child[i] = -1;
+
+    status = 0;
+
+    for (i = 0; i < n; ++i) {
+        const XDFTreeCache::Node &cache_node = cache->node(i);
+
+        if (i % restore_interval == 0) {
+            if (isLoadCanceled()) {
+                status = XDFProcessor::Canceled;
+                break;
+            }
+
+            reportProgress(i, n);
+        }
+
+        if (i == 0) {
+            ids[i] = root;
+            continue;
+        }
+
+        id = model->newNode(cache_node.type,
+                 cache_node.name  >= 0 ? cache->string(cache_node.name)  : "",
+                 cache_node.label >= 0 ? cache->string(cache_node.label) : "");
+
+        XDFTreeNode &node = model->node(id);
+
+        if (cache_node.value >= 0)
+            node.value  = model->addString(cache->string(cache_node.value));
+        if (cache_node.dims >= 0)
+            node.dims   = model->addDims(cache_node.n_dims, cache->dims(cache_node.dims));
+        if (cache_node.record >= 0)
+            node.record = model->addRecord(cache->record(cache_node.record),
+                                           cache_node.record_size);
+
+        node.size      = cache_node.size;
+        node.id        = cache_node.id;
+        node.count     = cache_node.count;
+        node.data_type = cache_node.data_type;
+        node.n_dims    = cache_node.n_dims;
+        node.flags     = cache_node.flags;
+
+        ids[i] = id;
+
+        addNode(ids[cache_node.parent], last_child[cache_node.parent], id);
+        last_child[cache_node.parent] = id;
+    }
+
+    free(ids);
+    free(last_child);
+
+    return status;
+}
+
+
+
+/*
+ * Merges the nodes of a reload into the tree under root.  The scanned tree is
+ * rebuilt from the pending nodes and compared with the existing one level by
+ * level, matching children by type and name.  Matched nodes are kept and
+ * updated in place, the rest are removed or linked.  The scanned nodes that
+ * were matched stay in the arenas until the model is cleared.
+ */
+void XDFTreeView::mergePendingNodes(int root)
+{
+    int i;
+    int j;
+
+    QList<PendingNode> nodes;
+    QHash<int, QVector<int> > children;
+
+    pending_mutex.lock();
+    nodes = pending_nodes;
+    pending_nodes.clear();
+    pending_mutex.unlock();
+
+    for (i = 0; i < nodes.size(); ++i) {
+        QVector<int> &list = children[nodes[i].parent];
+
+        if (nodes[i].after < 0)
+            j = 0;
+        else if (list.size() > 0 && list.last() == nodes[i].after)
+            j = list.size();
+        else
+            j = list.indexOf(nodes[i].after) + 1;
+
+        list.insert(j, nodes[i].node);
+    }
+
+    mergeChildren(root, children.value(root), children);
+}
+
+
+
+/*
+ * Nodes of a reload are matched to existing nodes by type and name.
+ */
+QString XDFTreeView::nodeKey(int id)
+{
+    return QString::number(model->node(id).type) + "/" + model->string(model->node(id).name);
+}
+
+
+
+void XDFTreeView::mergeChildren(int parent, const QVector<int> &ids,
+                                const QHash<int, QVector<int> > &children)
+{
+    int i;
+    int j;
+    int n;
+    int id;
+    int after;
+
+    QString key;
+
+    QHash<QString, QList<int> > old_ids;
+    QHash<int, int> matches;
+    QHash<int, int> kept;
+    QVector<int> run;
+
+    n = model->childCount(parent);
+    for (i = 0; i < n; ++i) {
+        id = model->child(parent, i);
+        old_ids[nodeKey(id)].append(id);
+    }
+
+    for (i = 0; i < ids.size(); ++i) {
+        key = nodeKey(ids[i]);
+        if (old_ids.contains(key) && ! old_ids[key].isEmpty()) {
+            id = old_ids[key].takeFirst();
+            matches[ids[i]] = id;
+            kept[id] = ids[i];
+        }
+    }
+
+    /*
+     * Remove the nodes that are gone, in runs, from the end.
+     */
+    for (i = n - 1; i >= 0; i = j) {
+        for (j = i; j >= 0 && ! kept.contains(model->child(parent, j)); --j) ;
+
+        if (j < i)
+            model->removeNodes(parent, j + 1, i - j);
+        else
+            --j;
+    }
+
+    /*
+     * Update the nodes that are kept and link the new ones in scan order.
+     */
+    after = -1;
+    for (i = 0; i < ids.size(); ) {
+        if (matches.contains(ids[i])) {
+            id = matches[ids[i]];
+
+            if (updateNode(id, ids[i]))
+                mergeChildren(id, children.value(ids[i]), children);
+
+            after = id;
+            ++i;
+            continue;
+        }
+
+        run.clear();
+        for ( ; i < ids.size() && ! matches.contains(ids[i]); ++i)
+            run.append(ids[i]);
+
+        model->insertNodes(parent, model->childRowAfter(parent, after), run);
+
+        for (j = 0; j < run.size(); ++j)
+            linkChildren(run[j], children);
+
+        after = run.last();
+    }
+}
+
+
+
+void XDFTreeView::linkChildren(int id, const QHash<int, QVector<int> > &children)
+{
+    int i;
+
+    QVector<int> ids;
+
+    ids = children.value(id);
+    if (ids.size() == 0)
+        return;
+
+    model->insertNodes(id, 0, ids);
+
+    for (i = 0; i < ids.size(); ++i)
+        linkChildren(ids[i], children);
+}
+
+
+
+/*
+ * Copies the scanned node new_id into the existing node id and repaints it if
+ * anything changed.  Returns whether the children of id should be merged,
+ * which is not the case when id was populated on expansion but the scan left
+ * new_id unpopulated, in which case the existing children are kept as is.
+ */
+bool XDFTreeView::updateNode(int id, int new_id)
+{
+    int i;
+
+    bool changed;
+
+    XDFTreeNode &node = model->node(id);
+    const XDFTreeNode &new_node = model->node(new_id);
+
+    changed = strcmp(model->string(node.label), model->string(new_node.label)) != 0 ||
+              node.size      != new_node.size      ||
+              node.id        != new_node.id        ||
+              node.count     != new_node.count     ||
+              node.data_type != new_node.data_type ||
+              node.n_dims    != new_node.n_dims    ||
+              (node.flags & XDFTreeModel::HasDataTable) !=
+              (new_node.flags & XDFTreeModel::HasDataTable);
+
+    if (! changed && (node.value < 0) != (new_node.value < 0))
+        changed = true;
+    if (! changed && node.value >= 0 &&
+        strcmp(model->string(node.value), model->string(new_node.value)) != 0)
+        changed = true;
+
+    for (i = 0; ! changed && i < node.n_dims; ++i) {
+        if (model->dims(node.dims)[i] != model->dims(new_node.dims)[i])
+            changed = true;
+    }
+
+    if (! changed && (node.record < 0) != (new_node.record < 0))
+        changed = true;
+    if (! changed && node.record >= 0 &&
+        (model->recordSize(node.record) != model->recordSize(new_node.record) ||
+         memcmp(model->record(node.record), model->record(new_node.record),
+                model->recordSize(node.record)) != 0))
+        changed = true;
+
+    if (changed) {
+        node.label     = new_node.label;
+        node.value     = new_node.value;
+        node.dims      = new_node.dims;
+        node.record    = new_node.record;
+        node.size      = new_node.size;
+        node.id        = new_node.id;
+        node.count     = new_node.count;
+        node.data_type = new_node.data_type;
+        node.n_dims    = new_node.n_dims;
+
+        model->indexNode(id);
+        model->nodeChanged(id);
+    }
+
+    if (new_node.flags & XDFTreeModel::Unpopulated &&
+        ! (node.flags & XDFTreeModel::Unpopulated)) {
+        node.flags = new_node.flags & ~XDFTreeModel::Unpopulated;
+        return false;
+    }
+
+    node.flags = new_node.flags;
+
+    return true;
+}
+
+
+
+void XDFTreeView::finishLoad()
+{
+    if (! is_loading || loader->isRunning())
+        return;
+
+    if (! is_reloading)
+        linkPendingNodes(INT_MAX);
+    else if (loader->loadStatus() == 0)
+        mergePendingNodes(loader->loadRoot());
+    else
+        discardLoad();
+
+    if (loader->loadStatus() == 0 && ! loader->isRestored())
+        loader->saveCache(model);
+
+    is_cacheable = loader->loadStatus() == 0;
+
+    is_loading = false;
+
+    addPreviews();
+
+    emit loadFinished(loader->loadStatus());
+
+    is_reloading = false;
+}
+
+
+
+/*
+ * Asks the loader to stop.  The nodes loaded so far are kept, unless this is
+ * a reload in which case the tree is left as it was, and loadFinished() is
+ * emitted with Canceled when the loader returns.
+ */
+void XDFTreeView::cancelLoad()
+{
+    load_canceled = true;
+
+    XDFTreeViewLoader::wakeAll();
+}
+
+
+
+/*
+ * Stops the loader and waits for it, dropping the nodes not yet linked.
+ */
+void XDFTreeView::stopLoad()
+{
+    if (! is_loading)
+        return;
+
+    cancelLoad();
+
+    loader->wait();
+
+    discardLoad();
+
+    is_loading = false;
+
+    addPreviews();
+
+    emit loadFinished(XDFProcessor::Canceled);
+
+    is_reloading = false;
+}
+
+
+
+QVariant XDFTreeView::nodeData(int id, int column, int role)
+{
+    if (role == Qt::DisplayRole) {
+        if (model->node(id).flags & XDFTreeModel::PreviewPending &&
+            ! (model->node(id).flags & XDFTreeModel::PreviewRequested))
+            requestPreview(id);
+
+        return nodeText(id, column);
+    }
+
+    if (role == Qt::ForegroundRole && column == 0 && is_colorized)
+        return nodeColor(id);
+
+    return QVariant();
+}
+
+
+
+QString XDFTreeView::nodeText(int id, int column)
+{
+    if (column == 0)
+        return model->string(model->node(id).label);
+
+    return QString();
+}
+
+
+
+QColor XDFTreeView::nodeColor(int id)
+{
+    return QColor(0, 0, 0);
+}
+
+
+
+int XDFTreeView::populate(int id)
+{
+    return 0;
+}
+
+
+
+/*
+ * Reads the previews of the nodes ids into values, in order, with the library
+ * lock held.  Called on the preview loader's thread.  A preview should read at
+ * most max_preview_size bytes.  An empty value is shown as no preview.
+ */
+int XDFTreeView::loadPreviews(const QVector<int> &ids, QList<QByteArray> &values)
+{
+    return 0;
+}
+
+
+
+/*
+ * Called as a node flagged PreviewPending is first displayed.  The loader
+ * keeps only the most recent requests so that rows scrolled past quickly are
+ * not read.  A dropped request is made again if its row is displayed again.
+ */
+void XDFTreeView::requestPreview(int id)
+{
+    int dropped;
+
+    model->node(id).flags |= XDFTreeModel::PreviewRequested;
+
+    dropped = preview_loader->request(id);
+    if (dropped >= 0)
+        model->node(dropped).flags &= ~XDFTreeModel::PreviewRequested;
+
+    if (! preview_loader->isRunning())
+        preview_loader->start();
+}
+
+
+
+/*
+ * Called on the preview loader's thread to hand previews over to the GUI
+ * thread.
+ */
+void XDFTreeView::postPreviews(const QVector<int> &ids, const QList<QByteArray> &values)
+{
+    int i;
+
+    bool post;
+
+    preview_mutex.lock();
+    for (i = 0; i < ids.size(); ++i) {
+        Preview preview = {ids[i], values[i]};
+        previews.append(preview);
+    }
+    post = ! previews_posted;
+    previews_posted = true;
+    preview_mutex.unlock();
+
+    if (post)
+        emit previewsPending();
+}
+
+
+
+/*
+ * Sets the values of the nodes whose previews have been read.  Strings may
+ * only be added to the model by one thread at a time so while loading this
+ * waits for finishLoad().
+ */
+void XDFTreeView::addPreviews()
+{
+    int i;
+
+    QList<Preview> list;
+
+    preview_mutex.lock();
+    previews_posted = false;
+    if (! is_loading) {
+        list = previews;
+        previews.clear();
+    }
+    preview_mutex.unlock();
+
+    for (i = 0; i < list.size(); ++i) {
+        XDFTreeNode &node = model->node(list[i].id);
+
+        if (! (node.flags & XDFTreeModel::PreviewPending))
+            continue;
+
+        node.flags &= ~(XDFTreeModel::PreviewPending | XDFTreeModel::PreviewRequested);
+
+        if (! list[i].value.isEmpty()) {
+            node.value = model->addString(list[i].value.constData());
+            model->indexNode(list[i].id);
+        }
+
+        model->nodeChanged(list[i].id);
+    }
+
+    if (list.size() > 0 && is_cacheable && ! cache_dirty) {
+        cache_dirty = true;
+        QTimer::singleShot(cache_interval, this, SLOT(saveCache()));
+    }
+}
+
+
+
+/*
+ * Rewrites the cache once previews have been read so that a tree restored
+ * from it shows them without opening the file.  Previews that arrive close
+ * together are saved at once.
+ */
+void XDFTreeView::saveCache()
 {
-    name = strdup(name_);
+    if (! cache_dirty)
+        return;
+
+    cache_dirty = false;
+
+    if (is_cacheable && ! is_loading)
+        loader->saveCache(model);
 }
 
 
 
-XDFTreeViewItem::XDFTreeViewItem(XDFTreeViewItem *parent, XDFTreeViewItem *after, const char *name_)
-    : QTreeWidgetItem((QTreeWidgetItem *) parent, (QTreeWidgetItem *) after), has_data_table(false)
+void XDFTreeView::populateItem(const QModelIndex &index)
 {
-    name = strdup(name_);
-}
+    int id;
 
+    QMutex *mutex;
 
+    id = model->nodeId(index);
 
-XDFTreeViewItem::~XDFTreeViewItem()
-{
-    free(name);
-}
+    if (! (model->node(id).flags & XDFTreeModel::Unpopulated))
+        return;
 
+    /*
+     * Rather than block the GUI while this or another view's loader holds the
+     * library, try again shortly.
+     */
+    mutex = XDFV::libraryMutex(file_type);
 
+    if (isLoading() || ! mutex->tryLock()) {
+        populate_retry.append(QPersistentModelIndex(index));
+        QTimer::singleShot(populate_interval, this, SLOT(retryPopulate()));
+        return;
+    }
 
-bool XDFTreeViewItem::hasDataTable()
-{
-    return has_data_table;
+    model->node(id).flags &= ~XDFTreeModel::Unpopulated;
+
+    if (populate(id))
+        fprintf(stderr, "ERROR: populate(), item_name = %s\n",
+                model->string(model->node(id).name));
+
+    mutex->unlock();
 }
 
 
 
-void XDFTreeViewItem::setHasDataTable(bool has)
+void XDFTreeView::retryPopulate()
 {
-    has_data_table = has;
+    int i;
+
+    QList<QPersistentModelIndex> indexes;
+
+    indexes = populate_retry;
+    populate_retry.clear();
+
+    for (i = 0; i < indexes.size(); ++i) {
+        if (indexes[i].isValid() && isExpanded(indexes[i]))
+            populateItem(indexes[i]);
+    }
 }
 
 
 
-XDFTreeView::XDFTreeView(const char *file_name_, XDFV::FileType file_type, QWidget *parent)
-    : QTreeWidget(parent), file_type(file_type)
+void XDFTreeView::showContextMenu(const QPoint &point)
 {
-    file_name = strdup(file_name_);
-/*
-    setAutoScroll(false);
-*/
-    setRootIsDecorated(true);
-    setSortingEnabled(false);
-    setContextMenuPolicy(Qt::CustomContextMenu);
-    QObject::connect(this, SIGNAL(customContextMenuRequested(const QPoint &)), this, SLOT(showContextMenu(const QPoint &)));
+    int id;
+
+    QMenu menu(this);
+
+    id = currentNode();
+
+    QAction *copy_item_name_action = new QAction("Copy item name", this);
+    connect(copy_item_name_action, SIGNAL(triggered()), this, SLOT(copyItemName()));
+    menu.addAction(copy_item_name_action);
+
+    menu.addSeparator();
+
+    QAction *view_data_table_action = new QAction("View data table", this);
+    view_data_table_action->setEnabled(id >= 0 && model->node(id).flags & XDFTreeModel::HasDataTable);
+    connect(view_data_table_action, SIGNAL(triggered()), this, SLOT(showDataTable()));
+    menu.addAction(view_data_table_action);
+
+    QAction *statistics_action = new QAction("Statistics", this);
+    statistics_action->setEnabled(id >= 0 && model->node(id).flags & XDFTreeModel::HasDataTable);
+    connect(statistics_action, SIGNAL(triggered()), this, SLOT(showStatistics()));
+    menu.addAction(statistics_action);
+
+    menu.exec(mapToGlobal(point));
 }
 
 
 
-XDFTreeView::~XDFTreeView()
+void XDFTreeView::copyItemName()
 {
-    free(file_name);
+    if (currentNode() >= 0)
+        copyItemName(currentNode());
 }
 
 
 
-const char *XDFTreeView::filename()
+void XDFTreeView::copyItemName(int id)
 {
-    return file_name;
+    const char *name = model->string(model->node(id).name);
+
+    QApplication::clipboard()->setText(name, QClipboard::Clipboard);
+    QApplication::clipboard()->setText(name, QClipboard::Selection);
 }
 
 
 
-XDFV::FileType XDFTreeView::fileType()
+/*
+ * Returns the path of a node, that of its parent and its name joined by '/',
+ * or its name if that is already a full path.  The path of the file node is
+ * empty.  own is set to the offset of the node's own name in the path.
+ */
+QByteArray XDFTreeView::nodePath(int id, int *own)
 {
-    return file_type;
+    int n;
+
+    const char *name;
+
+    QByteArray path;
+
+    const XDFTreeNode &node = model->node(id);
+
+    if (node.parent < 0) {
+        n = 0;
+        path = "";
+    }
+    else {
+        name = model->string(node.name);
+
+        if (name[0] == '/') {
+            path = name;
+            n = path.lastIndexOf('/') + 1;
+        }
+        else {
+            path = nodePath(node.parent);
+            if (! path.endsWith('/'))
+                path += '/';
+            n = path.size();
+            path += name;
+        }
+    }
+
+    if (own)
+        *own = n;
+
+    return path;
 }
 
 
 
-void XDFTreeView::load()
+bool XDFTreeView::selectNode(int id)
 {
+    if (id < 0 || id >= model->nodeCount() || ! model->isLinked(id))
+        return false;
 
+    setCurrentNode(id);
+
+    return true;
 }
 
 
 
-void XDFTreeView::showContextMenu(const QPoint &point)
+/*
+ * Returns the XDFSearchQuery::Rank with which a node matches query or -1.
+ */
+int XDFTreeView::matchNode(const XDFSearchQuery &query, int id)
 {
-    QMenu menu(this);
+    int own;
+    int rank;
 
-    QAction *copy_item_name_action = new QAction("Copy item name", this);
-    connect(copy_item_name_action, SIGNAL(triggered()), this, SLOT(copyItemName()));
-    menu.addAction(copy_item_name_action);
+    QByteArray path;
 
-    menu.addSeparator();
+    const XDFTreeNode &node = model->node(id);
 
-    QAction *view_data_table_action = new QAction("View data table", this);
-    view_data_table_action->setEnabled(((XDFTreeViewItem *) currentItem())->hasDataTable());
-    connect(view_data_table_action, SIGNAL(triggered()), this, SLOT(showDataTable()));
-    menu.addAction(view_data_table_action);
+    if (query.isPath()) {
+        path = nodePath(id, &own);
+        return query.matchPath(path.constData(), own);
+    }
 
-    menu.exec(mapToGlobal(point));
+    rank = query.matchName(model->string(node.label));
+    if (rank < 0 && node.value >= 0)
+        rank = query.matchValue(model->string(node.value));
+
+    return rank;
 }
 
 
 
-void XDFTreeView::copyItemName()
+/*
+ * Appends the linked nodes that match query to hits, in ascending order of
+ * node id, and returns how many were found.  Candidates are looked up in the
+ * model's search index, or if the query has no strings to look up every node
+ * is checked.
+ */
+int XDFTreeView::search(const XDFSearchQuery &query, QVector<XDFSearchHit> &hits)
 {
-    copyItemName((XDFTreeViewItem *) currentItem(), 0);
+    int i;
+    int n;
+    int id;
+
+    QVector<int> ids;
+
+    XDFSearchHit hit;
+
+    if (! query.isValid())
+        return 0;
+
+    n = hits.size();
+
+    hit.view = this;
+
+    if (model->searchIndex().lookup(query.requiredLiterals(), ids)) {
+        for (i = 0; i < ids.size(); ++i) {
+            if (! model->isLinked(ids[i]))
+                continue;
+            if ((hit.rank = matchNode(query, ids[i])) >= 0) {
+                hit.id = ids[i];
+                hits.append(hit);
+            }
+        }
+    }
+    else {
+        for (id = model->nextNode(-1); id >= 0; id = model->nextNode(id)) {
+            if ((hit.rank = matchNode(query, id)) >= 0) {
+                hit.id = id;
+                hits.append(hit);
+            }
+        }
+    }
+
+    return hits.size() - n;
 }
 
 
 
-void XDFTreeView::copyItemName(XDFTreeViewItem *item, int column)
+void XDFTreeView::markHits(const XDFSearchQuery &query, QBitArray &marks)
 {
-    QApplication::clipboard()->setText(item->name, QClipboard::Clipboard);
-    QApplication::clipboard()->setText(item->name, QClipboard::Selection);
+    int i;
+
+    QVector<XDFSearchHit> hits;
+
+    search(query, hits);
+
+    marks.fill(false, model->nodeCount());
+    for (i = 0; i < hits.size(); ++i)
+        marks.setBit(hits[i].id);
 }
 
 
 
-void XDFTreeView::find(QString &name)
+/*
+ * Selects the next node after the current one, or from the first node if
+ * from_start is true, that matches query.  Returns false if there is none.
+ */
+bool XDFTreeView::find(const XDFSearchQuery &query, bool from_start)
 {
-    QTreeWidgetItemIterator it(this);
+    int id;
 
-    if (currentItem()) {
-        it = QTreeWidgetItemIterator(currentItem());
-        it++;
-    }
+    QBitArray marks;
 
-    while (*it) {
-        if ((*it)->text(0).contains(name)) {
-            setCurrentItem(*it);
-            return;
+    markHits(query, marks);
+
+    for (id = model->nextNode(from_start ? -1 : currentNode()); id >= 0;
+         id = model->nextNode(id)) {
+        if (marks.testBit(id)) {
+            setCurrentNode(id);
+            return true;
         }
-        ++it;
     }
+
+    return false;
 }
 
 
 
-void XDFTreeView::findPrev(QString &name)
+bool XDFTreeView::findPrev(const XDFSearchQuery &query, bool from_end)
 {
-    QTreeWidgetItemIterator it(this);
+    int id;
 
-    if (currentItem()) {
-        it = QTreeWidgetItemIterator(currentItem());
-        it--;
-    }
+    QBitArray marks;
+
+    if (! from_end && currentNode() < 0)
+        return false;
 
-    while (*it) {
-        if ((*it)->text(0).contains(name)) {
-            setCurrentItem(*it);
-            return;
+    markHits(query, marks);
+
+    for (id = model->prevNode(from_end ? -1 : currentNode()); id >= 0;
+         id = model->prevNode(id)) {
+        if (marks.testBit(id)) {
+            setCurrentNode(id);
+            return true;
         }
-        --it;
     }
+
+    return false;
 }
 
 
 
-void XDFTreeView::selectAll(QString &name)
+int XDFTreeView::selectAll(const XDFSearchQuery &query)
 {
-    bool flag = true;
+    int n;
+    int id;
 
-    QTreeWidgetItemIterator it(this);
+    QBitArray marks;
 
-    while (*it) {
-        if ((*it)->text(0).contains(name)) {
-            if (flag) {
-                setCurrentItem(*it);
-                flag = false;
-            }
+    markHits(query, marks);
+
+    n = 0;
+
+    for (id = model->nextNode(-1); id >= 0; id = model->nextNode(id)) {
+        if (marks.testBit(id)) {
+            if (n == 0)
+                setCurrentNode(id);
             else
-                (*it)->setSelected(true);
+                selectionModel()->select(model->nodeIndex(id),
+                    QItemSelectionModel::Select | QItemSelectionModel::Rows);
+            n++;
         }
-
-        ++it;
     }
+
+    return n;
 }
 
 
 
+/*
+ * Unlike QTreeView::expandAll() this emits expanded() for each node so that
+ * unpopulated nodes are populated on the way.
+ */
 void XDFTreeView::expandAll()
 {
-    QTreeWidgetItemIterator it(this);
+    int id;
 
-    while (*it) {
-        expandItem(*it);
-        ++it;
-    }
+    for (id = model->nextNode(-1); id >= 0; id = model->nextNode(id))
+        expand(model->nodeIndex(id));
 }
 
 
 
 void XDFTreeView::collapseAll()
 {
-    QTreeWidgetItemIterator it(this);
-
-    while (*it) {
-        collapseItem(*it);
-        ++it;
-    }
+    QTreeView::collapseAll();
 }
 
 
 
 void XDFTreeView::showDataTable()
 {
-    if (currentItem() != NULL)
-        showDataTable((XDFTreeViewItem *) currentItem(), 0);
+    if (currentNode() >= 0)
+        showDataTable(currentNode());
+}
+
+
+
+void XDFTreeView::showDataTable(int id)
+{
+
+}
+
+
+
+void XDFTreeView::showStatistics()
+{
+    if (currentNode() >= 0)
+        showStatistics(currentNode());
 }
 
 
 
-void XDFTreeView::showDataTable(XDFTreeViewItem *item, int column)
+void XDFTreeView::showStatistics(int id)
 {
 
 }
@@ -260,25 +1286,281 @@ void XDFTreeView::changeFontSize(int delta)
 void XDFTreeView::mousePressEvent(QMouseEvent *event)
 {
     setAutoScroll(false);
-    QTreeWidget::mousePressEvent(event);
+    QTreeView::mousePressEvent(event);
     setAutoScroll(true);
 }
 
 
 
-void XDFTreeView::colorize(QTreeWidgetItem *item, bool color)
+void XDFTreeView::colorizeAll(bool color)
 {
+    is_colorized = color;
 
+    viewport()->update();
 }
 
 
 
-void XDFTreeView::colorizeAll(bool color)
+QMutex XDFTreeViewLoader::queue_mutex;
+QWaitCondition XDFTreeViewLoader::queue_changed;
+QHash<QMutex *, QList<XDFTreeViewLoader *> > XDFTreeViewLoader::queues;
+
+
+
+XDFTreeViewLoader::XDFTreeViewLoader(XDFTreeView *view)
+    : view(view), root(-1), cache(NULL), is_restored(false), status(0)
+{
+    library_mutex = XDFV::libraryMutex(view->fileType());
+}
+
+
+
+XDFTreeViewLoader::~XDFTreeViewLoader()
+{
+    delete cache;
+}
+
+
+
+void XDFTreeViewLoader::setRoot(int root_)
+{
+    root = root_;
+}
+
+
+
+int XDFTreeViewLoader::loadRoot()
+{
+    return root;
+}
+
+
+
+int XDFTreeViewLoader::loadStatus()
+{
+    return status;
+}
+
+
+
+bool XDFTreeViewLoader::isRestored()
+{
+    return is_restored;
+}
+
+
+
+/*
+ * Called on the GUI thread once the scanned tree has been linked.  The cache
+ * is keyed on the file as it was when the scan started.
+ */
+int XDFTreeViewLoader::saveCache(XDFTreeModel *model)
+{
+    if (cache == NULL)
+        return -1;
+
+    return cache->save(model, root);
+}
+
+
+
+/*
+ * Called on the GUI thread before start() so that the files given on the
+ * command line are loaded in order and the first tab is ready first.
+ */
+void XDFTreeViewLoader::queue()
+{
+    QMutexLocker locker(&queue_mutex);
+
+    queues[library_mutex].append(this);
+}
+
+
+
+void XDFTreeViewLoader::wakeAll()
+{
+    QMutexLocker locker(&queue_mutex);
+
+    queue_changed.wakeAll();
+}
+
+
+
+/*
+ * Waits until this loader is at the front of its library's queue.  Returns
+ * false if the load was canceled while waiting.
+ */
+bool XDFTreeViewLoader::waitTurn()
+{
+    QMutexLocker locker(&queue_mutex);
+
+    while (queues[library_mutex].first() != this) {
+        if (view->isLoadCanceled())
+            return false;
+
+        queue_changed.wait(&queue_mutex);
+    }
+
+    return true;
+}
+
+
+
+void XDFTreeViewLoader::endTurn()
+{
+    QMutexLocker locker(&queue_mutex);
+
+    queues[library_mutex].removeOne(this);
+
+    queue_changed.wakeAll();
+}
+
+
+
+void XDFTreeViewLoader::run()
+{
+    delete cache;
+    cache = new XDFTreeCache(view->filename(), view->fileType(), view->loadOptions());
+
+    is_restored = cache->open();
+
+    if (is_restored) {
+        status = view->restoreItems(cache, root);
+        cache->close();
+    }
+    else if (! waitTurn())
+        status = XDFProcessor::Canceled;
+    else {
+        QMutexLocker locker(library_mutex);
+
+        status = view->loadItems(root);
+    }
+
+    endTurn();
+
+    view->flushNodes(true);
+}
+
+
+
+XDFPreviewLoader::XDFPreviewLoader(XDFTreeView *view)
+    : view(view), is_busy(false), is_stopping(false)
+{
+    library_mutex = XDFV::libraryMutex(view->fileType());
+}
+
+
+
+XDFPreviewLoader::~XDFPreviewLoader()
+{
+
+}
+
+
+
+/*
+ * Queues a preview of node id.  Returns the id of the oldest request if it
+ * had to be dropped to make room or -1.
+ */
+int XDFPreviewLoader::request(int id)
+{
+    int dropped;
+
+    QMutexLocker locker(&mutex);
+
+    dropped = -1;
+    if (requests.size() == max_requests) {
+        dropped = requests.first();
+        requests.remove(0);
+    }
+
+    requests.append(id);
+
+    changed.wakeAll();
+
+    return dropped;
+}
+
+
+
+/*
+ * Drops the queued requests and waits for the batch being read, if any.
+ */
+void XDFPreviewLoader::cancel()
+{
+    QMutexLocker locker(&mutex);
+
+    requests.clear();
+
+    while (is_busy)
+        changed.wait(&mutex);
+}
+
+
+
+void XDFPreviewLoader::stop()
+{
+    mutex.lock();
+    is_stopping = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    wait();
+}
+
+
+
+void XDFPreviewLoader::run()
 {
-    QTreeWidgetItemIterator it(this);
+    bool locked;
+
+    int i;
+
+    QVector<int> ids;
+    QList<QByteArray> values;
+
+    for ( ; ; ) {
+        mutex.lock();
+        while (requests.isEmpty() && ! is_stopping)
+            changed.wait(&mutex);
+        if (is_stopping) {
+            mutex.unlock();
+            break;
+        }
+        ids = requests;
+        requests.clear();
+        is_busy = true;
+        mutex.unlock();
+
+        /*
+         * Another view's loader may hold the library for a long time so check
+         * now and then whether the view is going away.
+         */
+        locked = false;
+        while (! is_stopping) {
+            locked = library_mutex->tryLock(lock_interval);
+            if (locked)
+                break;
+        }
+
+        if (locked) {
+            values.clear();
+
+            if (view->loadPreviews(ids, values))
+                fprintf(stderr, "ERROR: loadPreviews(), file_name = %s\n",
+                        view->filename());
+
+            library_mutex->unlock();
+
+            for (i = values.size(); i < ids.size(); ++i)
+                values.append(QByteArray());
+
+            view->postPreviews(ids, values);
+        }
 
-    while (*it) {
-        colorize(*it, color);
-        ++it;
+        mutex.lock();
+        is_busy = false;
+        changed.wakeAll();
+        mutex.unlock();
     }
 }
@@ -10,29 +10,159 @@
 #ifndef XDFTREEVIEW_H
 #define XDFTREEVIEW_H
 
-#include <qstandarditemmodel.h>
-#include <qtreewidget.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include <qbitarray.h>
+#include <qbytearray.h>
+#include <qelapsedtimer.h>
+#include <qcolor.h>
+#include <qhash.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qpersistentmodelindex.h>
+#include <qthread.h>
+#include <qtreeview.h>
+#include <qvector.h>
+#include <qwaitcondition.h>
 
 #include "xdfv.h"
+#include "xdfsearchindex.h"
+#include "xdftreemodel.h"
 
 
-class XDFTreeViewItem;
+class XDFPreviewLoader;
+class XDFTreeCache;
+class XDFTreeView;
+class XDFTreeViewLoader;
 
 
-class XDFTreeView : public QTreeWidget
+/*
+ * A node found by XDFTreeView::search() and its XDFSearchQuery::Rank.
+ */
+struct XDFSearchHit
+{
+    XDFTreeView *view;
+    int id;
+    int rank;
+};
+
+
+
+/*
+ * A tree of the objects in a file.  The tree is kept in an XDFTreeModel as
+ * compact nodes identified by int ids.  The format specific views create the
+ * nodes from the processor callbacks, which pass node ids back and forth as
+ * opaque pointers through nodePointer() and nodeId(), and format the columns
+ * of a node on demand in nodeText().
+ */
+class XDFTreeView : public QTreeView
 {
     Q_OBJECT
 
-    QStandardItemModel *model;
+    XDFTreeModel *model;
+
+    friend class XDFPreviewLoader;
+    friend class XDFTreeViewLoader;
 
 private:
+    struct PendingNode {
+        int parent;
+        int after;
+        int node;
+    };
+
+    struct Preview {
+        int id;
+        QByteArray value;
+    };
+
+    static const int flush_size     = 256;
+    static const int flush_interval = 100;
+    static const int max_link_size  = 4096;
+
+    static const int populate_interval = 100;
+
+    static const int restore_interval = 4096;
+
+    static const int cache_interval = 2000;
+
     char *file_name;
     XDFV::FileType file_type;
 
+    bool is_colorized;
+
+    XDFTreeViewLoader *loader;
+
+    bool is_loading;
+    bool is_reloading;
+    bool is_cacheable;
+    bool cache_dirty;
+    std::atomic<bool> load_canceled;
+    int load_progress;
+
+    QList<PendingNode> load_batch;
+    QElapsedTimer load_timer;
+
+    QMutex pending_mutex;
+    QList<PendingNode> pending_nodes;
+    bool pending_posted;
+
+    QList<QPersistentModelIndex> populate_retry;
+
+    XDFPreviewLoader *preview_loader;
+
+    QMutex preview_mutex;
+    QList<Preview> previews;
+    bool previews_posted;
+
     void mousePressEvent(QMouseEvent *event);
 
+    void flushNodes(bool all);
+    int linkPendingNodes(int max);
+    void discardLoad();
+
+    int restoreItems(XDFTreeCache *cache, int root);
+
+    void mergePendingNodes(int root);
+    QString nodeKey(int id);
+    void mergeChildren(int parent, const QVector<int> &ids,
+                       const QHash<int, QVector<int> > &children);
+    void linkChildren(int id, const QHash<int, QVector<int> > &children);
+    bool updateNode(int id, int new_id);
+
+    int matchNode(const XDFSearchQuery &query, int id);
+    void markHits(const XDFSearchQuery &query, QBitArray &marks);
+
+    void requestPreview(int id);
+    void postPreviews(const QVector<int> &ids, const QList<QByteArray> &values);
+
 protected:
-    virtual void colorize(QTreeWidgetItem *item, bool color);
+    static void *nodePointer(int id) { return (void *) (intptr_t) (id + 1); }
+    static int nodeId(const void *pointer) { return (int) (intptr_t) pointer - 1; }
+
+    XDFTreeModel *treeModel();
+
+    int currentNode();
+    void setCurrentNode(int id);
+
+    void setHeaderLabels(const QStringList &labels);
+
+    virtual QString nodeText(int id, int column);
+    virtual QColor nodeColor(int id);
+    virtual int populate(int id);
+    virtual int loadPreviews(const QVector<int> &ids, QList<QByteArray> &values);
+
+    static const int max_preview_size = 4096;
+
+    virtual int loadItems(int root);
+    virtual int loadOptions();
+    void startLoad(int root);
+    bool isLoadCanceled();
+    void reportProgress(long done, long total);
+
+    int addNode(int parent, int after, int id);
 
 public:
     XDFTreeView(const char *file_name, XDFV::FileType file_type, QWidget *parent = 0);
@@ -42,43 +172,142 @@ public:
     XDFV::FileType fileType();
 
     virtual void load();
+    void reload();
+    void clear();
+
+    bool isLoading();
+    bool isReloading();
+
+    QVariant nodeData(int id, int column, int role);
+
+    QByteArray nodePath(int id, int *own = NULL);
+    bool selectNode(int id);
+
+    int search(const XDFSearchQuery &query, QVector<XDFSearchHit> &hits);
+    bool find(const XDFSearchQuery &query, bool from_start);
+    bool findPrev(const XDFSearchQuery &query, bool from_end);
+    int selectAll(const XDFSearchQuery &query);
+
+signals:
+    void itemsPending();
+    void previewsPending();
+
+    void loadRangeChanged(int minimum, int maximum);
+    void loadProgress(int value);
+    void loadFinished(int status);
 
 public slots:
     void showContextMenu(const QPoint &point);
 
     void copyItemName();
-    void copyItemName(XDFTreeViewItem *item, int column);
-
-    void find(QString &name);
-    void findPrev(QString &name);
-    void selectAll(QString &name);
+    void copyItemName(int id);
 
     void expandAll();
     void collapseAll();
     void colorizeAll(bool color);
+    void populateItem(const QModelIndex &index);
+
+    void showDataTable();
+    virtual void showDataTable(int id);
 
-    virtual void showDataTable();
-    virtual void showDataTable(XDFTreeViewItem *item, int column);
+    void showStatistics();
+    virtual void showStatistics(int id);
 
     void setFontSize(int size);
     void changeFontSize(int delta);
+
+    void cancelLoad();
+    void stopLoad();
+
+private slots:
+    void addPendingNodes();
+    void addPreviews();
+    void finishLoad();
+    void saveCache();
+    void retryPopulate();
 };
 
 
-class XDFTreeViewItem : public QTreeWidgetItem
+/*
+ * Runs XDFTreeView::loadItems() for a view on a worker thread.  Loaders that
+ * use the same library lock run one at a time in the order they were queued
+ * while loaders for different libraries run concurrently.  If the file has a
+ * valid XDFTreeCache the tree is restored from it instead, without the library
+ * lock.
+ */
+class XDFTreeViewLoader : public QThread
 {
 private:
-    bool has_data_table;
+    static QMutex queue_mutex;
+    static QWaitCondition queue_changed;
+    static QHash<QMutex *, QList<XDFTreeViewLoader *> > queues;
+
+    XDFTreeView *view;
+    int root;
+
+    QMutex *library_mutex;
+
+    XDFTreeCache *cache;
+    bool is_restored;
+
+    int status;
+
+    bool waitTurn();
+    void endTurn();
+
+protected:
+    void run();
 
 public:
-    char *name;
+    XDFTreeViewLoader(XDFTreeView *view);
+    ~XDFTreeViewLoader();
+
+    void setRoot(int root);
+    int loadRoot();
+    int loadStatus();
+
+    bool isRestored();
+    int saveCache(XDFTreeModel *model);
+
+    void queue();
+    static void wakeAll();
+};
+
+
+
+/*
+ * Reads the previews of the nodes an XDFTreeView displays with
+ * XDFTreeView::loadPreviews() on a worker thread, a batch at a time, so that
+ * the value column fills in as rows are scrolled into view without the load
+ * or the GUI reading any data.  Only the most recent requests are kept, see
+ * request().
+ */
+class XDFPreviewLoader : public QThread
+{
+private:
+    static const int max_requests  = 256;
+    static const int lock_interval = 100;
+
+    XDFTreeView *view;
+
+    QMutex *library_mutex;
 
-    XDFTreeViewItem(XDFTreeView *parent, const char *name_);
-    XDFTreeViewItem(XDFTreeViewItem *parent, XDFTreeViewItem *after, const char *name_);
-    ~XDFTreeViewItem();
+    QMutex mutex;
+    QWaitCondition changed;
+    QVector<int> requests;
+    bool is_busy;
+    std::atomic<bool> is_stopping;
+
+protected:
+    void run();
+
+public:
+    XDFPreviewLoader(XDFTreeView *view);
+    ~XDFPreviewLoader();
 
-    bool hasDataTable();
-    void setHasDataTable(bool has);
+    int request(int id);
+    void cancel();
+    void stop();
 };
 
 #endif /* XDFTREEVIEW_H */
@@ -7,11 +7,22 @@
  *
  ******************************************************************************/
 
+#include <unistd.h>
+
 #include <qapplication.h>
+#include <qmutex.h>
 
 #include "version.h"
 #include "xdfv.h"
+#include "xdfdump.h"
 #include "xdfmainwindow.h"
+#include "xdfhandlepool.h"
+#include "xdfinventory.h"
+#include "xdfpyramid.h"
+#include "xdfstatistics.h"
+#include "xdftableview.h"
+#include "xdftilecache.h"
+#include "xdftreecache.h"
 
 
 const char *program_name = "xdfv";
@@ -30,13 +41,24 @@ void version();
 int main(int argc, char *argv[])
 {
     char *file_names[MAX_FILES];
+    char *statistics_name;
+    char *inventory_dir;
+    char *search_pattern;
+    char statistics[LN];
 
     int i_file;
     int n_files;
+    int lazy;
+    int cache;
     int view_in_color;
     int expand_all;
     int collapse_all;
     int font_size;
+    int tile_cache;
+    int dump;
+    int dump_format;
+    int jobs;
+    int status;
 
     int window_width;
     int window_height;
@@ -47,15 +69,29 @@ int main(int argc, char *argv[])
 
     XDFV::FileType file_types[MAX_FILES];
 
+    XDFStatistics::Result result;
+
 
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
     i_file = -1;
 
+    statistics_name = NULL;
+    inventory_dir   = NULL;
+    search_pattern  = NULL;
+
+    dump        = 0;
+    dump_format = XDFDumpEmitter::Text;
+
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
     expand_all    = 0;
     collapse_all  = 1;
     font_size     = 0;
+    lazy          = 0;
+    cache         = 1;
+    tile_cache    = 256;
     view_in_color = 1;
     window_width  = 850;
     window_height = 400;
@@ -65,7 +101,19 @@ int main(int argc, char *argv[])
 
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
-            if (strcmp(argv[i], "--expand_all") == 0) {
+            if (strcmp(argv[i], "--cache") == 0)
+                cache = 1;
+            else if (strcmp(argv[i], "--no-cache") == 0)
+                cache = 0;
+            else if (strcmp(argv[i], "--dump") == 0) {
+                dump        = 1;
+                dump_format = XDFDumpEmitter::Text;
+            }
+            else if (strcmp(argv[i], "--dump_json") == 0) {
+                dump        = 1;
+                dump_format = XDFDumpEmitter::JSON;
+            }
+            else if (strcmp(argv[i], "--expand_all") == 0) {
                 expand_all   = 1;
                 collapse_all = 0;
             }
@@ -101,6 +149,27 @@ int main(int argc, char *argv[])
                 usage();
                 exit(0);
             }
+            else if (strcmp(argv[i], "--inventory") == 0)
+                inventory_dir = argv[++i];
+            else if (strcmp(argv[i], "--jobs") == 0) {
+                try {
+                    jobs = string_to_int(argv[++i]);
+                }
+                catch (...) {
+                    fprintf(stderr, "ERROR: Invalid value for --jobs <n>: %s\n", argv[i]);
+                    exit(1);
+                }
+                if (jobs < 1) {
+                    fprintf(stderr, "ERROR: Invalid value for --jobs <n>: %s\n", argv[i]);
+                    exit(1);
+                }
+            }
+            else if (strcmp(argv[i], "--lazy") == 0)
+                lazy = 1;
+            else if (strcmp(argv[i], "--no-lazy") == 0)
+                lazy = 0;
+            else if (strcmp(argv[i], "--search") == 0)
+                search_pattern = argv[++i];
             else if (strcmp(argv[i], "--sds") == 0)
                 assume_sds[i_file] = 1;
             else if (strcmp(argv[i], "--vgroups") == 0)
@@ -109,6 +178,21 @@ int main(int argc, char *argv[])
                 view_in_color = 1;
             else if (strcmp(argv[i], "--no-view_in_color") == 0)
                 view_in_color = 0;
+            else if (strcmp(argv[i], "--statistics") == 0)
+                statistics_name = argv[++i];
+            else if (strcmp(argv[i], "--tile_cache") == 0) {
+                try {
+                    tile_cache = string_to_int(argv[++i]);
+                }
+                catch (...) {
+                    fprintf(stderr, "ERROR: Invalid value for --tile_cache <size>: %s\n", argv[i]);
+                    exit(1);
+                }
+                if (tile_cache < 0) {
+                    fprintf(stderr, "ERROR: Invalid value for --tile_cache <size>: %s\n", argv[i]);
+                    exit(1);
+                }
+            }
             else if (strcmp(argv[i], "--version") == 0) {
                 version();
                 exit(0);
@@ -144,14 +228,142 @@ int main(int argc, char *argv[])
     n_files = i_file + 1;
 
 
+    /*--------------------------------------------------------------------------
+     * With --statistics print the statistics of the object in each file and
+     * exit without starting the GUI.
+     *------------------------------------------------------------------------*/
+    if (statistics_name) {
+        for (int i = 0; i < n_files; ++i) {
+            try {
+                if (file_types[i] == XDFV::Unknown &&
+                    (file_types[i] = XDFMainWindow::file_type_from_extension(file_names[i])) ==
+                    XDFV::Unknown) {
+                    fprintf(stderr, "ERROR: Unknown file extension: %s\n", file_names[i]);
+                    exit(1);
+                }
+            }
+            catch (XDFMainWindow::ErrorCode e) {
+                fprintf(stderr, "ERROR: File does not exist: %s\n", file_names[i]);
+                exit(1);
+            }
+
+            XDFStatistics s(file_types[i], file_names[i], statistics_name);
+            if (s.compute(&result)) {
+                fprintf(stderr, "ERROR: Unable to compute statistics of %s in %s\n",
+                        statistics_name, file_names[i]);
+                exit(1);
+            }
+
+            XDFStatistics::format(result, statistics, LN);
+            printf("%s: %s\n%s", file_names[i], statistics_name, statistics);
+        }
+
+        exit(0);
+    }
+
+
+    /*--------------------------------------------------------------------------
+     * With --dump or --dump_json write the tree of each file to stdout as it
+     * is scanned and exit without starting the GUI.  Errors go to stderr and
+     * do not stop the remaining files.
+     *------------------------------------------------------------------------*/
+    if (dump) {
+        XDFDumpEmitter emitter((XDFDumpEmitter::Format) dump_format);
+
+        status = 0;
+
+        for (int i = 0; i < n_files; ++i) {
+            try {
+                if (file_types[i] == XDFV::Unknown &&
+                    (file_types[i] = XDFMainWindow::file_type_from_extension(file_names[i])) ==
+                    XDFV::Unknown) {
+                    fprintf(stderr, "ERROR: Unknown file extension: %s\n", file_names[i]);
+                    status = 1;
+                    continue;
+                }
+            }
+            catch (XDFMainWindow::ErrorCode e) {
+                fprintf(stderr, "ERROR: File does not exist: %s\n", file_names[i]);
+                status = 1;
+                continue;
+            }
+
+            switch(emitter.dumpFile(file_types[i], file_names[i], assume_sds[i])) {
+                case 0:
+                    break;
+                case XDFProcessor::FileNotFound:
+                    fprintf(stderr, "ERROR: File does not exist: %s\n", file_names[i]);
+                    status = 1;
+                    break;
+                case XDFProcessor::UnableToOpenFile:
+                    fprintf(stderr, "ERROR: Unable to open file, invalid format or file "
+                            "corrupt: %s\n", file_names[i]);
+                    status = 1;
+                    break;
+                default:
+                    fprintf(stderr, "ERROR: Unable to dump %s\n", file_names[i]);
+                    status = 1;
+                    break;
+            }
+        }
+
+        exit(status);
+    }
+
+
+    /*--------------------------------------------------------------------------
+     * With --inventory index the files under each file or directory given into
+     * a tree of indexes under the inventory directory, in --jobs worker
+     * processes, and exit without starting the GUI.
+     *------------------------------------------------------------------------*/
+    if (inventory_dir) {
+        XDFInventory inventory(inventory_dir, jobs);
+
+        status = 0;
+
+        for (int i = 0; i < n_files; ++i) {
+            if (inventory.addPath(file_names[i]))
+                status = 1;
+        }
+
+        if (inventory.run() != 0)
+            status = 1;
+
+        exit(status);
+    }
+
+
+    /*--------------------------------------------------------------------------
+     * With --search print the nodes matching the pattern in each index or
+     * directory of indexes given and exit without starting the GUI.
+     *------------------------------------------------------------------------*/
+    if (search_pattern) {
+        status = 0;
+
+        for (int i = 0; i < n_files; ++i) {
+            if (XDFInventory::search(search_pattern, file_names[i], stdout) < 0)
+                status = 1;
+        }
+
+        exit(status);
+    }
+
+
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
     QApplication a(argc, argv);
 
+    XDFHandlePool::instance();
+
+    XDFTreeCache::setEnabled(cache);
+    XDFTileCache::setMaxSize((size_t) tile_cache * 1024 * 1024);
+
     main_window = new XDFMainWindow();
     main_window->resize(window_width, window_height);
 
+    main_window->tabTreeView()->setLazyLoad(lazy);
+
     for (int i = 0; i < n_files; ++i) {
         try {
             if (file_types[i] == XDFV::Unknown)
@@ -189,6 +401,9 @@ int main(int argc, char *argv[])
 
     a.exec();
 
+    XDFTablePrefetcher::instance()->stop();
+    XDFPyramidBuilder::instance()->stop();
+
     a.~QApplication();
 
     exit(0);
@@ -196,6 +411,26 @@ int main(int argc, char *argv[])
 
 
 
+/*
+ * The HDF4, HDF5, and NetCDF libraries are not built thread safe.  Every call
+ * into one of them, from the tree view loaders as well as from the GUI thread,
+ * is made while holding its lock.  NetCDF-4 files are read through the HDF5
+ * library so NetCDF shares the HDF5 lock.  Files of different libraries can be
+ * read concurrently.
+ */
+QMutex *XDFV::libraryMutex(FileType file_type)
+{
+    static QMutex hdf4_mutex(QMutex::Recursive);
+    static QMutex hdf5_mutex(QMutex::Recursive);
+
+    if (file_type == HDF4)
+        return &hdf4_mutex;
+
+    return &hdf5_mutex;
+}
+
+
+
 int string_to_int(const std::string &s)
 {
     int result;
@@ -242,6 +477,11 @@ void usage()
     printf("Usage: xdfv [OPTIONS] [FILE 1 | FILE 2 | FILE 3 | ...]\n");
     printf("\n");
     printf("Options:\n");
+    printf("    --cache:               Restore trees from ~/.cache/xdfv when unchanged (default).\n");
+    printf("    --no-cache:            Always scan files and do not write the cache.\n");
+    printf("    --dump:                Write the tree of each file to stdout as text and exit\n");
+    printf("                           without opening a window.\n");
+    printf("    --dump_json:           As --dump but one JSON object per node and line.\n");
     printf("    --expand_all:          Start with the tree view expanded.\n");
     printf("    --collapse_all:        Start with the tree view collapsed (default).\n");
     printf("    --font_size <size>:    Font point size.\n");
@@ -249,7 +489,17 @@ void usage()
     printf("    --hdf5   <filename>:   Open \"filename\" as an HDF5 file.\n");
     printf("    --netcdf <filename>:   Open \"filename\" as a NetCDF file.\n");
     printf("    --help:                Print this help content.\n");
+    printf("    --inventory <dir>:     Index the files under each file or directory given into\n");
+    printf("                           \"dir\" and exit without opening a window.\n");
+    printf("    --jobs <n>:            Worker processes for --inventory (number of CPUs).\n");
+    printf("    --lazy:                Enumerate HDF5 groups when they are first expanded.\n");
+    printf("    --no-lazy:             Enumerate the whole file when it is opened (default).\n");
+    printf("    --search <pattern>:    Print the nodes whose paths match \"pattern\", a substring\n");
+    printf("                           or glob, in each index or directory of indexes given.\n");
     printf("    --sds:                 Scan HDF4 file as a set of SDS's, ignore VGroups.\n");
+    printf("    --statistics <name>:   Print the statistics of dataset/variable \"name\" in each\n");
+    printf("                           file and exit without opening a window.\n");
+    printf("    --tile_cache <size>:   Megabytes of dataset tiles kept for tables (256).\n");
     printf("    --vgroups:             Scan HDF4 through VGroups (default).\n");
     printf("    --view_in_color:       Use color for the tree view (default).\n");
     printf("    --no-view_in_color:    Use b/w for the tree view.\n");
@@ -33,6 +33,9 @@ extern const char *program_name;
 extern const char *PROGRAM_NAME;
 
 
+class QMutex;
+
+
 namespace XDFV
 {
     enum FileType {
@@ -41,6 +44,8 @@ namespace XDFV
         NetCDF,
         Unknown
     };
+
+    QMutex *libraryMutex(FileType file_type);
 }
 
 #endif /* XDFV_H */
@@ -14,18 +14,24 @@
 #include "hdf5processor.h"
 
 
-int HDF5Processor::procHDF5File(const char *file_name, const void *parent)
+int HDF5Processor::procHDF5File(const char *file_name, const void *parent, int lazy_)
 {
+    int status;
+
     void *item;
 
     FILE *fp;
 
     hid_t file_id;
+    hid_t group_id;
 
     H5E_auto2_t error_func;
     void *error_client_data;
 
 
+    lazy = lazy_;
+
+
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
@@ -51,6 +57,7 @@ int HDF5Processor::procHDF5File(const char *file_name, const void *parent)
      *------------------------------------------------------------------------*/
     if (functionInit(file_id)) {
         fprintf(stderr, "ERROR: functionInit(), file_name = %s\n", file_name);
+        H5Fclose(file_id);
         return -1;
     }
 
@@ -58,9 +65,26 @@ int HDF5Processor::procHDF5File(const char *file_name, const void *parent)
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
+    group_id = H5Gopen(file_id, "/", H5P_DEFAULT);
+    if (group_id < 0) {
+        fprintf(stderr, "ERROR: H5Gopen(), group_name = /\n");
+        H5Fclose(file_id);
+        return -1;
+    }
+
+    visited.clear();
+
     item = NULL;
-    if (processH5G(parent, &item, file_id, "/", 0) < 0) {
+    if ((status = processH5G(parent, &item, group_id, "/", object_key(group_id), 0)) < 0) {
         fprintf(stderr, "ERROR: processH5G(), file_name = %s\n", file_name);
+        H5Gclose(group_id);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+    if (H5Gclose(group_id) < 0) {
+        fprintf(stderr, "ERROR: H5Gclose(), group_name = /\n");
+        H5Fclose(file_id);
         return -1;
     }
 
@@ -70,6 +94,7 @@ int HDF5Processor::procHDF5File(const char *file_name, const void *parent)
      *------------------------------------------------------------------------*/
     if (functionFree(file_id)) {
         fprintf(stderr, "ERROR: functionFree(), file_name = %s\n", file_name);
+        H5Fclose(file_id);
         return -1;
     }
 
@@ -83,7 +108,98 @@ int HDF5Processor::procHDF5File(const char *file_name, const void *parent)
     }
 
 
-    return 0;
+    return status > 0 ? Canceled : 0;
+}
+
+
+
+int HDF5Processor::procHDF5Group(const char *file_name, const char *group_name,
+                                 const void *parent)
+{
+    int status;
+
+    FILE *fp;
+
+    hid_t file_id;
+    hid_t group_id;
+
+    H5E_auto2_t error_func;
+    void *error_client_data;
+
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    fp = fopen(file_name, "r");
+    if (fp == NULL)
+        return FileNotFound;
+    fclose(fp);
+
+    H5Eget_auto(H5E_DEFAULT, &error_func, &error_client_data);
+    H5Eset_auto(H5E_DEFAULT, NULL, NULL);
+    file_id = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
+    H5Eset_auto(H5E_DEFAULT, error_func, error_client_data);
+    if (file_id < 0)
+        return UnableToOpenFile;
+
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    if (functionInit(file_id)) {
+        fprintf(stderr, "ERROR: functionInit(), file_name = %s\n", file_name);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+
+    /*--------------------------------------------------------------------------
+     * Enumerate one level below the group.  Groups found there are deferred
+     * again when in lazy mode.
+     *------------------------------------------------------------------------*/
+    group_id = H5Gopen(file_id, group_name, H5P_DEFAULT);
+    if (group_id < 0) {
+        fprintf(stderr, "ERROR: H5Gopen(), group_name = %s\n", group_name);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+    visited[object_key(group_id)] = (void *) parent;
+
+    if ((status = processH5GMembers(parent, group_id, group_name, 0)) < 0) {
+        fprintf(stderr, "ERROR: processH5GMembers(), group_name = %s\n", group_name);
+        H5Gclose(group_id);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+    if (H5Gclose(group_id) < 0) {
+        fprintf(stderr, "ERROR: H5Gclose(), group_name = %s\n", group_name);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    if (functionFree(file_id)) {
+        fprintf(stderr, "ERROR: functionFree(), file_name = %s\n", file_name);
+        H5Fclose(file_id);
+        return -1;
+    }
+
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    if (H5Fclose(file_id) < 0) {
+        fprintf(stderr, "ERROR: H5Fclose(), file_name = %s\n", file_name);
+        return -1;
+    }
+
+
+    return status > 0 ? Canceled : 0;
 }
 
 
@@ -100,91 +216,186 @@ const char *HDF5Processor::indent_string(int depth)
 
 
 
-herr_t HDF5Processor::H5Aiterate_operator(hid_t loc_id, const char *attr_name,
-                                          void *operator_data)
+/*
+ * Objects are identified by their address in the file, which for a hard link
+ * is given by the link itself.
+ */
+QString HDF5Processor::object_key(hid_t obj_id)
 {
-    struct operator_data_type *operator_data2;
+#if H5_VERSION_GE(1, 12, 0)
+    char *token;
 
-    operator_data2 = (struct operator_data_type *) operator_data;
+    QString key;
+
+    H5O_info2_t obj_info;
+
+    if (H5Oget_info3(obj_id, &obj_info, H5O_INFO_BASIC) < 0)
+        return QString();
+
+    if (H5Otoken_to_str(obj_id, &obj_info.token, &token) < 0)
+        return QString();
+
+    key = token;
+
+    H5free_memory(token);
+
+    return key;
+#else
+    H5O_info_t obj_info;
+
+    if (H5Oget_info(obj_id, &obj_info) < 0)
+        return QString();
+
+    return QString::number((qulonglong) obj_info.addr);
+#endif
+}
+
+
+
+QString HDF5Processor::object_key(hid_t loc_id, const H5L_info_t *link_info)
+{
+#if H5_VERSION_GE(1, 12, 0)
+    char *token;
+
+    QString key;
+
+    if (H5Otoken_to_str(loc_id, &link_info->u.token, &token) < 0)
+        return QString();
+
+    key = token;
+
+    H5free_memory(token);
+
+    return key;
+#else
+    return QString::number((qulonglong) link_info->u.address);
+#endif
+}
+
+
+
+/*
+ * The number of attributes of an object, in place of H5Aget_num_attrs().
+ */
+int HDF5Processor::object_num_attrs(hid_t obj_id)
+{
+#if H5_VERSION_GE(1, 12, 0)
+    H5O_info2_t obj_info;
 
-    if (operator_data2->object->processH5A(operator_data2->parent,
-        &operator_data2->after, loc_id, attr_name, operator_data2->depth) < 0) {
-        fprintf(stderr, "ERROR: processH5A(), attr_name = %s\n", attr_name);
+    if (H5Oget_info3(obj_id, &obj_info, H5O_INFO_NUM_ATTRS) < 0)
         return -1;
-    }
+#elif H5_VERSION_GE(1, 10, 3)
+    H5O_info_t obj_info;
 
-    return 0;
+    if (H5Oget_info2(obj_id, &obj_info, H5O_INFO_NUM_ATTRS) < 0)
+        return -1;
+#else
+    H5O_info_t obj_info;
+
+    if (H5Oget_info(obj_id, &obj_info) < 0)
+        return -1;
+#endif
+    return obj_info.num_attrs;
+}
+
+
+
+/*
+ * Attributes and links are visited in creation order if the object keeps an
+ * index of it and otherwise in name order.
+ */
+H5_index_t HDF5Processor::order_index(unsigned int order_flags)
+{
+    return order_flags & H5P_CRT_ORDER_INDEXED ? H5_INDEX_CRT_ORDER : H5_INDEX_NAME;
 }
 
 
 
-herr_t HDF5Processor::H5Giterate_operator(hid_t group_id, const char *member_name,
+herr_t HDF5Processor::H5Literate_operator(hid_t group_id, const char *link_name,
+                                          const H5L_info_t *link_info,
                                           void *operator_data)
 {
-    H5G_stat_t statbuf;
+    int status = 0;
 
     struct operator_data_type *operator_data2;
 
-    if (H5Gget_objinfo(group_id, member_name, 0, &statbuf) < 0) {
-        fprintf(stderr, "ERROR: processH5D(), member_name = %s\n", member_name);
-        return -1;
-    }
-
     operator_data2 = (struct operator_data_type *) operator_data;
 
-    switch (statbuf.type) {
-        case H5G_GROUP:
-            if (operator_data2->object->processH5G(operator_data2->parent,
-                &operator_data2->after, group_id, member_name, operator_data2->depth) < 0) {
-                fprintf(stderr, "ERROR: processH5G(), member_name = %s\n", member_name);
-                return -1;
-            }
-            break;
-        case H5G_DATASET:
-            if (operator_data2->object->processH5D(operator_data2->parent,
-                &operator_data2->after, group_id, member_name, operator_data2->depth) < 0) {
-                fprintf(stderr, "ERROR: processH5D(), member_name = %s\n", member_name);
-                return -1;
-            }
-            break;
-        case H5G_TYPE:
-            fprintf(stderr, "WARNING: Named datatype processing not supported, "
-                            "member_name = %s\n", member_name);
-            break;
-        case H5G_LINK:
-            fprintf(stderr, "WARNING: Symbolic link processing not supported, "
-                            "member_name = %s\n", member_name);
-            break;
-        case H5G_UDLINK:
-            fprintf(stderr, "WARNING: User-defined link processing not supported, "
-                            "member_name = %s\n", member_name);
-            break;
-        default:
-            fprintf(stderr, "WARNING: Unable to identify an object, "
-                            "member_name = %s\n", member_name);
+    if (operator_data2->object->functionCanceled())
+        return 1;
+
+    if (link_info->type == H5L_TYPE_HARD) {
+        if ((status = operator_data2->object->processH5O(operator_data2->parent,
+            &operator_data2->after, group_id, link_name, link_info, operator_data2->depth)) < 0) {
+            fprintf(stderr, "ERROR: processH5O(), link_name = %s\n", link_name);
+            return -1;
+        }
+    }
+    else {
+        if ((status = operator_data2->object->processH5L(operator_data2->parent,
+            &operator_data2->after, group_id, link_name, link_info, operator_data2->depth)) < 0) {
+            fprintf(stderr, "ERROR: processH5L(), link_name = %s\n", link_name);
+            return -1;
+        }
     }
 
-    return 0;
+    if (operator_data2->depth == 1)
+        operator_data2->object->functionProgress(++operator_data2->object->progress_done,
+                                                 operator_data2->object->progress_total);
+
+    return status;
 }
 
 
 
 int HDF5Processor::processH5A(const void *parent, void **after, hid_t loc_id,
-                              const char *attr_name, int depth)
+                              H5_index_t index_type, hsize_t attr_index, int depth)
 {
+    char *attr_name;
+
+    ssize_t length;
+
     void *item;
 
     hid_t attr_id;
 
-    attr_id = H5Aopen(loc_id, attr_name, H5P_DEFAULT);
+    attr_id = H5Aopen_by_idx(loc_id, ".", index_type, H5_ITER_INC, attr_index,
+                             H5P_DEFAULT, H5P_DEFAULT);
     if (attr_id < 0) {
-        fprintf(stderr, "ERROR: H5Aopen(), attribute_name = %s\n", attr_name);
+        fprintf(stderr, "ERROR: H5Aopen_by_idx(), attr_index = %llu\n",
+                (unsigned long long) attr_index);
+        return -1;
+    }
+
+    length = H5Aget_name(attr_id, 0, NULL);
+    if (length < 0) {
+        fprintf(stderr, "ERROR: H5Aget_name(), attr_index = %llu\n",
+                (unsigned long long) attr_index);
+        H5Aclose(attr_id);
+        return -1;
+    }
+
+    attr_name = (char *) malloc((length + 1) * sizeof(char));
+    if (attr_name == NULL) {
+        fprintf(stderr, "ERROR: malloc(), attr_index = %llu\n",
+                (unsigned long long) attr_index);
+        H5Aclose(attr_id);
+        return -1;
+    }
+
+    if (H5Aget_name(attr_id, length + 1, attr_name) < 0) {
+        fprintf(stderr, "ERROR: H5Aget_name(), attr_index = %llu\n",
+                (unsigned long long) attr_index);
+        free(attr_name);
+        H5Aclose(attr_id);
         return -1;
     }
 
     item = functionH5A(parent, *after, attr_id, attr_name);
     if (item == NULL) {
         fprintf(stderr, "ERROR: functionH5A(), attribute_name = %s\n", attr_name);
+        free(attr_name);
+        H5Aclose(attr_id);
         return -1;
     }
 
@@ -192,29 +403,63 @@ int HDF5Processor::processH5A(const void *parent, void **after, hid_t loc_id,
 
     if (H5Aclose(attr_id) < 0) {
         fprintf(stderr, "ERROR: H5Aclose(), attribute_name = %s\n", attr_name);
+        free(attr_name);
         return -1;
     }
 
+    free(attr_name);
+
     return 0;
 }
 
 
 
-int HDF5Processor::processH5D(const void *parent, void **after, hid_t loc_id,
-                              const char *dataset_name, int depth)
+/*
+ * Attributes are opened by index, in the same order as the links of a group,
+ * rather than looked up by name.
+ */
+int HDF5Processor::processH5AMembers(const void *item, hid_t loc_id,
+                                     const char *loc_name, H5_index_t index_type,
+                                     int depth)
 {
-    void *item;
-
-    hid_t dataset_id;
+    int i;
+    int n_attr;
 
-    operator_data_type operator_data;
+    void *after;
 
-    dataset_id = H5Dopen(loc_id, dataset_name, H5P_DEFAULT);
-    if (dataset_id < 0) {
-        fprintf(stderr, "ERROR: H5Dopen(), dataset_name = %s\n", dataset_name);
+    n_attr = object_num_attrs(loc_id);
+    if (n_attr < 0) {
+        fprintf(stderr, "ERROR: object_num_attrs(), loc_name = %s\n", loc_name);
         return -1;
     }
 
+    after = NULL;
+    for (i = 0; i < n_attr; ++i) {
+        if (functionCanceled())
+            return 1;
+
+        if (processH5A(item, &after, loc_id, index_type, i, depth + 1) < 0) {
+            fprintf(stderr, "ERROR: processH5A(), loc_name = %s\n", loc_name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+
+int HDF5Processor::processH5D(const void *parent, void **after, hid_t dataset_id,
+                              const char *dataset_name, const QString &key, int depth)
+{
+    int status;
+
+    unsigned int order_flags;
+
+    void *item;
+
+    hid_t plist_id;
+
     item = functionH5D(parent, *after, dataset_id, dataset_name);
     if (item == NULL) {
         fprintf(stderr, "ERROR: functionH5D(), dataset_name = %s\n", dataset_name);
@@ -223,82 +468,317 @@ int HDF5Processor::processH5D(const void *parent, void **after, hid_t loc_id,
 
     *after = item;
 
-    operator_data.depth  = depth + 1;
-    operator_data.parent = item;
-    operator_data.after  = NULL;
-    operator_data.object = this;
+    visited[key] = item;
 
-    if (H5Aiterate1(dataset_id, 0, HDF5Processor::H5Aiterate_operator,
-        &operator_data) < 0) {
-        fprintf(stderr, "ERROR: H5Aiterate1(), dataset_name = %s\n", dataset_name);
+    functionVisited(item, key);
+
+    plist_id = H5Dget_create_plist(dataset_id);
+    if (plist_id < 0) {
+        fprintf(stderr, "ERROR: H5Dget_create_plist(), dataset_name = %s\n", dataset_name);
         return -1;
     }
 
-    if (H5Dclose(dataset_id) < 0) {
-        fprintf(stderr, "ERROR: H5Dclose(), dataset_name = %s\n", dataset_name);
+    if (H5Pget_attr_creation_order(plist_id, &order_flags) < 0) {
+        fprintf(stderr, "ERROR: H5Pget_attr_creation_order(), dataset_name = %s\n", dataset_name);
+        H5Pclose(plist_id);
         return -1;
     }
 
-    return 0;
+    if (H5Pclose(plist_id) < 0) {
+        fprintf(stderr, "ERROR: H5Pclose(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    if ((status = processH5AMembers(item, dataset_id, dataset_name,
+                                    order_index(order_flags), depth)) < 0) {
+        fprintf(stderr, "ERROR: processH5AMembers(), dataset_name = %s\n", dataset_name);
+        return -1;
+    }
+
+    return status;
 }
 
 
 
-int HDF5Processor::processH5G(const void *parent, void **after, hid_t loc_id,
-                              const char *group_name, int depth)
+/*
+ * The group is recorded as visited before its members are processed so that
+ * a link back to it or one of its ancestors is shown rather than followed.
+ */
+int HDF5Processor::processH5G(const void *parent, void **after, hid_t group_id,
+                              const char *group_name, const QString &key, int depth)
 {
+    int status = 0;
+
     void *item;
 
-    hid_t group_id;
+    item = functionH5G(parent, *after, group_id, group_name);
+    if (item == NULL) {
+        fprintf(stderr, "ERROR: functionH5G(), group_name = %s\n", group_name);
+        return -1;
+    }
+
+    *after = item;
+
+    visited[key] = item;
+
+    functionVisited(item, key);
+
+    if (lazy && depth > 0) {
+        if (functionH5GLazy(item, group_id, group_name)) {
+            fprintf(stderr, "ERROR: functionH5GLazy(), group_name = %s\n", group_name);
+            return -1;
+        }
+    }
+    else {
+        if ((status = processH5GMembers(item, group_id, group_name, depth)) < 0) {
+            fprintf(stderr, "ERROR: processH5GMembers(), group_name = %s\n", group_name);
+            return -1;
+        }
+    }
+
+    return status;
+}
+
+
+
+/*
+ * Links and attributes are visited by index, each in the order given by
+ * order_index().
+ */
+int HDF5Processor::processH5GMembers(const void *item, hid_t group_id,
+                                     const char *group_name, int depth)
+{
+    int status;
+
+    unsigned int order_flags;
+    unsigned int attr_order_flags;
+
+    hid_t plist_id;
+
+    H5G_info_t group_info;
 
     operator_data_type operator_data;
 
-    group_id = H5Gopen(loc_id, group_name, H5P_DEFAULT);
-    if (group_id < 0) {
-        fprintf(stderr, "ERROR: H5Gopen(), group_name = %s\n", group_name);
+    if (depth == 0) {
+        if (H5Gget_info(group_id, &group_info) < 0) {
+            fprintf(stderr, "ERROR: H5Gget_info(), group_name = %s\n", group_name);
+            return -1;
+        }
+
+        progress_done  = 0;
+        progress_total = group_info.nlinks;
+    }
+
+    plist_id = H5Gget_create_plist(group_id);
+    if (plist_id < 0) {
+        fprintf(stderr, "ERROR: H5Gget_create_plist(), group_name = %s\n", group_name);
         return -1;
     }
 
-    item = functionH5G(parent, *after, group_id, group_name);
-    if (item == NULL) {
-        fprintf(stderr, "ERROR: functionH5G(), group_name = %s\n", group_name);
+    if (H5Pget_link_creation_order(plist_id, &order_flags) < 0) {
+        fprintf(stderr, "ERROR: H5Pget_link_creation_order(), group_name = %s\n", group_name);
+        H5Pclose(plist_id);
         return -1;
     }
 
-    *after = item;
+    if (H5Pget_attr_creation_order(plist_id, &attr_order_flags) < 0) {
+        fprintf(stderr, "ERROR: H5Pget_attr_creation_order(), group_name = %s\n", group_name);
+        H5Pclose(plist_id);
+        return -1;
+    }
+
+    if (H5Pclose(plist_id) < 0) {
+        fprintf(stderr, "ERROR: H5Pclose(), group_name = %s\n", group_name);
+        return -1;
+    }
 
     operator_data.depth  = depth + 1;
-    operator_data.parent = item;
+    operator_data.parent = (void *) item;
     operator_data.after  = NULL;
     operator_data.object = this;
 
-    if (H5Giterate(loc_id, group_name, NULL, HDF5Processor::H5Giterate_operator,
-        &operator_data) < 0) {
-        fprintf(stderr, "ERROR: H5Giterate(), group_name = %s\n", group_name);
+    if ((status = H5Literate(group_id, order_index(order_flags), H5_ITER_INC, NULL,
+        HDF5Processor::H5Literate_operator, &operator_data)) < 0) {
+        fprintf(stderr, "ERROR: H5Literate(), group_name = %s\n", group_name);
         return -1;
     }
 
-    operator_data.depth  = depth + 1;
-    operator_data.parent = item;
-    operator_data.after  = NULL;
-    operator_data.object = this;
+    if (status > 0)
+        return status;
 
-    if (H5Aiterate1(group_id, 0, HDF5Processor::H5Aiterate_operator,
-        &operator_data) < 0) {
-        fprintf(stderr, "ERROR: H5Aiterate1(), group_name = %s\n", group_name);
+    if ((status = processH5AMembers(item, group_id, group_name,
+                                    order_index(attr_order_flags), depth)) < 0) {
+        fprintf(stderr, "ERROR: processH5AMembers(), group_name = %s\n", group_name);
         return -1;
     }
 
-    if (H5Gclose(group_id) < 0) {
-        fprintf(stderr, "ERROR: H5Gclose(), group_name = %s\n", group_name);
+    return status;
+}
+
+
+
+/*
+ * Soft, external, and user-defined links are shown with their target but not
+ * followed.
+ */
+int HDF5Processor::processH5L(const void *parent, void **after, hid_t group_id,
+                              const char *link_name, const H5L_info_t *link_info,
+                              int depth)
+{
+    char *value;
+    char *target;
+
+    const char *file_name;
+    const char *obj_path;
+
+    unsigned int flags;
+
+    void *item;
+
+    value  = (char *) malloc((link_info->u.val_size + 1) * sizeof(char));
+    target = (char *) malloc((link_info->u.val_size + 2) * sizeof(char));
+    if (value == NULL || target == NULL) {
+        fprintf(stderr, "ERROR: malloc(), link_name = %s\n", link_name);
+        free(value);
+        free(target);
+        return -1;
+    }
+
+    target[0] = '\0';
+
+    if (link_info->type == H5L_TYPE_SOFT ||
+        link_info->type == H5L_TYPE_EXTERNAL) {
+        if (H5Lget_val(group_id, link_name, value, link_info->u.val_size + 1,
+                       H5P_DEFAULT) < 0) {
+            fprintf(stderr, "ERROR: H5Lget_val(), link_name = %s\n", link_name);
+            free(value);
+            free(target);
+            return -1;
+        }
+
+        if (link_info->type == H5L_TYPE_SOFT)
+            snprintf(target, link_info->u.val_size + 2, "%s", value);
+        else {
+            if (H5Lunpack_elink_val(value, link_info->u.val_size, &flags,
+                                    &file_name, &obj_path) < 0) {
+                fprintf(stderr, "ERROR: H5Lunpack_elink_val(), link_name = %s\n", link_name);
+                free(value);
+                free(target);
+                return -1;
+            }
+
+            snprintf(target, link_info->u.val_size + 2, "%s:%s", file_name, obj_path);
+        }
+    }
+
+    item = functionH5L(parent, *after, link_name, link_info->type, target, NULL);
+    if (item == NULL) {
+        fprintf(stderr, "ERROR: functionH5L(), link_name = %s\n", link_name);
+        free(value);
+        free(target);
         return -1;
     }
 
+    *after = item;
+
+    free(value);
+    free(target);
+
     return 0;
 }
 
 
 
+/*
+ * An object that has been seen before is shown as a reference to where it was
+ * first found.  Otherwise it is opened once, whatever its type, in place of
+ * H5Gget_objinfo() followed by an open by name.
+ */
+int HDF5Processor::processH5O(const void *parent, void **after, hid_t group_id,
+                              const char *link_name, const H5L_info_t *link_info,
+                              int depth)
+{
+    int status = 0;
+
+    void *item;
+
+    hid_t obj_id;
+
+    QString key;
+
+    key = object_key(group_id, link_info);
+
+    if (visited.contains(key)) {
+        item = functionH5L(parent, *after, link_name, H5L_TYPE_HARD, NULL, visited[key]);
+        if (item == NULL) {
+            fprintf(stderr, "ERROR: functionH5L(), link_name = %s\n", link_name);
+            return -1;
+        }
+
+        *after = item;
+
+        return 0;
+    }
+
+    obj_id = H5Oopen(group_id, link_name, H5P_DEFAULT);
+    if (obj_id < 0) {
+        fprintf(stderr, "ERROR: H5Oopen(), link_name = %s\n", link_name);
+        return -1;
+    }
+
+    switch (H5Iget_type(obj_id)) {
+        case H5I_GROUP:
+            if ((status = processH5G(parent, after, obj_id, link_name, key, depth)) < 0) {
+                fprintf(stderr, "ERROR: processH5G(), link_name = %s\n", link_name);
+                H5Oclose(obj_id);
+                return -1;
+            }
+            break;
+        case H5I_DATASET:
+            if ((status = processH5D(parent, after, obj_id, link_name, key, depth)) < 0) {
+                fprintf(stderr, "ERROR: processH5D(), link_name = %s\n", link_name);
+                H5Oclose(obj_id);
+                return -1;
+            }
+            break;
+        case H5I_DATATYPE:
+            fprintf(stderr, "WARNING: Named datatype processing not supported, "
+                            "link_name = %s\n", link_name);
+            break;
+        default:
+            fprintf(stderr, "WARNING: Unable to identify an object, "
+                            "link_name = %s\n", link_name);
+    }
+
+    if (H5Oclose(obj_id) < 0) {
+        fprintf(stderr, "ERROR: H5Oclose(), link_name = %s\n", link_name);
+        return -1;
+    }
+
+    return status;
+}
+
+
+
+/*
+ * Restores the visited object at key, such as after the items of a previous
+ * procHDF5File() have been restored from elsewhere, so that procHDF5Group()
+ * still shows links to them as references.
+ */
+void HDF5Processor::addVisited(const QString &key, const void *item)
+{
+    visited[key] = (void *) item;
+}
+
+
+
+bool HDF5Processor::hasVisited() const
+{
+    return ! visited.isEmpty();
+}
+
+
+
 int HDF5Processor::functionInit(hid_t loc_id)
 {
     return 0;
@@ -321,6 +801,18 @@ void *HDF5Processor::functionH5A(const void *parent, const void *after,
 
 
 
+/*
+ * Called with the key of each group and dataset item as it is recorded as
+ * visited, for subclasses that keep their items beyond the processor and
+ * restore them with addVisited().
+ */
+void HDF5Processor::functionVisited(const void *item, const QString &key)
+{
+
+}
+
+
+
 void *HDF5Processor::functionH5D(const void *parent, const void *after,
                                  hid_t dataset_id, const char *dataset_name)
 {
@@ -334,3 +826,20 @@ void *HDF5Processor::functionH5G(const void *parent, const void *after,
 {
     return NULL;
 }
+
+
+
+int HDF5Processor::functionH5GLazy(const void *item, hid_t group_id,
+                                   const char *group_name)
+{
+    return 0;
+}
+
+
+
+void *HDF5Processor::functionH5L(const void *parent, const void *after,
+                                 const char *link_name, H5L_type_t link_type,
+                                 const char *target, const void *target_item)
+{
+    return NULL;
+}
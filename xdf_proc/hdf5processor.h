@@ -12,12 +12,28 @@
 
 #include <hdf5.h>
 
+#include <qhash.h>
+#include <qstring.h>
+
 #include "xdfprocessor.h"
 
 
 class HDF5Processor : public XDFProcessor
 {
 private:
+    int lazy;
+
+    long progress_done;
+    long progress_total;
+
+    /*
+     * The item of each group and dataset processed so far, by object address,
+     * so that objects hard linked from more than one place are only processed
+     * once and cycles are not followed.  Kept from procHDF5File() through the
+     * procHDF5Group() calls that expand its lazy groups.
+     */
+    QHash<QString, void *> visited;
+
     struct operator_data_type {
         int depth;
 
@@ -29,32 +45,57 @@ private:
 
     static const char *indent_string(int depth);
 
-    static herr_t H5Aiterate_operator(hid_t loc_id, const char *attr_name,
-                                      void *operator_data);
-    static herr_t H5Giterate_operator(hid_t group_id, const char *member_name,
+    static QString object_key(hid_t obj_id);
+    static QString object_key(hid_t loc_id, const H5L_info_t *link_info);
+    static H5_index_t order_index(unsigned int order_flags);
+
+    static herr_t H5Literate_operator(hid_t group_id, const char *link_name,
+                                      const H5L_info_t *link_info,
                                       void *operator_data);
 
     int processH5A(const void *parent, void **after, hid_t loc_id,
-                   const char *attr_name, int depth);
-    int processH5D(const void *parent, void **after, hid_t loc_id,
-                   const char *dataset_name, int depth);
-    int processH5G(const void *parent, void **after, hid_t loc_id,
-                   const char *group_name, int depth);
+                   H5_index_t index_type, hsize_t attr_index, int depth);
+    int processH5AMembers(const void *item, hid_t loc_id,
+                          const char *loc_name, H5_index_t index_type,
+                          int depth);
+    int processH5D(const void *parent, void **after, hid_t dataset_id,
+                   const char *dataset_name, const QString &key, int depth);
+    int processH5G(const void *parent, void **after, hid_t group_id,
+                   const char *group_name, const QString &key, int depth);
+    int processH5GMembers(const void *item, hid_t group_id,
+                          const char *group_name, int depth);
+    int processH5L(const void *parent, void **after, hid_t group_id,
+                   const char *link_name, const H5L_info_t *link_info, int depth);
+    int processH5O(const void *parent, void **after, hid_t group_id,
+                   const char *link_name, const H5L_info_t *link_info, int depth);
 
 protected:
+    static int object_num_attrs(hid_t obj_id);
+
+    void addVisited(const QString &key, const void *item);
+    bool hasVisited() const;
+
     virtual int functionInit(hid_t loc_id);
     virtual int functionFree(hid_t loc_id);
     virtual void *functionH5A(const void *parent, const void *after,
                               hid_t attr_id, const char *attr_name);
+    virtual void functionVisited(const void *item, const QString &key);
     virtual void *functionH5D(const void *parent, const void *after,
                               hid_t dataset_id, const char *dataset_name);
     virtual void *functionH5G(const void *parent, const void *after,
                               hid_t group_id, const char *group_name);
+    virtual int functionH5GLazy(const void *item, hid_t group_id,
+                                const char *group_name);
+    virtual void *functionH5L(const void *parent, const void *after,
+                              const char *link_name, H5L_type_t link_type,
+                              const char *target, const void *target_item);
 
 public:
     virtual ~HDF5Processor() { }
 
-    int procHDF5File(const char *file_name, const void *parent);
+    int procHDF5File(const char *file_name, const void *parent, int lazy_ = 0);
+    int procHDF5Group(const char *file_name, const char *group_name,
+                      const void *parent);
 };
 
 #endif /* HDF5PROCESSOR_H */
@@ -34,6 +34,8 @@ int HDFProcessor::procHDFFile(const char *file_name, const char *path,
 
     int32 *refs;
 
+    int canceled;
+
     void *item;
 
     FILE *fp;
@@ -116,13 +118,22 @@ int HDFProcessor::procHDFFile(const char *file_name, const char *path,
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
+    canceled = 0;
+
     if (sds) {
         item = NULL;
         for (int i = 0; i < num_datasets; ++i) {
+            if (functionCanceled()) {
+                canceled = 1;
+                break;
+            }
+
             if (processSDIndex(parent, &item, i, path_nodes, 0) < 0) {
                 fprintf(stderr, "ERROR: processSDIndex(), file_name = %s\n", file_name);
                 return -1;
             }
+
+            functionProgress(i + 1, num_datasets);
         }
     }
     else {
@@ -146,10 +157,17 @@ int HDFProcessor::procHDFFile(const char *file_name, const char *path,
 
         item = NULL;
         for (int i = 0; i < n_refs - 1; ++i) {
+            if (functionCanceled()) {
+                canceled = 1;
+                break;
+            }
+
             if (processVRef(parent, &item, refs[i], path_nodes, 0) < 0) {
                 fprintf(stderr, "ERROR: processVRef(), file_name = %s\n", file_name);
                 return -1;
             }
+
+            functionProgress(i + 1, n_refs - 1);
         }
 
         free(refs);
@@ -221,7 +239,7 @@ int HDFProcessor::procHDFFile(const char *file_name, const char *path,
 
     free(path2);
 
-    return 0;
+    return canceled ? Canceled : 0;
 }
 
 
@@ -241,6 +259,9 @@ int HDFProcessor::processV(const void *parent, void **after,
     }
 
     for (int i = 0; i < n_pairs; ++i) {
+        if (functionCanceled())
+            break;
+
         if (Vgettagref(vgroup_id, i, &vgroup_tag, &vgroup_ref) == FAIL) {
             fprintf(stderr, "ERROR: Vgettagref()\n");
             return -1;
@@ -26,12 +26,7 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
 
     int status;
 
-    int n_dims;
-    int n_vars;
-    int n_gatts;
-    int unlimdim_id;
-
-    void *item;
+    int canceled;
 
     FILE *fp;
 
@@ -59,8 +54,10 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
      *
      *------------------------------------------------------------------------*/
     fp = fopen(file_name, "r");
-    if (fp == NULL)
+    if (fp == NULL) {
+        free(path2);
         return FileNotFound;
+    }
 
     fclose(fp);
 
@@ -70,6 +67,7 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
         fprintf(stderr, "ERROR: nc_open(), file_name = %s, %s\n", file_name,
                nc_strerror(status));
 */
+        free(path2);
         return UnableToOpenFile;
     }
 
@@ -79,6 +77,8 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
      *------------------------------------------------------------------------*/
     if (functionInit(nc_id)) {
         fprintf(stderr, "ERROR: functionInit(), file_name = %s\n", file_name);
+        nc_close(nc_id);
+        free(path2);
         return -1;
     }
 
@@ -86,14 +86,21 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
-    status = nc_inq(nc_id, &n_dims, &n_vars, &n_gatts, &unlimdim_id);
-    if (status != NC_NOERR) {
-        fprintf(stderr, "ERROR: nc_inq(), %s\n", nc_strerror(status));
+    if ((canceled = processGroup(parent, nc_id, path_nodes, 0, 1)) < 0) {
+        fprintf(stderr, "ERROR: processGroup(), file_name = %s\n", file_name);
+        nc_close(nc_id);
+        free(path2);
         return -1;
     }
 
-    if (processAttrs(parent, NC_GLOBAL, n_gatts, 0)) {
-        fprintf(stderr, "ERROR: processAttrs(), file_name = %s\n", file_name);
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    if (functionFree(nc_id)) {
+        fprintf(stderr, "ERROR: functionFree(), file_name = %s\n", file_name);
+        nc_close(nc_id);
+        free(path2);
         return -1;
     }
 
@@ -101,37 +108,117 @@ int NCProcessor::procNCFile(const char *file_name, const char *path, const void
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
-    item = NULL;
-    for (int i = 0; i < n_vars; ++i) {
-        if (processVarID(parent, &item, i, path_nodes, 0) < 0) {
-            fprintf(stderr, "ERROR: processVarID(), file_name = %s\n", file_name);
-            return -1;
-        }
+    status = nc_close(nc_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_close(), file_name = %s, %s\n", file_name,
+               nc_strerror(status));
+        free(path2);
+        return -1;
     }
 
+    free(path2);
+
+    return canceled ? Canceled : 0;
+}
+
+
+
+/*
+ * Enumerate one level below a group when it is expanded, see functionGroup().
+ * The file is closed however the enumeration ends.
+ */
+int NCProcessor::procNCGroup(const char *file_name, const char *group_name,
+                             const void *parent)
+{
+    int status;
+
+    int canceled;
+
+    int file_id;
+
+    FILE *fp;
+
 
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
-    if (functionFree(nc_id)) {
-        fprintf(stderr, "ERROR: functionFree(), file_name = %s\n", file_name);
-        return -1;
-    }
+    fp = fopen(file_name, "r");
+    if (fp == NULL)
+        return FileNotFound;
+
+    fclose(fp);
+
+    status = nc_open(file_name, NC_NOWRITE, &file_id);
+    if (status != NC_NOERR)
+        return UnableToOpenFile;
+
+    nc_id = file_id;
 
 
     /*--------------------------------------------------------------------------
      *
      *------------------------------------------------------------------------*/
-    status = nc_close(nc_id);
+    canceled = enumerateGroup(file_id, file_name, group_name, parent);
+
+
+    /*--------------------------------------------------------------------------
+     *
+     *------------------------------------------------------------------------*/
+    status = nc_close(file_id);
     if (status != NC_NOERR) {
         fprintf(stderr, "ERROR: nc_close(), file_name = %s, %s\n", file_name,
                nc_strerror(status));
         return -1;
     }
 
-    free(path2);
+    if (canceled < 0)
+        return -1;
 
-    return 0;
+    return canceled ? Canceled : 0;
+}
+
+
+
+/*
+ * The part of procNCGroup() done while the file is open.  Returns 1 if
+ * canceled.
+ */
+int NCProcessor::enumerateGroup(int file_id, const char *file_name,
+                                const char *group_name, const void *parent)
+{
+    char *path_nodes[1];
+
+    int status;
+
+    int canceled;
+
+    int grp_id;
+
+    path_nodes[0] = NULL;
+
+    if (functionInit(file_id)) {
+        fprintf(stderr, "ERROR: functionInit(), file_name = %s\n", file_name);
+        return -1;
+    }
+
+    status = nc_inq_grp_full_ncid(file_id, group_name, &grp_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grp_full_ncid(), group_name = %s, %s\n",
+                group_name, nc_strerror(status));
+        return -1;
+    }
+
+    if ((canceled = processGroup(parent, grp_id, path_nodes, 0, 0)) < 0) {
+        fprintf(stderr, "ERROR: processGroup(), group_name = %s\n", group_name);
+        return -1;
+    }
+
+    if (functionFree(file_id)) {
+        fprintf(stderr, "ERROR: functionFree(), file_name = %s\n", file_name);
+        return -1;
+    }
+
+    return canceled;
 }
 
 
@@ -173,6 +260,131 @@ int NCProcessor::processAttrs(const void *parent, int id, int num_attrs, int fla
 
 
 
+/*
+ * Processes the attributes and variables of a group and adds its subgroups
+ * without descending into them, see functionGroup().  nc_id is the group while
+ * it is processed and the group ids are freed however processGroupMembers()
+ * ends.  Returns 1 if canceled.
+ */
+int NCProcessor::processGroup(const void *parent, int grp_id, char **path,
+                              int flags, int progress)
+{
+    int status;
+
+    int *grp_ids;
+
+    int nc_id2;
+
+    nc_id2 = nc_id;
+    nc_id  = grp_id;
+
+    grp_ids = NULL;
+
+    status = processGroupMembers(parent, grp_id, path, flags, progress, &grp_ids);
+
+    free(grp_ids);
+
+    nc_id = nc_id2;
+
+    return status;
+}
+
+
+
+int NCProcessor::processGroupMembers(const void *parent, int grp_id, char **path,
+                                     int flags, int progress, int **grp_ids)
+{
+    int i;
+
+    int status;
+
+    int n_dims;
+    int n_vars;
+    int n_gatts;
+    int unlimdim_id;
+
+    int n_grps;
+
+    void *item;
+
+    status = nc_inq(grp_id, &n_dims, &n_vars, &n_gatts, &unlimdim_id);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq(), %s\n", nc_strerror(status));
+        return -1;
+    }
+
+    status = nc_inq_grps(grp_id, &n_grps, NULL);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grps(), %s\n", nc_strerror(status));
+        return -1;
+    }
+
+    *grp_ids = (int *) malloc((n_grps > 0 ? n_grps : 1) * sizeof(int));
+    if (*grp_ids == NULL) {
+        fprintf(stderr, "ERROR: malloc(), n_grps = %d\n", n_grps);
+        return -1;
+    }
+
+    status = nc_inq_grps(grp_id, NULL, *grp_ids);
+    if (status != NC_NOERR) {
+        fprintf(stderr, "ERROR: nc_inq_grps(), %s\n", nc_strerror(status));
+        return -1;
+    }
+
+    if (processAttrs(parent, NC_GLOBAL, n_gatts, flags)) {
+        fprintf(stderr, "ERROR: processAttrs()\n");
+        return -1;
+    }
+
+    item = NULL;
+    for (i = 0; i < n_vars; ++i) {
+        if (functionCanceled())
+            return 1;
+
+        if (processVarID(parent, &item, i, path, flags) < 0) {
+            fprintf(stderr, "ERROR: processVarID()\n");
+            return -1;
+        }
+
+        if (progress)
+            functionProgress(i + 1, n_vars + n_grps);
+    }
+
+    for (i = 0; i < n_grps; ++i) {
+        if (functionCanceled())
+            return 1;
+
+        item = functionGroup(parent, item, (*grp_ids)[i], &flags);
+        if (item == NULL) {
+            fprintf(stderr, "ERROR: functionGroup()\n");
+            return -1;
+        }
+
+        if (progress)
+            functionProgress(n_vars + i + 1, n_vars + n_grps);
+    }
+
+    return 0;
+}
+
+
+
+/*
+ * Processes a group added by functionGroup() in place, under its item, for
+ * subclasses that want the whole tree in one pass instead of enumerating
+ * groups when they are expanded.  Returns 1 if canceled.
+ */
+int NCProcessor::descendGroup(const void *item, int grp_id)
+{
+    char *path_nodes[1];
+
+    path_nodes[0] = NULL;
+
+    return processGroup(item, grp_id, path_nodes, 0, 0);
+}
+
+
+
 int NCProcessor::processVarID(const void *parent, void **item,
                               int var_id, char **path, int flags)
 {
@@ -265,6 +477,14 @@ void *NCProcessor::functionVarID(const void *parent, const void *after,
 
 
 
+void *NCProcessor::functionGroup(const void *parent, const void *after,
+                                 int grp_id, const int *flags)
+{
+     return NULL;
+}
+
+
+
 int NCProcessor::functionSetAfter(const void *item, const void *after)
 {
      return 0;
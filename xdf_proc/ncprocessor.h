@@ -21,10 +21,19 @@ private:
     int processDims(const void *parent, int var_id, int n_dims,
                     const int *dim_ids, int flags);
     int processAttrs(const void *parent, int id, int num_attrs, int flags);
+    int processGroup(const void *parent, int grp_id, char **path, int flags,
+                     int progress);
+    int processGroupMembers(const void *parent, int grp_id, char **path,
+                            int flags, int progress, int **grp_ids);
+    int enumerateGroup(int file_id, const char *file_name,
+                       const char *group_name, const void *parent);
     int processVarID(const void *parent, void **item,
                      int var_id, char **path, int flags);
 
 protected:
+    /*
+     * The group being processed, the file's root group at the top level.
+     */
     int nc_id;
 
     virtual int functionInit(int var_id);
@@ -35,12 +44,18 @@ protected:
                                 int id, int num_attrs, const int *flags);
     virtual void *functionVarID(const void *parent, const void *after,
                                 int var_id, const int *flags);
+    virtual void *functionGroup(const void *parent, const void *after,
+                                int grp_id, const int *flags);
     virtual int functionSetAfter(const void *item, const void *after);
 
+    int descendGroup(const void *item, int grp_id);
+
 public:
     virtual ~NCProcessor() { }
 
     virtual int procNCFile(const char *file_name, const char *path, const void *parent);
+    virtual int procNCGroup(const char *file_name, const char *group_name,
+                            const void *parent);
 };
 
 #endif /* NCPROCESSOR_H */
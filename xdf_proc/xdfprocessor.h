@@ -19,8 +19,25 @@ class XDFProcessor
 public:
     enum ErrorCode {
          FileNotFound = 1,
-         UnableToOpenFile
+         UnableToOpenFile,
+         Canceled
     };
+
+protected:
+    /*
+     * Polled between objects.  A nonzero return stops the traversal, which
+     * then cleans up and returns Canceled.
+     */
+    virtual int functionCanceled() { return 0; }
+
+    /*
+     * Called after each top level object with the number done so far and the
+     * total number, if known, otherwise zero.
+     */
+    virtual void functionProgress(long done, long total) { }
+
+public:
+    virtual ~XDFProcessor() { }
 };
 
 #endif /* XDFPROCESSOR_H */